@@ -0,0 +1,54 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "common.h"
+#include "log_ring.h"
+
+#define LOG_TASK_STACK 4096
+#define LOG_TASK_PRIORITY 1             // same as the Arduino loop task, so a busy loop cannot starve it
+#define LOG_TASK_IDLE_MS 20             // poll interval while the ring is empty
+#define LOG_LINE_MAX 256
+#define LOG_LEVEL_INHERIT 0xff          // module follows currentLogLevel
+
+/// @brief Deferred logging.
+/// logWrite only checks the level and packs the call into a LogRing slot;
+/// a task formats and writes the lines to Serial, so WiFi/MQTT callbacks no
+/// longer wait on the UART. When the ring is full the line is dropped and
+/// counted, and the next drain reports how many were lost. Until Start()
+/// (and for Flush) lines are written synchronously, as before.
+/// Lines printed straight to Serial can appear ahead of queued log lines.
+class AsyncLog {
+    TaskHandle_t _task = nullptr;
+    LogRing _ring;
+    uint8_t _levels[LOG_MODULE_COUNT];
+    uint32_t _reportedDrops = 0;
+
+    void ReadNVM();
+    void SaveNVM();
+    void Drain();
+    static void LogTask(void* arg);
+
+public:
+    static AsyncLog logger;
+
+    AsyncLog();
+
+    /// @brief Load the module levels and start the log task
+    void Start();
+
+    inline bool Enabled(LogModule module, LogLevel level) const {
+        uint8_t moduleLevel = _levels[module];
+        return level <= (moduleLevel == LOG_LEVEL_INHERIT ? currentLogLevel : moduleLevel);
+    }
+    void Write(LogModule module, LogLevel level, const char* format, va_list args);
+
+    /// @brief Write out everything queued, from the calling task (before a reboot)
+    void Flush();
+
+    /// @brief Level of one module by name, LOG_LEVEL_INHERIT to follow the global level
+    bool SetModuleLevel(const char* module, uint8_t level);
+
+    void Configure(const JsonDocument& doc);
+    JsonDocument describe();
+};
@@ -5,5 +5,7 @@ void loopAwsIot();
 bool isIotConnected();
 bool IoTPublish(const String& topic, const String& payload, bool retained, int qos);
 bool IoTPublish(const String& topic, const JsonDocument& payload, bool retained, int qos);
+bool IoTPublish(const String& topic, const uint8_t* payload, size_t len, bool retained, int qos);
+size_t IoTMaxPayload(const String& topic);
 
 String buildTopicName(const String& topic);
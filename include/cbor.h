@@ -0,0 +1,57 @@
+#pragma once
+
+// Minimal CBOR (RFC 8949) writer for MQTT telemetry, shared by the firmware and
+// the host decoder (tools/cbor_decode.cpp). Plain C++, no Arduino dependencies.
+//
+// Map keys found in the key dictionary are written as small integers (1 byte
+// for the first 23 keys, 2 bytes for the rest) instead of text, which is most
+// of the saving over JSON. Key 0 of the top-level map carries the dictionary
+// version. Numbers use the shortest integer encoding; non-integral numbers
+// are written as float32.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CBOR_DICTIONARY_VERSION 1
+#define CBOR_KEY_VERSION 0
+
+/// @brief Key dictionary, index = integer key. Append only: decoders of older
+/// payloads rely on the existing indexes. Bump CBOR_DICTIONARY_VERSION when
+/// entries are added.
+extern const char* const CBOR_KEYS[];
+extern const size_t CBOR_KEY_COUNT;
+
+/// @brief Dictionary index of key, 0 when it is not in the dictionary
+unsigned cborKeyIndex(const char* key);
+
+/// @brief Writes CBOR items into a caller-provided buffer.
+/// Containers have definite lengths: the caller passes the item count.
+class CborWriter {
+    uint8_t* _buf;
+    size_t _cap;
+    size_t _len = 0;
+    bool _overflow = false;
+
+    void Put(uint8_t b);
+    void Put(const uint8_t* data, size_t len);
+    void Head(uint8_t major, uint64_t value);
+
+public:
+    CborWriter(uint8_t* buf, size_t cap) : _buf(buf), _cap(cap) {}
+
+    void Map(size_t pairs);
+    void Array(size_t items);
+    /// @brief Map key, as its dictionary index when it has one
+    void Key(const char* key);
+    void Uint(uint64_t value);
+    void Int(int64_t value);
+    void Float(double value);
+    void Text(const char* text);
+    void Text(const char* text, size_t len);
+    void Bytes(const uint8_t* data, size_t len);
+    void Bool(bool value);
+    void Null();
+
+    /// @brief Encoded length, 0 when the buffer was too small
+    size_t Length() const { return _overflow ? 0 : _len; }
+};
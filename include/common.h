@@ -4,8 +4,12 @@
 #include <Arduino.h>
 #include <DHT.h>
 #include <Preferences.h>
+#include <ArduinoJson.h>
 #include "esp_camera.h"
 #include "image_analyzer.h"
+#include "upload_scheduler.h"
+#include "shelter_control.h"
+#include "s3_fetch_cache.h"
 
 // Forward declarations and external declarations
 extern "C" {
@@ -14,22 +18,13 @@ extern "C" {
 
 // Timing constants
 #define DHT_READ_INTERVAL 2000  // Read DHT22 every 2 seconds
-#define PHOTO_HOURLY_INTERVAL 600000   // 10 minutes in milliseconds (continuous power available)
-#define PHOTO_MOTION_COOLDOWN 60000    // 1 minute in milliseconds (continuous power available)
 #define STATUS_REPORT_INTERVAL 60000   // Status report every 60 seconds
 #define WIFI_IDLE_TIMEOUT 360000       // UNUSED - WiFi always on with continuous power
-#define BLANKET_MIN_STATE_TIME 300000  // 5 minutes minimum time before blanket can change state
-#define CAT_PRESENCE_TIMEOUT 3600000   // 60 minutes - PIR motion extends presence (PIR is motion, not presence)
 #define WIFI_RETRY_CONNECT 30000 // 30s between WiFi connect attempts
 #define SNTP_NORMAL_INTERVAL 3600000 // 1h SNTP sync once time is set
 #define SNTP_START_INTERVAL 15000 // 15s SNTP sync to obtain the first time
 #define OFFLINE_REBOOT_INTERVAL 15*60*1000 // 15m reboot if not connected
 
-// Temperature threshold for blanket control (in Celsius)
-#define TEMP_COLD_THRESHOLD 13.0  // Turn on blanket if temp is below this and cat present
-#define TEMP_MAX_REASONABLE 45.0  // Maximum reasonable outdoor temperature (detect sensor errors)
-#define TEMP_MIN_REASONABLE -30.0 // Minimum reasonable outdoor temperature (detect sensor errors)
-
 // Boot and recovery settings
 #define MAX_BOOT_ATTEMPTS 3       // Max failed boots before entering safe mode
 #define BOOT_SUCCESS_TIMEOUT 300000  // 5 minutes - if running this long, boot is successful
@@ -37,6 +32,7 @@ extern "C" {
 
 // Camera configuration check interval
 #define CAMERA_CONFIG_CHECK_INTERVAL 3600000  // 60 minutes in milliseconds
+#define CAMERA_CONFIG_S3_FILE "camera_config.json"  // In the device S3 folder
 
 extern const char* deviceName; 
 extern const char* s3Folder;
@@ -122,6 +118,12 @@ class BackOffRetry {
       return _resetCount;
     }
 
+    // Time left until CanRetry() allows the next attempt
+    inline unsigned long RemainingDelay() {
+      unsigned long elapsed = millis() - _lastRetry;
+      return elapsed < _currentDelay ? _currentDelay - elapsed : 0;
+    }
+
     inline void Reset() {
       _currentDelay = 0;
       _lastRetry = 0;
@@ -150,25 +152,45 @@ enum LogLevel {
   LOG_DEBUG = 3
 };
 
-// Logging macro - logPrint implemented as macro using logPrintf
+// Logging modules, each can have a level of its own (see async_log.h)
+enum LogModule {
+  LOG_MODULE_MAIN = 0,
+  LOG_MODULE_WIFI,
+  LOG_MODULE_IOT,
+  LOG_MODULE_UPLOAD,
+  LOG_MODULE_CAMERA,
+  LOG_MODULE_SENSORS,
+  LOG_MODULE_HTTPD,
+  LOG_MODULE_COUNT
+};
+
+// A source file picks its module by defining LOG_MODULE before any include
+#ifndef LOG_MODULE
+#define LOG_MODULE LOG_MODULE_MAIN
+#endif
+
+// Logging macros - both go through logWrite with the file's module
+#define logPrintf(level, ...) logWrite(LOG_MODULE, level, __VA_ARGS__)
 #define logPrint(level, msg) logPrintf(level, "%s", msg)
 
 // External global variables
 extern LogLevel currentLogLevel;
 extern DHT* dht;
-extern bool catPresent;
-extern bool blanketOn;
-extern bool blanketManualOverride;
-extern unsigned long lastBlanketChange;
-extern unsigned long lastMotionDetected;
-extern float currentTemp;
-extern float currentHumidity;
-extern bool dhtSensorWorking;
+// Decision state, the fields of shelter (shelter_control.h)
+extern ShelterState shelter;
+extern bool& catPresent;
+extern bool& blanketOn;
+extern bool& blanketManualOverride;
+extern uint32_t& lastBlanketChange;
+extern uint32_t& lastMotionDetected;
+extern float& currentTemp;
+extern float& currentHumidity;
+extern bool& dhtSensorWorking;
 extern bool wifiManualOverride;
 extern unsigned long lastWiFiActivity;
-extern unsigned long lastPhotoTime;
-extern unsigned long lastHourlyPhotoTime;
-extern bool lastCatPresent;
+extern uint32_t& lastPhotoTime;
+extern uint32_t& lastHourlyPhotoTime;
+extern bool& lastCatPresent;
 extern unsigned long lastStatusReport;
 extern Preferences preferences;
 extern bool safeMode;
@@ -176,6 +198,7 @@ extern bool cameraAvailable;
 extern int bootAttempts;
 extern unsigned long bootStartTime;
 extern unsigned long lastSafeModeRecoveryAttempt;
+extern unsigned long lastCameraConfigCheck;
 
 // Function declarations
 
@@ -183,7 +206,8 @@ extern unsigned long lastSafeModeRecoveryAttempt;
 float getChipTemperature();
 
 // Logging functions
-void logPrintf(LogLevel level, const char* format, ...);
+// Format must be a string literal: it is printed later, by the log task
+void logWrite(LogModule module, LogLevel level, const char* format, ...);
 
 // AWS Signature V4 functions
 void getSHA256AsString(const char *input, size_t input_len, char *output);
@@ -191,8 +215,32 @@ void getSignatureKey(const char *key, const char *dateStamp, const char *regionN
 void generateAWSSignatureV4(const char *method, const char *host, const char *uri,
                            const char *region, const char *accessKey, const char *secretKey,
                            const uint8_t *payload, size_t payload_len,
-                           char *outAuthHeader, char *outAmzDate, char *outPayloadHash);
+                           char *outAuthHeader, char *outAmzDate, char *outPayloadHash,
+                           const char *canonicalQueryString = "");
+String s3Host();
+String s3Url(const String& path);
+class HTTPClient;
+bool beginS3Request(HTTPClient& http, const String& url);
 bool downloadFromS3(const String& filename, String& content, String& etag, String& errorMsg);
+
+
+// Conditional (If-None-Match) S3 download with the ETag and body cached in NVM.
+// A changed object is only cached by Commit(), once it was applied.
+class S3CachedFetch : public S3FetchTransport, public S3FetchStore {
+  S3FetchCache _cache;
+  String _errorMsg;
+
+public:
+  S3CachedFetch() : _cache(*this, *this) {}
+
+  int Get(const char* key, const char* ifNoneMatch,
+          char* body, size_t bodyCap, char* etag, size_t etagCap) override;
+  bool Load(const char* cacheKey, char* etag, size_t etagCap, char* body, size_t bodyCap) override;
+  void Save(const char* cacheKey, const char* etag, const char* body) override;
+
+  S3FetchResult Fetch(const String& filename, const char* cacheKey, String& content, String& errorMsg);
+  bool Commit(const String& content);
+};
 bool uploadJSONToS3(const String& jsonContent, const String& filename);
 
 // Boot and recovery functions
@@ -208,6 +256,10 @@ void flashOff();
 camera_fb_t* capturePhoto();
 void releasePhoto(camera_fb_t* fb);
 
+// Camera configuration functions (S3 -> NVM -> defaults)
+void loadCameraConfigAtBoot();
+void checkCameraConfigUpdate();
+
 // WiFi functions
 void setupWifi(const char* hostname);
 bool connectWiFi();
@@ -218,6 +270,7 @@ bool IsWiFiConnected();
 // S3 upload functions
 String getTimestamp();
 bool uploadPhotoToS3(camera_fb_t* fb, const String& filename, const String& folderName);
+bool uploadBufferToS3(const uint8_t* buf, size_t len, const String& filename, const String& folderName, const char* contentType);
 bool uploadStatusToS3(const String& filename, const ImageQualityMetrics& stats);
 
 // GPIO and sensor functions
@@ -228,19 +281,26 @@ void controlBlanket(bool shouldBeOn);
 void readDHT22();
 
 // Temperature calculation functions
+/// @brief Local hour 0-23, -1 while the clock is not set
+int getLocalHour();
 float getExpectedTemperature();
 float getEffectiveTemperature();
 
 // Control functions
 void updateBlanketControl();
-bool takeAndUploadPhoto(const char* reason);
+bool takeAndUploadPhoto(const char* reason, UploadPriority priority = UPLOAD_SCHEDULED);
 void checkPhotoSchedule();
 
 // Serial command functions
 void handleSerialCommands();
 
 // Status reporting functions
-String generateStatusJSON(const ImageQualityMetrics& stats);
+class StatusSink;
+void writeStatusFields(StatusSink& out, const ImageQualityMetrics& stats);
+/// @brief Status JSON into buf, returns its length (0 if it does not fit)
+size_t writeStatusJSON(char* buf, size_t cap, const ImageQualityMetrics& stats, bool compact = false);
+/// @brief Status fields for MQTT, with the metrics of the last photo
+JsonDocument statusDocument();
 void printStatusReport(bool forceImmediate = false);
 
 #endif // COMMON_H
\ No newline at end of file
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHA256_DIGEST_SIZE 32
+#define SHA256_BLOCK_SIZE 64
+#define CRYPTO_CONTEXT_SIZE 192
+
+/// @brief SHA-256 / HMAC-SHA256 provider used for payload hashing and SigV4.
+/// Hardware() drives the ESP32 SHA peripheral (crypto_backend.cpp), Software()
+/// is a portable implementation (crypto_software.cpp, also built by
+/// tools/crypto_check.cpp); Active() is the one used by the signing code.
+class CryptoBackend {
+public:
+    struct Context {
+        alignas(8) uint8_t opaque[CRYPTO_CONTEXT_SIZE];
+    };
+
+    virtual const char* Name() const = 0;
+    virtual void Begin(Context& ctx) const = 0;
+    virtual void Update(Context& ctx, const uint8_t* data, size_t len) const = 0;
+    virtual void Finish(Context& ctx, uint8_t* digest) const = 0;
+    virtual void Sha256(const uint8_t* data, size_t len, uint8_t* digest) const;
+
+    void HmacSha256(const uint8_t* key, size_t keyLen,
+                    const uint8_t* data, size_t len, uint8_t* mac) const;
+
+    static CryptoBackend& Hardware();
+    static CryptoBackend& Software();
+    static CryptoBackend& Active();
+    static void Select(CryptoBackend& backend);
+
+    /// @brief Number of FIPS 180-4 and RFC 4231 test vectors this backend gets wrong
+    int KnownAnswerFailures() const;
+};
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <ArduinoJson.h>
+
+/// @brief Throughput of the hardware and software SHA-256/HMAC backends for
+/// 64 KB..512 KB buffers, a digest cross-check between them, and the known
+/// answer tests (FIPS 180-4, RFC 4231) for each.
+JsonDocument cryptoBenchmark();
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <Arduino.h>
+#include <WiFiClientSecure.h>
+#include <ArduinoJson.h>
+
+#define DNS_CACHE_SIZE 6                 // upload targets, IoT endpoint, NTP pool
+#define DNS_CACHE_HOST_LEN 96            // UploadEndpoint.host; longer names are not cached
+#define DNS_CACHE_MIN_TTL 60             // S3 answers with ~5 s TTLs, don't re-resolve that often
+#define DNS_CACHE_MAX_TTL 3600
+#define DNS_CACHE_DEFAULT_TTL 300        // when the TTL is unknown (system resolver fallback)
+#define DNS_CACHE_REFRESH_MARGIN 20000   // ms before expiry the background task refreshes
+#define DNS_CACHE_REFRESH_PERIOD 5000    // ms between background task checks
+#define DNS_CACHE_IDLE_MS 3600000        // stop refreshing hosts unused for an hour
+#define DNS_QUERY_TIMEOUT 2000
+
+struct DnsCacheEntry {
+    char host[DNS_CACHE_HOST_LEN];
+    uint32_t ip;
+    unsigned long expiresMs;   // 0: last-known-good only (restored after reboot)
+    unsigned long lastUsedMs;
+};
+
+/// @brief Resolver cache for the S3 and IoT endpoints.
+/// Answers are kept for their DNS TTL (clamped) and refreshed by a background
+/// task before they expire. Last-known-good addresses live in RTC memory, so
+/// after a reboot or a resolver failure the previous address is still used.
+class DnsCache {
+    DnsCacheEntry _entries[DNS_CACHE_SIZE] = {};
+    SemaphoreHandle_t _lock = nullptr;
+
+    uint32_t _hits = 0;
+    uint32_t _misses = 0;
+    uint32_t _stale = 0;
+    uint32_t _failures = 0;
+    uint32_t _refreshes = 0;
+    uint32_t _lookups = 0;
+    uint64_t _lookupMs = 0;
+    uint32_t _maxLookupMs = 0;
+
+    bool Lookup(const char* host, IPAddress& ip, uint32_t& ttl);
+    DnsCacheEntry* Find(const char* host);
+    void Store(const char* host, const IPAddress& ip, uint32_t ttl);
+    void SaveRTC();
+    void LoadRTC();
+    void Refresh();
+    static void RefreshTask(void* arg);
+
+public:
+    static DnsCache cache;
+
+    void Begin();
+    bool Resolve(const char* host, IPAddress& ip);
+    JsonDocument describe();
+
+    inline uint32_t Hits() const { return _hits; }
+    inline uint32_t Misses() const { return _misses; }
+    uint32_t AvgLookupMs();
+};
+
+/// @brief WiFiClientSecure that resolves host names through DnsCache.
+/// The host name is still passed to TLS for SNI and certificate checks.
+class ResolvingClientSecure : public WiFiClientSecure {
+public:
+    using WiFiClientSecure::connect;
+    // The timeout overload sets the timeout and lands here as well
+    int connect(const char* host, uint16_t port) override;
+};
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "event_trace.h"
+
+#define EVENT_SEGMENT_BYTES_PSRAM 16384     // per segment: an hour of a busy shelter
+#define EVENT_SEGMENT_BYTES 2048            // boards without PSRAM
+#define EVENT_QUEUE_BYTES_PSRAM 65536       // sealed segments waiting for upload
+#define EVENT_QUEUE_BYTES 6144
+#define EVENT_DEFAULT_INTERVAL 60           // minutes per segment
+#define EVENT_MAX_INTERVAL 240
+#define EVENT_STALL_MS 1000                 // loop gaps from this long on are recorded
+#define EVENT_RETRY_INTERVAL 60000          // after a failed upload
+
+/// @brief Input recorder for the host replay harness (tools/event_replay.cpp).
+/// Records what the control loop saw, with the millis() it saw it at: PIR
+/// edges, DHT22 and LTR308 readings when they change, WiFi and MQTT state,
+/// serial and IoT commands, the local hour, loop stalls (a photo upload
+/// blocking the loop) and the decisions taken from them. Segments start with
+/// a snapshot of the decision state and are sealed every interval (or when
+/// full) and uploaded to S3 as events_YYYYMMDD_HHMMSS.cev; the queue drops its
+/// oldest segments when full. Only the loop task records, so nothing here
+/// needs a lock. Disabled by default, the setting is kept in NVM.
+class EventRecorder {
+    bool _loaded = false;
+    bool _enabled = false;
+    uint16_t _intervalMinutes = EVENT_DEFAULT_INTERVAL;
+
+    uint8_t* _segment = nullptr;      // records of the open segment
+    size_t _segmentCap = 0;
+    EventTraceWriter _writer;
+    EventTraceHeader _header = {};
+    bool _open = false;
+
+    uint8_t* _queue = nullptr;        // sealed segments, each prefixed by its uint32_t length
+    size_t _queueCap = 0;
+    size_t _queueLen = 0;
+    uint16_t _queued = 0;
+
+    void* _task = nullptr;            // the loop task
+    uint32_t _bootId = 0;
+    uint32_t _sequence = 0;
+    uint32_t _lastLoopMs = 0;
+
+    // Last recorded inputs, to record changes only
+    bool _pir = false;
+    uint32_t _pirReadMs = 0;          // last loop that read _pir
+    bool _wifi = false;
+    bool _mqtt = false;
+    uint8_t _dhtNan = 0xff;           // 0xff: nothing recorded yet
+    int32_t _temperature = 0;         // tenths
+    int32_t _humidity = 0;
+    uint32_t _lux = UINT32_MAX;       // hundredths
+    int8_t _hour = -2;                // -2: nothing recorded yet
+    uint32_t _clockMinute = 0;
+
+    unsigned long _lastFailMs = 0;
+    uint32_t _records = 0;
+    uint32_t _segments = 0;
+    uint32_t _uploaded = 0;
+    uint32_t _dropped = 0;
+    uint32_t _failed = 0;
+    uint32_t _foreign = 0;            // calls from other tasks, ignored
+
+    void ReadNVM();
+    void SaveNVM();
+    bool Allocate();
+    void StartSegment(uint32_t now);
+    void Seal(uint32_t now);
+    bool Upload();
+    /// @brief Open segment with room for one record, on the loop task
+    bool Recording(uint32_t now);
+    void Recorded(bool ok);
+
+public:
+    static EventRecorder recorder;
+
+    bool Enabled();
+
+    // Inputs, from the loop task
+    void Pir(bool level);
+    void Dht(float temperature, float humidity);
+    void Lux(float lux);
+    void Command(EventSource source, const char* text, size_t len);
+    // Outputs, for the replay to compare against
+    void Decision(EventDecision decision);
+
+    void Loop();
+    void Configure(const JsonDocument& doc);
+    JsonDocument describe();
+};
@@ -0,0 +1,86 @@
+#pragma once
+
+// Event trace records (event_trace_format.h), shared by the firmware recorder
+// and the host replay harness (tools/event_replay.cpp). Plain C++, no Arduino
+// dependencies. Times are millis() values; a record stores its distance to the
+// previous one, so a steady loop costs one or two bytes of time per record.
+
+#include <stddef.h>
+#include <stdint.h>
+#include "event_trace_format.h"
+
+#define EVENT_RECORD_MAX (2 + 5 + 5 + EVENT_COMMAND_MAX)  // type, time, source and length, text
+
+/// @brief Appends records to a caller-provided buffer
+class EventTraceWriter {
+    uint8_t* _buf = nullptr;
+    size_t _cap = 0;
+    size_t _len = 0;
+    uint32_t _lastMs = 0;
+    uint32_t _records = 0;
+
+    uint8_t _record[EVENT_RECORD_MAX];
+    size_t _recordLen = 0;
+
+    void Start(EventType type, uint32_t ms);
+    void Byte(uint8_t value);
+    void Varint(uint32_t value);
+    bool Commit(uint32_t ms);
+
+public:
+    void Begin(uint8_t* buf, size_t cap, uint32_t startMs);
+
+    // Each returns false, and writes nothing, when the record does not fit
+    bool Event(EventType type, uint32_t ms);
+    bool Pir(uint32_t ms, bool level, uint32_t sinceOtherMs);
+    bool Dht(uint32_t ms, float temperature, float humidity);
+    bool DhtFail(uint32_t ms, uint8_t nanBits);
+    bool Lux(uint32_t ms, float lux);
+    bool Command(uint32_t ms, EventSource source, const char* text, size_t len);
+    bool Clock(uint32_t ms, uint32_t epoch, int hour);
+    bool Stall(uint32_t ms, uint32_t gapMs);
+    bool Decision(uint32_t ms, EventDecision decision);
+
+    inline size_t Bytes() const { return _len; }
+    inline uint32_t Records() const { return _records; }
+    inline uint32_t LastMs() const { return _lastMs; }
+    inline const uint8_t* Data() const { return _buf; }
+};
+
+/// @brief One decoded record
+struct EventRecord {
+    uint8_t type;               // EventType
+    uint32_t ms;                // millis() when it happened
+    float temperature;          // EVENT_DHT
+    float humidity;
+    float lux;                  // EVENT_LUX
+    uint32_t value;             // PIR or stall ms, NaN bits, source, epoch or decision
+    int8_t hour;                // EVENT_CLOCK, -1: clock not set
+    const char* text;           // EVENT_COMMAND, not NUL terminated
+    uint16_t textLength;
+};
+
+/// @brief Reads back the records of one segment
+class EventTraceReader {
+    const uint8_t* _buf = nullptr;
+    size_t _len = 0;
+    size_t _pos = 0;
+    uint32_t _ms = 0;
+    bool _corrupt = false;
+
+    bool Byte(uint8_t& value);
+    bool Varint(uint32_t& value);
+
+public:
+    void Begin(const uint8_t* buf, size_t len, uint32_t startMs);
+
+    /// @brief Next record; false at the end or on a malformed record (Corrupt())
+    bool Next(EventRecord& record);
+
+    inline bool Corrupt() const { return _corrupt; }
+};
+
+/// @brief DHT22 value in tenths, as the sensor sends it
+int32_t eventTenths(float value);
+/// @brief The float the DHT library makes of a value in tenths
+float eventFromTenths(int32_t tenths);
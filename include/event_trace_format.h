@@ -0,0 +1,108 @@
+#pragma once
+
+// Event trace segment layout, shared by the firmware recorder and the host
+// replay harness (tools/event_replay.cpp). Plain C types only, no Arduino
+// dependencies.
+//
+// All integers are little-endian:
+//
+//   EventTraceHeader                         at offset 0
+//   records                                  `length` bytes
+//
+// A record is its EventType byte, the milliseconds since the previous record
+// (or the segment start) as an unsigned LEB128 varint, then its payload:
+//
+//   EVENT_PIR_LOW/HIGH     varint              PIR output edge, as the loop read it; ms since
+//                                              the loop last read the other level
+//   EVENT_DHT              zigzag varint       temperature in tenths of a degree
+//                          varint              humidity in tenths of a percent
+//   EVENT_DHT_FAIL         uint8               EVENT_DHT_NAN_* bits
+//   EVENT_LUX              varint              hundredths of a lux
+//   EVENT_WIFI_DOWN/UP     -                   IsWiFiConnected() changed
+//   EVENT_MQTT_DOWN/UP     -                   isIotConnected() changed
+//   EVENT_COMMAND          uint8, varint, text EventSource, length, command text
+//   EVENT_CLOCK            varint, uint8       epoch seconds, local hour (0xff: not set)
+//   EVENT_STALL            varint              no loop ran for this many ms before now
+//   EVENT_DECISION         uint8               EventDecision the firmware took
+//
+// DHT22 values have a resolution of 0.1; the replay rebuilds them the way the
+// DHT library does (tenths * 0.1). Readings are recorded when they change.
+// Each segment starts with a snapshot of the decision state, so it can be
+// replayed on its own or continue the previous segment of the same boot.
+
+#include <stdint.h>
+
+#define EVENT_TRACE_MAGIC "CSEV"
+#define EVENT_TRACE_VERSION 1
+#define EVENT_TRACE_EXTENSION ".cev"
+#define EVENT_COMMAND_MAX 192           // longer command texts are truncated
+
+enum EventType {
+    EVENT_PIR_LOW = 1,
+    EVENT_PIR_HIGH,
+    EVENT_DHT,
+    EVENT_DHT_FAIL,
+    EVENT_LUX,
+    EVENT_WIFI_DOWN,
+    EVENT_WIFI_UP,
+    EVENT_MQTT_DOWN,
+    EVENT_MQTT_UP,
+    EVENT_COMMAND,
+    EVENT_CLOCK,
+    EVENT_STALL,
+    EVENT_DECISION,
+    EVENT_TYPE_END
+};
+
+enum EventSource {
+    EVENT_SOURCE_SERIAL = 0,
+    EVENT_SOURCE_IOT
+};
+
+enum EventDecision {
+    EVENT_CAT_ARRIVED = 0,
+    EVENT_CAT_LEFT,
+    EVENT_BLANKET_ON,
+    EVENT_BLANKET_OFF,
+    EVENT_PHOTO_SCHEDULED,
+    EVENT_PHOTO_MOTION,
+    EVENT_DECISION_COUNT
+};
+
+#define EVENT_DHT_NAN_TEMPERATURE 0x01
+#define EVENT_DHT_NAN_HUMIDITY 0x02
+
+// EventTraceHeader.flags: state at startMs
+#define EVENT_FLAG_CAT_PRESENT 0x0001
+#define EVENT_FLAG_BLANKET_ON 0x0002
+#define EVENT_FLAG_BLANKET_OVERRIDE 0x0004
+#define EVENT_FLAG_DHT_WORKING 0x0008
+#define EVENT_FLAG_LAST_CAT_PRESENT 0x0010
+#define EVENT_FLAG_PIR 0x0020
+#define EVENT_FLAG_WIFI 0x0040
+#define EVENT_FLAG_MQTT 0x0080
+#define EVENT_FLAG_CAMERA 0x0100
+
+struct EventTraceHeader {
+    char magic[4];              // EVENT_TRACE_MAGIC, not NUL terminated
+    uint16_t version;           // EVENT_TRACE_VERSION
+    uint16_t flags;             // EVENT_FLAG_*
+    uint32_t bootId;            // random, one per boot
+    uint32_t sequence;          // segment number within the boot, 0 first
+    uint32_t startMs;           // millis() at the segment start
+    uint32_t endMs;             // millis() when sealed
+    uint32_t startTime;         // epoch seconds at startMs, 0 when the clock was not set
+    uint32_t length;            // record bytes following the header
+    uint32_t records;
+    // Decision state (ShelterState) at startMs
+    uint32_t lastBlanketChange;
+    uint32_t lastMotionDetected;
+    uint32_t lastPhotoTime;
+    uint32_t lastHourlyPhotoTime;
+    float currentTemp;
+    float currentHumidity;
+    int8_t hour;                // local hour at startMs, -1 when the clock was not set
+    uint8_t reserved[3];
+};
+
+static_assert(sizeof(EventTraceHeader) == 64, "EventTraceHeader must be packed");
@@ -0,0 +1,66 @@
+#pragma once
+
+// Gorilla time-series compression (Pelkonen et al., VLDB 2015) for float32
+// samples with epoch-second timestamps, shared by the firmware and the host
+// reader (tools/telemetry_reader.cpp). Plain C++, no Arduino dependencies.
+//
+// Timestamps are stored as delta-of-delta: a sensor read on a steady period
+// costs 1 bit. Values are XORed with the previous one and only the changed
+// bits are stored: a repeated value costs 1 bit, a slowly moving temperature
+// typically 10-20 bits. The first sample is stored raw (64 bits).
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define GORILLA_MAX_SAMPLE_BITS 80      // worst case for one sample after the first
+
+/// @brief Appends samples to a bit stream in a caller-provided buffer
+class GorillaWriter {
+    uint8_t* _buf = nullptr;
+    size_t _cap = 0;
+    size_t _bits = 0;
+    uint16_t _count = 0;
+
+    uint32_t _prevTime = 0;
+    int32_t _prevDelta = 0;
+    uint32_t _prevValue = 0;
+    uint8_t _leading = 0xff;          // 0xff: no XOR window yet
+    uint8_t _trailing = 0;
+
+    void Bits(uint32_t value, int n);
+
+public:
+    void Begin(uint8_t* buf, size_t cap);
+
+    /// @brief Add a sample. False when the buffer cannot take the worst case.
+    bool Append(uint32_t time, float value);
+
+    inline uint16_t Count() const { return _count; }
+    inline size_t Bytes() const { return (_bits + 7) / 8; }
+    inline const uint8_t* Data() const { return _buf; }
+    inline bool HasLast() const { return _count > 0; }
+    float LastValue() const;
+};
+
+/// @brief Reads back a GorillaWriter stream
+class GorillaReader {
+    const uint8_t* _buf = nullptr;
+    size_t _len = 0;
+    size_t _pos = 0;                  // in bits
+    uint16_t _remaining = 0;
+    bool _first = true;
+
+    uint32_t _prevTime = 0;
+    int32_t _prevDelta = 0;
+    uint32_t _prevValue = 0;
+    uint8_t _leading = 0;
+    uint8_t _trailing = 0;
+
+    bool Bits(int n, uint32_t& value);
+
+public:
+    void Begin(const uint8_t* buf, size_t len, uint16_t count);
+
+    /// @brief Next sample; false at the end of the stream or on truncated data
+    bool Next(uint32_t& time, float& value);
+};
@@ -0,0 +1,29 @@
+#pragma once
+
+// Small gzip (RFC 1952) encoder for JSON documents, shared by the firmware and
+// the host benchmark (tools/gzip_bench.cpp). Plain C++, no Arduino dependencies.
+//
+// Single deflate block with the fixed Huffman code and greedy LZ77 matching
+// through a 4K-entry hash table (16 KB heap scratch): no dynamic trees, no window
+// copy, since the whole document is already in memory. A compact 1 KB status
+// document shrinks by ~40%, larger documents with repeated keys by 60-70%;
+// incompressible input grows by ~12%.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define GZIP_HASH_BITS 12
+#define GZIP_WINDOW_SIZE 32768
+
+/// @brief Worst case gzip size for len input bytes (9-bit literals + header/trailer)
+size_t gzipBound(size_t len);
+
+/// @brief Compress src into dst as one gzip member.
+/// Returns the compressed length, or 0 when dst is smaller than needed.
+size_t gzipCompress(const uint8_t* src, size_t len, uint8_t* dst, size_t cap);
+
+/// @brief CRC-32 (IEEE 802.3), start with crc = 0
+uint32_t crc32Update(uint32_t crc, const uint8_t* data, size_t len);
+
+/// @brief Strip whitespace outside of strings, in place. Returns the new length.
+size_t jsonMinify(char* json, size_t len);
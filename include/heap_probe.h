@@ -0,0 +1,113 @@
+#pragma once
+
+// Per-call-site heap accounting, shared by the firmware (heap_profile.cpp) and
+// the host soak test (tools/heap_soak.cpp). Plain C++, no Arduino dependencies.
+//
+// The malloc/calloc/realloc/free wrappers (linked with -Wl,--wrap, see the
+// profiling env in platformio.ini) report allocations here with their usable
+// size. A HeapProbe charges what its thread allocates until the end of its
+// scope to one site; the innermost probe wins. Charged blocks are kept in a
+// small table, so a free credits the site that allocated the block whichever
+// thread frees it and whenever; blocks allocated outside probes, or taken with
+// heap_caps_malloc() directly, are never charged and their free is ignored. A
+// site's live bytes are its charged blocks not freed yet: a site whose live
+// bytes keep climbing hands out memory that nobody frees. Counters are 32-bit
+// atomics, so byte totals wrap after 4 GB.
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+#define HEAP_PROBE_THREADS 8            // threads inside a probe at the same time
+#define HEAP_PROBE_BLOCKS 256           // charged blocks live at the same time, 12 bytes each on the device
+#define HEAP_PROBE_SPAN 16              // slots searched for a block, from its hash on
+
+/// @brief One instrumented call site.
+/// Sites are file-scope objects that link themselves into one list at static
+/// initialization, like the metrics registry.
+class HeapSite {
+    static HeapSite* _head;
+    HeapSite* _next;
+    const char* _name;
+
+    std::atomic<uint32_t> _entries{0};
+    std::atomic<uint32_t> _allocs{0};
+    std::atomic<uint32_t> _frees{0};
+    std::atomic<uint32_t> _failures{0};
+    std::atomic<uint32_t> _allocBytes{0};
+    std::atomic<uint32_t> _freeBytes{0};
+    std::atomic<int32_t> _live{0};
+    std::atomic<int32_t> _peakLive{0};
+    std::atomic<uint32_t> _largest{0};
+
+public:
+    explicit HeapSite(const char* name);
+
+    void Enter() { _entries.fetch_add(1, std::memory_order_relaxed); }
+    void Alloc(size_t size);
+    void Free(size_t size);
+    void Failed(size_t size);
+    /// @brief Zero the counters; live bytes carry on, the peak restarts from them
+    void Reset();
+
+    inline const char* Name() const { return _name; }
+    inline uint32_t Entries() const { return _entries.load(std::memory_order_relaxed); }
+    inline uint32_t Allocs() const { return _allocs.load(std::memory_order_relaxed); }
+    inline uint32_t Frees() const { return _frees.load(std::memory_order_relaxed); }
+    inline uint32_t Failures() const { return _failures.load(std::memory_order_relaxed); }
+    inline uint32_t AllocBytes() const { return _allocBytes.load(std::memory_order_relaxed); }
+    inline uint32_t FreeBytes() const { return _freeBytes.load(std::memory_order_relaxed); }
+    inline int32_t Live() const { return _live.load(std::memory_order_relaxed); }
+    inline int32_t PeakLive() const { return _peakLive.load(std::memory_order_relaxed); }
+    /// @brief Largest single allocation, the one that fails first when the heap fragments
+    inline uint32_t Largest() const { return _largest.load(std::memory_order_relaxed); }
+
+    inline HeapSite* Next() const { return _next; }
+    static inline HeapSite* First() { return _head; }
+};
+
+/// @brief Charges the calling thread's allocations to a site until the end of the scope.
+/// The thread is an opaque id: the FreeRTOS task handle on the device.
+class HeapProbe {
+    struct Block {
+        std::atomic<void*> ptr;
+        HeapSite* site;                 // only read by the thread that frees the block
+        uint32_t size;
+    };
+
+    static std::atomic<void*> _threads[HEAP_PROBE_THREADS];
+    static HeapSite* _sites[HEAP_PROBE_THREADS];      // only read and written by the owning thread
+    static Block _blocks[HEAP_PROBE_BLOCKS];
+    static std::atomic<uint32_t> _open;
+    static std::atomic<uint32_t> _charged;
+    static std::atomic<uint32_t> _overflows;
+
+    int _slot;
+    HeapSite* _previous;
+
+public:
+    HeapProbe(HeapSite& site, void* thread);
+    ~HeapProbe();
+
+    /// @brief Anything to account: a probe open or a charged block live.
+    /// When not, the wrappers go straight to the allocator.
+    static inline bool Open() {
+        return _open.load(std::memory_order_relaxed) != 0 || _charged.load(std::memory_order_relaxed) != 0;
+    }
+    /// @brief Probes that found every thread slot taken, and blocks that found
+    /// no table slot; neither is charged
+    static inline uint32_t Overflows() { return _overflows.load(std::memory_order_relaxed); }
+    /// @brief Charged blocks not freed yet
+    static inline uint32_t Charged() { return _charged.load(std::memory_order_relaxed); }
+    /// @brief Site of the thread's innermost probe, null outside probes
+    static HeapSite* Current(void* thread);
+
+    // Called by the allocator wrappers, which must not allocate in here.
+    /// @brief Charge a new block of size usable bytes to site
+    static void Charge(HeapSite& site, void* ptr, size_t size);
+    /// @brief Credit a block about to be freed to the site it was charged to.
+    /// Returns that site, or null for a block that was never charged.
+    static HeapSite* Release(void* ptr);
+};
+
+extern HeapSite heapSiteOther;
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "heap_probe.h"
+
+#define HEAP_SAMPLE_INTERVAL 60000          // fragmentation sample, 1 minute
+#define HEAP_LARGEST_BLOCK_WARN 16384       // internal RAM: a TLS record buffer no longer fits
+
+/// @brief Free space of one memory region at a sample
+struct HeapRegion {
+    uint32_t size;
+    uint32_t free;
+    uint32_t minFree;                   // lowest free since boot (heap_caps watermark)
+    uint32_t largest;                   // largest free block
+
+    /// @brief Share of the free space that is not in the largest block, 0-100
+    inline uint8_t Fragmentation() const {
+        return free ? (uint8_t)(100 - (uint64_t)largest * 100 / free) : 0;
+    }
+};
+
+/// @brief Heap health for devices that run unattended for months.
+/// Every minute the largest free block of internal RAM and PSRAM is sampled and
+/// its lowest value kept: free bytes can look fine while no single block is
+/// left for a TLS handshake. In the profiling build (HEAP_PROBES, the
+/// "profiling" env in platformio.ini) allocations are also charged to call
+/// sites (heap_probe.h) through the malloc/calloc/realloc/free and ps_malloc/
+/// ps_calloc/ps_realloc wrappers. Memory that IDF components take with
+/// heap_caps_malloc() directly (TLS, camera frame buffers, WiFi) is only
+/// visible in the fragmentation numbers.
+class HeapProfile {
+    HeapRegion _internal = {};
+    HeapRegion _psram = {};
+    uint32_t _lowestLargest = UINT32_MAX;         // internal RAM, since boot or reset
+    uint32_t _lowestLargestPsram = UINT32_MAX;
+    uint32_t _samples = 0;
+    unsigned long _lastSampleMs = 0;
+    bool _lowBlock = false;
+
+    void Sample();
+
+public:
+    static HeapProfile profile;
+
+    static HeapRegion Region(uint32_t caps);
+    static HeapRegion Internal();
+    static HeapRegion Psram();
+
+    void Loop();
+    void Configure(const JsonDocument& doc);
+    JsonDocument describe();
+};
+
+#define HEAP_CONCAT_(a, b) a##b
+#define HEAP_CONCAT(a, b) HEAP_CONCAT_(a, b)
+/// @brief Charges the allocations of the enclosing scope to a site (profiling build only)
+#ifdef HEAP_PROBES
+#define HEAP_PROBE(site) HeapProbe HEAP_CONCAT(heapProbe, __LINE__)(site, xTaskGetCurrentTaskHandle())
+#else
+#define HEAP_PROBE(site)
+#endif
+
+// Instrumented hot paths
+extern HeapSite heapSiteHttpUpload;
+extern HeapSite heapSiteHttpd;
+extern HeapSite heapSiteStatusJson;
+extern HeapSite heapSiteMqttPublish;
+extern HeapSite heapSiteMqttCommand;
+extern HeapSite heapSitePhoto;
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "journal_store.h"
+
+#define JOURNAL_PARTITION_LABEL "journal"      // partitions.csv
+#define JOURNAL_LOG_LEVEL LOG_WARNING          // lines at this level and above are kept
+#define JOURNAL_LINE_MAX 256                   // log lines are cut to this
+#define JOURNAL_SNAPSHOT_INTERVAL 600000       // 10 minutes: metrics and recent spans
+#define JOURNAL_SNAPSHOT_SPANS 16
+#define JOURNAL_UPLOAD_MAX_PSRAM 65536         // records of one upload, before gzip
+#define JOURNAL_UPLOAD_MAX 8192
+#define JOURNAL_RETRY_INTERVAL 300000          // after a failed upload
+
+/// @brief Crash context that survives resets.
+/// Warnings and errors, a metrics/span snapshot every 10 minutes and the reason
+/// given to rebootSystem() are appended to a ring of flash sectors in the
+/// "journal" partition (journal_format.h). Each boot starts with a record of
+/// the reset reason, so a watchdog or brownout reset shows up after the fact
+/// next to the last lines before it. Once WiFi and time are up, the records of
+/// the previous boot go to S3 as one gzip object, journal_*_bootN.cjl.gz.
+class Journal {
+    bool _started = false;
+    SemaphoreHandle_t _lock = nullptr;
+    JournalStore _store;
+
+    uint32_t _uploadedBoot = 0;       // NVM: newest boot already uploaded
+    bool _uploadPending = false;
+    unsigned long _lastSnapshotMs = 0;
+    unsigned long _lastFailMs = 0;
+    uint32_t _uploads = 0;
+    uint32_t _uploadFailures = 0;
+    uint32_t _lastUploadBytes = 0;
+
+    void ReadNVM();
+    void SaveNVM();
+    bool Append(uint8_t type, uint8_t level, const void* payload, size_t length);
+    bool Upload();
+
+public:
+    static Journal journal;
+
+    /// @brief Open the partition and record this boot (once, in setup)
+    void Begin();
+
+    /// @brief Keep a formatted log line, called by the log task
+    void Log(uint8_t level, uint8_t module, const char* line, size_t len);
+    /// @brief Metrics and the most recent trace spans
+    void Snapshot();
+    /// @brief Snapshot plus the reason, right before a deliberate restart
+    void RecordReboot(const char* reason);
+
+    void Loop();
+    void Configure(const JsonDocument& doc);
+    JsonDocument describe();
+};
@@ -0,0 +1,86 @@
+#pragma once
+
+// Flash journal layout, shared by the firmware (journal_store.cpp), the host
+// decoder (tools/journal_decode.cpp) and the power-loss simulation
+// (tools/journal_sim.cpp). Plain C types only, no Arduino dependencies.
+//
+// The "journal" partition is a ring of 4 KB sectors, all little-endian:
+//
+//   JournalSectorHeader                      at the start of each sector
+//   JournalRecordHeader, payload, CRC-32     back to back, 4-byte aligned
+//
+// Sectors are filled in sequence order and the oldest one is erased for the
+// next, so every sector wears at the same rate. A record counts only when its
+// CRC (over header and payload) matches: a write cut by a reset leaves a bad
+// CRC, and the rest of that sector is ignored. Erased flash reads 0xFF, so a
+// length of 0xFFFF marks the free space of a sector.
+//
+// An upload (.cjl) is a JournalUploadHeader followed by the records of the
+// previous boot exactly as stored, then gzip compressed as a whole.
+
+#include <stdint.h>
+
+#define JOURNAL_SECTOR_MAGIC 0x4c4e4a43   // "CJNL"
+#define JOURNAL_UPLOAD_MAGIC "CJLU"
+#define JOURNAL_VERSION 1
+#define JOURNAL_EXTENSION ".cjl.gz"
+#define JOURNAL_SECTOR_SIZE 4096
+#define JOURNAL_FREE_LENGTH 0xffff
+#define JOURNAL_RECORD_MAX 1024           // payload bytes
+#define JOURNAL_SPAN_NAME_MAX 24
+
+enum JournalRecordType {
+    JOURNAL_BOOT = 1,         // JournalBootPayload, first record of every boot
+    JOURNAL_LOG = 2,          // module byte, then the formatted line (level in the header)
+    JOURNAL_SPANS = 3,        // JournalSpan entries, oldest first
+    JOURNAL_METRICS = 4,      // "name value\n" lines, histograms as "name count sum_ms max_ms"
+    JOURNAL_REBOOT = 5        // rebootSystem() reason text
+};
+
+struct JournalSectorHeader {
+    uint32_t magic;           // JOURNAL_SECTOR_MAGIC
+    uint32_t sequence;        // grows by one per sector written
+    uint32_t crc;             // CRC-32 of magic and sequence
+    uint32_t reserved;
+};
+
+struct JournalRecordHeader {
+    uint16_t length;          // payload bytes, JOURNAL_FREE_LENGTH when erased
+    uint8_t type;             // JournalRecordType
+    uint8_t level;            // LogLevel for JOURNAL_LOG
+    uint32_t boot;            // boot number, counted by the journal itself
+    uint32_t uptimeMs;        // millis() when written
+    uint32_t time;            // epoch seconds, 0 before SNTP
+};
+
+struct JournalBootPayload {
+    uint8_t resetReason;      // esp_reset_reason_t of the reset that started this boot
+    uint8_t bootAttempts;     // boot counter of the safe mode logic
+    uint16_t version;         // JOURNAL_VERSION
+};
+
+struct JournalSpan {
+    uint32_t startUs;         // low 32 bits of esp_timer_get_time()
+    uint32_t durUs;
+    uint8_t core;
+    char name[JOURNAL_SPAN_NAME_MAX - 1];   // NUL terminated, cut if longer
+};
+
+struct JournalUploadHeader {
+    char magic[4];            // JOURNAL_UPLOAD_MAGIC, not NUL terminated
+    uint16_t version;
+    uint16_t records;
+    uint32_t fromBoot;        // first boot included
+    uint32_t toBoot;          // boot that uploaded it
+};
+
+/// @brief Size of a stored record: header, payload, CRC, padded to 4 bytes
+static inline uint32_t journalRecordSize(uint16_t length) {
+    return (sizeof(JournalRecordHeader) + length + sizeof(uint32_t) + 3) & ~3u;
+}
+
+static_assert(sizeof(JournalSectorHeader) == 16, "JournalSectorHeader must be packed");
+static_assert(sizeof(JournalRecordHeader) == 16, "JournalRecordHeader must be packed");
+static_assert(sizeof(JournalBootPayload) == 4, "JournalBootPayload must be packed");
+static_assert(sizeof(JournalSpan) == 32, "JournalSpan must be packed");
+static_assert(sizeof(JournalUploadHeader) == 16, "JournalUploadHeader must be packed");
@@ -0,0 +1,108 @@
+#pragma once
+
+// Record ring over raw flash (journal_format.h), shared by the firmware and the
+// host tools. Plain C++, no Arduino dependencies: the flash is reached through
+// JournalFlash, a partition on the device and a NOR flash model on the host.
+// Not thread safe, the caller serializes access.
+
+#include <stddef.h>
+#include <stdint.h>
+#include "journal_format.h"
+
+/// @brief Erase-before-write flash: a write can only clear bits
+class JournalFlash {
+public:
+    virtual ~JournalFlash() = default;
+    virtual bool Read(uint32_t offset, void* buf, size_t len) = 0;
+    virtual bool Write(uint32_t offset, const void* buf, size_t len) = 0;
+    virtual bool EraseSector(uint32_t offset) = 0;
+    virtual uint32_t Size() const = 0;
+};
+
+class JournalStore {
+public:
+    /// @brief Called oldest first with each valid record; return false to stop
+    typedef bool (*Visitor)(const JournalRecordHeader& header, const uint8_t* payload,
+                            const uint8_t* raw, uint32_t rawSize, void* ctx);
+
+private:
+    JournalFlash* _flash = nullptr;
+    uint32_t _sectors = 0;
+    uint32_t _active = 0;             // sector being filled
+    uint32_t _sequence = 0;           // sequence of the active sector, 0 before the first
+    uint32_t _offset = JOURNAL_SECTOR_SIZE;   // next free byte in it, SECTOR_SIZE when full or torn
+    uint32_t _boot = 0;
+    uint32_t _records = 0;
+    uint32_t _erases = 0;
+    uint32_t _failures = 0;
+    // One record, header to CRC
+    uint8_t _buf[(sizeof(JournalRecordHeader) + JOURNAL_RECORD_MAX + sizeof(uint32_t) + 3) & ~3u];
+
+    bool SectorHeader(uint32_t sector, JournalSectorHeader& header);
+    bool StartSector(uint32_t sector, uint32_t sequence);
+    uint32_t ScanSector(uint32_t sector, bool& torn, Visitor visit, void* ctx, bool& stop);
+
+public:
+    /// @brief Find the newest sector and its free space. Boot() becomes the
+    /// highest boot number found plus one. False when the flash is too small.
+    bool Open(JournalFlash* flash);
+
+    /// @brief Write one record. A full (or torn) sector is left for the next
+    /// one, erasing the oldest. False when the flash write fails.
+    bool Append(uint8_t type, uint8_t level, uint32_t uptimeMs, uint32_t time,
+                const void* payload, uint16_t length);
+
+    void ForEach(Visitor visit, void* ctx);
+
+    inline uint32_t Boot() const { return _boot; }
+    inline uint32_t Sectors() const { return _sectors; }
+    inline uint32_t ActiveSector() const { return _active; }
+    inline uint32_t Sequence() const { return _sequence; }
+    inline uint32_t Records() const { return _records; }
+    inline uint32_t Erases() const { return _erases; }
+    inline uint32_t Failures() const { return _failures; }
+};
+
+/// @brief Packs an upload (.cjl, before gzip): the records of the boots after
+/// uploadedBoot and before the store's current one, plus the JOURNAL_BOOT
+/// record of the current boot that holds the reset reason. When they do not
+/// fit, the oldest are left out.
+class JournalUpload {
+    uint32_t _uploadedBoot = 0;
+    uint32_t _boot = 0;
+    uint8_t* _buf = nullptr;
+    size_t _cap = 0;
+    size_t _len = 0;
+    size_t _total = 0;
+    size_t _skip = 0;
+    uint16_t _records = 0;
+    uint16_t _previous = 0;           // records of earlier boots
+    uint32_t _fromBoot = 0;
+
+    bool Selected(const JournalRecordHeader& header) const;
+    static bool MeasureRecord(const JournalRecordHeader& header, const uint8_t* payload, const uint8_t* raw,
+                              uint32_t rawSize, void* ctx);
+    static bool CopyRecord(const JournalRecordHeader& header, const uint8_t* payload, const uint8_t* raw,
+                           uint32_t rawSize, void* ctx);
+
+public:
+    /// @brief Count the selected records and their stored size
+    void Measure(JournalStore& store, uint32_t uploadedBoot);
+
+    /// @brief Write the JournalUploadHeader and the newest selected records
+    /// that fit into buf. Call after Measure. Returns the length.
+    size_t Pack(JournalStore& store, uint8_t* buf, size_t cap);
+
+    /// @brief Stored size of the selected records, without the upload header
+    inline size_t Total() const { return _total; }
+    inline uint16_t Previous() const { return _previous; }
+    inline uint16_t Records() const { return _records; }
+    inline uint32_t FromBoot() const { return _fromBoot; }
+    inline uint32_t ToBoot() const { return _boot; }
+};
+
+/// @brief Walk the records of an upload (gunzipped), oldest first. False when
+/// the magic is wrong, a record is truncated or fails its CRC, or the count
+/// does not match the header; records before the fault have been visited.
+bool journalReadUpload(const uint8_t* data, size_t len, JournalUploadHeader& header,
+                       JournalStore::Visitor visit, void* ctx);
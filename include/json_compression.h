@@ -0,0 +1,40 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#define JSON_GZIP_MIN_BYTES 256     // smaller documents are sent as plain compact JSON
+
+/// @brief Compact + gzip encoding of JSON bodies (gzip.h encoder).
+/// Status JSON uploads to S3 are gzipped by default and sent with
+/// Content-Encoding: gzip; MQTT JSON payloads are gzipped only when enabled
+/// with the "compression" IoT command, since subscribers have to inflate them
+/// (they start with the 1f 8b gzip magic). Keeps per-document size/CPU stats.
+class JsonCompression {
+    bool _loaded = false;
+    bool _statusGzip = true;
+    bool _mqttGzip = false;
+
+    uint32_t _documents = 0;
+    uint32_t _failed = 0;
+    uint64_t _bytesIn = 0;        // pretty/compact JSON as generated
+    uint64_t _bytesOut = 0;       // gzip output
+    uint64_t _totalUs = 0;
+    uint32_t _maxUs = 0;
+
+    void ReadNVM();
+    void SaveNVM();
+
+public:
+    static JsonCompression compression;
+
+    bool StatusGzip();
+    bool MqttGzip();
+
+    /// @brief gzip len bytes of JSON into a new buffer (free() it).
+    /// Returns nullptr when the document is too small to be worth it or on failure.
+    uint8_t* Gzip(const char* json, size_t len, size_t& gzLen);
+
+    void Configure(const JsonDocument& doc);
+    JsonDocument describe();
+};
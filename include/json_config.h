@@ -43,6 +43,7 @@ public:
     static bool checkConfigValue(String field, int value);
 
     void Apply();
+    void ApplyOperatingPoint(framesize_t framesize, int quality);
     void SaveNVM();
     void ReadNVM();
     void ClearNVM();
@@ -51,5 +52,5 @@ public:
     JsonDocument BuildStatus() const;
     JsonDocument BuildInfo() const;
     JsonDocument buildConfigurationDocument() const;
-    void readCameraConfiguration(const JsonDocument& doc);
+    bool readCameraConfiguration(const JsonDocument& doc);
 };
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "status_writer.h"
+
+#define SLO_WINDOW 64                   // rolling window: the last 64 photos per stage
+#define SLO_MIN_SAMPLES 10              // no alert on fewer samples
+#define SLO_PIR_EDGE_MAX_AGE 10000      // ms; an older edge did not trigger this photo
+#define SLO_ALERT_REPEAT 3600000        // 1 hour, while an SLO stays breached
+#define SLO_DEFAULT_PERCENTILE 95
+#define SLO_DEFAULT_TOTAL_MS 30000      // PIR edge (or trigger) to MQTT notification
+
+/// @brief Points of a photo's way from the PIR edge to the cloud
+enum SloStamp {
+    SLO_PIR_EDGE,                       // GPIO interrupt; the trigger for scheduled/manual photos
+    SLO_CAPTURE_START,
+    SLO_CAPTURE_END,
+    SLO_ANALYSIS_DONE,
+    SLO_UPLOAD_FIRST_BYTE,              // first request byte, after connect (SigV4) or before it (POST policy)
+    SLO_UPLOAD_DONE,                    // object committed
+    SLO_PUBLISH_DONE,                   // "photo" MQTT notification sent
+    SLO_STAMP_COUNT
+};
+
+/// @brief Intervals between consecutive stamps, plus the whole way
+enum SloStage {
+    SLO_STAGE_TRIGGER,                  // PIR edge to capture start
+    SLO_STAGE_CAPTURE,
+    SLO_STAGE_ANALYSIS,
+    SLO_STAGE_UPLOAD_START,             // signing, connect, POST policy preparation
+    SLO_STAGE_UPLOAD,
+    SLO_STAGE_PUBLISH,
+    SLO_STAGE_TOTAL,
+    SLO_STAGE_COUNT
+};
+
+/// @brief Rolling latency of the last SLO_WINDOW samples of one stage
+class SloWindow {
+    uint32_t _ms[SLO_WINDOW] = {};
+    uint16_t _next = 0;
+    uint16_t _count = 0;
+
+public:
+    void Add(uint32_t ms);
+    /// @brief Nearest-rank percentile (1-100), 0 without samples
+    uint32_t Percentile(uint8_t p) const;
+    inline uint16_t Count() const { return _count; }
+};
+
+/// @brief Capture-to-cloud latency per stage against configured SLOs.
+/// takeAndUploadPhoto() opens an event; the stamps along the way (capture,
+/// analysis, S3 connection, MQTT) only count when they come from the task that
+/// opened it, so the upload pipeline tasks do not leak into a photo. When the
+/// event closes, each stage feeds its rolling window; a stage whose percentile
+/// goes over its target publishes an alert on "slo-alert" (again every hour
+/// while it lasts, and once when it recovers). Targets are kept in NVM.
+class LatencySlo {
+    bool _loaded = false;
+    uint8_t _percentile = SLO_DEFAULT_PERCENTILE;
+    uint32_t _targetMs[SLO_STAGE_COUNT] = {};   // 0: no SLO for the stage
+
+    int64_t _stamps[SLO_STAMP_COUNT] = {};
+    void* _task = nullptr;                      // owner of the open event, null when none
+    SloWindow _windows[SLO_STAGE_COUNT];
+    bool _breached[SLO_STAGE_COUNT] = {};
+    unsigned long _lastAlertMs[SLO_STAGE_COUNT] = {};
+    uint32_t _events = 0;
+    uint32_t _incomplete = 0;                   // upload or notification failed
+    uint32_t _alerts = 0;
+
+    static volatile uint32_t _pirEdgeUs;        // low 32 bits of esp_timer_get_time(), 0: none
+    static void OnPirEdge();                    // GPIO interrupt, in IRAM
+
+    void ReadNVM();
+    void SaveNVM();
+    void Check(SloStage stage);
+
+public:
+    static LatencySlo slo;
+    static const char* StageName(SloStage stage);
+
+    /// @brief Stamp PIR edges from a GPIO interrupt (once, in setupGPIO)
+    static void AttachPir(uint8_t pin);
+
+    /// @brief Open an event; motion uses the latest PIR edge as its start
+    void Begin(bool motion);
+    void Stamp(SloStamp stamp);
+    /// @brief This event's stage latencies so far, for the notification
+    void Latencies(JsonObject out) const;
+    /// @brief Close the event: record its stages and check the SLOs
+    void Finish();
+    /// @brief Close the event without recording it (photo went into a bundle)
+    void Abort();
+
+    /// @brief p50/p95/p99 per stage for the status document
+    void WriteStatus(StatusSink& out) const;
+
+    void Configure(const JsonDocument& doc);
+    JsonDocument describe();
+};
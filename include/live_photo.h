@@ -1,16 +1,36 @@
 #pragma once
 
+// Header in front of every "live-preview" MQTT chunk, written field by field
+// as little-endian in this order (LIVE_PREVIEW_HEADER_SIZE bytes, no padding).
+// A viewer concatenates chunks 0..chunks-1 of the same seq into one JPEG.
+struct LivePreviewChunk {
+    uint16_t seq;        // frame sequence number, wraps
+    uint16_t chunk;      // index of this chunk
+    uint16_t chunks;     // number of chunks in the frame
+    uint16_t width;      // thumbnail width in pixels
+    uint32_t total;      // JPEG length in bytes
+};
+#define LIVE_PREVIEW_HEADER_SIZE 12
+
 class LivePhoto {
     bool _isStreaming = false;
+    bool _fullRequested = false;
+    bool _previewApplied = false;     // sensor switched to the preview framesize
     unsigned long _streamStartedMs = 0;
     unsigned long _lastPhotoMs = 0;
+    uint16_t _seq = 0;
 
     pixformat_t _pixFormat = PIXFORMAT_JPEG;
     
+    camera_fb_t* CapturePreview();
+    void SendPreview(camera_fb_t* fb);
+    void UploadFull();
+    bool PublishChunks(const uint8_t* jpeg, size_t len, uint16_t width);
 
 public:
     void Start();
     void Stop();
+    void RequestFull();
     void Loop();
     void sendCameraConfiguration(const String& topic);
     void readCameraConfiguration(const JsonDocument& doc);
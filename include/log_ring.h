@@ -0,0 +1,63 @@
+#pragma once
+
+// Deferred log records, shared by the firmware (async_log.cpp) and the host
+// benchmark (tools/log_bench.cpp). Plain C++, no Arduino dependencies.
+//
+// The caller only walks its format string and copies the arguments into a
+// fixed-size record: the format pointer (string literals only), integers and
+// doubles as raw bytes, and %s arguments copied in place, since they are often
+// temporaries. vsnprintf and the output run later, on the consumer side.
+//
+// The ring is a bounded multi-producer multi-consumer queue (per-slot sequence
+// numbers, one compare-and-swap per push); it never blocks, and a record that
+// finds the ring full is counted as dropped.
+
+#include <atomic>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define LOG_RING_SLOTS 64               // power of two
+#define LOG_RECORD_ARGS 80              // packed argument bytes per record
+
+#define LOG_RECORD_TRUNCATED 0x01       // arguments did not fit, printed up to the first missing one
+
+struct LogRecord {
+    uint32_t ms;
+    const char* format;
+    uint8_t level;
+    uint8_t module;
+    uint8_t argLen;
+    uint8_t flags;
+    uint8_t args[LOG_RECORD_ARGS];
+};
+
+class LogRing {
+    struct Slot {
+        std::atomic<uint32_t> seq;
+        LogRecord record;
+    };
+
+    Slot _slots[LOG_RING_SLOTS];
+    std::atomic<uint32_t> _enqueue{0};
+    std::atomic<uint32_t> _dequeue{0};
+    std::atomic<uint32_t> _pushed{0};
+    std::atomic<uint32_t> _dropped{0};
+
+public:
+    LogRing();
+
+    /// @brief Pack a call into a free slot. False (and counted) when the ring is full.
+    bool Push(uint8_t module, uint8_t level, uint32_t ms, const char* format, va_list args);
+    /// @brief Oldest complete record, false when there is none
+    bool Pop(LogRecord& out);
+
+    /// @brief printf the record's message into out, returns its length
+    static size_t Format(const LogRecord& record, char* out, size_t cap);
+
+    inline uint32_t Pushed() const { return _pushed.load(std::memory_order_relaxed); }
+    inline uint32_t Dropped() const { return _dropped.load(std::memory_order_relaxed); }
+    inline uint32_t Pending() const {
+        return _enqueue.load(std::memory_order_relaxed) - _dequeue.load(std::memory_order_relaxed);
+    }
+};
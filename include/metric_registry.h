@@ -0,0 +1,92 @@
+#pragma once
+
+// Metric classes and the Prometheus text exposition. Plain C++, no Arduino
+// dependencies: checked on the host (tools/metrics_check.cpp). The metric
+// instances, MetricTimer and the JSON export are in metrics.h.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+#define METRICS_PREFIX "cat_shelter_"
+#define METRICS_BUCKET_COUNT 13
+
+enum MetricType {
+    METRIC_COUNTER,
+    METRIC_GAUGE,
+    METRIC_HISTOGRAM
+};
+
+/// @brief Base of the registry entries.
+/// Metrics are file-scope objects that link themselves into one list at static
+/// initialization, so the exporters need no table of them. Updates are 32-bit
+/// atomics: safe from both cores and any task without a lock.
+class Metric {
+    static Metric* _head;
+    Metric* _next;
+
+protected:
+    const char* _name;                // Prometheus name without METRICS_PREFIX
+    const char* _help;
+
+    Metric(const char* name, const char* help);
+
+public:
+    virtual ~Metric() = default;
+    virtual MetricType Type() const = 0;
+
+    inline const char* Name() const { return _name; }
+    inline const char* Help() const { return _help; }
+    inline Metric* Next() const { return _next; }
+    static inline Metric* First() { return _head; }
+};
+
+class MetricCounter : public Metric {
+    std::atomic<uint32_t> _value{0};
+
+public:
+    MetricCounter(const char* name, const char* help) : Metric(name, help) {}
+    MetricType Type() const override { return METRIC_COUNTER; }
+
+    inline void Inc(uint32_t n = 1) { _value.fetch_add(n, std::memory_order_relaxed); }
+    inline uint32_t Value() const { return _value.load(std::memory_order_relaxed); }
+};
+
+class MetricGauge : public Metric {
+    std::atomic<int32_t> _value{0};
+
+public:
+    MetricGauge(const char* name, const char* help) : Metric(name, help) {}
+    MetricType Type() const override { return METRIC_GAUGE; }
+
+    inline void Set(int32_t value) { _value.store(value, std::memory_order_relaxed); }
+    inline int32_t Value() const { return _value.load(std::memory_order_relaxed); }
+};
+
+/// @brief Latency histogram with fixed buckets (METRICS_BUCKETS_MS, 1 ms to 30 s)
+class MetricHistogram : public Metric {
+    std::atomic<uint32_t> _buckets[METRICS_BUCKET_COUNT + 1] = {};   // last one is +Inf
+    std::atomic<uint32_t> _count{0};
+    std::atomic<uint32_t> _sumMs{0};
+    std::atomic<uint32_t> _maxUs{0};
+
+public:
+    static const uint32_t BOUNDS_MS[METRICS_BUCKET_COUNT];
+
+    MetricHistogram(const char* name, const char* help) : Metric(name, help) {}
+    MetricType Type() const override { return METRIC_HISTOGRAM; }
+
+    void Observe(uint32_t us);
+
+    /// @brief Observations in bucket i (not cumulative), i == METRICS_BUCKET_COUNT is +Inf
+    inline uint32_t Bucket(int i) const { return _buckets[i].load(std::memory_order_relaxed); }
+    inline uint32_t Count() const { return _count.load(std::memory_order_relaxed); }
+    inline uint32_t SumMs() const { return _sumMs.load(std::memory_order_relaxed); }
+    inline uint32_t MaxUs() const { return _maxUs.load(std::memory_order_relaxed); }
+};
+
+namespace Metrics {
+    /// @brief Prometheus text exposition (version 0.0.4) of every registered
+    /// metric, one line at a time
+    void WritePrometheus(void (*emit)(const char* line, size_t len, void* ctx), void* ctx);
+}
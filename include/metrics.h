@@ -0,0 +1,41 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "metric_registry.h"
+
+#define METRICS_PUBLISH_INTERVAL 300000     // 5 minutes, "metrics" MQTT topic
+
+/// @brief Observes the time until the end of the scope
+class MetricTimer {
+    MetricHistogram& _histogram;
+    int64_t _start;
+
+public:
+    explicit MetricTimer(MetricHistogram& histogram);
+    ~MetricTimer();
+};
+
+namespace Metrics {
+    /// @brief Sample(), then the Prometheus text exposition
+    void Prometheus(void (*emit)(const char* line, size_t len, void* ctx), void* ctx);
+    /// @brief Same numbers for the "metrics" MQTT topic
+    JsonDocument describe();
+    /// @brief Refresh the heap/RSSI/uptime gauges before an export
+    void Sample();
+}
+
+// Instrumented operations
+extern MetricHistogram metricCapture;
+extern MetricHistogram metricAnalysis;
+extern MetricHistogram metricSigV4;
+extern MetricHistogram metricS3Connect;
+extern MetricHistogram metricS3Request;
+extern MetricHistogram metricPhotoUpload;
+extern MetricHistogram metricWifiScan;
+extern MetricHistogram metricWifiConnect;
+extern MetricHistogram metricMqttConnect;
+extern MetricCounter metricCaptureFailures;
+extern MetricCounter metricPhotoUploadFailures;
+extern MetricCounter metricWifiDisconnects;
+extern MetricCounter metricMqttConnectFailures;
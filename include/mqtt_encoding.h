@@ -0,0 +1,48 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#define MQTT_CBOR_TOPICS_SIZE 160     // comma separated topic names
+
+/// @brief Per-topic payload encoding for device-to-cloud MQTT documents.
+/// Topics listed with the "mqtt-encoding" IoT command are published as CBOR
+/// with the cbor.h key dictionary, the others stay JSON (optionally gzipped).
+/// The list is kept in NVM, so the cloud side opts in topic by topic once its
+/// consumers decode CBOR. Keeps size/time stats for both encodings; for CBOR
+/// documents the JSON size is measured too, for a like-for-like ratio.
+class MqttEncoding {
+    struct Stats {
+        uint32_t documents = 0;
+        uint64_t bytes = 0;
+        uint64_t totalUs = 0;
+        uint32_t maxUs = 0;
+
+        void Record(size_t len, uint32_t us);
+        void Describe(JsonObject obj) const;
+    };
+
+    bool _loaded = false;
+    char _cborTopics[MQTT_CBOR_TOPICS_SIZE] = "";
+
+    Stats _json;
+    Stats _cbor;
+    uint64_t _cborJsonBytes = 0;
+    uint32_t _cborFailed = 0;
+
+    void ReadNVM();
+    void SaveNVM();
+
+public:
+    static MqttEncoding encoding;
+
+    /// @brief True when topic (full name, matched on its last segment) is published as CBOR
+    bool Cbor(const String& topic);
+
+    /// @brief CBOR encoding of doc into buf. Returns its length, 0 if it does not fit.
+    size_t EncodeCbor(const JsonDocument& doc, uint8_t* buf, size_t cap);
+    void RecordJson(size_t len, uint32_t us);
+
+    void Configure(const JsonDocument& doc);
+    JsonDocument describe();
+};
@@ -0,0 +1,110 @@
+#pragma once
+
+// S3 multipart upload driver (Initiate/UploadPart/Complete/Abort), shared by
+// the firmware (s3_multipart.cpp) and the host check (tools/multipart_check.cpp).
+// Plain C++, no Arduino dependencies: requests go through MultipartTransport
+// (SigV4 over HTTPClient on the device, a plain socket to the stand-in on the
+// host) and the resume state through MultipartStore (NVM on the device).
+//
+// The state is saved after every acknowledged part, as one record, so an
+// upload cut by a WiFi drop or a reboot resumes at the next part when Upload()
+// is called again with the same object.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define S3_MULTIPART_PART_SIZE (5*1024*1024)  // S3 minimum part size (last part may be smaller)
+#define S3_MULTIPART_MAX_PARTS 16
+#define S3_MULTIPART_PART_ATTEMPTS 3          // per part and Upload() call, reconnecting in between
+#define S3_MULTIPART_KEY_MAX 160
+#define S3_MULTIPART_ID_MAX 256               // S3 upload ids run to about 150 characters
+#define S3_MULTIPART_ETAG_MAX 48              // quoted MD5 hex
+#define S3_MULTIPART_STATE_VERSION 1
+#define S3_MULTIPART_RESPONSE_MAX 1024
+#define S3_MULTIPART_QUERY_MAX (64 + 3 * S3_MULTIPART_ID_MAX)
+#define S3_MULTIPART_BODY_MAX (64 + S3_MULTIPART_MAX_PARTS * (64 + S3_MULTIPART_ETAG_MAX))
+
+/// @brief Resume state, stored as one record
+struct MultipartState {
+    uint32_t version;                 // S3_MULTIPART_STATE_VERSION, 0: nothing pending
+    uint32_t totalLen;
+    uint32_t partSize;
+    uint32_t partCount;               // parts acknowledged, in order from 1
+    char key[S3_MULTIPART_KEY_MAX];   // object path, "/folder/name"
+    char uploadId[S3_MULTIPART_ID_MAX];
+    char etags[S3_MULTIPART_MAX_PARTS][S3_MULTIPART_ETAG_MAX];
+};
+
+class MultipartTransport {
+public:
+    virtual ~MultipartTransport() = default;
+    /// @brief One request on the object. query is the canonical query string.
+    /// Returns the HTTP status, or a negative value when no response arrived.
+    /// body (NUL terminated, truncated to bodyCap) and etag may be null.
+    virtual int Request(const char* method, const char* key, const char* query,
+                        const uint8_t* payload, size_t len,
+                        char* body, size_t bodyCap, char* etag, size_t etagCap) = 0;
+    /// @brief Called before retrying a part; false gives up for this call
+    virtual bool Reconnect() { return true; }
+};
+
+class MultipartStore {
+public:
+    virtual ~MultipartStore() = default;
+    virtual bool Load(MultipartState& state) = 0;
+    virtual void Save(const MultipartState& state) = 0;
+    virtual void Clear() = 0;
+};
+
+enum MultipartResult {
+    MULTIPART_DONE = 0,
+    MULTIPART_FAILED,         // pending state kept, call Upload() again to resume
+    MULTIPART_INVALID         // too large, key too long, or an upload id that does not fit
+};
+
+class MultipartUpload {
+    MultipartTransport& _transport;
+    MultipartStore& _store;
+    size_t _partSize;
+    MultipartState _state = {};
+
+    uint32_t _partsSent = 0;          // acknowledged parts, this instance
+    uint32_t _partRetries = 0;
+    uint32_t _resumed = 0;
+    uint32_t _aborted = 0;
+
+    // Request buffers (about 3.7 KB), kept out of the caller's stack: uploads
+    // run on the loop task, under HTTPClient, SigV4 and the TLS frames
+    char _query[S3_MULTIPART_QUERY_MAX];
+    char _body[S3_MULTIPART_BODY_MAX];
+    char _response[S3_MULTIPART_RESPONSE_MAX];
+
+    const char* UploadIdQuery(const char* prefix);
+    bool Initiate();
+    bool UploadPart(uint32_t part, const uint8_t* buf, size_t len);
+    bool Complete();
+    bool Abort();
+
+public:
+    MultipartUpload(MultipartTransport& transport, MultipartStore& store,
+                    size_t partSize = S3_MULTIPART_PART_SIZE)
+        : _transport(transport), _store(store), _partSize(partSize) {}
+
+    /// @brief Upload buf as key ("/folder/name"), resuming a pending upload of
+    /// the same key and length; a pending upload of anything else is aborted
+    MultipartResult Upload(const uint8_t* buf, size_t len, const char* key);
+
+    /// @brief Abort whatever upload the store still holds
+    bool AbortPending();
+
+    inline uint32_t PartCount() const { return _state.partCount; }
+    inline uint32_t PartsSent() const { return _partsSent; }
+    inline uint32_t PartRetries() const { return _partRetries; }
+    inline uint32_t Resumed() const { return _resumed; }
+    inline uint32_t Aborted() const { return _aborted; }
+};
+
+/// @brief Text of the first <tag>...</tag> in xml into out; false when missing or too long
+bool multipartXmlElement(const char* xml, const char* tag, char* out, size_t cap);
+/// @brief URI-encode a query value as the SigV4 canonical query string wants it
+bool multipartUriEncode(const char* value, char* out, size_t cap);
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "esp_camera.h"
+
+#define RATE_CONTROL_TARGET_MS 15000      // keep uploads well under the 60s HTTP timeout
+#define RATE_CONTROL_UPGRADE_MARGIN 0.6   // only step up when predicted time is well below target
+#define RATE_CONTROL_WEAK_RSSI -78        // start conservative on a weak link before any measurement
+#define RATE_CONTROL_EWMA_ALPHA 0.3
+
+/// @brief One JPEG quality/frame size combination the controller can choose
+struct OperatingPoint {
+    framesize_t framesize;
+    int quality;
+    float sizeFactor;     // expected JPEG size relative to the first (best) point
+};
+
+/// @brief Picks camera quality/framesize from measured upload throughput and RSSI
+/// so each upload stays under a latency target. The operating point lives here
+/// and is only applied to the sensor, capped by the user's camera config; it is
+/// never written into the config or NVM.
+class RateController {
+    SemaphoreHandle_t _lock = nullptr;   // RecordUpload also runs on the pipeline network task
+    bool _enabled = true;
+    unsigned long _targetMs = RATE_CONTROL_TARGET_MS;
+    int _level = -1;               // current index in the operating point ladder
+    int _floorLevel = 0;           // lowest allowed quality index (upload budget degradation)
+    float _throughputBps = 0;      // EWMA of upload throughput
+    float _refBytes = 0;           // EWMA of frame size normalized to the best point
+    unsigned long _lastUploadMs = 0;
+    size_t _lastUploadBytes = 0;
+    int _rssi = 0;
+    uint32_t _samples = 0;
+    bool _sensorStale = false;     // sensor set outside the controller (live preview)
+
+    int MinLevel() const;
+    int PickLevel() const;
+    unsigned long PredictMs(int level) const;
+
+public:
+    static RateController rate;
+
+    void Begin();
+    void Select();
+    void Reapply();
+    void Invalidate();
+    void RecordUpload(size_t bytes, unsigned long ms, bool success, int level);
+    void Configure(const JsonDocument& doc);
+    void SetFloor(int level);
+    size_t EstimateBytes(int level) const;
+    static int ThumbnailLevel();
+
+    inline int Level() const { return _level; }
+    inline float ThroughputBps() const { return _throughputBps; }
+    const OperatingPoint& Current() const;
+    JsonDocument describe() const;
+};
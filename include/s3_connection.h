@@ -0,0 +1,69 @@
+#pragma once
+
+#include <Arduino.h>
+#include <WiFiClient.h>
+#include <ArduinoJson.h>
+#include "dns_cache.h"
+#include "upload_targets.h"
+#include "s3_http.h"
+
+#define S3_WRITE_CHUNK 8192
+#define S3_CONNECTION_IDLE_MS 15000     // S3 drops idle keep-alive connections after ~20 s
+
+/// @brief Allocation-free HTTP/1.1 client for signed S3 requests.
+/// The request line and headers are formatted into a fixed buffer, the body
+/// is written straight from the caller's buffer (e.g. the camera frame
+/// buffer) and the response is parsed line by line into fixed buffers, so a
+/// request makes no String or heap allocations of its own. The connection is
+/// kept alive between requests to the same target and closed when idle.
+/// The head and response handling lives in s3_http.h (checked on the host).
+/// One instance per task: shared for the loop task, one in the pipeline.
+class S3Connection : public S3ResponseSource {
+    ResolvingClientSecure _tls;
+    WiFiClient _plain;
+    Client* _client = nullptr;
+    char _host[96] = "";              // target the open connection belongs to
+    bool _tlsActive = false;
+    unsigned long _lastUseMs = 0;
+
+    S3RequestHead _request;
+    S3Response _response;
+    unsigned long _deadline = 0;      // of the response being read
+    int _status = 0;
+
+    uint32_t _requests = 0;
+    uint32_t _reused = 0;
+    uint32_t _reconnects = 0;         // stale kept-alive connection, request resent
+    uint64_t _bytesSent = 0;
+    int32_t _lastHeapDelta = 0;       // free heap after - before, on a reused connection
+    int32_t _minHeapDelta = 0;
+
+    bool Connect(const UploadEndpoint& target, uint16_t connectTimeout, bool& reused);
+    bool Write(const uint8_t* buf, size_t len);
+    int ReadResponse(bool& gotBytes);
+
+    // S3ResponseSource over the open client
+    int Read(uint8_t* buf, size_t len) override;
+    bool Idle() override;
+
+public:
+    static S3Connection shared;
+
+    void Begin(const UploadEndpoint& target, const char* method, const char* uri);
+    void Header(const char* name, const char* value);
+    void Header(const char* name, unsigned long value);
+
+    /// @brief Send the request with body, wait for the response.
+    /// Returns the HTTP status, or a negative HTTPC_ERROR_* on network failure.
+    int Send(const UploadEndpoint& target, const uint8_t* body, size_t len,
+             uint16_t connectTimeout, uint16_t timeout);
+
+    inline const char* ETag() const { return _response.ETag(); }
+    inline const char* ResponseBody() const { return _response.Body(); }
+
+    void Close();
+    void CloseIdle();
+    JsonDocument describe() const;
+
+    static const char* ErrorToString(int error);
+};
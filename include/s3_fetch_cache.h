@@ -0,0 +1,59 @@
+#pragma once
+
+// Conditional S3 download (If-None-Match) with the ETag and body cached,
+// shared by the firmware (S3CachedFetch in common.cpp, NVM cache) and the host
+// check (tools/fetch_cache_check.cpp). Plain C++, no Arduino dependencies.
+//
+// A changed object is only cached when the caller calls Commit() after it
+// parsed and applied the body: a document the device rejects is fetched
+// (and rejected) again next time instead of being answered 304 forever.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define S3_FETCH_ETAG_MAX 48          // unquoted MD5 hex, or multipart "hex-n"
+#define S3_FETCH_BODY_MAX 3800        // fits one NVS string entry (4000 bytes)
+
+// Conditional (If-None-Match) S3 download results
+enum S3FetchResult {
+    S3_FETCH_ERROR,
+    S3_FETCH_NOT_FOUND,
+    S3_FETCH_NOT_MODIFIED,
+    S3_FETCH_MODIFIED
+};
+
+class S3FetchTransport {
+public:
+    virtual ~S3FetchTransport() = default;
+    /// @brief GET key, with If-None-Match when ifNoneMatch (unquoted) is not
+    /// empty. Returns the HTTP status, negative when no response arrived or the
+    /// body did not fit. body is NUL terminated, etag unquoted.
+    virtual int Get(const char* key, const char* ifNoneMatch,
+                    char* body, size_t bodyCap, char* etag, size_t etagCap) = 0;
+};
+
+class S3FetchStore {
+public:
+    virtual ~S3FetchStore() = default;
+    /// @brief Cached ETag and body; body may be null to only check there is one
+    virtual bool Load(const char* cacheKey, char* etag, size_t etagCap, char* body, size_t bodyCap) = 0;
+    virtual void Save(const char* cacheKey, const char* etag, const char* body) = 0;
+};
+
+class S3FetchCache {
+    S3FetchTransport& _transport;
+    S3FetchStore& _store;
+    char _cacheKey[16] = "";
+    char _pendingEtag[S3_FETCH_ETAG_MAX] = "";    // of the last S3_FETCH_MODIFIED body
+
+public:
+    S3FetchCache(S3FetchTransport& transport, S3FetchStore& store) : _transport(transport), _store(store) {}
+
+    /// @brief Fetch key into body. body is the current object for
+    /// S3_FETCH_MODIFIED and S3_FETCH_NOT_MODIFIED, and the last cached copy
+    /// (empty when none) on errors. cacheKey is at most 10 characters (NVS keys).
+    S3FetchResult Fetch(const char* key, const char* cacheKey, char* body, size_t bodyCap);
+
+    /// @brief Cache the body of the last S3_FETCH_MODIFIED, once it was applied
+    bool Commit(const char* body);
+};
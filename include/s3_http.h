@@ -0,0 +1,72 @@
+#pragma once
+
+// Request head builder and response parser of S3Connection, shared with the
+// host check (tools/s3_request_check.cpp). Plain C++, no Arduino
+// dependencies; both work in fixed buffers and make no heap allocations.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define S3_REQUEST_HEAD_SIZE 1024       // request line + headers
+#define S3_RESPONSE_BODY_SIZE 256       // start of the response body, kept for error logs
+#define S3_RESPONSE_LINE_SIZE 256
+
+/// @brief Parse failures, mapped to HTTPC_ERROR_* by S3Connection
+enum S3HttpError {
+    S3_HTTP_NO_RESPONSE = -1,           // nothing arrived before the deadline
+    S3_HTTP_CONNECTION_LOST = -2,       // closed or timed out mid-response
+    S3_HTTP_NOT_HTTP = -3               // no HTTP/1.x status line
+};
+
+/// @brief Request line and headers, formatted into a fixed buffer
+class S3RequestHead {
+    char _head[S3_REQUEST_HEAD_SIZE];
+    size_t _len = 0;
+    bool _overflow = false;
+    bool _isHead = false;
+
+    void Append(const char* text);
+
+public:
+    void Begin(const char* host, const char* method, const char* uri);
+    void Header(const char* name, const char* value);
+    void Header(const char* name, unsigned long value);
+
+    /// @brief Terminate the head; false when it did not fit the buffer
+    bool Finish();
+
+    inline const char* Data() const { return _head; }
+    inline size_t Length() const { return _len; }
+    inline bool IsHead() const { return _isHead; }
+};
+
+class S3ResponseSource {
+public:
+    virtual ~S3ResponseSource() = default;
+    /// @brief Up to len bytes: > 0 bytes read, 0 nothing yet, < 0 closed with nothing left
+    virtual int Read(uint8_t* buf, size_t len) = 0;
+    /// @brief Nothing to read yet: wait a little. False once the deadline passed.
+    virtual bool Idle() = 0;
+};
+
+/// @brief Status line, ETag, Content-Length / chunked body, parsed line by line.
+/// Only the first S3_RESPONSE_BODY_SIZE - 1 body bytes are kept.
+class S3Response {
+    int _status = 0;
+    bool _keepAlive = false;
+    char _etag[48] = "";
+    char _body[S3_RESPONSE_BODY_SIZE] = "";
+
+    bool ReadLine(S3ResponseSource& source, char* line, size_t cap);
+    bool ReadBody(S3ResponseSource& source, size_t length, bool chunked);
+
+public:
+    /// @brief Read one response. Returns the HTTP status or an S3HttpError.
+    /// gotBytes tells a silent peer from one that closed mid-response.
+    int Parse(S3ResponseSource& source, bool isHead, bool& gotBytes);
+
+    inline int Status() const { return _status; }
+    inline bool KeepAlive() const { return _keepAlive; }
+    inline const char* ETag() const { return _etag; }
+    inline const char* Body() const { return _body; }
+};
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <Arduino.h>
+#include "multipart_upload.h"
+
+/// @brief S3 multipart upload (Initiate/UploadPart/Complete/Abort) for large payloads,
+/// MultipartUpload over SigV4 requests. The upload id and part ETags are kept in
+/// NVM as one record, so an upload interrupted by a WiFi drop or a reboot resumes
+/// at the next part when Upload() is called again with the same object. A failed
+/// part is retried after reconnecting WiFi.
+class S3MultipartUpload : public MultipartTransport, public MultipartStore {
+    MultipartUpload _upload;
+
+public:
+    S3MultipartUpload() : _upload(*this, *this) {}
+
+    int Request(const char* method, const char* key, const char* query,
+                const uint8_t* payload, size_t len,
+                char* body, size_t bodyCap, char* etag, size_t etagCap) override;
+    bool Reconnect() override;
+
+    bool Load(MultipartState& state) override;
+    void Save(const MultipartState& state) override;
+    void Clear() override;
+
+    bool Upload(const uint8_t* buf, size_t len, const String& filename, const String& folderName);
+    void AbortPending();
+
+    inline int PartCount() const { return _upload.PartCount(); }
+};
@@ -0,0 +1,15 @@
+#pragma once
+
+// Host check for POST policy URLs received over MQTT (S3PostPolicy::Read),
+// shared with the host check (tools/policy_check.cpp). Plain C++, no Arduino
+// dependencies.
+//
+// The policy arrives on an MQTT connection whose TLS is not verified, so the
+// URL is only accepted when it points at the configured bucket: otherwise a
+// forged policy could send every photo to someone else's server.
+
+/// @brief True for https://<bucket>.s3.<region>.amazonaws.com/,
+/// https://<bucket>.s3.amazonaws.com/ and https://s3.<region>.amazonaws.com/<bucket>/,
+/// or, when a stand-in endpoint ("host[:port]", may be null) is configured,
+/// for http://<endpoint>/ only. No user info, other ports or other paths.
+bool s3PolicyUrlAllowed(const char* url, const char* bucket, const char* region, const char* endpoint);
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#define S3_POLICY_REFRESH_MARGIN 600      // seconds before expiry to request a new policy
+#define S3_POLICY_REQUEST_INTERVAL 60000  // ms between unanswered policy requests
+
+/// @brief Browser-style S3 POST policy uploads.
+/// The device asks for a signed POST policy over MQTT ("policy-request"), the
+/// cloud answers on the "policy" topic and the cached policy is reused for
+/// every upload until it expires: no per-request SigV4/HMAC work on the device.
+/// Photos and status JSON both use it; a policy whose url is not the
+/// configured bucket is ignored. tools/policy_responder.py answers the requests.
+class S3PostPolicy {
+    bool _enabled = false;
+    String _url;
+    JsonDocument _fields;
+    time_t _expires = 0;
+    unsigned long _lastRequestMs = 0;
+
+    uint32_t _policyUploads = 0;
+    uint64_t _policyUs = 0;
+    uint32_t _sigv4Uploads = 0;
+    uint64_t _sigv4Us = 0;
+
+    void ReadNVM();
+    void SaveNVM();
+
+public:
+    static S3PostPolicy policy;
+
+    void Begin();
+    void Loop();
+    void Read(const JsonDocument& doc);
+    void Configure(const JsonDocument& doc);
+    bool Valid() const;
+    void Invalidate();
+
+    bool Upload(const uint8_t* buf, size_t len, const String& key, const char* contentType,
+                const char* contentEncoding = nullptr);
+    void RecordSigV4(uint32_t us);
+    JsonDocument describe() const;
+};
@@ -0,0 +1,94 @@
+#pragma once
+
+// Retry decisions for one signed S3 PUT, shared by the firmware
+// (putToS3WithRetry in common.cpp) and the host check
+// (tools/s3_put_retry_check.cpp). Plain C++, no Arduino dependencies: the
+// requests, the clock and the target choice go through S3PutTransport.
+//
+// The object key is fixed before the first attempt, so a retry writes the
+// same object. After a lost response the object is checked with HEAD before
+// anything is sent again: a match ends the upload, a 404 (or a 403 from a
+// bucket that hides missing keys) lets the PUT go ahead, and no answer keeps
+// the object in doubt; the next attempt on that target checks again rather
+// than writing it blind.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define UPLOAD_MAX_ATTEMPTS 4               // per object, across all targets
+#define UPLOAD_RETRY_MIN_DELAY 1000         // backoff once every target failed, doubled each round
+#define UPLOAD_RETRY_MAX_DELAY 8000
+#define UPLOAD_RETRY_MIN_ATTEMPT_MS 5000    // don't start a retry with less time left than this
+#define UPLOAD_HEAD_CONNECT_TIMEOUT 5000
+#define UPLOAD_HEAD_TIMEOUT 10000
+
+enum UploadOutcome {
+    UPLOAD_OUTCOME_FIRST_TRY = 0,
+    UPLOAD_OUTCOME_AFTER_RETRY,
+    UPLOAD_OUTCOME_ALREADY_STORED,    // lost response, HEAD showed the object had landed
+    UPLOAD_OUTCOME_PERMANENT,         // 4xx that a retry cannot fix
+    UPLOAD_OUTCOME_EXHAUSTED,         // out of attempts
+    UPLOAD_OUTCOME_BUDGET,            // out of retry budget
+    UPLOAD_OUTCOME_DEADLINE,          // out of time: retries only get what one attempt could take
+    UPLOAD_OUTCOME_COUNT
+};
+
+enum S3EtagCheck {
+    S3_ETAG_MATCH = 0,
+    S3_ETAG_MISMATCH,
+    S3_ETAG_UNVERIFIED,               // missing, or multipart ("-N"): not a plain MD5
+    S3_ETAG_SKIPPED                   // verification off (SSE-KMS buckets)
+};
+
+/// @brief What came back for one request
+struct S3PutReply {
+    int status;                       // HTTP status, <= 0 when no response arrived
+    const char* body;                 // response body or network error text, never null
+    const char* etag;                 // never null
+};
+
+class S3PutTransport {
+public:
+    virtual ~S3PutTransport() = default;
+    virtual uint32_t Millis() = 0;
+    /// @brief Backoff wait before the next round over the targets
+    virtual void Delay(uint32_t ms) = 0;
+    /// @brief Best target not in excludeMask (bit per index); false when none
+    virtual bool Select(uint32_t excludeMask, int& target) = 0;
+    virtual bool Online() { return true; }
+    /// @brief A token from the shared retry budget; false stops retrying
+    virtual bool TakeRetry() { return true; }
+    virtual void Put(int target, uint32_t connectTimeout, uint32_t timeout, S3PutReply& reply) = 0;
+    virtual void Head(int target, uint32_t connectTimeout, uint32_t timeout, S3PutReply& reply) = 0;
+    /// @brief Every PUT: target, reply, ETag check and whether it confirmed the upload
+    virtual void Recorded(int, const S3PutReply&, S3EtagCheck, bool) {}
+};
+
+class S3PutRetry {
+    S3PutTransport& _transport;
+    int _target = -1;
+    int _attempts = 0;
+    uint32_t _puts = 0;
+    uint32_t _heads = 0;
+    uint32_t _headsInDoubt = 0;
+
+public:
+    explicit S3PutRetry(S3PutTransport& transport) : _transport(transport) {}
+
+    /// @brief Upload the payload whose MD5 is md5Hex. All attempts, backoff
+    /// and HEAD checks share connectTimeout + timeout.
+    UploadOutcome Put(const char* md5Hex, uint32_t connectTimeout, uint32_t timeout, bool verifyEtag);
+
+    /// @brief Target of the last request, -1 before any
+    inline int Target() const { return _target; }
+    inline int Attempts() const { return _attempts; }
+    inline uint32_t Puts() const { return _puts; }
+    inline uint32_t Heads() const { return _heads; }
+    inline uint32_t HeadsInDoubt() const { return _headsInDoubt; }
+};
+
+/// @brief Network errors, throttling, server errors and damaged bodies are worth another try
+bool s3Retryable(int status, const char* body);
+/// @brief ETag as returned by S3, with or without quotes, against 32 hex digits
+bool s3EtagMatches(const char* etag, const char* md5Hex);
+S3EtagCheck s3CheckEtag(const char* etag, const char* md5Hex);
@@ -0,0 +1,90 @@
+#pragma once
+
+// Shelter decisions: cat presence, temperature fallback, blanket and photo
+// schedule. Shared by the firmware (common.cpp) and the host replay harness
+// (tools/event_replay.cpp). Plain C++, no Arduino dependencies: the time
+// (millis()) and the local hour come in as arguments and the decisions go back
+// as return values; relays, logs and uploads stay with the caller.
+
+#include <stdint.h>
+
+#define PHOTO_HOURLY_INTERVAL 600000   // 10 minutes in milliseconds (continuous power available)
+#define PHOTO_MOTION_COOLDOWN 60000    // 1 minute in milliseconds (continuous power available)
+#define BLANKET_MIN_STATE_TIME 300000  // 5 minutes minimum time before blanket can change state
+#define CAT_PRESENCE_TIMEOUT 3600000   // 60 minutes - PIR motion extends presence (PIR is motion, not presence)
+
+// Temperature threshold for blanket control (in Celsius)
+#ifndef TEMP_COLD_THRESHOLD
+#define TEMP_COLD_THRESHOLD 13.0  // Turn on blanket if temp is below this and cat present
+#endif
+#define TEMP_MAX_REASONABLE 45.0  // Maximum reasonable outdoor temperature (detect sensor errors)
+#define TEMP_MIN_REASONABLE -30.0 // Minimum reasonable outdoor temperature (detect sensor errors)
+
+extern const float WINTER_TEMP_TABLE[24];
+
+enum PresenceChange {
+    PRESENCE_NONE,
+    PRESENCE_ARRIVED,           // first motion
+    PRESENCE_EXTENDED,          // motion while present
+    PRESENCE_TIMEOUT            // no motion for CAT_PRESENCE_TIMEOUT
+};
+
+enum DhtChange {
+    DHT_READING,                // valid, state updated
+    DHT_RECOVERED,              // valid after a failure, state updated
+    DHT_FAILED,                 // first NaN reading
+    DHT_STILL_FAILED
+};
+
+enum TempSource {
+    TEMP_SOURCE_SENSOR,
+    TEMP_SOURCE_FAILED,         // expected temperature, sensor not working
+    TEMP_SOURCE_ABERRANT        // expected temperature, reading out of range
+};
+
+enum BlanketStep {
+    BLANKET_KEEP,
+    BLANKET_SWITCH,             // call SetBlanket(!blanketOn)
+    BLANKET_DELAYED             // should switch, BLANKET_MIN_STATE_TIME not over
+};
+
+enum PhotoTrigger {
+    PHOTO_NONE,
+    PHOTO_SCHEDULED,
+    PHOTO_MOTION
+};
+
+/// @brief Decision state of the control loop.
+/// The firmware keeps one instance (shelter, common.cpp) behind the old global
+/// names; times are millis() values and wrap the same way on both sides.
+struct ShelterState {
+    bool catPresent = false;
+    bool blanketOn = false;
+    bool blanketManualOverride = false;  // Track if blanket is in manual control mode
+    uint32_t lastBlanketChange = 0;      // Track when blanket last changed state for debouncing
+    uint32_t lastMotionDetected = 0;     // Track last PIR motion for presence timeout
+    float currentTemp = 0.0;
+    float currentHumidity = 0.0;
+    bool dhtSensorWorking = true;        // Track DHT22 state for debounced error logging
+    uint32_t lastPhotoTime = 0;          // Will be initialized in setup to allow first motion photo
+    uint32_t lastHourlyPhotoTime = 0;    // Will be initialized in setup
+    bool lastCatPresent = false;
+
+    /// @brief PIR level of this loop; motion extends presence, silence times it out
+    PresenceChange Motion(bool motion, uint32_t now);
+    /// @brief DHT22 reading, NaN when the read failed
+    DhtChange Reading(float temp, float humidity);
+
+    /// @brief Typical temperature for the local hour, -1 when the clock is not set
+    static float ExpectedTemperature(int hour);
+    /// @brief Sensor temperature, or the expected one when the sensor cannot be trusted
+    float EffectiveTemperature(int hour, TempSource* source = nullptr) const;
+
+    /// @brief Automatic blanket decision; remainingMs is set when delayed
+    BlanketStep Blanket(float effectiveTemp, uint32_t now, uint32_t* remainingMs = nullptr) const;
+    /// @brief Switch the blanket, returns false when it already was in that state
+    bool SetBlanket(bool on, uint32_t now);
+
+    /// @brief Photo due at this loop (the camera is available)
+    PhotoTrigger Photo(uint32_t now);
+};
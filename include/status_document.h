@@ -0,0 +1,21 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "status_writer.h"
+
+/// @brief Status fields into a JsonDocument (MQTT publish)
+class JsonDocumentSink : public StatusSink {
+    JsonObject _objects[STATUS_WRITER_MAX_DEPTH + 1];
+    int _depth = 0;
+
+public:
+    explicit JsonDocumentSink(JsonDocument& doc);
+
+    void BeginObject(const char* key) override;
+    void EndObject() override;
+    void Text(const char* key, const char* value) override;
+    void Int(const char* key, int64_t value) override;
+    void Float(const char* key, double value, int decimals) override;
+    void Bool(const char* key, bool value) override;
+};
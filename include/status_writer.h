@@ -0,0 +1,58 @@
+#pragma once
+
+// Plain C++, no Arduino dependencies: JsonBufferWriter is checked on the
+// host (tools/status_json_check.cpp). The JsonDocument sink is in
+// status_document.h.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define STATUS_JSON_MAX 3072          // pretty status document is ~1.5 KB
+#define STATUS_WRITER_MAX_DEPTH 4
+
+/// @brief Receives the status document field by field.
+/// writeStatusFields() (common.cpp) is the one list of status fields; each
+/// sink turns it into a format: JSON text for S3, a JsonDocument for MQTT.
+class StatusSink {
+public:
+    virtual void BeginObject(const char* key) = 0;
+    virtual void EndObject() = 0;
+    virtual void Text(const char* key, const char* value) = 0;
+    virtual void Int(const char* key, int64_t value) = 0;
+    virtual void Float(const char* key, double value, int decimals) = 0;
+    virtual void Bool(const char* key, bool value) = 0;
+};
+
+/// @brief JSON text into a caller-provided buffer, pretty (two-space indent,
+/// same layout as the former String-built document) or compact.
+/// Numbers are formatted by hand: no printf, no heap, no String temporaries.
+/// Floats get the same digits as String(value, decimals).
+class JsonBufferWriter : public StatusSink {
+    char* _buf;
+    size_t _cap;
+    size_t _len = 0;
+    bool _overflow = false;
+    bool _pretty;
+    int _depth = 0;
+    bool _first[STATUS_WRITER_MAX_DEPTH + 1];
+
+    void Put(char c);
+    void Put(const char* text);
+    void PutEscaped(const char* text);
+    void PutUnsigned(uint64_t value);
+    void Key(const char* key);
+    void Close(char bracket);
+
+public:
+    JsonBufferWriter(char* buf, size_t cap, bool pretty);
+
+    /// @brief Finish the document. Returns its length, 0 if it did not fit.
+    size_t Finish();
+
+    void BeginObject(const char* key) override;
+    void EndObject() override;
+    void Text(const char* key, const char* value) override;
+    void Int(const char* key, int64_t value) override;
+    void Float(const char* key, double value, int decimals) override;
+    void Bool(const char* key, bool value) override;
+};
@@ -0,0 +1,47 @@
+#pragma once
+
+// Telemetry batch layout, shared by the firmware writer and the host reader
+// (tools/telemetry_reader.cpp). Plain C types only, no Arduino dependencies.
+//
+// All integers are little-endian:
+//
+//   TelemetryHeader                          at offset 0
+//   TelemetrySeriesHeader, Gorilla stream    seriesCount times, back to back
+//
+// Each stream holds `count` samples encoded by GorillaWriter (gorilla.h).
+// Motion and blanket are 0/1 values recorded on change only.
+
+#include <stdint.h>
+
+#define TELEMETRY_MAGIC "CSTM"
+#define TELEMETRY_VERSION 1
+#define TELEMETRY_EXTENSION ".ctm"
+
+enum TelemetrySeries {
+    TELEMETRY_TEMPERATURE = 0,    // DHT22, celsius
+    TELEMETRY_HUMIDITY,           // DHT22, percent
+    TELEMETRY_LUX,                // LTR308
+    TELEMETRY_MOTION,             // PIR output edges
+    TELEMETRY_BLANKET,            // relay state changes
+    TELEMETRY_SERIES_COUNT
+};
+
+struct TelemetryHeader {
+    char magic[4];            // TELEMETRY_MAGIC, not NUL terminated
+    uint16_t version;         // TELEMETRY_VERSION
+    uint8_t seriesCount;
+    uint8_t reserved;
+    uint32_t startTime;       // epoch seconds of the batch start
+    uint32_t endTime;         // epoch seconds when the batch was sealed
+};
+
+struct TelemetrySeriesHeader {
+    uint8_t series;           // TelemetrySeries
+    uint8_t reserved;
+    uint16_t count;           // samples
+    uint16_t length;          // stream bytes following this header
+    uint16_t reserved2;
+};
+
+static_assert(sizeof(TelemetryHeader) == 16, "TelemetryHeader must be packed");
+static_assert(sizeof(TelemetrySeriesHeader) == 8, "TelemetrySeriesHeader must be packed");
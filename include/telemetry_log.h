@@ -0,0 +1,69 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "gorilla.h"
+#include "telemetry_format.h"
+
+#define TELEMETRY_SERIES_BYTES_PSRAM 2048   // per series and batch: ~15 min of DHT22 samples
+#define TELEMETRY_SERIES_BYTES 768          // boards without PSRAM
+#define TELEMETRY_QUEUE_BYTES_PSRAM 65536   // sealed batches waiting for upload
+#define TELEMETRY_QUEUE_BYTES 6144
+#define TELEMETRY_DEFAULT_INTERVAL 15       // minutes per batch
+#define TELEMETRY_MAX_INTERVAL 240
+#define TELEMETRY_RETRY_INTERVAL 60000      // after a failed upload
+
+/// @brief Full-resolution sensor history, Gorilla compressed.
+/// Every DHT22/LTR308 reading and every PIR/blanket change is appended to a
+/// per-series Gorilla stream. Every interval (or when a stream fills up) the
+/// streams are sealed into one batch (telemetry_format.h) and queued; the
+/// queue drops its oldest batches when full, so an outage loses the oldest
+/// history first. Batches go to S3 as telemetry_YYYYMMDD_HHMMSS.ctm, or on
+/// the "telemetry" MQTT topic when configured and the batch fits.
+/// Buffers live in PSRAM when present; they do not survive a reset.
+class TelemetryLog {
+    bool _loaded = false;
+    bool _enabled = true;
+    bool _mqtt = false;
+    uint16_t _intervalMinutes = TELEMETRY_DEFAULT_INTERVAL;
+
+    uint8_t* _streams = nullptr;      // TELEMETRY_SERIES_COUNT * _seriesBytes
+    size_t _seriesBytes = 0;
+    GorillaWriter _writers[TELEMETRY_SERIES_COUNT];
+    uint32_t _batchStart = 0;
+
+    uint8_t* _queue = nullptr;        // sealed batches, each prefixed by its uint32_t length
+    size_t _queueCap = 0;
+    size_t _queueLen = 0;
+    uint16_t _queued = 0;
+
+    unsigned long _lastFailMs = 0;
+    uint32_t _samples = 0;
+    uint32_t _batches = 0;
+    uint32_t _uploaded = 0;
+    uint32_t _dropped = 0;
+    uint32_t _failed = 0;
+    uint64_t _rawBytes = 0;           // 8 bytes per sample uncompressed
+    uint64_t _sealedBytes = 0;
+
+    void ReadNVM();
+    void SaveNVM();
+    bool Allocate();
+    void StartBatch(uint32_t now);
+    void Seal(uint32_t now);
+    bool Upload();
+
+public:
+    static TelemetryLog telemetry;
+
+    bool Enabled();
+
+    /// @brief Record a reading
+    void Record(TelemetrySeries series, float value);
+    /// @brief Record a 0/1 state, only when it changed
+    void RecordState(TelemetrySeries series, bool state);
+
+    void Loop();
+    void Configure(const JsonDocument& doc);
+    JsonDocument describe();
+};
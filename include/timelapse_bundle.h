@@ -0,0 +1,49 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "timelapse_format.h"
+
+#define TIMELAPSE_BUNDLE_CAPACITY (6*1024*1024)   // upper bound of the PSRAM bundle buffer
+#define TIMELAPSE_PSRAM_HEADROOM (1536*1024)      // left free for camera frame buffers
+#define TIMELAPSE_MIN_CAPACITY (512*1024)         // don't bundle with less than this
+#define TIMELAPSE_MAX_FRAMES 64
+#define TIMELAPSE_PERIOD 3600                     // seconds covered by one bundle
+#define TIMELAPSE_RETRY_INTERVAL 300000           // ms between failed bundle uploads
+
+/// @brief Optional bundling of scheduled frames into one S3 object per hour.
+/// Frames and their status JSON are appended to a PSRAM buffer in the
+/// timelapse_format.h layout; the bundle is uploaded (multipart when larger
+/// than one part) once the hour is over or the buffer is full.
+class TimelapseBundle {
+    bool _loaded = false;
+    bool _enabled = false;
+    uint8_t* _buf = nullptr;
+    size_t _capacity = 0;
+    size_t _len = 0;
+    TimelapseIndexEntry _index[TIMELAPSE_MAX_FRAMES];
+    uint32_t _count = 0;
+    uint32_t _startTime = 0;
+    unsigned long _lastFailMs = 0;
+
+    uint32_t _bundles = 0;
+    uint32_t _frames = 0;
+    uint32_t _failed = 0;
+    uint32_t _lastBundleBytes = 0;
+
+    void ReadNVM();
+    void SaveNVM();
+    bool Allocate();
+    bool Fits(size_t len) const;
+    size_t Finalize();
+
+public:
+    static TimelapseBundle bundle;
+
+    bool Enabled();
+    bool Append(const uint8_t* jpeg, size_t len, const char* metadata, size_t metadataLen);
+    void Loop();
+    bool Flush();
+    void Configure(const JsonDocument& doc);
+    JsonDocument describe();
+};
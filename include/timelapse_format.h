@@ -0,0 +1,38 @@
+#pragma once
+
+// Time-lapse bundle layout, shared by the firmware writer and the host reader
+// (tools/timelapse_reader.cpp). Plain C types only, no Arduino dependencies.
+//
+// All integers are little-endian:
+//
+//   TimelapseHeader                      at offset 0
+//   frame 0: JPEG bytes, metadata JSON   back to back, no padding
+//   frame 1: ...
+//   TimelapseIndexEntry[frameCount]      at header.indexOffset
+//
+// The index is written last, so a bundle is only valid once indexOffset != 0.
+
+#include <stdint.h>
+
+#define TIMELAPSE_MAGIC "CSTL"
+#define TIMELAPSE_VERSION 1
+#define TIMELAPSE_EXTENSION ".ctl"
+
+struct TimelapseHeader {
+    char magic[4];            // TIMELAPSE_MAGIC, not NUL terminated
+    uint16_t version;         // TIMELAPSE_VERSION
+    uint16_t reserved;
+    uint32_t frameCount;
+    uint32_t indexOffset;     // byte offset of the index from the start of the bundle
+    uint32_t startTime;       // epoch seconds of the first frame
+};
+
+struct TimelapseIndexEntry {
+    uint32_t timestamp;       // epoch seconds
+    uint32_t offset;          // JPEG byte offset from the start of the bundle
+    uint32_t length;          // JPEG length
+    uint32_t metaLength;      // metadata JSON follows the JPEG directly
+};
+
+static_assert(sizeof(TimelapseHeader) == 20, "TimelapseHeader must be packed");
+static_assert(sizeof(TimelapseIndexEntry) == 16, "TimelapseIndexEntry must be packed");
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <esp_timer.h>
+#include "trace_ring.h"
+
+/// @brief Hot-path spans in one ring per core.
+/// A span is two esp_timer_get_time() reads, one atomic slot reservation and a
+/// 16-byte store; nothing blocks and nothing allocates. Rings overwrite their
+/// oldest spans, so a dump shows the last few hundred operations per core.
+/// Dumps are Chrome trace-event JSON ("ph":"X", pid = core, tid = task) and
+/// open in Perfetto or chrome://tracing. Recording pauses while a dump runs.
+/// The rings themselves are TraceRing (trace_ring.h).
+class Trace {
+    static TraceRing _rings;
+    static uint32_t _spanCostNs;
+
+public:
+    static inline bool Recording() { return _rings.Recording(); }
+    static void Record(const char* name, int64_t startUs, int64_t endUs);
+
+    static void Enable(bool enabled);
+    static void Clear();
+    /// @brief Measure the cost of a span (span_cost_ns in describe)
+    static void Calibrate();
+
+    /// @brief Write the rings as Chrome trace JSON through buf.
+    /// With split, every flush is a self-contained document (one MQTT message
+    /// each); otherwise the flushes are consecutive pieces of one document.
+    static void ChromeJson(char* buf, size_t cap, bool split,
+                           void (*flush)(const char* json, size_t len, void* ctx), void* ctx);
+
+    /// @brief Copy the newest spans of both cores, oldest first. Returns the count.
+    static size_t Recent(TraceEvent* out, uint8_t* cores, size_t max);
+
+    static JsonDocument describe();
+    static void Configure(const JsonDocument& doc);
+};
+
+/// @brief Records the enclosing scope as a span
+class TraceSpan {
+    const char* _name;
+    int64_t _start;
+
+public:
+    inline explicit TraceSpan(const char* name) : _name(name), _start(Trace::Recording() ? esp_timer_get_time() : 0) {}
+    inline ~TraceSpan() {
+        if (_start) {
+            Trace::Record(_name, _start, esp_timer_get_time());
+        }
+    }
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SPAN(name) TraceSpan TRACE_CONCAT(traceSpan, __LINE__)(name)
@@ -0,0 +1,57 @@
+#pragma once
+
+// Span rings and the Chrome trace dump behind Trace (trace.h). Plain C++, no
+// Arduino dependencies: the caller passes the core, task and time, so the
+// rings are checked on the host (tools/trace_check.cpp).
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+#define TRACE_RING_EVENTS 256           // per core, 16 bytes each, internal RAM
+#define TRACE_CORES 2
+
+/// @brief One completed span. Names are string literals, never copied.
+struct TraceEvent {
+    const char* name;
+    uint32_t startUs;                   // low 32 bits of esp_timer_get_time()
+    uint32_t durUs;
+    void* task;                         // FreeRTOS task handle, the Chrome "tid"
+};
+
+/// @brief One ring per core. Each core only writes its own ring; tasks on the
+/// same core can preempt each other, so a slot is reserved atomically before
+/// it is filled. Rings overwrite their oldest spans.
+class TraceRing {
+    TraceEvent _ring[TRACE_CORES][TRACE_RING_EVENTS] = {};
+    std::atomic<uint32_t> _head[TRACE_CORES] = {};
+    std::atomic<bool> _enabled{true};
+    std::atomic<bool> _paused{false};
+    std::atomic<uint32_t> _spans{0};
+
+public:
+    inline bool Recording() const {
+        return _enabled.load(std::memory_order_relaxed) && !_paused.load(std::memory_order_relaxed);
+    }
+    void Record(int core, void* task, const char* name, int64_t startUs, int64_t endUs);
+
+    void Enable(bool enabled);
+    void Clear();
+
+    /// @brief Write the rings as Chrome trace JSON through buf, timestamps
+    /// unwrapped against nowUs. With split, every flush is a self-contained
+    /// document; otherwise the flushes are consecutive pieces of one document.
+    void ChromeJson(int64_t nowUs, char* buf, size_t cap, bool split,
+                    void (*flush)(const char* json, size_t len, void* ctx), void* ctx);
+
+    /// @brief Copy the newest spans of both cores, oldest first. Returns the count.
+    size_t Recent(uint32_t nowUs, TraceEvent* out, uint8_t* cores, size_t max) const;
+
+    inline bool Enabled() const { return _enabled.load(); }
+    inline uint32_t Spans() const { return _spans.load(); }
+    /// @brief Spans held by a core's ring
+    inline uint32_t Held(int core) const {
+        uint32_t head = _head[core].load();
+        return head < TRACE_RING_EVENTS ? head : TRACE_RING_EVENTS;
+    }
+};
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#define UPLOAD_BENCHMARK_MAX_COUNT 50
+#define UPLOAD_BENCHMARK_MAX_BYTES (1024*1024)
+#define UPLOAD_BENCHMARK_FOLDER "bench"      // under the device S3 folder
+
+/// @brief End-to-end S3 benchmark: `count` PUTs of `bytes` each through the
+/// regular upload path, then GETs of the same objects. Reports requests/s,
+/// bytes/s and p50/p99 latency per operation. Point S3_ENDPOINT at the local
+/// stand-in (tools/s3_standin.py) to inject latency, bandwidth limits and failures.
+JsonDocument uploadBenchmark(int count, size_t bytes);
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include "esp_camera.h"
+#include "upload_pipeline_model.h"
+
+#define UPLOAD_PIPELINE_PREP_CORE 1       // hash/sign next to the loop task
+#define UPLOAD_PIPELINE_NET_CORE 0        // network next to the WiFi stack
+
+struct UploadJob;
+
+/// @brief Two-stage upload pipeline for continuous capture.
+/// A task on core 1 hashes and signs frame N+1 while a task on core 0 sends
+/// frame N over a persistent TLS connection. Completed uploads are handed back
+/// to the loop task through Poll() so MQTT is only touched from one task.
+class UploadPipeline {
+    QueueHandle_t _frames = nullptr;    // copied frames waiting for hash/sign
+    QueueHandle_t _prepared = nullptr;  // signed requests waiting for the network
+    QueueHandle_t _done = nullptr;      // sent requests waiting for Poll()
+    bool _started = false;
+
+    // Written by both stage tasks, read by the loop task
+    SemaphoreHandle_t _statsLock = nullptr;
+    UploadStageStats _prep;
+    UploadStageStats _queue;
+    UploadStageStats _net;
+    uint32_t _dropped = 0;
+    uint32_t _failed = 0;
+    unsigned long _firstEnqueueMs = 0;
+    unsigned long _lastDoneMs = 0;
+
+    void RecordStats(UploadStageStats& stage, uint32_t us);
+
+    static void PrepTask(void* arg);
+    static void NetTask(void* arg);
+    void Prepare(UploadJob* job);
+    bool Send(UploadJob* job);
+
+public:
+    static UploadPipeline pipeline;
+
+    bool Begin();
+    bool Enqueue(camera_fb_t* fb, const String& filename, const String& folderName);
+    bool Poll(String& uri, bool& success);
+    JsonDocument describe() const;
+};
@@ -0,0 +1,36 @@
+#pragma once
+
+// Stage counters and the frames/minute model of the upload pipeline, shared
+// by the firmware (upload_pipeline.cpp) and the host model
+// (tools/pipeline_model.cpp). Plain C++, no Arduino dependencies.
+
+#include <stdint.h>
+
+#define UPLOAD_PIPELINE_DEPTH 2           // frames buffered per stage
+
+/// @brief Timing counters for one pipeline stage (not thread safe, the owner locks)
+struct UploadStageStats {
+    uint32_t count = 0;
+    uint64_t totalUs = 0;
+    uint32_t maxUs = 0;
+
+    inline void Record(uint32_t us) {
+        ++count;
+        totalUs += us;
+        if (us > maxUs) {
+            maxUs = us;
+        }
+    }
+    inline uint32_t AverageUs() const { return count ? (uint32_t)(totalUs / count) : 0; }
+};
+
+/// @brief Frames/minute when each frame is hashed, signed and sent in turn
+inline double uploadSerialFpm(uint32_t prepUs, uint32_t netUs) {
+    return prepUs + netUs ? 60000000.0 / (prepUs + netUs) : 0;
+}
+
+/// @brief Frames/minute when the two stages overlap: the slower one sets the pace
+inline double uploadPipelinedFpm(uint32_t prepUs, uint32_t netUs) {
+    uint32_t slower = prepUs > netUs ? prepUs : netUs;
+    return slower ? 60000000.0 / slower : 0;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "s3_put_retry.h"
+
+#define UPLOAD_RETRY_BUDGET_MAX 10.0        // retry tokens, spent 1 per retry
+#define UPLOAD_RETRY_BUDGET_RATIO 0.2       // tokens earned per upload: retries stay under ~20%
+
+/// @brief MD5 of a payload as S3 uses it: base64 for Content-MD5, hex for the ETag
+struct PayloadMd5 {
+    char base64[25];
+    char hex[33];
+
+    void Compute(const uint8_t* buf, size_t len);
+    bool Matches(const char* etag) const;
+};
+
+/// @brief Retry budget, integrity checks and counters for signed S3 PUTs; the
+/// retry decisions themselves are in S3PutRetry (s3_put_retry.h). Each PUT
+/// carries Content-MD5 (S3 rejects damaged bodies with 400 BadDigest) and the
+/// returned ETag is compared with the local MD5. Retries share a token budget
+/// so a failing network does not turn every upload into four, and all attempts
+/// of one upload share the time a single attempt may take, so retrying does not
+/// hold the calling (loop) task any longer than one upload did before.
+/// Counters are also updated by the pipeline network task, hence the lock.
+class UploadRetry {
+    SemaphoreHandle_t _lock = nullptr;
+    bool _verifyEtag = true;
+    float _tokens = UPLOAD_RETRY_BUDGET_MAX;
+
+    uint32_t _outcomes[UPLOAD_OUTCOME_COUNT] = {};
+    uint32_t _attempts = 0;
+    uint32_t _retries = 0;
+    uint32_t _digestErrors = 0;       // 400 BadDigest: body damaged on the way
+    uint32_t _etagMismatches = 0;
+    uint32_t _unverified = 0;         // no plain MD5 ETag in the response
+
+    void ReadNVM();
+    void SaveNVM();
+
+public:
+    static UploadRetry retry;
+
+    void Begin();
+    bool VerifyEtag();
+    bool TakeRetry();
+    void RecordAttempt(int httpCode, const char* responseBody);
+    bool CheckEtag(const PayloadMd5& md5, const char* etag);
+    void RecordEtag(S3EtagCheck check, const char* etag, const char* md5Hex);
+    void RecordOutcome(UploadOutcome outcome);
+
+    uint32_t Attempts();
+    uint32_t Retries();
+    float Budget();
+    uint32_t Failed();
+
+    void Configure(const JsonDocument& doc);
+    JsonDocument describe();
+};
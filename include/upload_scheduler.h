@@ -0,0 +1,59 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#ifndef UPLOAD_DAILY_BUDGET_BYTES
+#define UPLOAD_DAILY_BUDGET_BYTES (60UL*1024*1024)  // ~1.8 GB/month of cellular/hotspot data
+#endif
+#define UPLOAD_BUDGET_LOW_PERCENT 25               // below this, non-motion photos are reduced
+#define UPLOAD_BUDGET_SAVE_INTERVAL 600000         // 10 minutes between NVM writes
+
+// Upload classes, highest priority first
+enum UploadPriority {
+    UPLOAD_MOTION = 0,
+    UPLOAD_MANUAL,
+    UPLOAD_LIVE,
+    UPLOAD_SCHEDULED,
+    UPLOAD_TELEMETRY,
+    UPLOAD_PRIORITY_COUNT
+};
+
+enum UploadDecision {
+    UPLOAD_FULL,      // upload as requested
+    UPLOAD_REDUCED,   // upload a thumbnail-size frame instead
+    UPLOAD_SKIP       // not enough budget left for this class
+};
+
+/// @brief Token-bucket daily byte budget shared by all uploads.
+/// Lower priority classes keep a reserve free for higher ones, and degrade to
+/// thumbnails or are skipped when the bucket runs low. Bucket state survives
+/// reboots (NVM) and refills from wall clock time.
+class UploadScheduler {
+    bool _loaded = false;
+    bool _dirty = false;
+    uint32_t _dailyBudget = UPLOAD_DAILY_BUDGET_BYTES;
+    float _tokens = UPLOAD_DAILY_BUDGET_BYTES;
+    time_t _lastRefill = 0;
+    unsigned long _lastSaveMs = 0;
+
+    uint32_t _full[UPLOAD_PRIORITY_COUNT] = {};
+    uint32_t _reduced[UPLOAD_PRIORITY_COUNT] = {};
+    uint32_t _skipped[UPLOAD_PRIORITY_COUNT] = {};
+    uint32_t _bytes[UPLOAD_PRIORITY_COUNT] = {};
+
+    void Refill();
+    void ReadNVM();
+    void SaveNVM();
+    float Reserve(UploadPriority priority) const;
+
+public:
+    static UploadScheduler scheduler;
+
+    UploadDecision Admit(UploadPriority priority, size_t estimatedBytes, size_t reducedBytes);
+    void Consume(UploadPriority priority, size_t bytes);
+    void Configure(const JsonDocument& doc);
+    JsonDocument describe();
+
+    static const char* PriorityName(UploadPriority priority);
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+// Scoring, cooldown and selection behind UploadTargets (upload_targets.h),
+// shared by the firmware and the host check (tools/upload_targets_check.cpp).
+// Plain C++, no Arduino dependencies: the caller passes the time in ms and
+// serializes access.
+//
+// A target's cost is the EWMA of milliseconds per KB sent, with a fixed
+// UPLOAD_TARGET_OVERHEAD_KB added to every request for connect, TLS and the
+// response. A 1 KB status document and a 100 KB photo over the same link come
+// out at about the same cost, so the score does not depend on which payload a
+// target sent last. The score is the cost scaled by the error rate; a target
+// that failed cools down, doubling per consecutive failure, and is only used
+// as a last resort until then.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define UPLOAD_TARGETS_MAX 4
+#define UPLOAD_TARGET_OVERHEAD_KB 16        // fixed cost of a request, in KB of transfer
+#define UPLOAD_TARGET_DEFAULT_MS_PER_KB 40  // assumed cost of a target never measured: 3 s for a 60 KB photo
+#define UPLOAD_TARGET_ERROR_WEIGHT 4.0f     // score = ms per KB * (1 + weight * error rate)
+#define UPLOAD_TARGET_EWMA_ALPHA 0.3f
+#define UPLOAD_TARGET_COOLDOWN_MS 30000     // after a failure, doubled per consecutive failure
+#define UPLOAD_TARGET_MAX_COOLDOWN_MS 600000
+#define UPLOAD_TARGET_LAST_RESORT 1e9f      // added to the score while cooling down
+
+struct UploadTargetScore {
+    uint32_t samples;
+    float msPerKb;              // EWMA over successful requests
+    float errorRate;            // EWMA of failures (0..1)
+    uint32_t ok;
+    uint32_t failed;
+    uint8_t consecutiveFailures;
+    uint32_t cooldownUntil;     // ms, 0 when not cooling down
+};
+
+class UploadTargetScores {
+    UploadTargetScore _targets[UPLOAD_TARGETS_MAX] = {};
+    int _count = 0;
+
+public:
+    /// @brief Append an unmeasured target. Returns its index, -1 when full.
+    int Add();
+    /// @brief Drop the targets from count on
+    void Truncate(int count);
+    /// @brief Forget measurements and cooldowns, keep the counters
+    void Reset();
+
+    /// @brief Best scoring target not in excludeMask (bit per index), ties to
+    /// the lower index. Returns -1 when every target is excluded.
+    int Select(uint32_t excludeMask, uint32_t nowMs) const;
+
+    /// @brief Account one request of bytes that took ms. Returns the cooldown
+    /// started by a failure, 0 after a success.
+    uint32_t Record(int index, uint32_t ms, size_t bytes, bool success, uint32_t nowMs);
+
+    float Score(int index, uint32_t nowMs) const;
+    uint32_t CooldownLeft(int index, uint32_t nowMs) const;
+
+    inline int Count() const { return _count; }
+    inline const UploadTargetScore& Target(int index) const { return _targets[index]; }
+};
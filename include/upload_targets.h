@@ -0,0 +1,44 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "upload_target_scores.h"
+
+/// @brief Where one signed PUT goes: a copy, safe to use outside the target lock
+struct UploadEndpoint {
+    int index;
+    char host[96];        // bucket.s3.<region>.amazonaws.com or host:port of a LAN gateway
+    char region[24];      // SigV4 signing region
+    bool tls;
+};
+
+/// @brief Upload targets with a running cost/error score (upload_target_scores.h).
+/// Target 0 is the configured S3 bucket (secrets.h); more region buckets or a
+/// LAN gateway can be added with the "upload-targets" IoT command. Uploads go
+/// to the best scoring target and fail over to the next one; a failing target
+/// cools down for a while before it is preferred again.
+class UploadTargets {
+    struct Target {
+        String name;
+        String host;
+        String region;
+        bool tls;
+    };
+
+    Target _targets[UPLOAD_TARGETS_MAX];
+    UploadTargetScores _scores;
+    SemaphoreHandle_t _lock = nullptr;
+
+    void AddTarget(const char* name, const String& host, const char* region, bool tls);
+    void LoadExtras(const JsonDocument& doc);
+
+public:
+    static UploadTargets targets;
+
+    void Begin();
+    bool Select(uint32_t excludeMask, UploadEndpoint& endpoint);
+    /// @brief Account one request to target index that sent bytes in ms
+    void Record(int index, unsigned long ms, size_t bytes, bool success);
+    void Configure(const JsonDocument& doc);
+    JsonDocument describe();
+};
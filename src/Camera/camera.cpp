@@ -14,6 +14,13 @@
 #include "common.h"
 #include "aws_iot.h"
 #include "offline_reboot.h"
+#include "timelapse_bundle.h"
+#include "s3_connection.h"
+#include "telemetry_log.h"
+#include "async_log.h"
+#include "journal.h"
+#include "heap_profile.h"
+#include "event_recorder.h"
 
 #ifndef CAMERA
 #error "This file should only be included in the CAMERA environment"
@@ -29,6 +36,8 @@ void setup() {
 
   // Initialize serial communication for debugging
   Serial.begin(115200);
+  AsyncLog::logger.Start();
+  Journal::journal.Begin();
 
   logPrintf(LOG_INFO, "=== Cat Camera Controller Starting ===");
 
@@ -54,6 +63,10 @@ void setup() {
 void loop() {
     unsigned long now = millis();
     loopAwsIot();
+    TelemetryLog::telemetry.Loop();
+    Journal::journal.Loop();
+    HeapProfile::profile.Loop();
+    EventRecorder::recorder.Loop();
 
     if (!IsWiFiConnected()) {
       !offlineReboot.Check(true);
@@ -61,11 +74,13 @@ void loop() {
     }
     else {
       offlineReboot.Reset();
+      TimelapseBundle::bundle.Loop();
+      S3Connection::shared.CloseIdle();
       bool motion = readPIRSensor();
       bool canAct = cameraAction.CanAct(), mustAct = cameraAction.MustAct();
       if ((motion && canAct) || mustAct) {
         logPrintf(LOG_INFO, "ACTION: %lu %d %d %d", cameraAction.CurrentDelay(), motion, canAct, mustAct);
-        if (takeAndUploadPhoto("Action")) {
+        if (takeAndUploadPhoto("Action", (motion && canAct) ? UPLOAD_MOTION : UPLOAD_SCHEDULED)) {
           cameraAction.MarkAct();
         }
       }
@@ -16,6 +16,13 @@
 #include "app_httpd.h"
 #include "json_config.h"
 #include "ambient.h"
+#include "timelapse_bundle.h"
+#include "s3_connection.h"
+#include "telemetry_log.h"
+#include "async_log.h"
+#include "journal.h"
+#include "heap_profile.h"
+#include "event_recorder.h"
 
 
 #ifdef DFR1154
@@ -45,6 +52,8 @@ void setup() {
 
   // Initialize serial communication for debugging
   Serial.begin(115200);
+  AsyncLog::logger.Start();
+  Journal::journal.Begin();
 
   logPrintf(LOG_INFO, "=== Cat Camera Controller Starting ===");
 
@@ -89,12 +98,18 @@ void loopCallback() {
     loopAwsIot();
 
     Ambient::ltr.loop();
+    TelemetryLog::telemetry.Loop();
+    Journal::journal.Loop();
+    HeapProfile::profile.Loop();
+    EventRecorder::recorder.Loop();
 
     if (!IsWiFiConnected()) {
 
         connectWiFi();
     }
     else {
+      TimelapseBundle::bundle.Loop();
+      S3Connection::shared.CloseIdle();
       if (cameraAction.MustAct()) {
         if (takeAndUploadPhoto("Action")) {
           cameraAction.MarkAct();
@@ -1,14 +1,37 @@
+#define LOG_MODULE LOG_MODULE_IOT
+
 #include <WiFiClientSecure.h>
 #include <MQTT.h>
 #include <ArduinoJson.h>
+#include <esp_timer.h>
 #include "common.h"
 #include "aws_iot.h"
 #include "secrets.h"
 #include "live_photo.h"
 #include "json_config.h"
+#include "upload_pipeline.h"
+#include "crypto_benchmark.h"
+#include "rate_controller.h"
+#include "s3_post_policy.h"
+#include "timelapse_bundle.h"
+#include "upload_benchmark.h"
+#include "dns_cache.h"
+#include "upload_targets.h"
+#include "json_compression.h"
+#include "upload_retry.h"
+#include "s3_connection.h"
+#include "mqtt_encoding.h"
+#include "telemetry_log.h"
+#include "metrics.h"
+#include "trace.h"
+#include "async_log.h"
+#include "journal.h"
+#include "heap_profile.h"
+#include "latency_slo.h"
+#include "event_recorder.h"
 
 // MQTT configuration
-#define MQTT_BUFFER_SIZE 1024
+#define MQTT_BUFFER_SIZE 2048  // S3 POST policy responses exceed 1 KB
 #define MQTT_KEEPALIVE_SEC 60
 #define IOT_RECONNECT_MAX_DELAY 120000   // 2 minutes max backoff
 #define IOT_RECONNECT_MIN_DELAY 5000     // 5 seconds initial
@@ -16,17 +39,21 @@
 
 // Topic strings (built in setup)
 static String topicCommands;
+static String topicPolicy;
 
 static String clientId;
 
 static LivePhoto livePhoto;
 
 // Module state
-static WiFiClientSecure tlsClient;
+static ResolvingClientSecure tlsClient;
 static MQTTClient mqttClient(MQTT_BUFFER_SIZE);
 static BackOffRetry mqttRetry(IOT_RECONNECT_MAX_DELAY, IOT_RECONNECT_MIN_DELAY);
 static bool iotInitialized = false;
 static unsigned long lastStatusPublish = 0;
+static unsigned long lastMetricsPublish = 0;
+// Encoded JsonDocument payloads (loop task only, like the MQTT client)
+static uint8_t payloadBuffer[MQTT_BUFFER_SIZE];
 
 // Forward declarations
 static void onMqttMessage(String &topic, String &payload);
@@ -41,6 +68,10 @@ String buildTopicName(const String& topic) {
 
 void setupAwsIot() {
   topicCommands = buildTopicName("commands");
+  topicPolicy = buildTopicName("policy");
+  S3PostPolicy::policy.Begin();
+  UploadTargets::targets.Begin();
+  UploadRetry::retry.Begin();
 
   tlsClient.setCACert(AWS_IOT_ROOT_CA);
   tlsClient.setCertificate(AWS_IOT_DEVICE_CERT);
@@ -66,7 +97,13 @@ void loopAwsIot() {
 
   
   mqttClient.loop();
+  S3PostPolicy::policy.Loop();
   livePhoto.Loop();
+
+  if (millis() - lastMetricsPublish >= METRICS_PUBLISH_INTERVAL) {
+    lastMetricsPublish = millis();
+    IoTPublish(buildTopicName("metrics"), Metrics::describe(), false, 0);
+  }
 }
 
 bool isIotConnected() {
@@ -80,8 +117,12 @@ static bool mqttConnect() {
 
   auto deviceName = WiFi.getHostname();
 
+  TRACE_SPAN("mqtt.connect");
+  int64_t start = esp_timer_get_time();
   bool ok = mqttClient.connect(deviceName);
+  metricMqttConnect.Observe((uint32_t)(esp_timer_get_time() - start));
   if (!ok) {
+    metricMqttConnectFailures.Inc();
     logPrintf(LOG_WARNING, "MQTT connect failed (error: %d)", mqttClient.lastError());
     return false;
   }
@@ -91,6 +132,7 @@ static bool mqttConnect() {
 
   mqttClient.subscribe(topicCommands, 1);
   logPrintf(LOG_INFO, "MQTT subscribed to %s", topicCommands.c_str());
+  mqttClient.subscribe(topicPolicy, 1);
 
   JsonDocument doc;
   doc["device"] = deviceName;
@@ -105,11 +147,21 @@ static bool mqttConnect() {
 // ===== Incoming messages =====
 
 static void onMqttMessage(String &topic, String &payload) {
+  HEAP_PROBE(heapSiteMqttCommand);
   logPrintf(LOG_INFO, "MQTT message on %s: %s", topic.c_str(), payload.c_str());
 
   if (topic == topicCommands) {
+    EventRecorder::recorder.Command(EVENT_SOURCE_IOT, payload.c_str(), payload.length());
     handleIotCommand(payload);
   }
+  else if (topic == topicPolicy) {
+    JsonDocument doc;
+    if (deserializeJson(doc, payload)) {
+      logPrint(LOG_ERROR, "S3 POST policy JSON parse error");
+      return;
+    }
+    S3PostPolicy::policy.Read(doc);
+  }
 }
 
 static void handleIotCommand(const String &payload) {
@@ -132,12 +184,108 @@ static void handleIotCommand(const String &payload) {
 
   if (strcmp(command, "snapshot") == 0) {
     if (cameraAvailable) {
-      takeAndUploadPhoto("iot-command");
+      takeAndUploadPhoto("iot-command", UPLOAD_MANUAL);
     }
   }
   else if (strcmp(command, "live-photo") == 0) {
     livePhoto.Start();
   }
+  else if (strcmp(command, "live-photo-full") == 0) {
+    livePhoto.RequestFull();
+  }
+  else if (strcmp(command, "status") == 0) {
+    // Same fields as the S3 status JSON (writeStatusFields)
+    HEAP_PROBE(heapSiteStatusJson);
+    IoTPublish(buildTopicName("status"), statusDocument(), false, 0);
+  }
+  else if (strcmp(command, "get-pipeline-stats") == 0) {
+    IoTPublish(buildTopicName("pipeline"), UploadPipeline::pipeline.describe(), false, 0);
+  }
+  else if (strcmp(command, "crypto-benchmark") == 0) {
+    IoTPublish(buildTopicName("crypto-benchmark"), cryptoBenchmark(), false, 0);
+  }
+  else if (strcmp(command, "upload-benchmark") == 0) {
+    IoTPublish(buildTopicName("upload-benchmark"),
+               uploadBenchmark(doc["count"] | 10, doc["bytes"] | 100 * 1024), false, 0);
+  }
+  else if (strcmp(command, "dns-cache") == 0) {
+    IoTPublish(buildTopicName("dns-cache"), DnsCache::cache.describe(), false, 0);
+  }
+  else if (strcmp(command, "upload-retry") == 0) {
+    UploadRetry::retry.Configure(doc);
+    IoTPublish(buildTopicName("upload-retry"), UploadRetry::retry.describe(), false, 0);
+  }
+  else if (strcmp(command, "s3-connection") == 0) {
+    IoTPublish(buildTopicName("s3-connection"), S3Connection::shared.describe(), false, 0);
+  }
+  else if (strcmp(command, "upload-targets") == 0) {
+    UploadTargets::targets.Configure(doc);
+    IoTPublish(buildTopicName("upload-targets"), UploadTargets::targets.describe(), false, 0);
+  }
+  else if (strcmp(command, "metrics") == 0) {
+    lastMetricsPublish = millis();
+    IoTPublish(buildTopicName("metrics"), Metrics::describe(), false, 0);
+  }
+  else if (strcmp(command, "log") == 0) {
+    AsyncLog::logger.Configure(doc);
+    IoTPublish(buildTopicName("log"), AsyncLog::logger.describe(), false, 0);
+  }
+  else if (strcmp(command, "journal") == 0) {
+    Journal::journal.Configure(doc);
+    IoTPublish(buildTopicName("journal"), Journal::journal.describe(), false, 0);
+  }
+  else if (strcmp(command, "slo") == 0) {
+    LatencySlo::slo.Configure(doc);
+    IoTPublish(buildTopicName("slo"), LatencySlo::slo.describe(), false, 0);
+  }
+  else if (strcmp(command, "heap-report") == 0) {
+    HeapProfile::profile.Configure(doc);
+    IoTPublish(buildTopicName("heap-report"), HeapProfile::profile.describe(), false, 0);
+  }
+  else if (strcmp(command, "trace") == 0) {
+    Trace::Configure(doc);
+    if (doc["dump"] | false) {
+      // One self-contained trace document per message
+      String topic = buildTopicName("trace");
+      Trace::ChromeJson((char*)payloadBuffer, IoTMaxPayload(topic), true,
+          [](const char* json, size_t len, void* ctx) {
+            IoTPublish(*(const String*)ctx, (const uint8_t*)json, len, false, 0);
+          }, &topic);
+    }
+    IoTPublish(buildTopicName("trace-stats"), Trace::describe(), false, 0);
+  }
+  else if (strcmp(command, "recorder") == 0) {
+    EventRecorder::recorder.Configure(doc);
+    IoTPublish(buildTopicName("recorder-stats"), EventRecorder::recorder.describe(), false, 0);
+  }
+  else if (strcmp(command, "telemetry") == 0) {
+    TelemetryLog::telemetry.Configure(doc);
+    IoTPublish(buildTopicName("telemetry-stats"), TelemetryLog::telemetry.describe(), false, 0);
+  }
+  else if (strcmp(command, "mqtt-encoding") == 0) {
+    MqttEncoding::encoding.Configure(doc);
+    IoTPublish(buildTopicName("mqtt-encoding"), MqttEncoding::encoding.describe(), false, 0);
+  }
+  else if (strcmp(command, "compression") == 0) {
+    JsonCompression::compression.Configure(doc);
+    IoTPublish(buildTopicName("compression"), JsonCompression::compression.describe(), false, 0);
+  }
+  else if (strcmp(command, "rate-control") == 0) {
+    RateController::rate.Configure(doc);
+    IoTPublish(buildTopicName("rate-control"), RateController::rate.describe(), false, 0);
+  }
+  else if (strcmp(command, "upload-budget") == 0) {
+    UploadScheduler::scheduler.Configure(doc);
+    IoTPublish(buildTopicName("upload-budget"), UploadScheduler::scheduler.describe(), false, 0);
+  }
+  else if (strcmp(command, "upload-mode") == 0) {
+    S3PostPolicy::policy.Configure(doc);
+    IoTPublish(buildTopicName("upload-mode"), S3PostPolicy::policy.describe(), false, 0);
+  }
+  else if (strcmp(command, "timelapse") == 0) {
+    TimelapseBundle::bundle.Configure(doc);
+    IoTPublish(buildTopicName("timelapse"), TimelapseBundle::bundle.describe(), false, 0);
+  }
   else if (strcmp(command, "reboot") == 0) {
     rebootSystem("IoT reboot command");
   }
@@ -155,12 +303,57 @@ static void handleIotCommand(const String &payload) {
 
 
 bool IoTPublish(const String& topic, const String& payload, bool retained, int qos) {
+  TRACE_SPAN("mqtt.publish");
   return  mqttClient.connected() &&
     mqttClient.publish(topic, payload, retained, qos);
 }
 
 bool IoTPublish(const String& topic, const JsonDocument& payload, bool retained, int qos) {
-  String serialized;
-  serializeJson(payload, serialized);
-  return  IoTPublish(topic, serialized, retained, qos);
+  HEAP_PROBE(heapSiteMqttPublish);
+  size_t maxLen = IoTMaxPayload(topic);
+  if (MqttEncoding::encoding.Cbor(topic)) {
+    size_t len = MqttEncoding::encoding.EncodeCbor(payload, payloadBuffer, maxLen);
+    if (len) {
+      return IoTPublish(topic, payloadBuffer, len, retained, qos);
+    }
+  }
+
+  int64_t start = esp_timer_get_time();
+  size_t len = serializeJson(payload, (char*)payloadBuffer, sizeof(payloadBuffer));
+  MqttEncoding::encoding.RecordJson(len, (uint32_t)(esp_timer_get_time() - start));
+  const char* json = (const char*)payloadBuffer;
+  String oversized;
+  if (len >= sizeof(payloadBuffer) - 1) {
+    // Truncated: only gzip can still make it fit
+    serializeJson(payload, oversized);
+    json = oversized.c_str();
+    len = oversized.length();
+  }
+  if (JsonCompression::compression.MqttGzip()) {
+    size_t gzLen = 0;
+    uint8_t* gz = JsonCompression::compression.Gzip(json, len, gzLen);
+    if (gz) {
+      bool ok = IoTPublish(topic, gz, gzLen, retained, qos);
+      free(gz);
+      return ok;
+    }
+  }
+  if (len > maxLen) {
+    logPrintf(LOG_WARNING, "MQTT payload for %s exceeds %u bytes", topic.c_str(), maxLen);
+    return false;
+  }
+  return  IoTPublish(topic, (const uint8_t*)json, len, retained, qos);
+}
+
+// Binary payload published straight from the caller's buffer
+bool IoTPublish(const String& topic, const uint8_t* payload, size_t len, bool retained, int qos) {
+  TRACE_SPAN("mqtt.publish");
+  return  mqttClient.connected() &&
+    mqttClient.publish(topic.c_str(), (const char*)payload, (int)len, retained, qos);
+}
+
+// Largest payload that fits the client buffer with this topic
+// (fixed header + remaining length + topic length prefix + packet id)
+size_t IoTMaxPayload(const String& topic) {
+  return MQTT_BUFFER_SIZE - topic.length() - 9;
 }
\ No newline at end of file
@@ -26,12 +26,18 @@
 #include "image_analyzer.h"
 #include "common.h"
 #include "aws_iot.h"
+#include "telemetry_log.h"
+#include "async_log.h"
+#include "journal.h"
+#include "heap_profile.h"
+#include "event_recorder.h"
 
 const char* deviceName = "PATURA";
 
 void setup() {
   // Initialize serial communication for debugging
   Serial.begin(115200);
+  AsyncLog::logger.Start();
   delay(1000);
 
   Serial.println("\n=== Cat Shelter Controller Starting ===");
@@ -41,6 +47,7 @@ void setup() {
 
   // Increment boot attempt counter
   incrementBootAttempt();
+  Journal::journal.Begin();
 
   bootStartTime = millis();
 
@@ -165,6 +172,12 @@ void loop() {
   // Update blanket control based on conditions
   updateBlanketControl();
 
+  // Seal and upload sensor history batches
+  TelemetryLog::telemetry.Loop();
+  Journal::journal.Loop();
+  HeapProfile::profile.Loop();
+  EventRecorder::recorder.Loop();
+
   // Check if it's time to take and upload a photo
   checkPhotoSchedule();
   
@@ -1,3 +1,5 @@
+#define LOG_MODULE LOG_MODULE_SENSORS
+
 #include <Arduino.h>
 #include <ArduinoJson.h>
 #ifdef HAS_LTR308    
@@ -5,6 +7,8 @@
 #endif
 #include "common.h"
 #include "ambient.h"
+#include "telemetry_log.h"
+#include "event_recorder.h"
 
 
 #ifdef HAS_LTR308    
@@ -47,6 +51,8 @@ void Ambient::loop() {
         auto status = ltr308.getStatus();
         if (lux > 0) { // 0 means no data acquired
             _lux = lux;
+            TelemetryLog::telemetry.Record(TELEMETRY_LUX, lux);
+            EventRecorder::recorder.Lux(lux);
         }
         if (lux > 0 && lux < 1) {
             _condition = Night;
@@ -0,0 +1,159 @@
+#include <Arduino.h>
+#include <Preferences.h>
+#include <ArduinoJson.h>
+#include "common.h"
+#include "async_log.h"
+#include "journal.h"
+
+#define NVM_PREFS_SECTION "log"
+#define NVM_LEVELS_KEY "levels"
+
+AsyncLog AsyncLog::logger;
+
+static const char* MODULE_NAMES[LOG_MODULE_COUNT] = {
+    "main", "wifi", "iot", "upload", "camera", "sensors", "httpd"};
+
+static const char* LEVEL_NAMES[] = {"ERROR", "WARNING", "INFO", "DEBUG"};
+
+void logWrite(LogModule module, LogLevel level, const char* format, ...) {
+    if (!AsyncLog::logger.Enabled(module, level)) {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    AsyncLog::logger.Write(module, level, format, args);
+    va_end(args);
+}
+
+static void printLine(uint8_t level, const char* message) {
+    const char* prefix = "";
+    switch (level) {
+      case LOG_ERROR:   prefix = "[ERROR] "; break;
+      case LOG_WARNING: prefix = "[WARN]  "; break;
+      case LOG_INFO:    prefix = "[INFO]  "; break;
+      case LOG_DEBUG:   prefix = "[DEBUG] "; break;
+    }
+    Serial.print(prefix);
+    Serial.println(message);
+}
+
+AsyncLog::AsyncLog() {
+    memset(_levels, LOG_LEVEL_INHERIT, sizeof(_levels));
+}
+
+void AsyncLog::ReadNVM() {
+    Preferences prefs;
+    prefs.begin(NVM_PREFS_SECTION, true);
+    if (prefs.getBytesLength(NVM_LEVELS_KEY) == sizeof(_levels)) {
+        prefs.getBytes(NVM_LEVELS_KEY, _levels, sizeof(_levels));
+    }
+    prefs.end();
+}
+
+void AsyncLog::SaveNVM() {
+    Preferences prefs;
+    prefs.begin(NVM_PREFS_SECTION, false);
+    prefs.putBytes(NVM_LEVELS_KEY, _levels, sizeof(_levels));
+    prefs.end();
+}
+
+void AsyncLog::Start() {
+    if (_task) {
+        return;
+    }
+    ReadNVM();
+    if (xTaskCreate(LogTask, "log", LOG_TASK_STACK, this, LOG_TASK_PRIORITY, &_task) != pdPASS) {
+        _task = nullptr;
+        logPrint(LOG_ERROR, "Log task not started, logging stays synchronous");
+    }
+}
+
+void AsyncLog::Write(LogModule module, LogLevel level, const char* format, va_list args) {
+    if (_task) {
+        _ring.Push(module, level, millis(), format, args);
+        return;
+    }
+    char buffer[LOG_LINE_MAX];
+    int len = vsnprintf(buffer, sizeof(buffer), format, args);
+    printLine(level, buffer);
+    Journal::journal.Log(level, module, buffer, min(max(len, 0), (int)sizeof(buffer) - 1));
+}
+
+void AsyncLog::Drain() {
+    LogRecord record;
+    char line[LOG_LINE_MAX];
+    while (_ring.Pop(record)) {
+        size_t len = LogRing::Format(record, line, sizeof(line));
+        printLine(record.level, line);
+        Journal::journal.Log(record.level, record.module, line, len);
+    }
+    uint32_t dropped = _ring.Dropped();
+    if (dropped != _reportedDrops) {
+        snprintf(line, sizeof(line), "Log ring full: %u lines dropped", dropped - _reportedDrops);
+        printLine(LOG_WARNING, line);
+        _reportedDrops = dropped;
+    }
+}
+
+void AsyncLog::LogTask(void* arg) {
+    AsyncLog* self = (AsyncLog*)arg;
+    for (;;) {
+        self->Drain();
+        vTaskDelay(pdMS_TO_TICKS(LOG_TASK_IDLE_MS));
+    }
+}
+
+void AsyncLog::Flush() {
+    Drain();
+    Serial.flush();
+}
+
+bool AsyncLog::SetModuleLevel(const char* module, uint8_t level) {
+    for (int i = 0; i < LOG_MODULE_COUNT; i++) {
+        if (strcmp(module, MODULE_NAMES[i]) == 0) {
+            _levels[i] = level;
+            SaveNVM();
+            return true;
+        }
+    }
+    return false;
+}
+
+// {"level": 2, "modules": {"wifi": 3, "iot": null}}, null/-1 follows "level"
+void AsyncLog::Configure(const JsonDocument& doc) {
+    int level = doc["level"] | -1;
+    if (level >= LOG_ERROR && level <= LOG_DEBUG) {
+        currentLogLevel = (LogLevel)level;
+        logPrintf(LOG_INFO, "Log level set to: %s", LEVEL_NAMES[level]);
+    }
+    JsonObjectConst modules = doc["modules"];
+    if (!modules) {
+        return;
+    }
+    for (JsonPairConst kv : modules) {
+        int moduleLevel = kv.value().is<int>() ? kv.value().as<int>() : -1;
+        uint8_t value = moduleLevel >= LOG_ERROR && moduleLevel <= LOG_DEBUG ? moduleLevel : LOG_LEVEL_INHERIT;
+        if (!SetModuleLevel(kv.key().c_str(), value)) {
+            logPrintf(LOG_WARNING, "Unknown log module: %s", kv.key().c_str());
+        }
+    }
+}
+
+JsonDocument AsyncLog::describe() {
+    JsonDocument doc;
+    doc["level"] = LEVEL_NAMES[currentLogLevel];
+    doc["async"] = _task != nullptr;
+    JsonObject modules = doc["modules"].to<JsonObject>();
+    for (int i = 0; i < LOG_MODULE_COUNT; i++) {
+        if (_levels[i] == LOG_LEVEL_INHERIT) {
+            modules[MODULE_NAMES[i]] = nullptr;
+        } else {
+            modules[MODULE_NAMES[i]] = LEVEL_NAMES[_levels[i]];
+        }
+    }
+    doc["queued"] = _ring.Pushed();
+    doc["dropped"] = _ring.Dropped();
+    doc["pending"] = _ring.Pending();
+    doc["ring_slots"] = LOG_RING_SLOTS;
+    return doc;
+}
@@ -0,0 +1,133 @@
+#include <math.h>
+#include <string.h>
+#include "cbor.h"
+
+// Status document fields first (writeStatusFields order), then keys shared by
+// the describe() documents. Index 0 is the dictionary version.
+const char* const CBOR_KEYS[] = {
+    "_dictionary",
+    "device", "timestamp", "uptime_seconds", "mode", "boot_attempts", "max_boot_attempts",
+    "lux", "ae_level", "temperature_celsius", "humidity_percent", "dht22_sensor_working",
+    "effective_temperature_celsius", "expected_temperature_celsius", "using_fallback_temperature",
+    "cat_present", "seconds_since_last_motion", "presence_timeout_seconds", "blanket_on",
+    "blanket_manual_override", "camera_available", "image_quality_metrics", "brightness",
+    "contrast", "isBright", "isDark", "noiseLevel", "overexposure", "qualityScore", "sharpness",
+    "underexposure", "wifi_connected", "wifi_ssid", "wifi_rssi", "rate_control", "framesize",
+    "quality", "throughput_bps", "dns", "hits", "misses", "avg_lookup_ms", "uploads", "attempts",
+    "retries", "failed", "retry_budget", "wifi_manual_override", "heap_free_bytes",
+    "heap_size_bytes", "heap_min_free_bytes", "psram_free_bytes", "psram_size_bytes",
+    "chip_temperature", "next_scheduled_photo_minutes", "time_since_last_photo_minutes",
+    "SSID", "RSSI", "error", "reason", "enabled", "requests", "documents", "bytes", "bytes_in",
+    "bytes_out", "ratio", "avg_us", "max_us", "count", "total", "min", "max",
+};
+const size_t CBOR_KEY_COUNT = sizeof(CBOR_KEYS) / sizeof(CBOR_KEYS[0]);
+
+unsigned cborKeyIndex(const char* key) {
+    for (size_t i = 1; i < CBOR_KEY_COUNT; i++) {
+        if (strcmp(CBOR_KEYS[i], key) == 0) {
+            return (unsigned)i;
+        }
+    }
+    return 0;
+}
+
+void CborWriter::Put(uint8_t b) {
+    if (_len >= _cap) {
+        _overflow = true;
+        return;
+    }
+    _buf[_len++] = b;
+}
+
+void CborWriter::Put(const uint8_t* data, size_t len) {
+    if (_len + len > _cap) {
+        _overflow = true;
+        return;
+    }
+    memcpy(_buf + _len, data, len);
+    _len += len;
+}
+
+// Major type and argument, shortest form
+void CborWriter::Head(uint8_t major, uint64_t value) {
+    major <<= 5;
+    if (value < 24) {
+        Put(major | (uint8_t)value);
+        return;
+    }
+    int bytes = value <= 0xff ? 1 : value <= 0xffff ? 2 : value <= 0xffffffffULL ? 4 : 8;
+    Put(major | (bytes == 1 ? 24 : bytes == 2 ? 25 : bytes == 4 ? 26 : 27));
+    for (int i = bytes - 1; i >= 0; i--) {
+        Put((uint8_t)(value >> (8 * i)));
+    }
+}
+
+void CborWriter::Map(size_t pairs) {
+    Head(5, pairs);
+}
+
+void CborWriter::Array(size_t items) {
+    Head(4, items);
+}
+
+void CborWriter::Key(const char* key) {
+    unsigned index = cborKeyIndex(key);
+    if (index) {
+        Uint(index);
+    } else {
+        Text(key);
+    }
+}
+
+void CborWriter::Uint(uint64_t value) {
+    Head(0, value);
+}
+
+void CborWriter::Int(int64_t value) {
+    if (value < 0) {
+        Head(1, (uint64_t)(-1 - value));
+    } else {
+        Head(0, (uint64_t)value);
+    }
+}
+
+void CborWriter::Float(double value) {
+    if (isnan(value) || isinf(value)) {
+        Null();
+        return;
+    }
+    // Integral values (counters that went through a double) as integers
+    if (value == floor(value) && fabs(value) < 9007199254740992.0) {
+        Int((int64_t)value);
+        return;
+    }
+    float f = (float)value;
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    Put(0xfa);
+    for (int i = 3; i >= 0; i--) {
+        Put((uint8_t)(bits >> (8 * i)));
+    }
+}
+
+void CborWriter::Text(const char* text) {
+    Text(text, strlen(text));
+}
+
+void CborWriter::Text(const char* text, size_t len) {
+    Head(3, len);
+    Put((const uint8_t*)text, len);
+}
+
+void CborWriter::Bytes(const uint8_t* data, size_t len) {
+    Head(2, len);
+    Put(data, len);
+}
+
+void CborWriter::Bool(bool value) {
+    Put(value ? 0xf5 : 0xf4);
+}
+
+void CborWriter::Null() {
+    Put(0xf6);
+}
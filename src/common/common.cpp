@@ -28,6 +28,27 @@
 #include "json_config.h"
 #include "aws_iot.h"
 #include "ambient.h"
+#include "crypto_backend.h"
+#include "crypto_benchmark.h"
+#include "rate_controller.h"
+#include "s3_post_policy.h"
+#include "timelapse_bundle.h"
+#include "upload_benchmark.h"
+#include "dns_cache.h"
+#include "upload_targets.h"
+#include "json_compression.h"
+#include "upload_retry.h"
+#include "s3_put_retry.h"
+#include "s3_connection.h"
+#include "status_document.h"
+#include "telemetry_log.h"
+#include "metrics.h"
+#include "trace.h"
+#include "async_log.h"
+#include "journal.h"
+#include "heap_profile.h"
+#include "latency_slo.h"
+#include "event_recorder.h"
 #include "common.h"
 
 const char * s3Folder = nullptr;
@@ -90,36 +111,6 @@ DHT* dht = nullptr;
 #endif
 
 
-// Typical winter temperatures for Pitesti, Romania (December-February) by hour (in Celsius)
-// Based on average winter nighttime lows (-5 to 5°C) and daytime highs (0 to 10°C)
-const float WINTER_TEMP_TABLE[24] = {
-  -2.0,  // 00:00 - coldest part of night
-  -3.0,  // 01:00
-  -3.5,  // 02:00
-  -4.0,  // 03:00 - coldest before dawn
-  -3.5,  // 04:00
-  -3.0,  // 05:00
-  -2.0,  // 06:00 - sunrise
-  -1.0,  // 07:00
-   0.0,  // 08:00
-   2.0,  // 09:00
-   4.0,  // 10:00 - warming up
-   6.0,  // 11:00
-   7.0,  // 12:00 - peak daytime
-   8.0,  // 13:00
-   7.0,  // 14:00
-   6.0,  // 15:00 - starting to cool
-   4.0,  // 16:00
-   2.0,  // 17:00 - sunset
-   1.0,  // 18:00
-   0.0,  // 19:00
-  -1.0,  // 20:00
-  -1.5,  // 21:00
-  -2.0,  // 22:00
-  -2.0   // 23:00
-};
-
-
 // Current log level (can be changed via serial commands)
 LogLevel currentLogLevel = LOG_INFO;
 
@@ -138,18 +129,21 @@ float getChipTemperature()
 }
 
 // Global state variables
-bool catPresent = false;
-bool blanketOn = false;
-bool blanketManualOverride = false;  // Track if blanket is in manual control mode
-unsigned long lastBlanketChange = 0;  // Track when blanket last changed state for debouncing
-unsigned long lastMotionDetected = 0;  // Track last PIR motion for presence timeout
-float currentTemp = 0.0;
-float currentHumidity = 0.0;
+// Decisions run on shelter (shelter_control.cpp, also built by the host replay);
+// the old names stay as references to its fields
+ShelterState shelter;
+bool& catPresent = shelter.catPresent;
+bool& blanketOn = shelter.blanketOn;
+bool& blanketManualOverride = shelter.blanketManualOverride;
+uint32_t& lastBlanketChange = shelter.lastBlanketChange;
+uint32_t& lastMotionDetected = shelter.lastMotionDetected;
+float& currentTemp = shelter.currentTemp;
+float& currentHumidity = shelter.currentHumidity;
 unsigned long lastDHTRead = 0;
-bool dhtSensorWorking = true;  // Track DHT22 state for debounced error logging
-unsigned long lastPhotoTime = 0;  // Will be initialized in setup to allow first motion photo
-unsigned long lastHourlyPhotoTime = 0;  // Will be initialized in setup
-bool lastCatPresent = false;
+bool& dhtSensorWorking = shelter.dhtSensorWorking;
+uint32_t& lastPhotoTime = shelter.lastPhotoTime;
+uint32_t& lastHourlyPhotoTime = shelter.lastHourlyPhotoTime;
+bool& lastCatPresent = shelter.lastCatPresent;
 unsigned long lastStatusReport = 0;
 
 // Boot and recovery state
@@ -160,33 +154,12 @@ int bootAttempts = 0;
 unsigned long bootStartTime = 0;
 unsigned long lastSafeModeRecoveryAttempt = 0;  // Track recovery attempts in safe mode
 
-// Logging functions
-void logPrintf(LogLevel level, const char* format, ...) {
-  if (level <= currentLogLevel) {
-    const char* prefix = "";
-    switch (level) {
-      case LOG_ERROR:   prefix = "[ERROR] "; break;
-      case LOG_WARNING: prefix = "[WARN]  "; break;
-      case LOG_INFO:    prefix = "[INFO]  "; break;
-      case LOG_DEBUG:   prefix = "[DEBUG] "; break;
-    }
-    Serial.print(prefix);
-
-    char buffer[256];
-    va_list args;
-    va_start(args, format);
-    vsnprintf(buffer, sizeof(buffer), format, args);
-    va_end(args);
-    Serial.println(buffer);
-  }
-}
-
 // ===== AWS Signature V4 Functions =====
 // Adapted from: https://github.com/Mair/esp-aws-s3-auth-header
 
 void getSHA256AsString(const char *input, size_t input_len, char *output) {
   uint8_t shaOutput[32] = {};
-  mbedtls_sha256((uint8_t *)input, input_len, shaOutput, 0);
+  CryptoBackend::Active().Sha256((const uint8_t *)input, input_len, shaOutput);
 
   char temp[65] = {};
   for (int i = 0; i < 32; i++) {
@@ -200,19 +173,23 @@ void getSignatureKey(const char *key, const char *dateStamp, const char *regionN
   sprintf(augKey, "AWS4%s", key);
 
   memset(output, 0, 32);
-  const mbedtls_md_info_t *md_info = mbedtls_md_info_from_type(MBEDTLS_MD_SHA256);
+  const CryptoBackend& crypto = CryptoBackend::Active();
 
-  mbedtls_md_hmac(md_info, (uint8_t *)augKey, strlen(augKey), (uint8_t *)dateStamp, strlen(dateStamp), output);
-  mbedtls_md_hmac(md_info, output, 32, (uint8_t *)regionName, strlen(regionName), output);
-  mbedtls_md_hmac(md_info, output, 32, (uint8_t *)serviceName, strlen(serviceName), output);
+  crypto.HmacSha256((uint8_t *)augKey, strlen(augKey), (uint8_t *)dateStamp, strlen(dateStamp), output);
+  crypto.HmacSha256(output, 32, (uint8_t *)regionName, strlen(regionName), output);
+  crypto.HmacSha256(output, 32, (uint8_t *)serviceName, strlen(serviceName), output);
   const char *aws4Request = "aws4_request";
-  mbedtls_md_hmac(md_info, output, 32, (uint8_t *)aws4Request, strlen(aws4Request), output);
+  crypto.HmacSha256(output, 32, (uint8_t *)aws4Request, strlen(aws4Request), output);
 }
 
 void generateAWSSignatureV4(const char *method, const char *host, const char *uri,
                            const char *region, const char *accessKey, const char *secretKey,
                            const uint8_t *payload, size_t payload_len,
-                           char *outAuthHeader, char *outAmzDate, char *outPayloadHash) {
+                           char *outAuthHeader, char *outAmzDate, char *outPayloadHash,
+                           const char *canonicalQueryString) {
+  MetricTimer timer(metricSigV4);
+  TRACE_SPAN("sigv4.sign");
+
   // Get current time
   time_t now = time(nullptr);
   struct tm timeinfo;
@@ -235,8 +212,7 @@ void generateAWSSignatureV4(const char *method, const char *host, const char *ur
   sprintf(canonicalHeaders, "host:%s\nx-amz-content-sha256:%s\nx-amz-date:%s\n",
           host, outPayloadHash, amzDate);
 
-  const char *canonicalQueryString = "";
-  char canonicalRequest[600];
+  char canonicalRequest[800];
   sprintf(canonicalRequest, "%s\n%s\n%s\n%s\n%s\n%s",
           method, uri, canonicalQueryString, canonicalHeaders, signedHeaders, outPayloadHash);
 
@@ -256,8 +232,7 @@ void generateAWSSignatureV4(const char *method, const char *host, const char *ur
   getSignatureKey(secretKey, dateStamp, region, "s3", signatureKey);
 
   uint8_t signature[32];
-  const mbedtls_md_info_t *md_info = mbedtls_md_info_from_type(MBEDTLS_MD_SHA256);
-  mbedtls_md_hmac(md_info, signatureKey, 32, (uint8_t *)stringToSign, strlen(stringToSign), signature);
+  CryptoBackend::Active().HmacSha256(signatureKey, 32, (uint8_t *)stringToSign, strlen(stringToSign), signature);
 
   // Convert signature to hex string
   char signatureStr[65] = {};
@@ -272,28 +247,64 @@ void generateAWSSignatureV4(const char *method, const char *host, const char *ur
           algorithm, accessKey, credentialScope, signedHeaders, signatureStr);
 }
 
-// Download file from S3 with AWS Signature V4 authentication
-// Returns true on success, false on failure (including 404)
-// On success: content contains file data, etag contains ETag header
-bool downloadFromS3(const String& filename, String& content, String& etag, String& errorMsg) {
+// Virtual-hosted style S3 endpoint for the configured bucket, or the
+// S3_ENDPOINT override (host[:port] of a local stand-in, e.g. tools/s3_standin.py)
+String s3Host() {
+#ifdef S3_ENDPOINT
+  return S3_ENDPOINT;
+#else
+  return String(S3_BUCKET) + ".s3." + AWS_REGION + ".amazonaws.com";
+#endif
+}
+
+// Full URL for an S3 path; the local stand-in is plain HTTP
+String s3Url(const String& path) {
+#ifdef S3_ENDPOINT
+  return "http://" + s3Host() + path;
+#else
+  return "https://" + s3Host() + path;
+#endif
+}
+
+// S3 requests from the loop task share these clients; host names resolve through DnsCache
+bool beginS3Request(HTTPClient& http, const String& url) {
+  static ResolvingClientSecure tlsClient;
+  static WiFiClient plainClient;
+  if (url.startsWith("https://")) {
+    tlsClient.setInsecure();
+    return http.begin(tlsClient, url);
+  }
+  return http.begin(plainClient, url);
+}
+
+// Signed GET of an S3 object. With ifNoneMatch set, S3 answers 304 (headers only)
+// when the object still has that ETag. Returns the HTTP status code or a
+// negative value on network/precondition errors (errorMsg is set).
+static int getFromS3(const String& filename, String& content, String& etag, String& errorMsg,
+                     const String& ifNoneMatch) {
   // Ensure WiFi is connected
   if (!connectWiFi()) {
     errorMsg = "WiFi not connected";
-    return false;
+    return -1;
   }
 
   // Verify time is set (required for AWS Signature V4)
   time_t now = time(nullptr);
   if (now < 100000) {
     errorMsg = "Time not synchronized";
-    return false;
+    return -1;
+  }
+
+  if (s3Folder == nullptr) {
+    errorMsg = "S3 folder not set";
+    return -1;
   }
 
   // Build S3 path with folder (if configured)
   String uri = String("/") + s3Folder + "/" + filename;
 
-  String host = String(S3_BUCKET) + ".s3." + AWS_REGION + ".amazonaws.com";
-  String url = "https://" + host + uri;
+  String host = s3Host();
+  String url = s3Url(uri);
 
   logPrintf(LOG_DEBUG, "Downloading from S3: %s", uri.c_str());
 
@@ -311,16 +322,23 @@ bool downloadFromS3(const String& filename, String& content, String& etag, Strin
 
   // Make authenticated GET request
   HTTPClient http;
-  http.begin(url);
+  beginS3Request(http, url);
 
   // Set timeouts
   http.setConnectTimeout(10000);  // 10 seconds to establish connection
   http.setTimeout(30000);         // 30 seconds for data transfer
 
+  const char* headerKeys[] = {"ETag"};
+  http.collectHeaders(headerKeys, 1);
+
   http.addHeader("Host", host);
   http.addHeader("x-amz-date", amzDate);
   http.addHeader("x-amz-content-sha256", payloadHash);
   http.addHeader("Authorization", authHeader);
+  if (ifNoneMatch.length() > 0) {
+    // If-None-Match is not a signed header, so it does not change the signature
+    http.addHeader("If-None-Match", "\"" + ifNoneMatch + "\"");
+  }
 
   logPrint(LOG_DEBUG, "Sending GET request with AWS Signature V4...");
 
@@ -339,13 +357,17 @@ bool downloadFromS3(const String& filename, String& content, String& etag, Strin
     http.end();
     logPrintf(LOG_INFO, "Downloaded from S3: %s (%d bytes, ETag: %s)",
               filename.c_str(), content.length(), etag.c_str());
-    return true;
+  } else if (httpResponseCode == 304) {
+    // Unchanged since the cached ETag - only headers were transferred
+    http.end();
+    etag = ifNoneMatch;
+    errorMsg = "Not modified (304)";
+    logPrintf(LOG_DEBUG, "S3 file not modified: %s (ETag: %s)", filename.c_str(), etag.c_str());
   } else if (httpResponseCode == 404) {
     // File not found - not an error, just doesn't exist
     http.end();
     errorMsg = "File not found (404)";
     logPrintf(LOG_DEBUG, "S3 file not found: %s", filename.c_str());
-    return false;
   } else if (httpResponseCode > 0) {
     // Got HTTP response but it's an error
     String responseBody = http.getString();
@@ -359,7 +381,6 @@ bool downloadFromS3(const String& filename, String& content, String& etag, Strin
     }
 
     logPrintf(LOG_ERROR, "S3 download failed: HTTP %d for %s", httpResponseCode, filename.c_str());
-    return false;
   } else {
     // Network/connection error
     errorMsg = "Network error: ";
@@ -367,8 +388,77 @@ bool downloadFromS3(const String& filename, String& content, String& etag, Strin
     http.end();
 
     logPrintf(LOG_ERROR, "S3 download network error: %s", http.errorToString(httpResponseCode).c_str());
-    return false;
   }
+  return httpResponseCode;
+}
+
+// Download file from S3 with AWS Signature V4 authentication
+// Returns true on success, false on failure (including 404)
+// On success: content contains file data, etag contains ETag header
+bool downloadFromS3(const String& filename, String& content, String& etag, String& errorMsg) {
+  return getFromS3(filename, content, etag, errorMsg, "") == 200;
+}
+
+#define NVM_S3_CACHE_SECTION "s3-cache"
+
+int S3CachedFetch::Get(const char* key, const char* ifNoneMatch,
+                       char* body, size_t bodyCap, char* etag, size_t etagCap) {
+  String content, tag;
+  _errorMsg = "";
+  int httpResponseCode = getFromS3(key, content, tag, _errorMsg, ifNoneMatch);
+  if (httpResponseCode == 200) {
+    if (content.length() >= bodyCap || tag.length() >= etagCap) {
+      _errorMsg = "Object too large to cache";
+      return -1;
+    }
+    memcpy(body, content.c_str(), content.length() + 1);
+    memcpy(etag, tag.c_str(), tag.length() + 1);
+  }
+  return httpResponseCode;
+}
+
+bool S3CachedFetch::Load(const char* cacheKey, char* etag, size_t etagCap, char* body, size_t bodyCap) {
+  String etagKey = String(cacheKey) + ".etag";
+  String bodyKey = String(cacheKey) + ".body";
+
+  Preferences prefs;
+  prefs.begin(NVM_S3_CACHE_SECTION, true);
+  bool found = prefs.isKey(bodyKey.c_str()) && prefs.getString(etagKey.c_str(), etag, etagCap) > 0;
+  if (found && body) {
+    found = prefs.getString(bodyKey.c_str(), body, bodyCap) > 0;
+  }
+  prefs.end();
+  return found;
+}
+
+void S3CachedFetch::Save(const char* cacheKey, const char* etag, const char* body) {
+  String etagKey = String(cacheKey) + ".etag";
+  String bodyKey = String(cacheKey) + ".body";
+
+  Preferences prefs;
+  prefs.begin(NVM_S3_CACHE_SECTION, false);
+  prefs.putString(etagKey.c_str(), etag);
+  prefs.putString(bodyKey.c_str(), body);
+  prefs.end();
+}
+
+// content is the current object for S3_FETCH_MODIFIED and S3_FETCH_NOT_MODIFIED,
+// and the last cached copy (if any) on errors. cacheKey: max 10 chars.
+S3FetchResult S3CachedFetch::Fetch(const String& filename, const char* cacheKey, String& content, String& errorMsg) {
+  char* body = (char*)malloc(S3_FETCH_BODY_MAX);
+  if (!body) {
+    errorMsg = "Out of memory";
+    return S3_FETCH_ERROR;
+  }
+  S3FetchResult result = _cache.Fetch(filename.c_str(), cacheKey, body, S3_FETCH_BODY_MAX);
+  content = body;
+  errorMsg = _errorMsg;
+  free(body);
+  return result;
+}
+
+bool S3CachedFetch::Commit(const String& content) {
+  return _cache.Commit(content.c_str());
 }
 
 // Upload JSON string to S3
@@ -388,8 +478,8 @@ bool uploadJSONToS3(const String& jsonContent, const String& filename) {
   // Build S3 path with folder (if configured)
   String uri = String("/") + s3Folder + "/" + filename;
 
-  String host = String(S3_BUCKET) + ".s3." + AWS_REGION + ".amazonaws.com";
-  String url = "https://" + host + uri;
+  String host = s3Host();
+  String url = s3Url(uri);
 
   logPrintf(LOG_DEBUG, "Uploading JSON to S3: %s", filename.c_str());
 
@@ -405,7 +495,7 @@ bool uploadJSONToS3(const String& jsonContent, const String& filename) {
 
   // Make authenticated request
   HTTPClient http;
-  http.begin(url);
+  beginS3Request(http, url);
 
   http.setConnectTimeout(10000);
   http.setTimeout(30000);
@@ -470,6 +560,12 @@ void markBootSuccess() {
 }
 
 void rebootSystem(const char* reason) {
+  // The pending time-lapse bundle is in PSRAM and would be lost
+  if (IsWiFiConnected()) {
+    TimelapseBundle::bundle.Flush();
+  }
+  AsyncLog::logger.Flush();
+  Journal::journal.RecordReboot(reason);
   Serial.printf("\n!!! REBOOTING: %s !!!\n", reason);
   Serial.flush();
   delay(1000);
@@ -524,6 +620,7 @@ bool initCamera() {
     return false;
   }
 
+  RateController::rate.Begin();
   return true;
 }
 
@@ -537,11 +634,22 @@ void flashOff() {
 
 static int aeCorrection = 0;
 
+// Status JSON for S3 uploads and time-lapse metadata, built in place (loop task only)
+static char statusJson[STATUS_JSON_MAX];
+// Metrics of the last photo, for the MQTT status document
+static ImageQualityMetrics lastImageMetrics = {};
+
 camera_fb_t* capturePhoto() {
+  MetricTimer timer(metricCapture);
+  TRACE_SPAN("camera.capture");
+  LatencySlo::slo.Stamp(SLO_CAPTURE_START);
   camera_fb_t* fb = nullptr;
 
   sensor_t *s = esp_camera_sensor_get();
 
+  // Pick quality/framesize for the current link before flushing stale frames
+  RateController::rate.Select();
+
   switch(Ambient::ltr.getCondition()) {
     case Ambient::Bright:
       aeCorrection = -2;
@@ -587,6 +695,7 @@ camera_fb_t* capturePhoto() {
 
   if (!fb) {
     logPrint(LOG_ERROR, "Camera capture failed");
+    metricCaptureFailures.Inc();
     JsonDocument doc;
     doc["device"] = deviceName;
     doc["timestamp"] = getTimestamp();
@@ -595,6 +704,7 @@ camera_fb_t* capturePhoto() {
     return nullptr;
   }
 
+  LatencySlo::slo.Stamp(SLO_CAPTURE_END);
   logPrintf(LOG_INFO, "Photo captured: %d bytes [ae:%i ret:%i gret: %i]", fb->len, aeCorrection, aeRet, gRet);
   return fb;
 }
@@ -620,109 +730,233 @@ bool uploadPhotoToS3(camera_fb_t* fb, const String& filename, const String& fold
     logPrint(LOG_ERROR, "Invalid photo buffer");
     return false;
   }
-
-  // Ensure WiFi is connected
-  if (!connectWiFi()) {
-    return false;
+  MetricTimer timer(metricPhotoUpload);
+  TRACE_SPAN("s3.upload_photo");
+  bool ok = uploadBufferToS3(fb->buf, fb->len, filename, folderName, "image/jpeg");
+  if (!ok) {
+    metricPhotoUploadFailures.Inc();
   }
+  return ok;
+}
 
-  // Verify time is set (required for AWS Signature V4)
-  time_t now = time(nullptr);
-  if (now < 100000) {
-    logPrint(LOG_WARNING, "Time not synchronized! Attempting NTP sync...");
+// One signed PUT: what is sent and what came back
+struct S3PutRequest {
+  const char* uri;
+  const uint8_t* buf;
+  size_t len;
+  const char* contentType;
+  const char* contentEncoding;   // e.g. "gzip", stored with the object and applied by S3 clients
+  uint16_t connectTimeout;
+  uint16_t timeout;
+};
 
-    // Try to sync time on-demand (WiFi already connected)
-    if (!syncTimeWithNTP(3)) {
-      logPrint(LOG_ERROR, "Cannot generate AWS signature without time sync");
-      return false;
-    }
+struct S3PutResult {
+  int httpCode;                  // negative HTTPC_ERROR_* on network failure
+  const char* responseBody;      // start of the body, or the network error; valid until the next request
+  const char* etag;
+  unsigned long putMs;           // transfer time
+};
+
+// Signed PUT of one object to one upload target, with Content-MD5. The body is
+// written straight from buf on the kept-alive S3Connection, no Strings involved.
+static void signedPutToS3(const UploadEndpoint& target, const S3PutRequest& request,
+                          const PayloadMd5& md5, S3PutResult& result) {
+  // Generate AWS Signature V4 authentication headers
+  char authHeader[400];
+  char amzDate[18];
+  char payloadHash[65];
+
+  unsigned long signStart = micros();
+  generateAWSSignatureV4("PUT", target.host, request.uri,
+                         target.region, AWS_ACCESS_KEY_ID, AWS_SECRET_ACCESS_KEY,
+                         request.buf, request.len,
+                         authHeader, amzDate, payloadHash);
+  S3PostPolicy::policy.RecordSigV4(micros() - signStart);
+
+  S3Connection& connection = S3Connection::shared;
+  connection.Begin(target, "PUT", request.uri);
+  connection.Header("x-amz-date", amzDate);
+  connection.Header("x-amz-content-sha256", payloadHash);
+  connection.Header("Authorization", authHeader);
+  connection.Header("Content-Type", request.contentType);
+  if (request.contentEncoding) {
+    connection.Header("Content-Encoding", request.contentEncoding);
   }
+  // Not a signed header: S3 checks it against the body and answers 400 BadDigest
+  connection.Header("Content-MD5", md5.base64);
+  connection.Header("Content-Length", (unsigned long)request.len);
 
-  // Build S3 path with folder (if configured)
-  String uri = "/";
-  String logPath = "";
-  uri += folderName + "/";
-  logPath = folderName + "/";
-  uri += filename;
-  logPath += filename;
+  logPrintf(LOG_DEBUG, "Sending PUT request with AWS Signature V4 to %s...", target.host);
 
-  String host = String(S3_BUCKET) + ".s3." + AWS_REGION + ".amazonaws.com";
-  String url = "https://" + host + uri;
+  unsigned long putStart = millis();
+  result.httpCode = connection.Send(target, request.buf, request.len, request.connectTimeout, request.timeout);
+  result.putMs = millis() - putStart;
 
-  logPrintf(LOG_INFO, "Uploading photo to S3: %s", logPath.c_str());
+  result.etag = connection.ETag();
+  result.responseBody = result.httpCode > 0 ? connection.ResponseBody() : S3Connection::ErrorToString(result.httpCode);
+}
 
-  // Generate AWS Signature V4 authentication headers
+// Signed HEAD: after a lost PUT response, did the object land with our content?
+static void signedHeadToS3(const UploadEndpoint& target, const char* uri, uint16_t connectTimeout,
+                           uint16_t timeout, S3PutReply& reply) {
   char authHeader[400];
   char amzDate[18];
   char payloadHash[65];
 
-  generateAWSSignatureV4("PUT", host.c_str(), uri.c_str(),
-                         AWS_REGION, AWS_ACCESS_KEY_ID, AWS_SECRET_ACCESS_KEY,
-                         fb->buf, fb->len,
+  const uint8_t emptyPayload[] = "";
+  generateAWSSignatureV4("HEAD", target.host, uri,
+                         target.region, AWS_ACCESS_KEY_ID, AWS_SECRET_ACCESS_KEY,
+                         emptyPayload, 0,
                          authHeader, amzDate, payloadHash);
 
-  // Make authenticated request
-  HTTPClient http;
-  http.begin(url);
+  S3Connection& connection = S3Connection::shared;
+  connection.Begin(target, "HEAD", uri);
+  connection.Header("x-amz-date", amzDate);
+  connection.Header("x-amz-content-sha256", payloadHash);
+  connection.Header("Authorization", authHeader);
 
-  // Set timeouts for large file uploads
-  // For 78KB photos: ~10 seconds should be sufficient even on slow connections
-  // Default timeout is only 5 seconds which can fail for large payloads
-  http.setConnectTimeout(15000);  // 15 seconds to establish connection
-  http.setTimeout(60000);        // 60 seconds for data transfer (SO_SNDTIMEO)
+  reply.status = connection.Send(target, nullptr, 0, connectTimeout, timeout);
+  reply.etag = connection.ETag();
+  reply.body = reply.status > 0 ? "" : S3Connection::ErrorToString(reply.status);
+}
 
-  http.addHeader("Host", host);
-  http.addHeader("x-amz-date", amzDate);
-  http.addHeader("x-amz-content-sha256", payloadHash);
-  http.addHeader("Authorization", authHeader);
-  http.addHeader("Content-Type", "image/jpeg");
-  http.addHeader("Content-Length", String(fb->len));
+// S3PutRetry transport: signed requests to the upload targets, accounted in
+// UploadRetry, UploadTargets and the rate controller
+class SignedPutTransport : public S3PutTransport {
+  const S3PutRequest& _request;
+  const PayloadMd5& _md5;
+  const char* _what;
+  bool _rateSample;
+  int _frameLevel;
+  UploadEndpoint _targets[UPLOAD_TARGETS_MAX];
+  S3PutResult _result;
+  unsigned long _requestStart = 0;
+
+public:
+  SignedPutTransport(const S3PutRequest& request, const PayloadMd5& md5, const char* what, bool rateSample, int frameLevel)
+      : _request(request), _md5(md5), _what(what), _rateSample(rateSample), _frameLevel(frameLevel) {}
+
+  const char* Host(int target) const { return target >= 0 ? _targets[target].host : ""; }
+
+  uint32_t Millis() override { return millis(); }
+
+  void Delay(uint32_t ms) override {
+    logPrintf(LOG_INFO, "%s: retrying in %lu ms", _what, (unsigned long)ms);
+    delay(ms);
+  }
 
-  logPrint(LOG_DEBUG, "Sending PUT request with AWS Signature V4...");
+  bool Select(uint32_t excludeMask, int& target) override {
+    UploadEndpoint endpoint;
+    if (!UploadTargets::targets.Select(excludeMask, endpoint)) {
+      return false;
+    }
+    _targets[endpoint.index] = endpoint;
+    target = endpoint.index;
+    return true;
+  }
 
-  int httpResponseCode = http.PUT(fb->buf, fb->len);
+  bool Online() override { return IsWiFiConnected(); }
 
-  // Get response body before closing connection
-  String responseBody = "";
-  if (httpResponseCode > 0) {
-    responseBody = http.getString();
+  bool TakeRetry() override {
+    if (!UploadRetry::retry.TakeRetry()) {
+      logPrintf(LOG_WARNING, "%s: retry budget exhausted", _what);
+      return false;
+    }
+    return true;
   }
 
-  http.end();
+  void Put(int target, uint32_t connectTimeout, uint32_t timeout, S3PutReply& reply) override {
+    S3PutRequest bounded = _request;
+    bounded.connectTimeout = (uint16_t)connectTimeout;
+    bounded.timeout = (uint16_t)timeout;
+    _requestStart = millis();
+    signedPutToS3(_targets[target], bounded, _md5, _result);
+    reply.status = _result.httpCode;
+    reply.body = _result.responseBody;
+    reply.etag = _result.etag;
+  }
 
-  // HTTP 2xx codes are success, everything else is failure
-  if (httpResponseCode >= 200 && httpResponseCode < 300) {
-    logPrintf(LOG_INFO, "Upload successful! HTTP %d", httpResponseCode);
-    return true;
-  } else if (httpResponseCode > 0) {
-    // Got HTTP response but it's an error
-    logPrintf(LOG_ERROR, "Upload failed! HTTP %d", httpResponseCode);
+  void Head(int target, uint32_t connectTimeout, uint32_t timeout, S3PutReply& reply) override {
+    signedHeadToS3(_targets[target], _request.uri, (uint16_t)connectTimeout, (uint16_t)timeout, reply);
+    if (reply.status != 200 && reply.status != 404) {
+      logPrintf(LOG_WARNING, "%s: HEAD after a lost response answered %d (%s)", _what, reply.status, Host(target));
+    }
+  }
 
-    // Log response body for debugging (truncate if too long)
-    if (responseBody.length() > 0) {
-      if (responseBody.length() > 200) {
-        responseBody = responseBody.substring(0, 200) + "...";
-      }
-      logPrintf(LOG_ERROR, "Response: %s", responseBody.c_str());
+  void Recorded(int target, const S3PutReply& reply, S3EtagCheck etag, bool ok) override {
+    UploadRetry::retry.RecordAttempt(reply.status, reply.body);
+    UploadRetry::retry.RecordEtag(etag, reply.etag, _md5.hex);
+    UploadTargets::targets.Record(target, millis() - _requestStart, _request.len, ok);
+    if (_rateSample) {
+      RateController::rate.RecordUpload(_request.len, _result.putMs, ok, _frameLevel);
     }
 
-    // Provide helpful hints based on status code
-    if (httpResponseCode == 403) {
-      logPrint(LOG_ERROR, "HTTP 403 Forbidden - Check S3 bucket permissions or credentials");
-    } else if (httpResponseCode == 404) {
-      logPrint(LOG_ERROR, "HTTP 404 Not Found - Check S3 bucket name and region");
-    } else if (httpResponseCode >= 500) {
-      logPrint(LOG_ERROR, "HTTP 5xx Server Error - S3 service issue");
+    if (ok) {
+      logPrintf(LOG_INFO, "%s successful! HTTP %d (%s)", _what, reply.status, Host(target));
+    } else if (reply.status >= 200 && reply.status < 300) {
+      // ETag mismatch, logged by UploadRetry
+    } else if (reply.status > 0) {
+      // Got HTTP response but it's an error
+      logPrintf(LOG_ERROR, "%s failed! HTTP %d (%s)", _what, reply.status, Host(target));
+
+      // Log response body for debugging (truncated)
+      if (reply.body[0]) {
+        logPrintf(LOG_ERROR, "Response: %.200s", reply.body);
+      }
+
+      // Provide helpful hints based on status code
+      if (reply.status == 403) {
+        logPrint(LOG_ERROR, "HTTP 403 Forbidden - Check S3 bucket permissions or credentials");
+      } else if (reply.status == 404) {
+        logPrint(LOG_ERROR, "HTTP 404 Not Found - Check S3 bucket name and region");
+      } else if (reply.status >= 500) {
+        logPrint(LOG_ERROR, "HTTP 5xx Server Error - S3 service issue");
+      }
+    } else {
+      // Network/connection error
+      logPrintf(LOG_ERROR, "%s failed! Network error: %s (%s)", _what, reply.body, Host(target));
     }
-    return false;
-  } else {
-    // Network/connection error
-    logPrintf(LOG_ERROR, "Upload failed! Network error: %s", http.errorToString(httpResponseCode).c_str());
-    return false;
+  }
+};
+
+// PUT with failover across targets and retries of transient failures, decided
+// by S3PutRetry (s3_put_retry.cpp). Returns true once an attempt is confirmed.
+// rateSample feeds the rate controller; frameLevel is the operating point a
+// frame was captured at (its frame size estimate), negative for other uploads.
+// All attempts, backoff and HEAD checks share the time one attempt may take
+// (connect + transfer timeouts): this runs on the loop task, and retrying
+// must not block it longer than a single upload could.
+static bool putToS3WithRetry(const S3PutRequest& request, const char* what, bool rateSample, int frameLevel) {
+  HEAP_PROBE(heapSiteHttpUpload);
+  PayloadMd5 md5;
+  md5.Compute(request.buf, request.len);
+
+  SignedPutTransport transport(request, md5, what, rateSample, frameLevel);
+  S3PutRetry retry(transport);
+  UploadOutcome outcome = retry.Put(md5.hex, request.connectTimeout, request.timeout, UploadRetry::retry.VerifyEtag());
+  UploadRetry::retry.RecordOutcome(outcome);
+
+  switch (outcome) {
+    case UPLOAD_OUTCOME_FIRST_TRY:
+    case UPLOAD_OUTCOME_AFTER_RETRY:
+      return true;
+    case UPLOAD_OUTCOME_ALREADY_STORED:
+      logPrintf(LOG_INFO, "%s: already stored by the previous attempt (%s)", what, transport.Host(retry.Target()));
+      return true;
+    case UPLOAD_OUTCOME_DEADLINE:
+      logPrintf(LOG_WARNING, "%s: no time left after attempt %d", what, retry.Attempts());
+      return false;
+    default:
+      return false;
   }
 }
 
-bool uploadStatusToS3(const String& filename, const ImageQualityMetrics& stats) {
+bool uploadBufferToS3(const uint8_t* buf, size_t len, const String& filename, const String& folderName, const char* contentType) {
+  // Only single frames feed the rate controller's frame size estimate, they
+  // were captured at the current level just before
+  bool isFrame = strcmp(contentType, "image/jpeg") == 0;
+  int frameLevel = isFrame ? RateController::rate.Level() : -1;
+
   // Ensure WiFi is connected
   if (!connectWiFi()) {
     return false;
@@ -740,69 +974,90 @@ bool uploadStatusToS3(const String& filename, const ImageQualityMetrics& stats)
     }
   }
 
-  // Generate status JSON
-  String statusJSON = generateStatusJSON(stats);
-  uint8_t* payload = (uint8_t*)statusJSON.c_str();
-  size_t payload_len = statusJSON.length();
-
-  // Build S3 path with folder (if configured, same as photo)
-  String uri = String("/") + s3Folder + "/" + filename;
-  String logPath = String(s3Folder) + "/" + filename;
-  
-  String host = String(S3_BUCKET) + ".s3." + AWS_REGION + ".amazonaws.com";
-  String url = "https://" + host + uri;
+  // Build S3 path with folder (if configured); the key is uri without the leading slash
+  char uri[160];
+  snprintf(uri, sizeof(uri), "/%s/%s", folderName.c_str(), filename.c_str());
 
-  logPrintf(LOG_DEBUG, "Uploading status JSON to S3: %s", logPath.c_str());
+  logPrintf(LOG_INFO, "Uploading %s to S3: %s", isFrame ? "photo" : contentType, uri + 1);
 
-  // Generate AWS Signature V4 authentication headers
-  char authHeader[400];
-  char amzDate[18];
-  char payloadHash[65];
+  // Cached POST policy: no signing on the device, fall back to SigV4 on failure
+  if (S3PostPolicy::policy.Valid()) {
+    unsigned long putStart = millis();
+    bool ok = S3PostPolicy::policy.Upload(buf, len, uri + 1, contentType);
+    RateController::rate.RecordUpload(len, millis() - putStart, ok, frameLevel);
+    if (ok) {
+      return true;
+    }
+  }
 
-  generateAWSSignatureV4("PUT", host.c_str(), uri.c_str(),
-                         AWS_REGION, AWS_ACCESS_KEY_ID, AWS_SECRET_ACCESS_KEY,
-                         payload, payload_len,
-                         authHeader, amzDate, payloadHash);
+  // Set timeouts for large file uploads
+  // For 78KB photos: ~10 seconds should be sufficient even on slow connections
+  // Default timeout is only 5 seconds which can fail for large payloads
+  S3PutRequest request = {uri, buf, len, contentType, nullptr, 15000, 60000};
+  return putToS3WithRetry(request, "Upload", true, frameLevel);
+}
 
-  // Make authenticated request
-  HTTPClient http;
-  http.begin(url);
+bool uploadStatusToS3(const String& filename, const ImageQualityMetrics& stats) {
+  HEAP_PROBE(heapSiteStatusJson);
+  // Ensure WiFi is connected
+  if (!connectWiFi()) {
+    return false;
+  }
 
-  // Set timeouts (same as photo upload for consistency)
-  http.setConnectTimeout(5000);  // 5 seconds to establish connection
-  http.setTimeout(15000);        // 15 seconds for data transfer
+  // Verify time is set (required for AWS Signature V4)
+  time_t now = time(nullptr);
+  if (now < 100000) {
+    logPrint(LOG_WARNING, "Time not synchronized! Attempting NTP sync...");
 
-  http.addHeader("Host", host);
-  http.addHeader("x-amz-date", amzDate);
-  http.addHeader("x-amz-content-sha256", payloadHash);
-  http.addHeader("Authorization", authHeader);
-  http.addHeader("Content-Type", "application/json");
-  http.addHeader("Content-Length", String(payload_len));
+    // Try to sync time on-demand (WiFi already connected)
+    if (!syncTimeWithNTP(3)) {
+      logPrint(LOG_ERROR, "Cannot generate AWS signature without time sync");
+      return false;
+    }
+  }
 
-  int httpResponseCode = http.PUT(payload, payload_len);
+  // Generate status JSON, compact and gzipped unless disabled
+  bool gzip = JsonCompression::compression.StatusGzip();
+  size_t jsonLen = writeStatusJSON(statusJson, sizeof(statusJson), stats, gzip);
+  if (jsonLen == 0) {
+    return false;
+  }
+  size_t gzipLen = 0;
+  uint8_t* gzipped = gzip ? JsonCompression::compression.Gzip(statusJson, jsonLen, gzipLen) : nullptr;
+  const uint8_t* payload = gzipped ? gzipped : (const uint8_t*)statusJson;
+  size_t payload_len = gzipped ? gzipLen : jsonLen;
 
-  // Get response body before closing connection
-  String responseBody = "";
-  if (httpResponseCode > 0) {
-    responseBody = http.getString();
+  if (UploadScheduler::scheduler.Admit(UPLOAD_TELEMETRY, payload_len, 0) == UPLOAD_SKIP) {
+    free(gzipped);
+    return false;
   }
 
-  http.end();
+  // Build S3 path with folder (if configured, same as photo)
+  char uri[160];
+  snprintf(uri, sizeof(uri), "/%s/%s", s3Folder, filename.c_str());
+
+  logPrintf(LOG_DEBUG, "Uploading status JSON to S3: %s", uri + 1);
+
+  // Cached POST policy first, as for photos
+  bool ok = false;
+  if (S3PostPolicy::policy.Valid()) {
+    unsigned long putStart = millis();
+    ok = S3PostPolicy::policy.Upload(payload, payload_len, uri + 1, "application/json",
+                                     gzipped ? "gzip" : nullptr);
+    RateController::rate.RecordUpload(payload_len, millis() - putStart, ok, -1);
+  }
 
-  // HTTP 2xx codes are success
-  if (httpResponseCode >= 200 && httpResponseCode < 300) {
-    logPrintf(LOG_DEBUG, "Status JSON uploaded successfully! HTTP %d", httpResponseCode);
-    return true;
-  } else if (httpResponseCode > 0) {
-    logPrintf(LOG_WARNING, "Status JSON upload failed! HTTP %d", httpResponseCode);
-    if (responseBody.length() > 0 && responseBody.length() <= 100) {
-      logPrintf(LOG_DEBUG, "Response: %s", responseBody.c_str());
-    }
-    return false;
-  } else {
-    logPrintf(LOG_WARNING, "Status JSON upload failed! Network error: %s", http.errorToString(httpResponseCode).c_str());
-    return false;
+  // Set timeouts (5 s to connect, 15 s for data transfer)
+  if (!ok) {
+    S3PutRequest request = {uri, payload, payload_len, "application/json",
+                            gzipped ? "gzip" : nullptr, 5000, 15000};
+    ok = putToS3WithRetry(request, "Status JSON upload", false, -1);
+  }
+  if (ok) {
+    UploadScheduler::scheduler.Consume(UPLOAD_TELEMETRY, payload_len);
   }
+  free(gzipped);
+  return ok;
 }
 
 void setupGPIO() {
@@ -815,6 +1070,7 @@ void setupGPIO() {
   // Configure PIR sensor pin as input
   if (PIR_PIN) {
     pinMode(PIR_PIN, INPUT);
+    LatencySlo::AttachPir(PIR_PIN);
   }
 
   // Configure flash LED pin as output
@@ -836,39 +1092,36 @@ void setupGPIO() {
 
 bool readPIRSensor() {
     int pirState = digitalRead(PIR_PIN);
+    EventRecorder::recorder.Pir(pirState == HIGH);
     return pirState == HIGH;
 }
 
 void checkPIRSensor() {
-  unsigned long currentMillis = millis();
-
   // Read PIR sensor state
   bool motionDetected = readPIRSensor();
+  TelemetryLog::telemetry.RecordState(TELEMETRY_MOTION, motionDetected);
 
-  // PIR HC-SR501 is a MOTION detector, not a PRESENCE sensor
-  // Motion detection extends the presence timer (cat might be sleeping)
-  if (motionDetected) {
-    // Motion detected - update timestamp and mark cat as present
-    if (!catPresent) {
+  switch (shelter.Motion(motionDetected, millis())) {
+    case PRESENCE_ARRIVED:
       logPrint(LOG_INFO, "*** CAT MOTION DETECTED! ***");
-      catPresent = true;
-    } else {
+      EventRecorder::recorder.Decision(EVENT_CAT_ARRIVED);
+      break;
+    case PRESENCE_EXTENDED:
       logPrint(LOG_DEBUG, "Cat motion (presence extended)");
-    }
-    lastMotionDetected = currentMillis;
-  } else {
-    // No current motion - check if presence timeout expired
-    if (catPresent && (currentMillis - lastMotionDetected) >= CAT_PRESENCE_TIMEOUT) {
+      break;
+    case PRESENCE_TIMEOUT:
       logPrint(LOG_INFO, "Cat presence timeout - no motion for 60 minutes");
-      catPresent = false;
-    }
+      EventRecorder::recorder.Decision(EVENT_CAT_LEFT);
+      break;
+    case PRESENCE_NONE:
+      break;
   }
 }
 
 void controlBlanket(bool shouldBeOn) {
-  if (shouldBeOn != blanketOn) {
-    blanketOn = shouldBeOn;
-    lastBlanketChange = millis();  // Record state change time
+  if (shelter.SetBlanket(shouldBeOn, millis())) {
+    TelemetryLog::telemetry.RecordState(TELEMETRY_BLANKET, blanketOn);
+    EventRecorder::recorder.Decision(blanketOn ? EVENT_BLANKET_ON : EVENT_BLANKET_OFF);
     digitalWrite(RELAY_PIN, blanketOn ? HIGH : LOW);
 
     if (blanketOn) {
@@ -894,11 +1147,11 @@ void readDHT22() {
     // Read temperature and humidity
     float temp = dht->readTemperature();
     float humidity = dht->readHumidity();
+    EventRecorder::recorder.Dht(temp, humidity);
 
-    // Check if readings are valid
-    if (isnan(temp) || isnan(humidity)) {
-      // Only log error if sensor state changed from working to failed
-      if (dhtSensorWorking) {
+    switch (shelter.Reading(temp, humidity)) {
+      case DHT_FAILED:
+        // Only log error if sensor state changed from working to failed
         logPrint(LOG_ERROR, "DHT22 sensor failure detected!");
 
         // Provide detailed error information
@@ -912,65 +1165,50 @@ void readDHT22() {
         }
 
         logPrint(LOG_WARNING, "Check GPIO14 connection and DHT22 sensor");
-        dhtSensorWorking = false;
-      }
-      return;
-    }
-
-    // Sensor is working - check if it just recovered
-    if (!dhtSensorWorking) {
-      logPrint(LOG_INFO, "DHT22 sensor recovered and working normally");
-      dhtSensorWorking = true;
+        return;
+      case DHT_STILL_FAILED:
+        return;
+      case DHT_RECOVERED:
+        logPrint(LOG_INFO, "DHT22 sensor recovered and working normally");
+        break;
+      case DHT_READING:
+        break;
     }
 
-    // Update global state
-    currentTemp = temp;
-    currentHumidity = humidity;
+    TelemetryLog::telemetry.Record(TELEMETRY_TEMPERATURE, temp);
+    TelemetryLog::telemetry.Record(TELEMETRY_HUMIDITY, humidity);
 
     // Log readings at DEBUG level (happens every 2 seconds, too verbose for INFO)
     logPrintf(LOG_DEBUG, "Temperature: %.1f°C | Humidity: %.1f%%", currentTemp, currentHumidity);
   }
 }
 
-float getExpectedTemperature() {
-  // Get current hour from RTC
+int getLocalHour() {
   time_t now = time(nullptr);
   if (now < 100000) {
-    // Time not synced, assume coldest hour (3 AM)
-    return WINTER_TEMP_TABLE[3];
+    return -1;
   }
 
   struct tm timeinfo;
   localtime_r(&now, &timeinfo);
-  int hour = timeinfo.tm_hour;
-
-  // Bounds check
-  if (hour < 0 || hour >= 24) {
-    hour = 0;
-  }
+  return timeinfo.tm_hour;
+}
 
-  return WINTER_TEMP_TABLE[hour];
+float getExpectedTemperature() {
+  return ShelterState::ExpectedTemperature(getLocalHour());
 }
 
 float getEffectiveTemperature() {
-  // If sensor is not working, use expected temperature
-  if (!dhtSensorWorking) {
-    float expectedTemp = getExpectedTemperature();
-    logPrintf(LOG_DEBUG, "DHT22 failed - using expected temperature: %.1f°C", expectedTemp);
-    return expectedTemp;
-  }
-
-  // If sensor reading is unreasonable (aberrant), use expected temperature
-  if (currentTemp > TEMP_MAX_REASONABLE || currentTemp < TEMP_MIN_REASONABLE) {
-    float expectedTemp = getExpectedTemperature();
+  TempSource source;
+  float effectiveTemp = shelter.EffectiveTemperature(getLocalHour(), &source);
+  if (source == TEMP_SOURCE_FAILED) {
+    logPrintf(LOG_DEBUG, "DHT22 failed - using expected temperature: %.1f°C", effectiveTemp);
+  } else if (source == TEMP_SOURCE_ABERRANT) {
     logPrintf(LOG_WARNING, "DHT22 reading aberrant (%.1f°C) - using expected: %.1f°C",
-              currentTemp, expectedTemp);
+              currentTemp, effectiveTemp);
     logPrint(LOG_WARNING, "Possible cause: direct sunlight on sensor or sensor malfunction");
-    return expectedTemp;
   }
-
-  // Sensor is working and value is reasonable
-  return currentTemp;
+  return effectiveTemp;
 }
 
 void updateBlanketControl() {
@@ -979,26 +1217,19 @@ void updateBlanketControl() {
     return;
   }
 
-  // Blanket should be on if:
-  // 1. Cat is present
-  // 2. Temperature is below threshold
   // Use effective temperature (with fallback if sensor fails)
   float effectiveTemp = getEffectiveTemperature();
-  bool shouldBeOn = catPresent && (effectiveTemp < TEMP_COLD_THRESHOLD);
-
-  // Apply debouncing: only change state if minimum time has elapsed
-  unsigned long timeSinceLastChange = millis() - lastBlanketChange;
-
-  // If the desired state is different from current state
-  if (shouldBeOn != blanketOn) {
-    // Only change if enough time has passed since last change
-    if (timeSinceLastChange >= BLANKET_MIN_STATE_TIME) {
-      controlBlanket(shouldBeOn);
-    } else {
+  uint32_t remainingMs = 0;
+  switch (shelter.Blanket(effectiveTemp, millis(), &remainingMs)) {
+    case BLANKET_SWITCH:
+      controlBlanket(!blanketOn);
+      break;
+    case BLANKET_DELAYED:
       // Log at DEBUG level to avoid spam
-      unsigned long remainingTime = (BLANKET_MIN_STATE_TIME - timeSinceLastChange) / 1000;
-      logPrintf(LOG_DEBUG, "Blanket state change delayed (%lu seconds remaining)", remainingTime);
-    }
+      logPrintf(LOG_DEBUG, "Blanket state change delayed (%lu seconds remaining)", (unsigned long)remainingMs / 1000);
+      break;
+    case BLANKET_KEEP:
+      break;
   }
 }
 
@@ -1029,13 +1260,34 @@ bool uploadFbTimeS3(camera_fb_t* fb, struct tm& timeinfo)
   return photoSuccess;
 }
 
-bool takeAndUploadPhoto(const char* reason) {
+// MQTT notification of a committed photo, with the latency of each stage
+static bool publishPhotoEvent(const char* reason, const String& filename) {
+  JsonDocument doc;
+  doc["device"] = deviceName;
+  doc["object"] = String(s3Folder) + "/" + filename;
+  doc["reason"] = reason;
+  LatencySlo::slo.Latencies(doc["latency_ms"].to<JsonObject>());
+  return IoTPublish(buildTopicName("photo"), doc, false, 0);
+}
+
+bool takeAndUploadPhoto(const char* reason, UploadPriority priority) {
+  TRACE_SPAN("photo");
+  HEAP_PROBE(heapSitePhoto);
   // Skip if camera not available (safe mode or camera failed)
   if (!cameraAvailable || !IsWiFiConnected()) {
     return false;
   }
 
-  logPrintf(LOG_INFO, "Taking photo (%s)...", reason);
+  // Check the daily data budget for this class, degrade to a thumbnail if low
+  UploadDecision decision = UploadScheduler::scheduler.Admit(priority,
+      RateController::rate.EstimateBytes(-1),
+      RateController::rate.EstimateBytes(RateController::ThumbnailLevel()));
+  if (decision == UPLOAD_SKIP) {
+    return false;
+  }
+
+  logPrintf(LOG_INFO, "Taking photo (%s%s)...", reason, decision == UPLOAD_REDUCED ? ", reduced" : "");
+  LatencySlo::slo.Begin(priority == UPLOAD_MOTION);
 
   // Generate base filename with timestamp (without extension)
   String baseFilename = "cat_" + getTimestamp();
@@ -1044,15 +1296,37 @@ bool takeAndUploadPhoto(const char* reason) {
 
   bool photoSuccess = false;
 
+  if (decision == UPLOAD_REDUCED) {
+    RateController::rate.SetFloor(RateController::ThumbnailLevel());
+  }
   camera_fb_t* fb = capturePhoto();
+  RateController::rate.SetFloor(0);
+
   if (fb) {
     ImageAnalyzer analizer;
     auto stats = analizer.analyze(fb);
+    lastImageMetrics = stats;
+    LatencySlo::slo.Stamp(SLO_ANALYSIS_DONE);
+
+    // Scheduled frames go into the hourly time-lapse bundle when enabled
+    if (priority == UPLOAD_SCHEDULED && TimelapseBundle::bundle.Enabled() &&
+        TimelapseBundle::bundle.Append(fb->buf, fb->len, statusJson,
+                                       writeStatusJSON(statusJson, sizeof(statusJson), stats, true))) {
+      releasePhoto(fb);
+      LatencySlo::slo.Abort();
+      return true;
+    }
 
+    size_t photoLen = fb->len;
     photoSuccess = uploadPhotoToS3(fb, photoFilename, String(s3Folder));
     releasePhoto(fb);
 
     if (photoSuccess) {
+      LatencySlo::slo.Stamp(SLO_UPLOAD_DONE);
+      if (publishPhotoEvent(reason, photoFilename)) {
+        LatencySlo::slo.Stamp(SLO_PUBLISH_DONE);
+      }
+      UploadScheduler::scheduler.Consume(priority, photoLen);
       logPrint(LOG_INFO, "Photo uploaded successfully!");
       lastWiFiActivity = millis();  // Update activity timestamp
 
@@ -1067,6 +1341,7 @@ bool takeAndUploadPhoto(const char* reason) {
       logPrint(LOG_WARNING, "Photo upload failed!");
     }
   }
+  LatencySlo::slo.Finish();
   return photoSuccess;
 }
 
@@ -1076,28 +1351,22 @@ void checkPhotoSchedule() {
     return;
   }
 
-  unsigned long currentMillis = millis();
-
-  // Check for scheduled photo (regular interval)
-  if (currentMillis - lastHourlyPhotoTime >= PHOTO_HOURLY_INTERVAL) {
-    lastHourlyPhotoTime = currentMillis;
-    lastPhotoTime = currentMillis;
-    takeAndUploadPhoto("scheduled");
-    return;
-  }
-
-  // Check for motion-triggered photo
-  // Take photo when cat arrives, but not more than once every 5 minutes
-  bool catJustArrived = catPresent && !lastCatPresent;
-  bool cooldownExpired = (currentMillis - lastPhotoTime) >= PHOTO_MOTION_COOLDOWN;
+  TimelapseBundle::bundle.Loop();
+  S3Connection::shared.CloseIdle();
 
-  if (catJustArrived && cooldownExpired) {
-    lastPhotoTime = currentMillis;
-    takeAndUploadPhoto("motion detected");
+  // Scheduled interval, or the cat just arrived and the motion cooldown is over
+  switch (shelter.Photo(millis())) {
+    case PHOTO_SCHEDULED:
+      EventRecorder::recorder.Decision(EVENT_PHOTO_SCHEDULED);
+      takeAndUploadPhoto("scheduled", UPLOAD_SCHEDULED);
+      break;
+    case PHOTO_MOTION:
+      EventRecorder::recorder.Decision(EVENT_PHOTO_MOTION);
+      takeAndUploadPhoto("motion detected", UPLOAD_MOTION);
+      break;
+    case PHOTO_NONE:
+      break;
   }
-
-  // Update previous cat presence state
-  lastCatPresent = catPresent;
 }
 
 void handleSerialCommands() {
@@ -1105,6 +1374,7 @@ void handleSerialCommands() {
     String command = Serial.readStringUntil('\n');
     command.trim();
     command.toLowerCase();
+    EventRecorder::recorder.Command(EVENT_SOURCE_SERIAL, command.c_str(), command.length());
 
     if (command == "help" || command == "?") {
       Serial.println("\n=== Available Commands ===");
@@ -1119,6 +1389,13 @@ void handleSerialCommands() {
       Serial.println("wifi auto     - Return to automatic WiFi control");
       Serial.println("wifi strength - Monitor WiFi signal strength (press any key to stop)");
       Serial.println("loglevel <n>  - Set log level (0=ERROR, 1=WARN, 2=INFO, 3=DEBUG)");
+      Serial.println("loglevel <module> <n|auto> - Level of one module (wifi, iot, upload, camera, ...)");
+      Serial.println("crypto bench  - Benchmark SHA-256/HMAC backends");
+      Serial.println("crypto hw     - Use hardware SHA backend");
+      Serial.println("crypto sw     - Use software SHA backend");
+      Serial.println("upload bench [n] [bytes] - Benchmark S3 PUT/GET (default 10 x 100KB)");
+      Serial.println("trace         - Dump recent spans as Chrome trace JSON");
+      Serial.println("heap          - Heap report: fragmentation and allocations per call site");
       Serial.println("reboot        - Reboot system");
       Serial.println("safemode      - Enter safe mode");
       Serial.println("reset         - Reset boot counter");
@@ -1127,10 +1404,22 @@ void handleSerialCommands() {
     else if (command == "status") {
       printStatusReport(true);  // Force immediate output, bypass 60s interval
     }
+    else if (command == "trace") {
+      char buf[512];
+      Trace::ChromeJson(buf, sizeof(buf), false, [](const char* json, size_t len, void*) {
+        Serial.write((const uint8_t*)json, len);
+      }, nullptr);
+    }
+    else if (command == "heap") {
+      JsonDocument doc;
+      HeapProfile::profile.Configure(doc);
+      serializeJsonPretty(HeapProfile::profile.describe(), Serial);
+      Serial.println();
+    }
     else if (command == "snapshot") {
       if (cameraAvailable) {
         logPrint(LOG_INFO, "Manual snapshot triggered");
-        takeAndUploadPhoto("manual");
+        takeAndUploadPhoto("manual", UPLOAD_MANUAL);
       } else {
         logPrint(LOG_ERROR, "Camera not available (safe mode or init failed)");
       }
@@ -1222,6 +1511,19 @@ void handleSerialCommands() {
         delay(100);  // Small delay to avoid busy-waiting
       }
     }
+    else if (command.startsWith("loglevel ") && !isDigit(command[9])) {
+      int space = command.indexOf(' ', 9);
+      String module = command.substring(9, space);
+      String value = space > 0 ? command.substring(space + 1) : "";
+      int level = value == "auto" ? LOG_LEVEL_INHERIT : value.toInt();
+      if (space < 0 || (level != LOG_LEVEL_INHERIT && (!isDigit(value[0]) || level > 3))) {
+        logPrint(LOG_ERROR, "Usage: loglevel <module> <0-3|auto>");
+      } else if (!AsyncLog::logger.SetModuleLevel(module.c_str(), level)) {
+        logPrintf(LOG_ERROR, "Unknown log module: %s", module.c_str());
+      } else {
+        logPrintf(LOG_INFO, "Log level of %s set to: %s", module.c_str(), value.c_str());
+      }
+    }
     else if (command.startsWith("loglevel ")) {
       int level = command.substring(9).toInt();
       if (level >= 0 && level <= 3) {
@@ -1232,6 +1534,23 @@ void handleSerialCommands() {
         logPrint(LOG_ERROR, "Invalid log level. Use 0-3 (ERROR, WARN, INFO, DEBUG)");
       }
     }
+    else if (command == "crypto bench") {
+      serializeJsonPretty(cryptoBenchmark(), Serial);
+      Serial.println();
+    }
+    else if (command.startsWith("upload bench")) {
+      int count = 10;
+      unsigned int bytes = 100 * 1024;
+      sscanf(command.c_str(), "upload bench %d %u", &count, &bytes);
+      serializeJsonPretty(uploadBenchmark(count, bytes), Serial);
+      Serial.println();
+    }
+    else if (command == "crypto hw") {
+      CryptoBackend::Select(CryptoBackend::Hardware());
+    }
+    else if (command == "crypto sw") {
+      CryptoBackend::Select(CryptoBackend::Software());
+    }
     else if (command == "reboot") {
       rebootSystem("Manual reboot command");
     }
@@ -1252,7 +1571,9 @@ void handleSerialCommands() {
   }
 }
 
-String generateStatusJSON(const ImageQualityMetrics& stats) {
+// The status fields in document order. Every status format is built from
+// this list: the S3 status JSON, time-lapse frame metadata and MQTT status.
+void writeStatusFields(StatusSink& out, const ImageQualityMetrics& stats) {
   unsigned long currentMillis = millis();
   time_t now = time(nullptr);
   struct tm timeinfo;
@@ -1260,87 +1581,126 @@ String generateStatusJSON(const ImageQualityMetrics& stats) {
   char timestamp[64];
   strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", &timeinfo);
 
-  // Generate JSON manually (no complex libraries needed)
-  String json = "{\n";
-  json += "  \"device\": \"" + String(deviceName) + "\",\n";
-  json += "  \"timestamp\": \"" + String(timestamp) + "\",\n";
-  json += "  \"uptime_seconds\": " + String(currentMillis / 1000) + ",\n";
-  json += "  \"mode\": \"" + String(safeMode ? "SAFE_MODE" : "NORMAL") + "\",\n";
-  json += "  \"boot_attempts\": " + String(bootAttempts) + ",\n";
-  json += "  \"max_boot_attempts\": " + String(MAX_BOOT_ATTEMPTS) + ",\n";
-  json += "  \"lux\": " + String(Ambient::ltr.getLux()) + ",\n";
-  json += "  \"ae_level\": " + String(aeCorrection) + ",\n";
+  out.Text("device", deviceName);
+  out.Text("timestamp", timestamp);
+  out.Int("uptime_seconds", currentMillis / 1000);
+  out.Text("mode", safeMode ? "SAFE_MODE" : "NORMAL");
+  out.Int("boot_attempts", bootAttempts);
+  out.Int("max_boot_attempts", MAX_BOOT_ATTEMPTS);
+  out.Float("lux", Ambient::ltr.getLux(), 2);
+  out.Int("ae_level", aeCorrection);
   if (DHT_PIN != 0) {
-    json += "  \"temperature_celsius\": " + String(currentTemp, 1) + ",\n";
-    json += "  \"humidity_percent\": " + String(currentHumidity, 1) + ",\n";
-    json += "  \"dht22_sensor_working\": " + String(dhtSensorWorking ? "true" : "false") + ",\n";
+    out.Float("temperature_celsius", currentTemp, 1);
+    out.Float("humidity_percent", currentHumidity, 1);
+    out.Bool("dht22_sensor_working", dhtSensorWorking);
 
     // Add effective temperature and expected temperature
     float effectiveTemp = getEffectiveTemperature();
     float expectedTemp = getExpectedTemperature();
-    json += "  \"effective_temperature_celsius\": " + String(effectiveTemp, 1) + ",\n";
-    json += "  \"expected_temperature_celsius\": " + String(expectedTemp, 1) + ",\n";
-    json += "  \"using_fallback_temperature\": " + String((effectiveTemp != currentTemp) ? "true" : "false") + ",\n";
+    out.Float("effective_temperature_celsius", effectiveTemp, 1);
+    out.Float("expected_temperature_celsius", expectedTemp, 1);
+    out.Bool("using_fallback_temperature", effectiveTemp != currentTemp);
   }
 
   if (PIR_PIN != 0) {
-    json += "  \"cat_present\": " + String(catPresent ? "true" : "false") + ",\n";
+    out.Bool("cat_present", catPresent);
 
     // Cat presence timing info (PIR motion-based with timeout)
     if (lastMotionDetected > 0) {
       unsigned long timeSinceMotion = currentMillis - lastMotionDetected;
-      json += "  \"seconds_since_last_motion\": " + String(timeSinceMotion / 1000) + ",\n";
+      out.Int("seconds_since_last_motion", timeSinceMotion / 1000);
       if (catPresent) {
         unsigned long timeUntilTimeout = CAT_PRESENCE_TIMEOUT - timeSinceMotion;
-        json += "  \"presence_timeout_seconds\": " + String(timeUntilTimeout / 1000) + ",\n";
+        out.Int("presence_timeout_seconds", timeUntilTimeout / 1000);
       }
     }
   }
 
   if (RELAY_PIN != 0) {
-    json += "  \"blanket_on\": " + String(blanketOn ? "true" : "false") + ",\n";
-    json += "  \"blanket_manual_override\": " + String(blanketManualOverride ? "true" : "false") + ",\n";
+    out.Bool("blanket_on", blanketOn);
+    out.Bool("blanket_manual_override", blanketManualOverride);
   }
 
-  json += "  \"camera_available\": " + String(cameraAvailable ? "true" : "false") + ",\n";
-
-  json+= "  \"image_quality_metrics\": {\n"
-      "    \"brightness\": " + String(stats.brightness) +",\n"
-      "    \"contrast\": " + String(stats.contrast) +",\n"
-      "    \"isBright\": " + String(stats.isBright) +",\n"
-      "    \"isDark\": " + String(stats.isDark) +",\n"
-      "    \"noiseLevel\": " + String(stats.noiseLevel) +",\n"
-      "    \"overexposure\": " + String(stats.overexposure) +",\n"
-      "    \"qualityScore\": " + String(stats.qualityScore) +",\n"
-      "    \"sharpness\": " + String(stats.sharpness) +",\n"
-      "    \"underexposure\": " + String(stats.underexposure) +"\n"
-    "  },\n";
-
-  json += "  \"wifi_connected\": " + String(WiFi.isConnected() ? "true" : "false") + ",\n";
-  if (WiFi.isConnected()) {
-    json += "  \"wifi_ssid\": \"" + String(WiFi.SSID().c_str()) + "\",\n";
-    json += "  \"wifi_rssi\": \"" + String(WiFi.RSSI()) + "\",\n";
+  out.Bool("camera_available", cameraAvailable);
+
+  // isBright/isDark have always been published as 1/0
+  out.BeginObject("image_quality_metrics");
+  out.Float("brightness", stats.brightness, 2);
+  out.Float("contrast", stats.contrast, 2);
+  out.Int("isBright", stats.isBright);
+  out.Int("isDark", stats.isDark);
+  out.Float("noiseLevel", stats.noiseLevel, 2);
+  out.Float("overexposure", stats.overexposure, 2);
+  out.Float("qualityScore", stats.qualityScore, 2);
+  out.Float("sharpness", stats.sharpness, 2);
+  out.Float("underexposure", stats.underexposure, 2);
+  out.EndObject();
+
+  // SSID and RSSI straight from the driver, WiFi.SSID() returns a String
+  bool wifiConnected = WiFi.isConnected();
+  out.Bool("wifi_connected", wifiConnected);
+  wifi_ap_record_t ap;
+  if (wifiConnected && esp_wifi_sta_get_ap_info(&ap) == ESP_OK) {
+    char rssi[8];
+    snprintf(rssi, sizeof(rssi), "%d", ap.rssi);
+    out.Text("wifi_ssid", (const char*)ap.ssid);
+    out.Text("wifi_rssi", rssi);
   }
-  json += "  \"wifi_manual_override\": " + String(wifiManualOverride ? "true" : "false") + ",\n";
+  const OperatingPoint& point = RateController::rate.Current();
+  out.BeginObject("rate_control");
+  out.Int("framesize", (int)point.framesize);
+  out.Int("quality", point.quality);
+  out.Int("throughput_bps", (int)RateController::rate.ThroughputBps());
+  out.EndObject();
+  out.BeginObject("dns");
+  out.Int("hits", DnsCache::cache.Hits());
+  out.Int("misses", DnsCache::cache.Misses());
+  out.Int("avg_lookup_ms", DnsCache::cache.AvgLookupMs());
+  out.EndObject();
+  out.BeginObject("uploads");
+  out.Int("attempts", UploadRetry::retry.Attempts());
+  out.Int("retries", UploadRetry::retry.Retries());
+  out.Int("failed", UploadRetry::retry.Failed());
+  out.Float("retry_budget", UploadRetry::retry.Budget(), 1);
+  out.EndObject();
+  out.Bool("wifi_manual_override", wifiManualOverride);
+  LatencySlo::slo.WriteStatus(out);
 
   // Memory status (for leak detection)
-  json += "  \"heap_free_bytes\": " + String(ESP.getFreeHeap()) + ",\n";
-  json += "  \"heap_size_bytes\": " + String(ESP.getHeapSize()) + ",\n";
-  json += "  \"heap_min_free_bytes\": " + String(ESP.getMinFreeHeap()) + ",\n";
-  json += "  \"psram_free_bytes\": " + String(ESP.getFreePsram()) + ",\n";
-  json += "  \"psram_size_bytes\": " + String(ESP.getPsramSize()) +",\n";
-  json += "  \"chip_temperature\": " + String(getChipTemperature());
+  out.Int("heap_free_bytes", ESP.getFreeHeap());
+  out.Int("heap_size_bytes", ESP.getHeapSize());
+  out.Int("heap_min_free_bytes", ESP.getMinFreeHeap());
+  out.Int("psram_free_bytes", ESP.getFreePsram());
+  out.Int("psram_size_bytes", ESP.getPsramSize());
+  HeapRegion internal = HeapProfile::Internal();
+  out.Int("heap_largest_free_block_bytes", internal.largest);
+  out.Int("heap_fragmentation_percent", internal.Fragmentation());
+  out.Int("psram_largest_free_block_bytes", HeapProfile::Psram().largest);
+  out.Float("chip_temperature", getChipTemperature(), 2);
 
   if (cameraAvailable) {
     unsigned long nextScheduledPhoto = PHOTO_HOURLY_INTERVAL - (currentMillis - lastHourlyPhotoTime);
     unsigned long timeSinceLastPhoto = currentMillis - lastPhotoTime;
-    json += ",\n";
-    json += "  \"next_scheduled_photo_minutes\": " + String(nextScheduledPhoto / 60000) + ",\n";
-    json += "  \"time_since_last_photo_minutes\": " + String(timeSinceLastPhoto / 60000);
+    out.Int("next_scheduled_photo_minutes", nextScheduledPhoto / 60000);
+    out.Int("time_since_last_photo_minutes", timeSinceLastPhoto / 60000);
   }
+}
 
-  json += "\n}";
-  return json;
+size_t writeStatusJSON(char* buf, size_t cap, const ImageQualityMetrics& stats, bool compact) {
+  JsonBufferWriter writer(buf, cap, !compact);
+  writeStatusFields(writer, stats);
+  size_t len = writer.Finish();
+  if (len == 0) {
+    logPrintf(LOG_ERROR, "Status JSON exceeds %u byte buffer", cap);
+  }
+  return len;
+}
+
+JsonDocument statusDocument() {
+  JsonDocument doc;
+  JsonDocumentSink sink(doc);
+  writeStatusFields(sink, lastImageMetrics);
+  return doc;
 }
 
 void printStatusReport(bool forceImmediate) {
@@ -1392,6 +1752,12 @@ void printStatusReport(bool forceImmediate) {
     Serial.printf("Heap Min Free: %u bytes (%.1f KB)\n", ESP.getMinFreeHeap(), ESP.getMinFreeHeap() / 1024.0);
     Serial.printf("PSRAM Free: %u bytes (%.1f KB)\n", ESP.getFreePsram(), ESP.getFreePsram() / 1024.0);
     Serial.printf("PSRAM Size: %u bytes (%.1f KB)\n", ESP.getPsramSize(), ESP.getPsramSize() / 1024.0);
+    HeapRegion internal = HeapProfile::Internal();
+    Serial.printf("Heap Largest Block: %u bytes (%u%% fragmented)\n", internal.largest, internal.Fragmentation());
+    if (psramFound()) {
+      HeapRegion psram = HeapProfile::Psram();
+      Serial.printf("PSRAM Largest Block: %u bytes (%u%% fragmented)\n", psram.largest, psram.Fragmentation());
+    }
     Serial.printf("Chip Temperature: %.2f celsius\n", getChipTemperature());
     Serial.println("---------------------");
 
@@ -0,0 +1,131 @@
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <mbedtls/sha256.h>
+#include "esp_timer.h"
+#if CONFIG_IDF_TARGET_ESP32
+#include "sha/sha_parallel_engine.h"
+#else
+#include "sha/sha_dma.h"
+#endif
+#include "common.h"
+#include "crypto_backend.h"
+#include "crypto_benchmark.h"
+
+#define CRYPTO_BENCH_MIN_SIZE (64*1024)
+#define CRYPTO_BENCH_MAX_SIZE (512*1024)
+
+// ===== ESP32 SHA peripheral =====
+
+class HardwareCryptoBackend : public CryptoBackend {
+public:
+    const char* Name() const override { return "hardware"; }
+
+    // Streaming (HMAC) goes through the mbedtls context, which the ESP-IDF port
+    // maps onto the SHA peripheral when it is not busy
+    void Begin(Context& ctx) const override {
+        static_assert(sizeof(mbedtls_sha256_context) <= CRYPTO_CONTEXT_SIZE, "crypto context too small");
+        mbedtls_sha256_context* c = (mbedtls_sha256_context*)ctx.opaque;
+        mbedtls_sha256_init(c);
+        mbedtls_sha256_starts(c, 0);
+    }
+
+    void Update(Context& ctx, const uint8_t* data, size_t len) const override {
+        mbedtls_sha256_update((mbedtls_sha256_context*)ctx.opaque, data, len);
+    }
+
+    void Finish(Context& ctx, uint8_t* digest) const override {
+        mbedtls_sha256_context* c = (mbedtls_sha256_context*)ctx.opaque;
+        mbedtls_sha256_finish(c, digest);
+        mbedtls_sha256_free(c);
+    }
+
+    // One-shot payload hashing drives the peripheral directly
+    void Sha256(const uint8_t* data, size_t len, uint8_t* digest) const override {
+        esp_sha(SHA2_256, data, len, digest);
+    }
+};
+
+static HardwareCryptoBackend hardwareBackend;
+static CryptoBackend* activeBackend = &hardwareBackend;
+
+CryptoBackend& CryptoBackend::Hardware() {
+    return hardwareBackend;
+}
+
+CryptoBackend& CryptoBackend::Active() {
+    return *activeBackend;
+}
+
+void CryptoBackend::Select(CryptoBackend& backend) {
+    activeBackend = &backend;
+    logPrintf(LOG_INFO, "Crypto backend: %s", backend.Name());
+}
+
+// ===== Benchmark =====
+
+JsonDocument cryptoBenchmark() {
+    JsonDocument doc;
+    doc["device"] = deviceName;
+    doc["timestamp"] = getTimestamp();
+    doc["active"] = CryptoBackend::Active().Name();
+
+    uint8_t* buf = (uint8_t*)(psramFound() ? ps_malloc(CRYPTO_BENCH_MAX_SIZE) : nullptr);
+    size_t maxSize = CRYPTO_BENCH_MAX_SIZE;
+    if (!buf) {
+        maxSize = CRYPTO_BENCH_MIN_SIZE;
+        buf = (uint8_t*)malloc(maxSize);
+    }
+    if (!buf) {
+        doc["error"] = "out of memory";
+        return doc;
+    }
+    for (size_t i = 0; i < maxSize; i++) {
+        buf[i] = (uint8_t)(i * 31 + 7);
+    }
+
+    const uint8_t hmacKey[] = "cat-shelter-benchmark-key";
+    const CryptoBackend* backends[] = {&hardwareBackend, &CryptoBackend::Software()};
+    bool allMatch = true;
+
+    JsonObject known = doc["known_answers"].to<JsonObject>();
+    for (const CryptoBackend* backend : backends) {
+        int failures = backend->KnownAnswerFailures();
+        known[backend->Name()] = failures == 0;
+        allMatch = allMatch && failures == 0;
+    }
+
+    JsonArray results = doc["results"].to<JsonArray>();
+    for (size_t size = CRYPTO_BENCH_MIN_SIZE; size <= maxSize; size *= 2) {
+        JsonObject entry = results.add<JsonObject>();
+        entry["bytes"] = size;
+
+        uint8_t digests[2][SHA256_DIGEST_SIZE];
+        uint8_t macs[2][SHA256_DIGEST_SIZE];
+        for (int b = 0; b < 2; b++) {
+            int64_t start = esp_timer_get_time();
+            backends[b]->Sha256(buf, size, digests[b]);
+            int64_t shaUs = esp_timer_get_time() - start;
+
+            start = esp_timer_get_time();
+            backends[b]->HmacSha256(hmacKey, sizeof(hmacKey) - 1, buf, size, macs[b]);
+            int64_t hmacUs = esp_timer_get_time() - start;
+
+            JsonObject r = entry[backends[b]->Name()].to<JsonObject>();
+            r["sha256_mbps"] = shaUs > 0 ? (double)size / shaUs : 0;
+            r["hmac_mbps"] = hmacUs > 0 ? (double)size / hmacUs : 0;
+
+            // Keep the watchdog and the loop-side tasks happy between runs
+            delay(1);
+        }
+
+        bool match = memcmp(digests[0], digests[1], SHA256_DIGEST_SIZE) == 0 &&
+                     memcmp(macs[0], macs[1], SHA256_DIGEST_SIZE) == 0;
+        entry["match"] = match;
+        allMatch = allMatch && match;
+    }
+    doc["match"] = allMatch;
+
+    free(buf);
+    logPrintf(LOG_INFO, "Crypto benchmark done (backends %s)", allMatch ? "match" : "MISMATCH");
+    return doc;
+}
@@ -0,0 +1,260 @@
+#include <string.h>
+#include "crypto_backend.h"
+
+// ===== Portable software SHA-256 (FIPS 180-4) =====
+
+struct SoftSha256State {
+    uint32_t h[8];
+    uint64_t totalLen;
+    uint8_t block[SHA256_BLOCK_SIZE];
+    size_t blockLen;
+};
+
+static const uint32_t SHA256_K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static inline uint32_t rotr(uint32_t x, int n) {
+    return (x >> n) | (x << (32 - n));
+}
+
+static void softSha256Block(SoftSha256State* s, const uint8_t* p) {
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++) {
+        w[i] = ((uint32_t)p[i * 4] << 24) | ((uint32_t)p[i * 4 + 1] << 16) |
+               ((uint32_t)p[i * 4 + 2] << 8) | (uint32_t)p[i * 4 + 3];
+    }
+    for (int i = 16; i < 64; i++) {
+        uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = s->h[0], b = s->h[1], c = s->h[2], d = s->h[3];
+    uint32_t e = s->h[4], f = s->h[5], g = s->h[6], h = s->h[7];
+    for (int i = 0; i < 64; i++) {
+        uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + SHA256_K[i] + w[i];
+        uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+    s->h[0] += a; s->h[1] += b; s->h[2] += c; s->h[3] += d;
+    s->h[4] += e; s->h[5] += f; s->h[6] += g; s->h[7] += h;
+}
+
+class SoftwareCryptoBackend : public CryptoBackend {
+public:
+    const char* Name() const override { return "software"; }
+
+    void Begin(Context& ctx) const override {
+        static_assert(sizeof(SoftSha256State) <= CRYPTO_CONTEXT_SIZE, "crypto context too small");
+        SoftSha256State* s = (SoftSha256State*)ctx.opaque;
+        static const uint32_t init[8] = {
+            0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+        };
+        memcpy(s->h, init, sizeof(init));
+        s->totalLen = 0;
+        s->blockLen = 0;
+    }
+
+    void Update(Context& ctx, const uint8_t* data, size_t len) const override {
+        SoftSha256State* s = (SoftSha256State*)ctx.opaque;
+        s->totalLen += len;
+        if (s->blockLen > 0) {
+            size_t n = len < SHA256_BLOCK_SIZE - s->blockLen ? len : SHA256_BLOCK_SIZE - s->blockLen;
+            memcpy(s->block + s->blockLen, data, n);
+            s->blockLen += n;
+            data += n;
+            len -= n;
+            if (s->blockLen < SHA256_BLOCK_SIZE) {
+                return;
+            }
+            softSha256Block(s, s->block);
+            s->blockLen = 0;
+        }
+        while (len >= SHA256_BLOCK_SIZE) {
+            softSha256Block(s, data);
+            data += SHA256_BLOCK_SIZE;
+            len -= SHA256_BLOCK_SIZE;
+        }
+        memcpy(s->block, data, len);
+        s->blockLen = len;
+    }
+
+    void Finish(Context& ctx, uint8_t* digest) const override {
+        SoftSha256State* s = (SoftSha256State*)ctx.opaque;
+        uint64_t bitLen = s->totalLen * 8;
+        s->block[s->blockLen++] = 0x80;
+        if (s->blockLen > SHA256_BLOCK_SIZE - 8) {
+            memset(s->block + s->blockLen, 0, SHA256_BLOCK_SIZE - s->blockLen);
+            softSha256Block(s, s->block);
+            s->blockLen = 0;
+        }
+        memset(s->block + s->blockLen, 0, SHA256_BLOCK_SIZE - 8 - s->blockLen);
+        for (int i = 0; i < 8; i++) {
+            s->block[SHA256_BLOCK_SIZE - 1 - i] = (uint8_t)(bitLen >> (i * 8));
+        }
+        softSha256Block(s, s->block);
+        for (int i = 0; i < 8; i++) {
+            digest[i * 4] = (uint8_t)(s->h[i] >> 24);
+            digest[i * 4 + 1] = (uint8_t)(s->h[i] >> 16);
+            digest[i * 4 + 2] = (uint8_t)(s->h[i] >> 8);
+            digest[i * 4 + 3] = (uint8_t)s->h[i];
+        }
+    }
+};
+
+static SoftwareCryptoBackend softwareBackend;
+
+CryptoBackend& CryptoBackend::Software() {
+    return softwareBackend;
+}
+
+// ===== Shared by all backends =====
+
+void CryptoBackend::Sha256(const uint8_t* data, size_t len, uint8_t* digest) const {
+    Context ctx;
+    Begin(ctx);
+    Update(ctx, data, len);
+    Finish(ctx, digest);
+}
+
+// HMAC (RFC 2104) on top of the streaming hash
+void CryptoBackend::HmacSha256(const uint8_t* key, size_t keyLen,
+                               const uint8_t* data, size_t len, uint8_t* mac) const {
+    uint8_t keyBlock[SHA256_BLOCK_SIZE] = {};
+    if (keyLen > SHA256_BLOCK_SIZE) {
+        Sha256(key, keyLen, keyBlock);
+    } else {
+        memcpy(keyBlock, key, keyLen);
+    }
+
+    uint8_t pad[SHA256_BLOCK_SIZE];
+    uint8_t inner[SHA256_DIGEST_SIZE];
+    Context ctx;
+
+    for (int i = 0; i < SHA256_BLOCK_SIZE; i++) {
+        pad[i] = keyBlock[i] ^ 0x36;
+    }
+    Begin(ctx);
+    Update(ctx, pad, SHA256_BLOCK_SIZE);
+    Update(ctx, data, len);
+    Finish(ctx, inner);
+
+    for (int i = 0; i < SHA256_BLOCK_SIZE; i++) {
+        pad[i] = keyBlock[i] ^ 0x5c;
+    }
+    // data may alias mac (chained SigV4 key derivation), inner is already a copy
+    Begin(ctx);
+    Update(ctx, pad, SHA256_BLOCK_SIZE);
+    Update(ctx, inner, SHA256_DIGEST_SIZE);
+    Finish(ctx, mac);
+}
+
+// ===== Known answers =====
+
+struct KnownBytes {
+    const char* bytes;      // nullptr: len copies of fill
+    size_t len;
+    uint8_t fill;
+};
+
+struct KnownHash {
+    KnownBytes message;
+    uint32_t repeat;        // message fed this many times
+    const char* digest;
+};
+
+struct KnownMac {
+    KnownBytes key;
+    KnownBytes data;
+    size_t macLen;          // compared bytes (test case 5 is truncated)
+    const char* mac;
+};
+
+// FIPS 180-4 examples (NIST CSRC) and the empty message
+static const KnownHash KNOWN_HASHES[] = {
+    {{"abc", 3, 0}, 1, "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"},
+    {{"", 0, 0}, 1, "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855"},
+    {{"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", 56, 0}, 1,
+     "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1"},
+    {{"abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmnhijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu",
+      112, 0}, 1, "cf5b16a778af8380036ce59e7b0492370b249b11e8f07a51afac45037afee9d1"},
+    {{nullptr, 100, 'a'}, 10000, "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0"},
+};
+
+// RFC 4231 test cases 1-7
+static const KnownMac KNOWN_MACS[] = {
+    {{nullptr, 20, 0x0b}, {"Hi There", 8, 0}, 32,
+     "b0344c61d8db38535ca8afceaf0bf12b881dc200c9833da726e9376c2e32cff7"},
+    {{"Jefe", 4, 0}, {"what do ya want for nothing?", 28, 0}, 32,
+     "5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843"},
+    {{nullptr, 20, 0xaa}, {nullptr, 50, 0xdd}, 32,
+     "773ea91e36800e46854db8ebd09181a72959098b3ef8c122d9635514ced565fe"},
+    {{"\x01\x02\x03\x04\x05\x06\x07\x08\x09\x0a\x0b\x0c\x0d\x0e\x0f\x10\x11\x12\x13\x14\x15\x16\x17\x18\x19", 25, 0},
+     {nullptr, 50, 0xcd}, 32, "82558a389a443c0ea4cc819899f2083a85f0faa3e578f8077a2e3ff46729665b"},
+    {{nullptr, 20, 0x0c}, {"Test With Truncation", 20, 0}, 16, "a3b6167473100ee06e0c796c2955552b"},
+    {{nullptr, 131, 0xaa}, {"Test Using Larger Than Block-Size Key - Hash Key First", 54, 0}, 32,
+     "60e431591ee0b67f0d8a26aacbf5b77f8e0bc6213728c5140546040f0ee37f54"},
+    {{nullptr, 131, 0xaa},
+     {"This is a test using a larger than block-size key and a larger than block-size data. "
+      "The key needs to be hashed before being used by the HMAC algorithm.", 152, 0}, 32,
+     "9b09ffa71b942fcb27635fbcd5b0e944bfdc63644f0713938a7f51535c3a35e2"},
+};
+
+#define KNOWN_BYTES_MAX 160
+
+static const uint8_t* knownBytes(const KnownBytes& b, uint8_t* buf) {
+    if (b.bytes) {
+        return (const uint8_t*)b.bytes;
+    }
+    memset(buf, b.fill, b.len);
+    return buf;
+}
+
+static bool matchesHex(const uint8_t* digest, size_t len, const char* hex) {
+    static const char digits[] = "0123456789abcdef";
+    for (size_t i = 0; i < len; i++) {
+        if (hex[i * 2] != digits[digest[i] >> 4] || hex[i * 2 + 1] != digits[digest[i] & 0x0f]) {
+            return false;
+        }
+    }
+    return hex[len * 2] == '\0';
+}
+
+int CryptoBackend::KnownAnswerFailures() const {
+    uint8_t buf[KNOWN_BYTES_MAX];
+    uint8_t key[KNOWN_BYTES_MAX];
+    uint8_t digest[SHA256_DIGEST_SIZE];
+    int failures = 0;
+
+    for (const KnownHash& known : KNOWN_HASHES) {
+        const uint8_t* message = knownBytes(known.message, buf);
+        if (known.repeat == 1) {
+            Sha256(message, known.message.len, digest);
+        } else {
+            Context ctx;
+            Begin(ctx);
+            for (uint32_t i = 0; i < known.repeat; i++) {
+                Update(ctx, message, known.message.len);
+            }
+            Finish(ctx, digest);
+        }
+        failures += !matchesHex(digest, SHA256_DIGEST_SIZE, known.digest);
+    }
+
+    for (const KnownMac& known : KNOWN_MACS) {
+        const uint8_t* k = knownBytes(known.key, key);
+        const uint8_t* data = knownBytes(known.data, buf);
+        HmacSha256(k, known.key.len, data, known.data.len, digest);
+        failures += !matchesHex(digest, known.macLen, known.mac);
+    }
+    return failures;
+}
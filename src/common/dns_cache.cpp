@@ -0,0 +1,399 @@
+#define LOG_MODULE LOG_MODULE_UPLOAD
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <WiFiUdp.h>
+#include <ArduinoJson.h>
+#include "esp_attr.h"
+#include "common.h"
+#include "dns_cache.h"
+
+#define DNS_PORT 53
+#define DNS_PACKET_SIZE 512
+#define DNS_TYPE_A 1
+#define DNS_CLASS_IN 1
+#define DNS_RTC_MAGIC 0x444e5332   // "DNS2", 96 byte host names
+
+DnsCache DnsCache::cache;
+
+// Last-known-good addresses, kept across soft reboots (not power loss)
+struct DnsRtcState {
+    uint32_t magic;
+    struct {
+        char host[DNS_CACHE_HOST_LEN];
+        uint32_t ip;
+    } entries[DNS_CACHE_SIZE];
+    uint32_t checksum;
+};
+RTC_NOINIT_ATTR static DnsRtcState rtcState;
+
+static uint32_t rtcChecksum(const DnsRtcState& state) {
+    const uint8_t* p = (const uint8_t*)&state;
+    uint32_t sum = 0;
+    for (size_t i = 0; i < offsetof(DnsRtcState, checksum); i++) {
+        sum = sum * 31 + p[i];
+    }
+    return sum;
+}
+
+// ===== DNS wire format =====
+
+// Standard recursive A query. Returns the packet length, 0 if the name doesn't fit.
+static size_t buildDnsQuery(uint8_t* buf, size_t cap, const char* host, uint16_t id) {
+    static const uint8_t header[] = {0, 0, 0x01, 0x00, 0, 1, 0, 0, 0, 0, 0, 0};
+    size_t hostLen = strlen(host);
+    if (sizeof(header) + hostLen + 2 + 4 > cap) {
+        return 0;
+    }
+    memcpy(buf, header, sizeof(header));
+    buf[0] = id >> 8;
+    buf[1] = id & 0xff;
+
+    size_t pos = sizeof(header);
+    const char* label = host;
+    while (*label) {
+        const char* dot = strchr(label, '.');
+        size_t len = dot ? (size_t)(dot - label) : strlen(label);
+        if (len == 0 || len > 63) {
+            return 0;
+        }
+        buf[pos++] = len;
+        memcpy(buf + pos, label, len);
+        pos += len;
+        label += len + (dot ? 1 : 0);
+    }
+    buf[pos++] = 0;
+    buf[pos++] = 0;
+    buf[pos++] = DNS_TYPE_A;
+    buf[pos++] = 0;
+    buf[pos++] = DNS_CLASS_IN;
+    return pos;
+}
+
+// Skip a (possibly compressed) name, returns the offset after it or 0 on error
+static size_t skipDnsName(const uint8_t* buf, size_t len, size_t pos) {
+    while (pos < len) {
+        uint8_t n = buf[pos];
+        if (n == 0) {
+            return pos + 1;
+        }
+        if ((n & 0xc0) == 0xc0) {
+            return pos + 2 <= len ? pos + 2 : 0;
+        }
+        pos += n + 1;
+    }
+    return 0;
+}
+
+// First A record of the answer; ttl is the smallest TTL along the CNAME chain
+static bool parseDnsResponse(const uint8_t* buf, size_t len, uint16_t id, uint32_t& ip, uint32_t& ttl) {
+    if (len < 12 || ((buf[0] << 8) | buf[1]) != id || !(buf[2] & 0x80) || (buf[3] & 0x0f) != 0) {
+        return false;
+    }
+    uint16_t questions = (buf[4] << 8) | buf[5];
+    uint16_t answers = (buf[6] << 8) | buf[7];
+
+    size_t pos = 12;
+    for (uint16_t i = 0; i < questions; i++) {
+        pos = skipDnsName(buf, len, pos);
+        if (pos == 0 || pos + 4 > len) {
+            return false;
+        }
+        pos += 4;
+    }
+
+    ttl = UINT32_MAX;
+    for (uint16_t i = 0; i < answers; i++) {
+        pos = skipDnsName(buf, len, pos);
+        if (pos == 0 || pos + 10 > len) {
+            return false;
+        }
+        uint16_t type = (buf[pos] << 8) | buf[pos + 1];
+        uint32_t recordTtl = ((uint32_t)buf[pos + 4] << 24) | ((uint32_t)buf[pos + 5] << 16) |
+                             ((uint32_t)buf[pos + 6] << 8) | buf[pos + 7];
+        uint16_t rdlen = (buf[pos + 8] << 8) | buf[pos + 9];
+        pos += 10;
+        if (pos + rdlen > len) {
+            return false;
+        }
+        ttl = min(ttl, recordTtl);
+        if (type == DNS_TYPE_A && rdlen == 4) {
+            // IPAddress(uint32_t) expects network byte order in memory
+            memcpy(&ip, buf + pos, 4);
+            return true;
+        }
+        pos += rdlen;
+    }
+    return false;
+}
+
+// ===== Cache =====
+
+void DnsCache::Begin() {
+    if (_lock) {
+        return;
+    }
+    _lock = xSemaphoreCreateMutex();
+    LoadRTC();
+    xTaskCreatePinnedToCore(RefreshTask, "dns-refresh", 4096, this, 1, nullptr, 0);
+}
+
+void DnsCache::LoadRTC() {
+    if (rtcState.magic != DNS_RTC_MAGIC || rtcState.checksum != rtcChecksum(rtcState)) {
+        memset(&rtcState, 0, sizeof(rtcState));
+        return;
+    }
+    for (int i = 0; i < DNS_CACHE_SIZE; i++) {
+        rtcState.entries[i].host[DNS_CACHE_HOST_LEN - 1] = 0;
+        strcpy(_entries[i].host, rtcState.entries[i].host);
+        _entries[i].ip = rtcState.entries[i].ip;
+        _entries[i].expiresMs = 0;
+        _entries[i].lastUsedMs = 0;
+        if (_entries[i].host[0]) {
+            logPrintf(LOG_DEBUG, "DNS cache: restored %s -> %s", _entries[i].host,
+                      IPAddress(_entries[i].ip).toString().c_str());
+        }
+    }
+}
+
+void DnsCache::SaveRTC() {
+    rtcState.magic = DNS_RTC_MAGIC;
+    for (int i = 0; i < DNS_CACHE_SIZE; i++) {
+        strcpy(rtcState.entries[i].host, _entries[i].host);
+        rtcState.entries[i].ip = _entries[i].ip;
+    }
+    rtcState.checksum = rtcChecksum(rtcState);
+}
+
+DnsCacheEntry* DnsCache::Find(const char* host) {
+    for (int i = 0; i < DNS_CACHE_SIZE; i++) {
+        if (strcmp(_entries[i].host, host) == 0) {
+            return &_entries[i];
+        }
+    }
+    return nullptr;
+}
+
+// Caller holds the lock and checked that the name fits. Replaces the least
+// recently used entry for a new host.
+void DnsCache::Store(const char* host, const IPAddress& ip, uint32_t ttl) {
+    DnsCacheEntry* entry = Find(host);
+    if (!entry) {
+        entry = &_entries[0];
+        for (int i = 1; i < DNS_CACHE_SIZE; i++) {
+            if (_entries[i].lastUsedMs < entry->lastUsedMs) {
+                entry = &_entries[i];
+            }
+        }
+        strcpy(entry->host, host);
+        entry->lastUsedMs = millis();
+    }
+    ttl = constrain(ttl, (uint32_t)DNS_CACHE_MIN_TTL, (uint32_t)DNS_CACHE_MAX_TTL);
+    bool changed = entry->ip != (uint32_t)ip;
+    entry->ip = (uint32_t)ip;
+    entry->expiresMs = max(1UL, millis() + ttl * 1000UL);
+    if (changed) {
+        SaveRTC();
+    }
+}
+
+// Query the DHCP provided server directly to learn the TTL, fall back to the system resolver
+bool DnsCache::Lookup(const char* host, IPAddress& ip, uint32_t& ttl) {
+    if (!WiFi.isConnected()) {
+        return false;
+    }
+
+    unsigned long start = millis();
+    bool ok = false;
+
+    uint8_t packet[DNS_PACKET_SIZE];
+    uint16_t id = esp_random() & 0xffff;
+    size_t len = buildDnsQuery(packet, sizeof(packet), host, id);
+    IPAddress server = WiFi.dnsIP(0);
+    if (len > 0 && (uint32_t)server != 0) {
+        WiFiUDP udp;
+        if (udp.beginPacket(server, DNS_PORT) && udp.write(packet, len) == len && udp.endPacket()) {
+            while (!ok && millis() - start < DNS_QUERY_TIMEOUT) {
+                int received = udp.parsePacket();
+                if (received > 0) {
+                    received = udp.read(packet, sizeof(packet));
+                    uint32_t addr;
+                    if (received > 0 && parseDnsResponse(packet, received, id, addr, ttl)) {
+                        ip = IPAddress(addr);
+                        ok = true;
+                    }
+                } else {
+                    delay(10);
+                }
+            }
+        }
+        udp.stop();
+    }
+
+    if (!ok && WiFi.hostByName(host, ip) == 1) {
+        ttl = DNS_CACHE_DEFAULT_TTL;
+        ok = true;
+    }
+
+    uint32_t elapsed = millis() - start;
+    // Lookups run on the refresh task, the loop task and the pipeline net task
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    _lookupMs += elapsed;
+    ++_lookups;
+    _maxLookupMs = max(_maxLookupMs, elapsed);
+    xSemaphoreGive(_lock);
+
+    if (!ok) {
+        logPrintf(LOG_WARNING, "DNS lookup failed for %s (%lu ms)", host, (unsigned long)elapsed);
+    }
+    return ok;
+}
+
+bool DnsCache::Resolve(const char* host, IPAddress& ip) {
+    if (ip.fromString(host)) {
+        return true;
+    }
+    if (!_lock) {
+        Begin();
+    }
+
+    uint32_t ttl = 0;
+    if (strlen(host) >= DNS_CACHE_HOST_LEN) {
+        // Cut short, the name would never match its entry again
+        bool ok = Lookup(host, ip, ttl);
+        xSemaphoreTake(_lock, portMAX_DELAY);
+        ++_misses;
+        if (!ok) {
+            ++_failures;
+        }
+        xSemaphoreGive(_lock);
+        return ok;
+    }
+
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    DnsCacheEntry* entry = Find(host);
+    if (entry) {
+        entry->lastUsedMs = millis();
+        if (entry->expiresMs != 0 && (long)(entry->expiresMs - millis()) > 0) {
+            ip = IPAddress(entry->ip);
+            ++_hits;
+            xSemaphoreGive(_lock);
+            return true;
+        }
+    }
+    xSemaphoreGive(_lock);
+
+    // Lookup outside the lock, the refresh task may be resolving too
+    IPAddress resolved;
+    bool ok = Lookup(host, resolved, ttl);
+
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    ++_misses;
+    if (ok) {
+        Store(host, resolved, ttl);
+        ip = resolved;
+    } else if ((entry = Find(host)) != nullptr && entry->ip != 0) {
+        // Resolver down: keep using the last address that worked
+        ip = IPAddress(entry->ip);
+        ++_stale;
+        ok = true;
+    } else {
+        ++_failures;
+    }
+    xSemaphoreGive(_lock);
+    return ok;
+}
+
+// Re-resolve recently used entries shortly before they expire
+void DnsCache::Refresh() {
+    if (!WiFi.isConnected()) {
+        return;
+    }
+
+    for (int i = 0; i < DNS_CACHE_SIZE; i++) {
+        char host[DNS_CACHE_HOST_LEN];
+        xSemaphoreTake(_lock, portMAX_DELAY);
+        DnsCacheEntry& entry = _entries[i];
+        unsigned long now = millis();
+        bool due = entry.host[0] && entry.expiresMs != 0 &&
+                   (long)(entry.expiresMs - now) < DNS_CACHE_REFRESH_MARGIN &&
+                   now - entry.lastUsedMs < DNS_CACHE_IDLE_MS;
+        strcpy(host, entry.host);
+        xSemaphoreGive(_lock);
+
+        if (!due) {
+            continue;
+        }
+
+        IPAddress ip;
+        uint32_t ttl;
+        if (Lookup(host, ip, ttl)) {
+            xSemaphoreTake(_lock, portMAX_DELAY);
+            Store(host, ip, ttl);
+            ++_refreshes;
+            xSemaphoreGive(_lock);
+        }
+    }
+}
+
+void DnsCache::RefreshTask(void* arg) {
+    DnsCache* self = (DnsCache*)arg;
+    for (;;) {
+        vTaskDelay(pdMS_TO_TICKS(DNS_CACHE_REFRESH_PERIOD));
+        self->Refresh();
+    }
+}
+
+uint32_t DnsCache::AvgLookupMs() {
+    if (!_lock) {
+        return 0;
+    }
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    uint32_t avg = _lookups ? (uint32_t)(_lookupMs / _lookups) : 0;
+    xSemaphoreGive(_lock);
+    return avg;
+}
+
+JsonDocument DnsCache::describe() {
+    JsonDocument doc;
+    if (!_lock) {
+        // Not started: nothing resolved yet
+        doc["hits"] = 0;
+        doc["misses"] = 0;
+        doc["entries"].to<JsonArray>();
+        return doc;
+    }
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    doc["hits"] = _hits;
+    doc["misses"] = _misses;
+    doc["stale"] = _stale;
+    doc["failures"] = _failures;
+    doc["refreshes"] = _refreshes;
+    doc["avg_lookup_ms"] = _lookups ? (uint32_t)(_lookupMs / _lookups) : 0;
+    doc["max_lookup_ms"] = _maxLookupMs;
+
+    JsonArray entries = doc["entries"].to<JsonArray>();
+    unsigned long now = millis();
+    for (int i = 0; i < DNS_CACHE_SIZE; i++) {
+        if (!_entries[i].host[0]) {
+            continue;
+        }
+        JsonObject e = entries.add<JsonObject>();
+        e["host"] = _entries[i].host;
+        e["ip"] = IPAddress(_entries[i].ip).toString();
+        long left = (long)(_entries[i].expiresMs - now);
+        e["ttl_left"] = _entries[i].expiresMs != 0 && left > 0 ? left / 1000 : 0;
+    }
+    xSemaphoreGive(_lock);
+    return doc;
+}
+
+// ===== Client =====
+
+int ResolvingClientSecure::connect(const char* host, uint16_t port) {
+    IPAddress ip;
+    if (!DnsCache::cache.Resolve(host, ip)) {
+        return 0;
+    }
+    return WiFiClientSecure::connect(ip, port, host, _CA_cert, _cert, _private_key);
+}
@@ -0,0 +1,358 @@
+#define LOG_MODULE LOG_MODULE_SENSORS
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <ArduinoJson.h>
+#include <esp_system.h>
+#include "common.h"
+#include "aws_iot.h"
+#include "event_recorder.h"
+
+#define NVM_PREFS_SECTION "recorder"
+#define NVM_ENABLED_KEY "enabled"
+#define NVM_INTERVAL_KEY "interval"
+
+EventRecorder EventRecorder::recorder;
+
+void EventRecorder::ReadNVM() {
+    Preferences prefs;
+    prefs.begin(NVM_PREFS_SECTION, true);
+    _enabled = prefs.getBool(NVM_ENABLED_KEY, false);
+    _intervalMinutes = prefs.getUShort(NVM_INTERVAL_KEY, EVENT_DEFAULT_INTERVAL);
+    prefs.end();
+    _loaded = true;
+}
+
+void EventRecorder::SaveNVM() {
+    Preferences prefs;
+    prefs.begin(NVM_PREFS_SECTION, false);
+    prefs.putBool(NVM_ENABLED_KEY, _enabled);
+    prefs.putUShort(NVM_INTERVAL_KEY, _intervalMinutes);
+    prefs.end();
+}
+
+bool EventRecorder::Enabled() {
+    if (!_loaded) {
+        ReadNVM();
+    }
+    return _enabled;
+}
+
+// Segment and queue in PSRAM when present, a smaller set in internal RAM otherwise
+bool EventRecorder::Allocate() {
+    if (_segment) {
+        return true;
+    }
+    bool psram = psramFound();
+    _segmentCap = psram ? EVENT_SEGMENT_BYTES_PSRAM : EVENT_SEGMENT_BYTES;
+    _queueCap = psram ? EVENT_QUEUE_BYTES_PSRAM : EVENT_QUEUE_BYTES;
+    size_t total = _segmentCap + _queueCap;
+    uint8_t* mem = (uint8_t*)(psram ? ps_malloc(total) : malloc(total));
+    if (!mem) {
+        logPrintf(LOG_ERROR, "Event recorder: allocation of %u bytes failed", total);
+        _enabled = false;
+        return false;
+    }
+    _segment = mem;
+    _queue = mem + _segmentCap;
+    _queueLen = 0;
+    _queued = 0;
+    _bootId = esp_random();
+    logPrintf(LOG_INFO, "Event recorder buffers: %u bytes (%s)", total, psram ? "PSRAM" : "internal");
+    return true;
+}
+
+// The snapshot lets the replay start at any segment
+void EventRecorder::StartSegment(uint32_t now) {
+    memset(&_header, 0, sizeof(_header));
+    memcpy(_header.magic, EVENT_TRACE_MAGIC, sizeof(_header.magic));
+    _header.version = EVENT_TRACE_VERSION;
+    _header.flags = (shelter.catPresent ? EVENT_FLAG_CAT_PRESENT : 0) |
+                    (shelter.blanketOn ? EVENT_FLAG_BLANKET_ON : 0) |
+                    (shelter.blanketManualOverride ? EVENT_FLAG_BLANKET_OVERRIDE : 0) |
+                    (shelter.dhtSensorWorking ? EVENT_FLAG_DHT_WORKING : 0) |
+                    (shelter.lastCatPresent ? EVENT_FLAG_LAST_CAT_PRESENT : 0) |
+                    (_pir ? EVENT_FLAG_PIR : 0) |
+                    (_wifi ? EVENT_FLAG_WIFI : 0) |
+                    (_mqtt ? EVENT_FLAG_MQTT : 0) |
+                    (cameraAvailable ? EVENT_FLAG_CAMERA : 0);
+    _header.bootId = _bootId;
+    _header.sequence = _sequence++;
+    _header.startMs = now;
+    time_t epoch = time(nullptr);
+    _header.startTime = epoch >= 100000 ? (uint32_t)epoch : 0;
+    _header.lastBlanketChange = shelter.lastBlanketChange;
+    _header.lastMotionDetected = shelter.lastMotionDetected;
+    _header.lastPhotoTime = shelter.lastPhotoTime;
+    _header.lastHourlyPhotoTime = shelter.lastHourlyPhotoTime;
+    _header.currentTemp = shelter.currentTemp;
+    _header.currentHumidity = shelter.currentHumidity;
+    _header.hour = (int8_t)getLocalHour();
+    _hour = _header.hour;
+    _writer.Begin(_segment, _segmentCap, now);
+    _open = true;
+}
+
+void EventRecorder::Seal(uint32_t now) {
+    _header.endMs = now;
+    _header.length = _writer.Bytes();
+    _header.records = _writer.Records();
+    size_t size = sizeof(_header) + _writer.Bytes();
+
+    // Oldest segments make room
+    size_t need = sizeof(uint32_t) + size;
+    while (_queued > 0 && _queueLen + need > _queueCap) {
+        uint32_t len;
+        memcpy(&len, _queue, sizeof(len));
+        size_t recordLen = sizeof(len) + len;
+        memmove(_queue, _queue + recordLen, _queueLen - recordLen);
+        _queueLen -= recordLen;
+        --_queued;
+        ++_dropped;
+        logPrint(LOG_WARNING, "Event recorder: queue full, oldest segment dropped");
+    }
+    _open = false;
+    if (_queueLen + need > _queueCap) {
+        ++_dropped;
+        return;
+    }
+
+    uint8_t* p = _queue + _queueLen;
+    uint32_t len = size;
+    memcpy(p, &len, sizeof(len));
+    memcpy(p + sizeof(len), &_header, sizeof(_header));
+    memcpy(p + sizeof(len) + sizeof(_header), _writer.Data(), _writer.Bytes());
+    _queueLen += need;
+    ++_queued;
+    ++_segments;
+    logPrintf(LOG_DEBUG, "Event recorder: segment %" PRIu32 " sealed (%" PRIu32 " records, %u bytes)",
+              _header.sequence, _header.records, size);
+}
+
+bool EventRecorder::Recording(uint32_t now) {
+    if (!_open) {
+        return false;
+    }
+    if (xTaskGetCurrentTaskHandle() != _task) {
+        ++_foreign;
+        return false;
+    }
+    if (_writer.Bytes() + EVENT_RECORD_MAX > _segmentCap) {
+        Seal(now);
+        StartSegment(now);
+    }
+    return true;
+}
+
+void EventRecorder::Recorded(bool ok) {
+    if (ok) {
+        ++_records;
+    }
+}
+
+void EventRecorder::Pir(bool level) {
+    uint32_t now = millis();
+    if (level == _pir) {
+        _pirReadMs = now;
+        return;
+    }
+    if (!Recording(now)) {
+        return;
+    }
+    // With the previous read, the replay knows the last loop that saw the old
+    // level: the presence timeout counts from the last one that saw motion
+    _pir = level;
+    Recorded(_writer.Pir(now, level, now - _pirReadMs));
+    _pirReadMs = now;
+}
+
+void EventRecorder::Dht(float temperature, float humidity) {
+    uint32_t now = millis();
+    uint8_t nan = (isnan(temperature) ? EVENT_DHT_NAN_TEMPERATURE : 0) |
+                  (isnan(humidity) ? EVENT_DHT_NAN_HUMIDITY : 0);
+    if (nan) {
+        if (nan == _dhtNan || !Recording(now)) {
+            return;
+        }
+        _dhtNan = nan;
+        Recorded(_writer.DhtFail(now, nan));
+        return;
+    }
+
+    int32_t t = eventTenths(temperature);
+    int32_t h = eventTenths(humidity);
+    if ((_dhtNan == 0 && t == _temperature && h == _humidity) || !Recording(now)) {
+        return;
+    }
+    _dhtNan = 0;
+    _temperature = t;
+    _humidity = h;
+    Recorded(_writer.Dht(now, temperature, humidity));
+}
+
+void EventRecorder::Lux(float lux) {
+    uint32_t now = millis();
+    uint32_t centi = lux > 0 ? (uint32_t)lroundf(lux * 100) : 0;
+    if (centi == _lux || !Recording(now)) {
+        return;
+    }
+    _lux = centi;
+    Recorded(_writer.Lux(now, lux));
+}
+
+void EventRecorder::Command(EventSource source, const char* text, size_t len) {
+    uint32_t now = millis();
+    if (!Recording(now)) {
+        return;
+    }
+    Recorded(_writer.Command(now, source, text, len));
+}
+
+void EventRecorder::Decision(EventDecision decision) {
+    uint32_t now = millis();
+    if (!Recording(now)) {
+        return;
+    }
+    Recorded(_writer.Decision(now, decision));
+}
+
+// Oldest segment first
+bool EventRecorder::Upload() {
+    uint32_t len;
+    memcpy(&len, _queue, sizeof(len));
+    const uint8_t* segment = _queue + sizeof(len);
+
+    if (UploadScheduler::scheduler.Admit(UPLOAD_TELEMETRY, len, 0) == UPLOAD_SKIP) {
+        _lastFailMs = millis();
+        return false;
+    }
+    EventTraceHeader header;
+    memcpy(&header, segment, sizeof(header));
+    char filename[48];
+    if (header.startTime) {
+        time_t start = (time_t)header.startTime;
+        struct tm timeinfo;
+        gmtime_r(&start, &timeinfo);
+        strftime(filename, sizeof(filename), "events_%Y%m%d_%H%M%S" EVENT_TRACE_EXTENSION, &timeinfo);
+    } else {
+        snprintf(filename, sizeof(filename), "events_%08" PRIx32 "_%05" PRIu32 EVENT_TRACE_EXTENSION, header.bootId, header.sequence);
+    }
+    if (!uploadBufferToS3(segment, len, filename, String(s3Folder), "application/octet-stream")) {
+        ++_failed;
+        _lastFailMs = millis();
+        logPrint(LOG_WARNING, "Event segment upload failed");
+        return false;
+    }
+    UploadScheduler::scheduler.Consume(UPLOAD_TELEMETRY, len);
+
+    size_t recordLen = sizeof(len) + len;
+    memmove(_queue, _queue + recordLen, _queueLen - recordLen);
+    _queueLen -= recordLen;
+    --_queued;
+    ++_uploaded;
+    _lastFailMs = 0;
+    return true;
+}
+
+void EventRecorder::Loop() {
+    uint32_t now = millis();
+    if (Enabled() && Allocate()) {
+        if (!_open) {
+            _task = xTaskGetCurrentTaskHandle();
+            StartSegment(now);
+        } else if (now - _lastLoopMs >= EVENT_STALL_MS && Recording(now)) {
+            Recorded(_writer.Stall(now, now - _lastLoopMs));
+        }
+        _lastLoopMs = now;
+
+        bool wifi = IsWiFiConnected();
+        if (wifi != _wifi && Recording(now)) {
+            _wifi = wifi;
+            Recorded(_writer.Event(wifi ? EVENT_WIFI_UP : EVENT_WIFI_DOWN, now));
+        }
+        bool mqtt = isIotConnected();
+        if (mqtt != _mqtt && Recording(now)) {
+            _mqtt = mqtt;
+            Recorded(_writer.Event(mqtt ? EVENT_MQTT_UP : EVENT_MQTT_DOWN, now));
+        }
+
+        // The hour the temperature fallback uses, checked once a minute
+        time_t epoch = time(nullptr);
+        if (epoch >= 100000 && (uint32_t)epoch / 60 != _clockMinute) {
+            _clockMinute = (uint32_t)epoch / 60;
+            int hour = getLocalHour();
+            if (hour != _hour && Recording(now)) {
+                _hour = (int8_t)hour;
+                Recorded(_writer.Clock(now, (uint32_t)epoch, hour));
+            }
+        }
+
+        if (now - _header.startMs >= _intervalMinutes * 60000UL) {
+            Seal(now);
+            StartSegment(now);
+        }
+    }
+
+    if (_queued == 0 || !IsWiFiConnected()) {
+        return;
+    }
+    if (_lastFailMs != 0 && millis() - _lastFailMs < EVENT_RETRY_INTERVAL) {
+        return;
+    }
+    Upload();
+}
+
+void EventRecorder::Configure(const JsonDocument& doc) {
+    Enabled();
+    bool changed = false;
+    if (doc["enabled"].is<bool>()) {
+        _enabled = doc["enabled"].as<bool>();
+        changed = true;
+    }
+    if (doc["interval_minutes"].is<int>()) {
+        _intervalMinutes = constrain(doc["interval_minutes"].as<int>(), 1, EVENT_MAX_INTERVAL);
+        changed = true;
+    }
+    if (changed) {
+        SaveNVM();
+        logPrintf(LOG_INFO, "Event recorder %s, %u min segments", _enabled ? "enabled" : "disabled",
+                  _intervalMinutes);
+    }
+    // Disabling seals what was recorded so far; the queue still goes out
+    bool flush = doc["flush"] | false;
+    if (_open && (flush || !_enabled)) {
+        Seal(millis());
+        if (_enabled) {
+            StartSegment(millis());
+        }
+        _lastFailMs = 0;
+    }
+}
+
+JsonDocument EventRecorder::describe() {
+    JsonDocument doc;
+    doc["enabled"] = Enabled();
+    doc["interval_minutes"] = _intervalMinutes;
+    doc["segment_bytes"] = _segmentCap;
+    doc["queue_bytes"] = _queueCap;
+    doc["queue_used"] = _queueLen;
+    doc["queued"] = _queued;
+    doc["records"] = _records;
+    doc["segments"] = _segments;
+    doc["uploaded"] = _uploaded;
+    doc["dropped"] = _dropped;
+    doc["failed"] = _failed;
+    doc["foreign_task_calls"] = _foreign;
+    if (_segment) {
+        char bootId[9];
+        snprintf(bootId, sizeof(bootId), "%08" PRIx32, _bootId);
+        doc["boot_id"] = bootId;
+    }
+    if (_open) {
+        JsonObject pending = doc["pending"].to<JsonObject>();
+        pending["sequence"] = _header.sequence;
+        pending["records"] = _writer.Records();
+        pending["bytes"] = _writer.Bytes();
+    }
+    return doc;
+}
@@ -0,0 +1,224 @@
+#include <math.h>
+#include <string.h>
+#include "event_trace.h"
+
+int32_t eventTenths(float value) {
+    return (int32_t)lroundf(value * 10);
+}
+
+float eventFromTenths(int32_t tenths) {
+    // Magnitude times 0.1, sign last: bit for bit what DHT::readTemperature() returns
+    float f = tenths < 0 ? -tenths : tenths;
+    f *= 0.1;
+    return tenths < 0 ? -f : f;
+}
+
+static inline uint32_t zigzag(int32_t value) {
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static inline int32_t unzigzag(uint32_t value) {
+    return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+// ===== Writer =====
+
+void EventTraceWriter::Begin(uint8_t* buf, size_t cap, uint32_t startMs) {
+    _buf = buf;
+    _cap = cap;
+    _len = 0;
+    _lastMs = startMs;
+    _records = 0;
+}
+
+void EventTraceWriter::Start(EventType type, uint32_t ms) {
+    _recordLen = 0;
+    Byte((uint8_t)type);
+    Varint(ms - _lastMs);
+}
+
+void EventTraceWriter::Byte(uint8_t value) {
+    if (_recordLen < sizeof(_record)) {
+        _record[_recordLen++] = value;
+    }
+}
+
+void EventTraceWriter::Varint(uint32_t value) {
+    while (value >= 0x80) {
+        Byte((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    Byte((uint8_t)value);
+}
+
+bool EventTraceWriter::Commit(uint32_t ms) {
+    if (_len + _recordLen > _cap) {
+        return false;
+    }
+    memcpy(_buf + _len, _record, _recordLen);
+    _len += _recordLen;
+    _lastMs = ms;
+    ++_records;
+    return true;
+}
+
+bool EventTraceWriter::Event(EventType type, uint32_t ms) {
+    Start(type, ms);
+    return Commit(ms);
+}
+
+bool EventTraceWriter::Pir(uint32_t ms, bool level, uint32_t sinceOtherMs) {
+    Start(level ? EVENT_PIR_HIGH : EVENT_PIR_LOW, ms);
+    Varint(sinceOtherMs);
+    return Commit(ms);
+}
+
+bool EventTraceWriter::Dht(uint32_t ms, float temperature, float humidity) {
+    Start(EVENT_DHT, ms);
+    Varint(zigzag(eventTenths(temperature)));
+    Varint((uint32_t)eventTenths(humidity));
+    return Commit(ms);
+}
+
+bool EventTraceWriter::DhtFail(uint32_t ms, uint8_t nanBits) {
+    Start(EVENT_DHT_FAIL, ms);
+    Byte(nanBits);
+    return Commit(ms);
+}
+
+bool EventTraceWriter::Lux(uint32_t ms, float lux) {
+    Start(EVENT_LUX, ms);
+    Varint(lux > 0 ? (uint32_t)lroundf(lux * 100) : 0);
+    return Commit(ms);
+}
+
+bool EventTraceWriter::Command(uint32_t ms, EventSource source, const char* text, size_t len) {
+    if (len > EVENT_COMMAND_MAX) {
+        len = EVENT_COMMAND_MAX;
+    }
+    Start(EVENT_COMMAND, ms);
+    Byte((uint8_t)source);
+    Varint((uint32_t)len);
+    for (size_t i = 0; i < len; i++) {
+        Byte((uint8_t)text[i]);
+    }
+    return Commit(ms);
+}
+
+bool EventTraceWriter::Clock(uint32_t ms, uint32_t epoch, int hour) {
+    Start(EVENT_CLOCK, ms);
+    Varint(epoch);
+    Byte(hour < 0 ? 0xff : (uint8_t)hour);
+    return Commit(ms);
+}
+
+bool EventTraceWriter::Stall(uint32_t ms, uint32_t gapMs) {
+    Start(EVENT_STALL, ms);
+    Varint(gapMs);
+    return Commit(ms);
+}
+
+bool EventTraceWriter::Decision(uint32_t ms, EventDecision decision) {
+    Start(EVENT_DECISION, ms);
+    Byte((uint8_t)decision);
+    return Commit(ms);
+}
+
+// ===== Reader =====
+
+void EventTraceReader::Begin(const uint8_t* buf, size_t len, uint32_t startMs) {
+    _buf = buf;
+    _len = len;
+    _pos = 0;
+    _ms = startMs;
+    _corrupt = false;
+}
+
+bool EventTraceReader::Byte(uint8_t& value) {
+    if (_pos >= _len) {
+        return false;
+    }
+    value = _buf[_pos++];
+    return true;
+}
+
+bool EventTraceReader::Varint(uint32_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        uint8_t b;
+        if (!Byte(b)) {
+            return false;
+        }
+        value |= (uint32_t)(b & 0x7f) << shift;
+        if (!(b & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool EventTraceReader::Next(EventRecord& record) {
+    if (_pos >= _len || _corrupt) {
+        return false;
+    }
+    memset(&record, 0, sizeof(record));
+    record.hour = -1;
+
+    uint8_t type;
+    uint32_t delta;
+    bool ok = Byte(type) && Varint(delta);
+    if (ok) {
+        _ms += delta;
+        record.type = type;
+        record.ms = _ms;
+    }
+
+    uint32_t a = 0, b = 0;
+    uint8_t byte = 0;
+    switch (ok ? type : 0) {
+        case EVENT_WIFI_DOWN:
+        case EVENT_WIFI_UP:
+        case EVENT_MQTT_DOWN:
+        case EVENT_MQTT_UP:
+            break;
+        case EVENT_DHT:
+            ok = Varint(a) && Varint(b);
+            record.temperature = eventFromTenths(unzigzag(a));
+            record.humidity = eventFromTenths((int32_t)b);
+            break;
+        case EVENT_LUX:
+            ok = Varint(a);
+            record.lux = a / 100.0f;
+            break;
+        case EVENT_DHT_FAIL:
+        case EVENT_DECISION:
+            ok = Byte(byte);
+            record.value = byte;
+            break;
+        case EVENT_COMMAND:
+            ok = Byte(byte) && Varint(a) && a <= EVENT_COMMAND_MAX && _pos + a <= _len;
+            if (ok) {
+                record.value = byte;
+                record.text = (const char*)_buf + _pos;
+                record.textLength = (uint16_t)a;
+                _pos += a;
+            }
+            break;
+        case EVENT_CLOCK:
+            ok = Varint(a) && Byte(byte);
+            record.value = a;
+            record.hour = byte < 24 ? (int8_t)byte : -1;
+            break;
+        case EVENT_PIR_LOW:
+        case EVENT_PIR_HIGH:
+        case EVENT_STALL:
+            ok = Varint(a);
+            record.value = a;
+            break;
+        default:
+            ok = false;
+            break;
+    }
+    _corrupt = !ok;
+    return ok;
+}
@@ -0,0 +1,193 @@
+#include <string.h>
+#include "gorilla.h"
+
+// Delta-of-delta buckets: control bits, value bits
+//   0                 dod == 0
+//   10   + 7 bits     -63..64
+//   110  + 9 bits     -255..256
+//   1110 + 12 bits    -2047..2048
+//   1111 + 32 bits    anything else
+
+static inline uint32_t floatBits(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static inline float bitsFloat(uint32_t bits) {
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+void GorillaWriter::Begin(uint8_t* buf, size_t cap) {
+    _buf = buf;
+    _cap = cap;
+    _bits = 0;
+    _count = 0;
+    _prevDelta = 0;
+    _leading = 0xff;
+    _trailing = 0;
+    memset(_buf, 0, _cap);
+}
+
+// MSB first; the buffer is zeroed by Begin()
+void GorillaWriter::Bits(uint32_t value, int n) {
+    for (int i = n - 1; i >= 0; i--) {
+        if ((value >> i) & 1) {
+            _buf[_bits >> 3] |= 0x80 >> (_bits & 7);
+        }
+        ++_bits;
+    }
+}
+
+bool GorillaWriter::Append(uint32_t time, float value) {
+    if (_count == UINT16_MAX || _bits + GORILLA_MAX_SAMPLE_BITS > _cap * 8) {
+        return false;
+    }
+    uint32_t bits = floatBits(value);
+
+    if (_count == 0) {
+        Bits(time, 32);
+        Bits(bits, 32);
+        _prevTime = time;
+        _prevValue = bits;
+        ++_count;
+        return true;
+    }
+
+    int32_t delta = (int32_t)(time - _prevTime);
+    int32_t dod = delta - _prevDelta;
+    if (dod == 0) {
+        Bits(0, 1);
+    } else if (dod >= -63 && dod <= 64) {
+        Bits(0b10, 2);
+        Bits((uint32_t)(dod + 63), 7);
+    } else if (dod >= -255 && dod <= 256) {
+        Bits(0b110, 3);
+        Bits((uint32_t)(dod + 255), 9);
+    } else if (dod >= -2047 && dod <= 2048) {
+        Bits(0b1110, 4);
+        Bits((uint32_t)(dod + 2047), 12);
+    } else {
+        Bits(0b1111, 4);
+        Bits((uint32_t)dod, 32);
+    }
+    _prevDelta = delta;
+    _prevTime = time;
+
+    uint32_t x = bits ^ _prevValue;
+    _prevValue = bits;
+    if (x == 0) {
+        Bits(0, 1);
+    } else {
+        uint8_t leading = __builtin_clz(x);
+        uint8_t trailing = __builtin_ctz(x);
+        if (leading > 31) {
+            leading = 31;
+        }
+        if (_leading != 0xff && leading >= _leading && trailing >= _trailing) {
+            // Fits the previous window
+            Bits(0b10, 2);
+            Bits(x >> _trailing, 32 - _leading - _trailing);
+        } else {
+            int significant = 32 - leading - trailing;
+            Bits(0b11, 2);
+            Bits(leading, 5);
+            Bits(significant - 1, 5);
+            Bits(x >> trailing, significant);
+            _leading = leading;
+            _trailing = trailing;
+        }
+    }
+    ++_count;
+    return true;
+}
+
+float GorillaWriter::LastValue() const {
+    return bitsFloat(_prevValue);
+}
+
+void GorillaReader::Begin(const uint8_t* buf, size_t len, uint16_t count) {
+    _buf = buf;
+    _len = len;
+    _pos = 0;
+    _remaining = count;
+    _first = true;
+    _prevDelta = 0;
+}
+
+bool GorillaReader::Bits(int n, uint32_t& value) {
+    if (_pos + n > _len * 8) {
+        return false;
+    }
+    value = 0;
+    for (int i = 0; i < n; i++) {
+        value = (value << 1) | ((_buf[_pos >> 3] >> (7 - (_pos & 7))) & 1);
+        ++_pos;
+    }
+    return true;
+}
+
+bool GorillaReader::Next(uint32_t& time, float& value) {
+    if (_remaining == 0) {
+        return false;
+    }
+    uint32_t v;
+    if (_first) {
+        if (!Bits(32, _prevTime) || !Bits(32, _prevValue)) {
+            return false;
+        }
+        _first = false;
+    } else {
+        // Delta-of-delta bucket: count leading 1 bits, up to 4
+        int ones = 0;
+        while (ones < 4) {
+            if (!Bits(1, v)) {
+                return false;
+            }
+            if (!v) {
+                break;
+            }
+            ++ones;
+        }
+        int32_t dod = 0;
+        static const int WIDTH[] = {0, 7, 9, 12, 32};
+        static const int32_t BIAS[] = {0, 63, 255, 2047, 0};
+        if (ones > 0) {
+            if (!Bits(WIDTH[ones], v)) {
+                return false;
+            }
+            dod = (int32_t)v - BIAS[ones];
+        }
+        _prevDelta += dod;
+        _prevTime += (uint32_t)_prevDelta;
+
+        if (!Bits(1, v)) {
+            return false;
+        }
+        if (v) {
+            uint32_t control;
+            if (!Bits(1, control)) {
+                return false;
+            }
+            if (control) {
+                uint32_t leading, significant;
+                if (!Bits(5, leading) || !Bits(5, significant)) {
+                    return false;
+                }
+                _leading = leading;
+                _trailing = 32 - leading - (significant + 1);
+            }
+            uint32_t x;
+            if (!Bits(32 - _leading - _trailing, x)) {
+                return false;
+            }
+            _prevValue ^= x << _trailing;
+        }
+    }
+    --_remaining;
+    time = _prevTime;
+    value = bitsFloat(_prevValue);
+    return true;
+}
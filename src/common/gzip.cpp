@@ -0,0 +1,207 @@
+#include <stdlib.h>
+#include <string.h>
+#include "gzip.h"
+
+#define GZIP_MIN_MATCH 3
+#define GZIP_MAX_MATCH 258
+
+// Length codes 257..285: base length and extra bits
+static const uint16_t LENGTH_BASE[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const uint8_t LENGTH_EXTRA[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+
+// Distance codes 0..29: base distance and extra bits
+static const uint16_t DIST_BASE[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const uint8_t DIST_EXTRA[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+uint32_t crc32Update(uint32_t crc, const uint8_t* data, size_t len) {
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int k = 0; k < 8; k++) {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+size_t gzipBound(size_t len) {
+    // 10 byte header, 3 bit block header, 9 bits per literal, 7 bit end code, 8 byte trailer
+    return 10 + (len * 9 + 3 + 7 + 7) / 8 + 8;
+}
+
+namespace {
+
+// LSB-first bit writer; Huffman codes are reversed before being written
+struct BitWriter {
+    uint8_t* out;
+    size_t cap;
+    size_t pos;
+    uint32_t bits;
+    int count;
+    bool overflow;
+
+    void Put(uint32_t value, int n) {
+        bits |= value << count;
+        count += n;
+        while (count >= 8) {
+            if (pos < cap) {
+                out[pos++] = bits & 0xff;
+            } else {
+                overflow = true;
+            }
+            bits >>= 8;
+            count -= 8;
+        }
+    }
+
+    void PutCode(uint32_t code, int n) {
+        uint32_t reversed = 0;
+        for (int i = 0; i < n; i++) {
+            reversed = (reversed << 1) | ((code >> i) & 1);
+        }
+        Put(reversed, n);
+    }
+
+    void Flush() {
+        if (count > 0) {
+            Put(0, 8 - count);
+        }
+    }
+};
+
+// Fixed literal/length code (RFC 1951 3.2.6)
+void putSymbol(BitWriter& w, int symbol) {
+    if (symbol < 144) {
+        w.PutCode(0x30 + symbol, 8);
+    } else if (symbol < 256) {
+        w.PutCode(0x190 + symbol - 144, 9);
+    } else if (symbol < 280) {
+        w.PutCode(symbol - 256, 7);
+    } else {
+        w.PutCode(0xc0 + symbol - 280, 8);
+    }
+}
+
+void putMatch(BitWriter& w, int length, int distance) {
+    int code = 28;
+    while (LENGTH_BASE[code] > length) {
+        --code;
+    }
+    putSymbol(w, 257 + code);
+    w.Put(length - LENGTH_BASE[code], LENGTH_EXTRA[code]);
+
+    code = 29;
+    while (DIST_BASE[code] > distance) {
+        --code;
+    }
+    w.PutCode(code, 5);
+    w.Put(distance - DIST_BASE[code], DIST_EXTRA[code]);
+}
+
+inline uint32_t hash3(const uint8_t* p) {
+    uint32_t v = p[0] | (p[1] << 8) | (p[2] << 16);
+    return (v * 2654435761u) >> (32 - GZIP_HASH_BITS);
+}
+
+}  // namespace
+
+size_t gzipCompress(const uint8_t* src, size_t len, uint8_t* dst, size_t cap) {
+    static const uint8_t header[10] = {0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 0xff};
+    if (cap < sizeof(header) + 8) {
+        return 0;
+    }
+    memcpy(dst, header, sizeof(header));
+
+    // Last position + 1 seen for each hash, 0 = empty. On the heap: task stacks are 8 KB.
+    uint32_t* head = (uint32_t*)calloc(1 << GZIP_HASH_BITS, sizeof(uint32_t));
+    if (!head) {
+        return 0;
+    }
+
+    BitWriter w = {dst, cap - 8, sizeof(header), 0, 0, false};
+    w.Put(1, 1);   // BFINAL
+    w.Put(1, 2);   // BTYPE = fixed Huffman
+
+    size_t i = 0;
+    while (i < len && !w.overflow) {
+        int bestLen = 0;
+        size_t bestDist = 0;
+        if (i + GZIP_MIN_MATCH <= len) {
+            uint32_t h = hash3(src + i);
+            uint32_t candidate = head[h];
+            head[h] = i + 1;
+            if (candidate > 0 && i - (candidate - 1) <= GZIP_WINDOW_SIZE) {
+                size_t from = candidate - 1;
+                size_t limit = len - i < GZIP_MAX_MATCH ? len - i : GZIP_MAX_MATCH;
+                size_t n = 0;
+                while (n < limit && src[from + n] == src[i + n]) {
+                    ++n;
+                }
+                if (n >= GZIP_MIN_MATCH) {
+                    bestLen = n;
+                    bestDist = i - from;
+                }
+            }
+        }
+
+        if (bestLen > 0) {
+            putMatch(w, bestLen, bestDist);
+            // Index the skipped positions so later matches can find them
+            size_t end = i + bestLen;
+            for (++i; i < end && i + GZIP_MIN_MATCH <= len; ++i) {
+                head[hash3(src + i)] = i + 1;
+            }
+            i = end;
+        } else {
+            putSymbol(w, src[i]);
+            ++i;
+        }
+    }
+
+    free(head);
+    putSymbol(w, 256);   // end of block
+    w.Flush();
+    if (w.overflow) {
+        return 0;
+    }
+
+    uint32_t crc = crc32Update(0, src, len);
+    uint8_t* trailer = dst + w.pos;
+    for (int k = 0; k < 4; k++) {
+        trailer[k] = (crc >> (8 * k)) & 0xff;
+        trailer[4 + k] = ((uint32_t)len >> (8 * k)) & 0xff;
+    }
+    return w.pos + 8;
+}
+
+size_t jsonMinify(char* json, size_t len) {
+    size_t out = 0;
+    bool inString = false;
+    bool escaped = false;
+    for (size_t i = 0; i < len; i++) {
+        char c = json[i];
+        if (inString) {
+            if (escaped) {
+                escaped = false;
+            } else if (c == '\\') {
+                escaped = true;
+            } else if (c == '"') {
+                inString = false;
+            }
+        } else if (c == '"') {
+            inString = true;
+        } else if (c == ' ' || c == '\n' || c == '\r' || c == '\t') {
+            continue;
+        }
+        json[out++] = c;
+    }
+    return out;
+}
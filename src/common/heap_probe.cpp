@@ -0,0 +1,148 @@
+#include "heap_probe.h"
+
+HeapSite* HeapSite::_head = nullptr;
+
+std::atomic<void*> HeapProbe::_threads[HEAP_PROBE_THREADS];
+HeapSite* HeapProbe::_sites[HEAP_PROBE_THREADS];
+HeapProbe::Block HeapProbe::_blocks[HEAP_PROBE_BLOCKS];
+std::atomic<uint32_t> HeapProbe::_open{0};
+std::atomic<uint32_t> HeapProbe::_charged{0};
+std::atomic<uint32_t> HeapProbe::_overflows{0};
+
+HeapSite heapSiteOther("other");
+
+HeapSite::HeapSite(const char* name) : _next(_head), _name(name) {
+    // Static initialization runs on one thread before any task starts
+    _head = this;
+}
+
+template <typename T>
+static void raiseMax(std::atomic<T>& max, T value) {
+    T current = max.load(std::memory_order_relaxed);
+    while (value > current && !max.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+void HeapSite::Alloc(size_t size) {
+    _allocs.fetch_add(1, std::memory_order_relaxed);
+    _allocBytes.fetch_add((uint32_t)size, std::memory_order_relaxed);
+    int32_t live = _live.fetch_add((int32_t)size, std::memory_order_relaxed) + (int32_t)size;
+    raiseMax(_peakLive, live);
+    raiseMax(_largest, (uint32_t)size);
+}
+
+void HeapSite::Free(size_t size) {
+    _frees.fetch_add(1, std::memory_order_relaxed);
+    _freeBytes.fetch_add((uint32_t)size, std::memory_order_relaxed);
+    _live.fetch_sub((int32_t)size, std::memory_order_relaxed);
+}
+
+void HeapSite::Failed(size_t size) {
+    _failures.fetch_add(1, std::memory_order_relaxed);
+    raiseMax(_largest, (uint32_t)size);
+}
+
+void HeapSite::Reset() {
+    _entries.store(0, std::memory_order_relaxed);
+    _allocs.store(0, std::memory_order_relaxed);
+    _frees.store(0, std::memory_order_relaxed);
+    _failures.store(0, std::memory_order_relaxed);
+    _allocBytes.store(0, std::memory_order_relaxed);
+    _freeBytes.store(0, std::memory_order_relaxed);
+    _peakLive.store(_live.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    _largest.store(0, std::memory_order_relaxed);
+}
+
+// A thread keeps one slot while it has any probe open; nested probes only
+// swap the site in it. Other threads never read a slot's site, they only
+// compare the thread id, so the site needs no synchronization.
+HeapProbe::HeapProbe(HeapSite& site, void* thread) : _slot(-1), _previous(nullptr) {
+    site.Enter();
+    for (int i = 0; i < HEAP_PROBE_THREADS; i++) {
+        if (_threads[i].load(std::memory_order_relaxed) == thread) {
+            _slot = i;
+            break;
+        }
+    }
+    if (_slot < 0) {
+        for (int i = 0; i < HEAP_PROBE_THREADS && _slot < 0; i++) {
+            void* expected = nullptr;
+            if (_threads[i].compare_exchange_strong(expected, thread, std::memory_order_acquire)) {
+                _slot = i;
+                _sites[i] = nullptr;
+            }
+        }
+        if (_slot < 0) {
+            _overflows.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        _open.fetch_add(1, std::memory_order_relaxed);
+    }
+    _previous = _sites[_slot];
+    _sites[_slot] = &site;
+}
+
+HeapProbe::~HeapProbe() {
+    if (_slot < 0) {
+        return;
+    }
+    _sites[_slot] = _previous;
+    if (!_previous) {
+        _threads[_slot].store(nullptr, std::memory_order_release);
+        _open.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+HeapSite* HeapProbe::Current(void* thread) {
+    if (_open.load(std::memory_order_relaxed) == 0) {
+        return nullptr;
+    }
+    for (int i = 0; i < HEAP_PROBE_THREADS; i++) {
+        if (_threads[i].load(std::memory_order_relaxed) == thread) {
+            return _sites[i];
+        }
+    }
+    return nullptr;
+}
+
+static inline uint32_t blockHash(void* ptr) {
+    return ((uint32_t)((uintptr_t)ptr >> 3) * 2654435761u >> 16) % HEAP_PROBE_BLOCKS;
+}
+
+// A block is looked for in the HEAP_PROBE_SPAN slots from its hash on, so a
+// lookup is bounded and a removal only clears its slot. A block is in the table
+// while its memory is allocated, so the same pointer is never in it twice.
+void HeapProbe::Charge(HeapSite& site, void* ptr, size_t size) {
+    uint32_t first = blockHash(ptr);
+    for (uint32_t i = 0; i < HEAP_PROBE_SPAN; i++) {
+        Block& block = _blocks[(first + i) % HEAP_PROBE_BLOCKS];
+        void* expected = nullptr;
+        if (block.ptr.load(std::memory_order_relaxed) == nullptr &&
+            block.ptr.compare_exchange_strong(expected, ptr, std::memory_order_acquire)) {
+            block.site = &site;
+            block.size = (uint32_t)size;
+            _charged.fetch_add(1, std::memory_order_relaxed);
+            site.Alloc(size);
+            return;
+        }
+    }
+    _overflows.fetch_add(1, std::memory_order_relaxed);
+}
+
+HeapSite* HeapProbe::Release(void* ptr) {
+    if (_charged.load(std::memory_order_relaxed) == 0) {
+        return nullptr;
+    }
+    uint32_t first = blockHash(ptr);
+    for (uint32_t i = 0; i < HEAP_PROBE_SPAN; i++) {
+        Block& block = _blocks[(first + i) % HEAP_PROBE_BLOCKS];
+        if (block.ptr.load(std::memory_order_relaxed) == ptr) {
+            HeapSite* site = block.site;
+            site->Free(block.size);
+            block.ptr.store(nullptr, std::memory_order_release);
+            _charged.fetch_sub(1, std::memory_order_relaxed);
+            return site;
+        }
+    }
+    return nullptr;
+}
@@ -0,0 +1,216 @@
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <esp_heap_caps.h>
+#include "common.h"
+#include "heap_profile.h"
+
+HeapProfile HeapProfile::profile;
+
+HeapSite heapSiteHttpUpload("http.upload");
+HeapSite heapSiteHttpd("httpd");
+HeapSite heapSiteStatusJson("json.status");
+HeapSite heapSiteMqttPublish("mqtt.publish");
+HeapSite heapSiteMqttCommand("mqtt.command");
+HeapSite heapSitePhoto("photo");
+
+// ===== Allocator wrappers =====
+// Only in the profiling build (HEAP_PROBES, with -Wl,--wrap). Sizes are the
+// usable size of the block, kept with it until its free. Nothing in here may
+// allocate or log.
+
+#ifdef HEAP_PROBES
+static inline void* allocated(void* ptr, size_t size) {
+    HeapSite* site = HeapProbe::Current(xTaskGetCurrentTaskHandle());
+    if (!site) {
+        return ptr;
+    }
+    if (ptr) {
+        HeapProbe::Charge(*site, ptr, heap_caps_get_allocated_size(ptr));
+    } else if (size) {
+        site->Failed(size);
+    }
+    return ptr;
+}
+
+// The old block is released before the allocator can hand it to another task
+static inline void* reallocated(void* (*real)(void*, size_t), void* ptr, size_t size) {
+    HeapSite* previous = ptr ? HeapProbe::Release(ptr) : nullptr;
+    void* p = real(ptr, size);
+    HeapSite* site = HeapProbe::Current(xTaskGetCurrentTaskHandle());
+    if (!site) {
+        // Outside probes a grown block stays with the site that allocated it
+        site = previous;
+    }
+    if (!p && size) {
+        // Failed: the old block is still there
+        if (previous) {
+            HeapProbe::Charge(*previous, ptr, heap_caps_get_allocated_size(ptr));
+        }
+        if (site) {
+            site->Failed(size);
+        }
+    } else if (p && site) {
+        HeapProbe::Charge(*site, p, heap_caps_get_allocated_size(p));
+    }
+    return p;
+}
+
+extern "C" {
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t n, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+void __real_free(void* ptr);
+void* __real_ps_malloc(size_t size);
+void* __real_ps_calloc(size_t n, size_t size);
+void* __real_ps_realloc(void* ptr, size_t size);
+
+void* __wrap_malloc(size_t size) {
+    if (!HeapProbe::Open()) {
+        return __real_malloc(size);
+    }
+    return allocated(__real_malloc(size), size);
+}
+
+void* __wrap_calloc(size_t n, size_t size) {
+    if (!HeapProbe::Open()) {
+        return __real_calloc(n, size);
+    }
+    return allocated(__real_calloc(n, size), n * size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+    if (!HeapProbe::Open()) {
+        return __real_realloc(ptr, size);
+    }
+    return reallocated(__real_realloc, ptr, size);
+}
+
+void __wrap_free(void* ptr) {
+    if (!HeapProbe::Open()) {
+        __real_free(ptr);
+        return;
+    }
+    if (ptr) {
+        HeapProbe::Release(ptr);
+    }
+    __real_free(ptr);
+}
+
+void* __wrap_ps_malloc(size_t size) {
+    if (!HeapProbe::Open()) {
+        return __real_ps_malloc(size);
+    }
+    return allocated(__real_ps_malloc(size), size);
+}
+
+void* __wrap_ps_calloc(size_t n, size_t size) {
+    if (!HeapProbe::Open()) {
+        return __real_ps_calloc(n, size);
+    }
+    return allocated(__real_ps_calloc(n, size), n * size);
+}
+
+void* __wrap_ps_realloc(void* ptr, size_t size) {
+    if (!HeapProbe::Open()) {
+        return __real_ps_realloc(ptr, size);
+    }
+    return reallocated(__real_ps_realloc, ptr, size);
+}
+}
+#endif
+
+// ===== Fragmentation =====
+
+HeapRegion HeapProfile::Region(uint32_t caps) {
+    HeapRegion region;
+    region.size = heap_caps_get_total_size(caps);
+    region.free = heap_caps_get_free_size(caps);
+    region.minFree = heap_caps_get_minimum_free_size(caps);
+    region.largest = heap_caps_get_largest_free_block(caps);
+    return region;
+}
+
+HeapRegion HeapProfile::Internal() {
+    return Region(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+}
+
+HeapRegion HeapProfile::Psram() {
+    return psramFound() ? Region(MALLOC_CAP_SPIRAM) : HeapRegion{};
+}
+
+void HeapProfile::Sample() {
+    _internal = Internal();
+    _psram = Psram();
+    ++_samples;
+    if (_internal.largest < _lowestLargest) {
+        _lowestLargest = _internal.largest;
+    }
+    if (psramFound() && _psram.largest < _lowestLargestPsram) {
+        _lowestLargestPsram = _psram.largest;
+    }
+
+    bool low = _internal.largest < HEAP_LARGEST_BLOCK_WARN;
+    if (low && !_lowBlock) {
+        logPrintf(LOG_WARNING, "Heap fragmented: largest free block %u of %u free bytes (%u%%)",
+                  _internal.largest, _internal.free, _internal.Fragmentation());
+    } else if (!low && _lowBlock) {
+        logPrintf(LOG_INFO, "Heap recovered: largest free block %u bytes", _internal.largest);
+    }
+    _lowBlock = low;
+}
+
+void HeapProfile::Loop() {
+    unsigned long now = millis();
+    if (_samples == 0 || now - _lastSampleMs >= HEAP_SAMPLE_INTERVAL) {
+        _lastSampleMs = now;
+        Sample();
+    }
+}
+
+void HeapProfile::Configure(const JsonDocument& doc) {
+    if (doc["reset"] | false) {
+        for (HeapSite* site = HeapSite::First(); site; site = site->Next()) {
+            site->Reset();
+        }
+        _lowestLargest = UINT32_MAX;
+        _lowestLargestPsram = UINT32_MAX;
+    }
+    Sample();
+}
+
+static void describeRegion(JsonObject out, const HeapRegion& region, uint32_t lowestLargest) {
+    out["size_bytes"] = region.size;
+    out["free_bytes"] = region.free;
+    out["min_free_bytes"] = region.minFree;
+    out["largest_block_bytes"] = region.largest;
+    out["lowest_largest_block_bytes"] = lowestLargest == UINT32_MAX ? region.largest : lowestLargest;
+    out["fragmentation_percent"] = region.Fragmentation();
+}
+
+JsonDocument HeapProfile::describe() {
+    JsonDocument doc;
+    doc["samples"] = _samples;
+    describeRegion(doc["internal"].to<JsonObject>(), _internal, _lowestLargest);
+    if (psramFound()) {
+        describeRegion(doc["psram"].to<JsonObject>(), _psram, _lowestLargestPsram);
+    }
+#ifdef HEAP_PROBES
+    JsonArray sites = doc["sites"].to<JsonArray>();
+    for (HeapSite* site = HeapSite::First(); site; site = site->Next()) {
+        JsonObject s = sites.add<JsonObject>();
+        s["name"] = site->Name();
+        s["entries"] = site->Entries();
+        s["allocs"] = site->Allocs();
+        s["frees"] = site->Frees();
+        s["failures"] = site->Failures();
+        s["alloc_bytes"] = site->AllocBytes();
+        s["free_bytes"] = site->FreeBytes();
+        s["live_bytes"] = site->Live();
+        s["peak_live_bytes"] = site->PeakLive();
+        s["largest_bytes"] = site->Largest();
+    }
+    doc["charged_blocks"] = HeapProbe::Charged();
+    doc["probe_overflows"] = HeapProbe::Overflows();
+#endif
+    return doc;
+}
@@ -0,0 +1,277 @@
+#include <Arduino.h>
+#include <Preferences.h>
+#include <ArduinoJson.h>
+#include <esp_partition.h>
+#include <esp_system.h>
+#include "common.h"
+#include "gzip.h"
+#include "metrics.h"
+#include "trace.h"
+#include "journal.h"
+
+#define NVM_PREFS_SECTION "journal"
+#define NVM_UPLOADED_KEY "uploaded"
+
+#define JOURNAL_LOCK_TIMEOUT 100      // ms; a record that cannot get the lock is skipped
+
+Journal Journal::journal;
+
+class PartitionFlash : public JournalFlash {
+    const esp_partition_t* _partition = nullptr;
+
+public:
+    void Attach(const esp_partition_t* partition) { _partition = partition; }
+
+    bool Read(uint32_t offset, void* buf, size_t len) override {
+        return esp_partition_read(_partition, offset, buf, len) == ESP_OK;
+    }
+    bool Write(uint32_t offset, const void* buf, size_t len) override {
+        return esp_partition_write(_partition, offset, buf, len) == ESP_OK;
+    }
+    bool EraseSector(uint32_t offset) override {
+        return esp_partition_erase_range(_partition, offset, JOURNAL_SECTOR_SIZE) == ESP_OK;
+    }
+    uint32_t Size() const override { return _partition->size; }
+};
+
+static PartitionFlash partitionFlash;
+
+void Journal::ReadNVM() {
+    Preferences prefs;
+    prefs.begin(NVM_PREFS_SECTION, true);
+    _uploadedBoot = prefs.getULong(NVM_UPLOADED_KEY, 0);
+    prefs.end();
+}
+
+void Journal::SaveNVM() {
+    Preferences prefs;
+    prefs.begin(NVM_PREFS_SECTION, false);
+    prefs.putULong(NVM_UPLOADED_KEY, _uploadedBoot);
+    prefs.end();
+}
+
+void Journal::Begin() {
+    if (_started) {
+        return;
+    }
+    const esp_partition_t* partition =
+        esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, JOURNAL_PARTITION_LABEL);
+    if (!partition) {
+        logPrint(LOG_WARNING, "Journal: no \"" JOURNAL_PARTITION_LABEL "\" partition, flash journal disabled");
+        return;
+    }
+    partitionFlash.Attach(partition);
+    if (!_store.Open(&partitionFlash)) {
+        logPrintf(LOG_WARNING, "Journal: partition of %u bytes is too small", partition->size);
+        return;
+    }
+    _lock = xSemaphoreCreateMutex();
+    ReadNVM();
+    _started = true;
+    _uploadPending = true;
+    _lastSnapshotMs = millis();
+
+    JournalBootPayload boot = {(uint8_t)esp_reset_reason(), (uint8_t)min(bootAttempts, 255), JOURNAL_VERSION};
+    Append(JOURNAL_BOOT, 0, &boot, sizeof(boot));
+    logPrintf(LOG_INFO, "Journal: boot %u, %u sectors, reset reason %d", _store.Boot(), _store.Sectors(),
+              boot.resetReason);
+}
+
+bool Journal::Append(uint8_t type, uint8_t level, const void* payload, size_t length) {
+    if (!_started || xSemaphoreTake(_lock, pdMS_TO_TICKS(JOURNAL_LOCK_TIMEOUT)) != pdTRUE) {
+        return false;
+    }
+    time_t now = time(nullptr);
+    bool ok = _store.Append(type, level, millis(), now >= 100000 ? (uint32_t)now : 0, payload,
+                            (uint16_t)min(length, (size_t)JOURNAL_RECORD_MAX));
+    xSemaphoreGive(_lock);
+    return ok;
+}
+
+void Journal::Log(uint8_t level, uint8_t module, const char* line, size_t len) {
+    if (!_started || level > JOURNAL_LOG_LEVEL) {
+        return;
+    }
+    uint8_t payload[1 + JOURNAL_LINE_MAX];
+    len = min(len, (size_t)JOURNAL_LINE_MAX);
+    payload[0] = module;
+    memcpy(payload + 1, line, len);
+    Append(JOURNAL_LOG, level, payload, len + 1);
+}
+
+void Journal::Snapshot() {
+    if (!_started) {
+        return;
+    }
+    Metrics::Sample();
+    char text[JOURNAL_RECORD_MAX];
+    size_t len = 0;
+    for (Metric* m = Metric::First(); m; m = m->Next()) {
+        int n;
+        switch (m->Type()) {
+        case METRIC_COUNTER:
+            n = snprintf(text + len, sizeof(text) - len, "%s %u\n", m->Name(),
+                         static_cast<MetricCounter*>(m)->Value());
+            break;
+        case METRIC_GAUGE:
+            n = snprintf(text + len, sizeof(text) - len, "%s %d\n", m->Name(),
+                         static_cast<MetricGauge*>(m)->Value());
+            break;
+        default: {
+            MetricHistogram* h = static_cast<MetricHistogram*>(m);
+            n = snprintf(text + len, sizeof(text) - len, "%s %u %u %u\n", m->Name(), h->Count(), h->SumMs(),
+                         h->MaxUs() / 1000);
+            break;
+        }
+        }
+        if (n < 0 || (size_t)n >= sizeof(text) - len) {
+            break;
+        }
+        len += n;
+    }
+    Append(JOURNAL_METRICS, 0, text, len);
+
+    TraceEvent events[JOURNAL_SNAPSHOT_SPANS];
+    uint8_t cores[JOURNAL_SNAPSHOT_SPANS];
+    JournalSpan spans[JOURNAL_SNAPSHOT_SPANS];
+    size_t count = Trace::Recent(events, cores, JOURNAL_SNAPSHOT_SPANS);
+    for (size_t i = 0; i < count; i++) {
+        spans[i].startUs = events[i].startUs;
+        spans[i].durUs = events[i].durUs;
+        spans[i].core = cores[i];
+        strlcpy(spans[i].name, events[i].name, sizeof(spans[i].name));
+    }
+    if (count > 0) {
+        Append(JOURNAL_SPANS, 0, spans, count * sizeof(JournalSpan));
+    }
+    _lastSnapshotMs = millis();
+}
+
+void Journal::RecordReboot(const char* reason) {
+    if (!_started) {
+        return;
+    }
+    Snapshot();
+    Append(JOURNAL_REBOOT, 0, reason, strlen(reason));
+}
+
+bool Journal::Upload() {
+    JournalUpload upload;
+    if (xSemaphoreTake(_lock, pdMS_TO_TICKS(JOURNAL_LOCK_TIMEOUT)) != pdTRUE) {
+        return false;
+    }
+    upload.Measure(_store, _uploadedBoot);
+    xSemaphoreGive(_lock);
+    if (upload.Previous() == 0) {
+        // Nothing from earlier boots (first boot, or already uploaded)
+        _uploadedBoot = upload.ToBoot() - 1;
+        SaveNVM();
+        _uploadPending = false;
+        return true;
+    }
+
+    bool psram = psramFound();
+    size_t cap = psram ? JOURNAL_UPLOAD_MAX_PSRAM : JOURNAL_UPLOAD_MAX;
+    cap = min(cap, sizeof(JournalUploadHeader) + upload.Total());
+    uint8_t* buf = (uint8_t*)(psram ? ps_malloc(cap) : malloc(cap));
+    if (!buf) {
+        logPrintf(LOG_WARNING, "Journal: no memory for a %u byte upload", cap);
+        return false;
+    }
+
+    if (xSemaphoreTake(_lock, pdMS_TO_TICKS(JOURNAL_LOCK_TIMEOUT)) != pdTRUE) {
+        free(buf);
+        return false;
+    }
+    size_t len = upload.Pack(_store, buf, cap);
+    xSemaphoreGive(_lock);
+
+    size_t gzCap = gzipBound(len);
+    uint8_t* gz = (uint8_t*)(psram ? ps_malloc(gzCap) : malloc(gzCap));
+    size_t gzLen = gz ? gzipCompress(buf, len, gz, gzCap) : 0;
+    free(buf);
+    if (gzLen == 0) {
+        free(gz);
+        logPrintf(LOG_WARNING, "Journal: gzip of %u bytes failed", len);
+        return false;
+    }
+
+    if (UploadScheduler::scheduler.Admit(UPLOAD_TELEMETRY, gzLen, 0) == UPLOAD_SKIP) {
+        free(gz);
+        return false;
+    }
+    time_t now = time(nullptr);
+    struct tm timeinfo;
+    gmtime_r(&now, &timeinfo);
+    char stamp[24];
+    strftime(stamp, sizeof(stamp), "%Y%m%d_%H%M%S", &timeinfo);
+    char filename[64];
+    snprintf(filename, sizeof(filename), "journal_%s_boot%u" JOURNAL_EXTENSION, stamp, upload.ToBoot());
+    bool ok = uploadBufferToS3(gz, gzLen, filename, String(s3Folder), "application/gzip");
+    free(gz);
+    if (!ok) {
+        return false;
+    }
+    UploadScheduler::scheduler.Consume(UPLOAD_TELEMETRY, gzLen);
+
+    logPrintf(LOG_INFO, "Journal: %u records of boots %u-%u uploaded (%u -> %u bytes)", upload.Records(),
+              upload.FromBoot(), upload.ToBoot() - 1, len, gzLen);
+    _uploadedBoot = upload.ToBoot() - 1;
+    SaveNVM();
+    _uploadPending = false;
+    ++_uploads;
+    _lastUploadBytes = gzLen;
+    return true;
+}
+
+void Journal::Loop() {
+    if (!_started) {
+        return;
+    }
+    if (millis() - _lastSnapshotMs >= JOURNAL_SNAPSHOT_INTERVAL) {
+        Snapshot();
+    }
+    if (!_uploadPending || !IsWiFiConnected() || time(nullptr) < 100000) {
+        return;
+    }
+    if (_lastFailMs != 0 && millis() - _lastFailMs < JOURNAL_RETRY_INTERVAL) {
+        return;
+    }
+    if (Upload()) {
+        _lastFailMs = 0;
+    } else {
+        ++_uploadFailures;
+        _lastFailMs = millis();
+    }
+}
+
+void Journal::Configure(const JsonDocument& doc) {
+    if (doc["snapshot"] | false) {
+        Snapshot();
+    }
+    if (doc["upload"] | false) {
+        _uploadPending = true;
+        _lastFailMs = 0;
+    }
+}
+
+JsonDocument Journal::describe() {
+    JsonDocument doc;
+    doc["enabled"] = _started;
+    if (!_started) {
+        return doc;
+    }
+    doc["boot"] = _store.Boot();
+    doc["sectors"] = _store.Sectors();
+    doc["active_sector"] = _store.ActiveSector();
+    doc["sequence"] = _store.Sequence();
+    doc["records"] = _store.Records();
+    doc["erases"] = _store.Erases();
+    doc["write_failures"] = _store.Failures();
+    doc["uploaded_boot"] = _uploadedBoot;
+    doc["upload_pending"] = _uploadPending;
+    doc["uploads"] = _uploads;
+    doc["upload_failures"] = _uploadFailures;
+    doc["last_upload_bytes"] = _lastUploadBytes;
+    return doc;
+}
@@ -0,0 +1,267 @@
+#include <string.h>
+#include "gzip.h"
+#include "journal_store.h"
+
+static bool allErased(const uint8_t* p, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if (p[i] != 0xff) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool JournalStore::SectorHeader(uint32_t sector, JournalSectorHeader& header) {
+    if (!_flash->Read(sector * JOURNAL_SECTOR_SIZE, &header, sizeof(header))) {
+        return false;
+    }
+    return header.magic == JOURNAL_SECTOR_MAGIC &&
+           header.crc == crc32Update(0, (const uint8_t*)&header, offsetof(JournalSectorHeader, crc));
+}
+
+bool JournalStore::StartSector(uint32_t sector, uint32_t sequence) {
+    ++_erases;
+    if (!_flash->EraseSector(sector * JOURNAL_SECTOR_SIZE)) {
+        return false;
+    }
+    JournalSectorHeader header = {JOURNAL_SECTOR_MAGIC, sequence, 0, 0xffffffff};
+    header.crc = crc32Update(0, (const uint8_t*)&header, offsetof(JournalSectorHeader, crc));
+    if (!_flash->Write(sector * JOURNAL_SECTOR_SIZE, &header, sizeof(header))) {
+        return false;
+    }
+    _active = sector;
+    _sequence = sequence;
+    _offset = sizeof(header);
+    return true;
+}
+
+// Walks the records of one sector. Returns the offset of its free space;
+// torn is set when a record fails its checks (nothing after it is trusted).
+uint32_t JournalStore::ScanSector(uint32_t sector, bool& torn, Visitor visit, void* ctx, bool& stop) {
+    uint32_t base = sector * JOURNAL_SECTOR_SIZE;
+    uint32_t offset = sizeof(JournalSectorHeader);
+    torn = false;
+    while (offset + sizeof(JournalRecordHeader) <= JOURNAL_SECTOR_SIZE && !stop) {
+        JournalRecordHeader header;
+        if (!_flash->Read(base + offset, &header, sizeof(header))) {
+            torn = true;
+            return offset;
+        }
+        if (header.length == JOURNAL_FREE_LENGTH) {
+            torn = !allErased((const uint8_t*)&header, sizeof(header));
+            return offset;
+        }
+        uint32_t size = journalRecordSize(header.length);
+        if (header.length > JOURNAL_RECORD_MAX || offset + size > JOURNAL_SECTOR_SIZE ||
+            !_flash->Read(base + offset, _buf, size)) {
+            torn = true;
+            return offset;
+        }
+        uint32_t dataLen = sizeof(JournalRecordHeader) + header.length;
+        uint32_t crc;
+        memcpy(&crc, _buf + dataLen, sizeof(crc));
+        if (crc != crc32Update(0, _buf, dataLen)) {
+            torn = true;
+            return offset;
+        }
+        if (visit && !visit(header, _buf + sizeof(header), _buf, dataLen + sizeof(crc), ctx)) {
+            stop = true;
+        }
+        offset += size;
+    }
+    return offset;
+}
+
+static bool maxBoot(const JournalRecordHeader& header, const uint8_t*, const uint8_t*, uint32_t, void* ctx) {
+    uint32_t* boot = (uint32_t*)ctx;
+    if (header.boot > *boot) {
+        *boot = header.boot;
+    }
+    return true;
+}
+
+bool JournalStore::Open(JournalFlash* flash) {
+    _flash = flash;
+    _sectors = flash->Size() / JOURNAL_SECTOR_SIZE;
+    _sequence = 0;
+    _offset = JOURNAL_SECTOR_SIZE;
+    if (_sectors < 2) {
+        return false;
+    }
+
+    for (uint32_t sector = 0; sector < _sectors; sector++) {
+        JournalSectorHeader header;
+        if (SectorHeader(sector, header) && header.sequence >= _sequence) {
+            _sequence = header.sequence;
+            _active = sector;
+        }
+    }
+    if (_sequence == 0) {
+        // Blank or foreign partition: the first append starts sector 0
+        _active = _sectors - 1;
+        _boot = 1;
+        return true;
+    }
+
+    bool torn, stop = false;
+    uint32_t end = ScanSector(_active, torn, nullptr, nullptr, stop);
+    _offset = torn ? JOURNAL_SECTOR_SIZE : end;
+
+    uint32_t boot = 0;
+    ForEach(maxBoot, &boot);
+    _boot = boot + 1;
+    return true;
+}
+
+bool JournalStore::Append(uint8_t type, uint8_t level, uint32_t uptimeMs, uint32_t time,
+                          const void* payload, uint16_t length) {
+    if (!_flash || length > JOURNAL_RECORD_MAX) {
+        return false;
+    }
+    uint32_t size = journalRecordSize(length);
+    if (_offset + size > JOURNAL_SECTOR_SIZE &&
+        !StartSector((_active + 1) % _sectors, _sequence + 1)) {
+        // Retried on the next append; the sector stays unusable until then
+        _offset = JOURNAL_SECTOR_SIZE;
+        ++_failures;
+        return false;
+    }
+
+    JournalRecordHeader header = {length, type, level, _boot, uptimeMs, time};
+    memcpy(_buf, &header, sizeof(header));
+    memcpy(_buf + sizeof(header), payload, length);
+    uint32_t dataLen = sizeof(header) + length;
+    uint32_t crc = crc32Update(0, _buf, dataLen);
+    memcpy(_buf + dataLen, &crc, sizeof(crc));
+    memset(_buf + dataLen + sizeof(crc), 0xff, size - dataLen - sizeof(crc));
+
+    bool ok = _flash->Write(_active * JOURNAL_SECTOR_SIZE + _offset, _buf, size);
+    // Even a failed write may have programmed some bits: never reuse the space
+    _offset += size;
+    if (!ok) {
+        ++_failures;
+        return false;
+    }
+    ++_records;
+    return true;
+}
+
+void JournalStore::ForEach(Visitor visit, void* ctx) {
+    if (_sequence == 0) {
+        return;
+    }
+    bool stop = false;
+    for (uint32_t i = 1; i <= _sectors && !stop; i++) {
+        uint32_t sector = (_active + i) % _sectors;
+        JournalSectorHeader header;
+        // Only the current lap: a stale sector left by an interrupted erase is skipped
+        if (!SectorHeader(sector, header) || header.sequence > _sequence ||
+            _sequence - header.sequence >= _sectors) {
+            continue;
+        }
+        bool torn;
+        ScanSector(sector, torn, visit, ctx, stop);
+    }
+}
+
+bool JournalUpload::Selected(const JournalRecordHeader& header) const {
+    return header.boot > _uploadedBoot &&
+           (header.boot < _boot || (header.boot == _boot && header.type == JOURNAL_BOOT));
+}
+
+bool JournalUpload::MeasureRecord(const JournalRecordHeader& header, const uint8_t*, const uint8_t*,
+                                  uint32_t rawSize, void* ctx) {
+    JournalUpload* u = (JournalUpload*)ctx;
+    if (u->Selected(header)) {
+        u->_total += rawSize;
+        if (header.boot < u->_boot) {
+            ++u->_previous;
+        }
+    }
+    return true;
+}
+
+bool JournalUpload::CopyRecord(const JournalRecordHeader& header, const uint8_t*, const uint8_t* raw,
+                               uint32_t rawSize, void* ctx) {
+    JournalUpload* u = (JournalUpload*)ctx;
+    if (!u->Selected(header)) {
+        return true;
+    }
+    if (u->_skip > 0) {
+        u->_skip = rawSize < u->_skip ? u->_skip - rawSize : 0;
+        return true;
+    }
+    if (u->_len + rawSize > u->_cap) {
+        return false;
+    }
+    if (u->_records == 0) {
+        u->_fromBoot = header.boot;
+    }
+    memcpy(u->_buf + u->_len, raw, rawSize);
+    u->_len += rawSize;
+    ++u->_records;
+    return true;
+}
+
+void JournalUpload::Measure(JournalStore& store, uint32_t uploadedBoot) {
+    _uploadedBoot = uploadedBoot;
+    _boot = store.Boot();
+    _total = 0;
+    _previous = 0;
+    store.ForEach(MeasureRecord, this);
+}
+
+size_t JournalUpload::Pack(JournalStore& store, uint8_t* buf, size_t cap) {
+    if (cap < sizeof(JournalUploadHeader)) {
+        return 0;
+    }
+    _buf = buf;
+    _cap = cap;
+    _len = sizeof(JournalUploadHeader);
+    _skip = _total > cap - _len ? _total - (cap - _len) : 0;
+    _records = 0;
+    _fromBoot = 0;
+    store.ForEach(CopyRecord, this);
+
+    JournalUploadHeader header;
+    memcpy(header.magic, JOURNAL_UPLOAD_MAGIC, sizeof(header.magic));
+    header.version = JOURNAL_VERSION;
+    header.records = _records;
+    header.fromBoot = _fromBoot;
+    header.toBoot = _boot;
+    memcpy(buf, &header, sizeof(header));
+    _buf = nullptr;
+    return _len;
+}
+
+bool journalReadUpload(const uint8_t* data, size_t len, JournalUploadHeader& header,
+                       JournalStore::Visitor visit, void* ctx) {
+    if (len < sizeof(header) || memcmp(data, JOURNAL_UPLOAD_MAGIC, sizeof(header.magic)) != 0) {
+        return false;
+    }
+    memcpy(&header, data, sizeof(header));
+    size_t pos = sizeof(header);
+    uint16_t count = 0;
+    while (pos < len) {
+        JournalRecordHeader record;
+        if (pos + sizeof(record) + sizeof(uint32_t) > len) {
+            return false;
+        }
+        memcpy(&record, data + pos, sizeof(record));
+        uint32_t dataLen = sizeof(record) + record.length;
+        if (record.length > JOURNAL_RECORD_MAX || pos + dataLen + sizeof(uint32_t) > len) {
+            return false;
+        }
+        uint32_t crc;
+        memcpy(&crc, data + pos + dataLen, sizeof(crc));
+        if (crc != crc32Update(0, data + pos, dataLen)) {
+            return false;
+        }
+        if (visit && !visit(record, data + pos + sizeof(record), data + pos, dataLen + sizeof(crc), ctx)) {
+            return true;
+        }
+        pos += dataLen + sizeof(crc);
+        ++count;
+    }
+    return count == header.records;
+}
@@ -0,0 +1,109 @@
+#define LOG_MODULE LOG_MODULE_IOT
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <ArduinoJson.h>
+#include <esp_timer.h>
+#include "common.h"
+#include "gzip.h"
+#include "json_compression.h"
+
+#define NVM_PREFS_SECTION "compression"
+#define NVM_STATUS_KEY "status"
+#define NVM_MQTT_KEY "mqtt"
+
+JsonCompression JsonCompression::compression;
+
+void JsonCompression::ReadNVM() {
+    Preferences prefs;
+    prefs.begin(NVM_PREFS_SECTION, true);
+    _statusGzip = prefs.getBool(NVM_STATUS_KEY, true);
+    _mqttGzip = prefs.getBool(NVM_MQTT_KEY, false);
+    prefs.end();
+    _loaded = true;
+}
+
+void JsonCompression::SaveNVM() {
+    Preferences prefs;
+    prefs.begin(NVM_PREFS_SECTION, false);
+    prefs.putBool(NVM_STATUS_KEY, _statusGzip);
+    prefs.putBool(NVM_MQTT_KEY, _mqttGzip);
+    prefs.end();
+}
+
+bool JsonCompression::StatusGzip() {
+    if (!_loaded) {
+        ReadNVM();
+    }
+    return _statusGzip;
+}
+
+bool JsonCompression::MqttGzip() {
+    if (!_loaded) {
+        ReadNVM();
+    }
+    return _mqttGzip;
+}
+
+uint8_t* JsonCompression::Gzip(const char* json, size_t len, size_t& gzLen) {
+    gzLen = 0;
+    if (len < JSON_GZIP_MIN_BYTES) {
+        return nullptr;
+    }
+
+    size_t cap = gzipBound(len);
+    uint8_t* out = (uint8_t*)malloc(cap);
+    if (!out) {
+        ++_failed;
+        logPrintf(LOG_WARNING, "gzip: no memory for %u bytes", cap);
+        return nullptr;
+    }
+
+    int64_t start = esp_timer_get_time();
+    gzLen = gzipCompress((const uint8_t*)json, len, out, cap);
+    uint32_t us = (uint32_t)(esp_timer_get_time() - start);
+    if (gzLen == 0) {
+        ++_failed;
+        free(out);
+        return nullptr;
+    }
+
+    ++_documents;
+    _bytesIn += len;
+    _bytesOut += gzLen;
+    _totalUs += us;
+    _maxUs = max(_maxUs, us);
+    logPrintf(LOG_DEBUG, "gzip: %u -> %u bytes in %u us", len, gzLen, us);
+    return out;
+}
+
+void JsonCompression::Configure(const JsonDocument& doc) {
+    StatusGzip();
+    bool changed = false;
+    if (doc["status"].is<bool>()) {
+        _statusGzip = doc["status"].as<bool>();
+        changed = true;
+    }
+    if (doc["mqtt"].is<bool>()) {
+        _mqttGzip = doc["mqtt"].as<bool>();
+        changed = true;
+    }
+    if (changed) {
+        SaveNVM();
+        logPrintf(LOG_INFO, "JSON gzip: status %s, mqtt %s", _statusGzip ? "on" : "off", _mqttGzip ? "on" : "off");
+    }
+}
+
+JsonDocument JsonCompression::describe() {
+    JsonDocument doc;
+    doc["status"] = StatusGzip();
+    doc["mqtt"] = MqttGzip();
+    doc["documents"] = _documents;
+    doc["failed"] = _failed;
+    doc["bytes_in"] = _bytesIn;
+    doc["bytes_out"] = _bytesOut;
+    doc["ratio"] = _bytesIn ? (float)_bytesOut / _bytesIn : 0;
+    doc["avg_us"] = _documents ? (uint32_t)(_totalUs / _documents) : 0;
+    doc["max_us"] = _maxUs;
+    return doc;
+}
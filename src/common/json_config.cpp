@@ -1,7 +1,10 @@
+#define LOG_MODULE LOG_MODULE_CAMERA
+
 #include <Arduino.h>
 #include <ArduinoJson.h>
 #include "common.h"
 #include "json_config.h"
+#include "rate_controller.h"
 
 JsonCameraConfig JsonCameraConfig::config;
 
@@ -94,8 +97,33 @@ void JsonCameraConfig::Apply() {
 
     SENSOR_FIELDS(APPLY_VALUE)
     #undef APPLY_VALUE
+
+    // The configured framesize/quality are caps for the rate controller's point
+    RateController::rate.Reapply();
 };
 
+// Runtime quality/framesize change from the rate controller. Only the sensor
+// is changed: a framesize or quality set in the config is an upper bound
+// (larger framesize_t and smaller quality numbers mean bigger frames).
+void JsonCameraConfig::ApplyOperatingPoint(framesize_t framesize, int quality) {
+    sensor_t* s = esp_camera_sensor_get();
+    if (!s) {
+        return;
+    }
+
+    if (_framesize.isSet && _framesize.value < framesize) {
+        framesize = _framesize.value;
+    }
+    if (_quality.isSet && _quality.value > quality) {
+        quality = _quality.value;
+    }
+
+    auto vf = s->set_framesize(s, framesize);
+    auto vq = s->set_quality(s, quality);
+    logPrintf(LOG_DEBUG, "Applied operating point: framesize %i [%i] quality %i [%i]",
+        static_cast<int>(framesize), static_cast<int>(vf), quality, static_cast<int>(vq));
+}
+
 JsonDocument JsonCameraConfig::BuildStatus() const {
     
     JsonDocument status;
@@ -144,7 +172,9 @@ JsonDocument JsonCameraConfig::buildConfigurationDocument() const {
     return doc;
 }
 
-void JsonCameraConfig::readCameraConfiguration(const JsonDocument& doc) {
+// Returns false when the document had nothing to apply
+bool JsonCameraConfig::readCameraConfiguration(const JsonDocument& doc) {
+    bool applied = false;
     if (doc["clear"].is<bool>() && doc["clear"].as<bool>())
     {
         #define CLEAR_FIELD(T, FT, name) _##name.isSet = false;
@@ -157,16 +187,19 @@ void JsonCameraConfig::readCameraConfiguration(const JsonDocument& doc) {
         ClearNVM();
 
         logPrintf(LOG_INFO, "Camera config: all field reset");
+        applied = true;
     }
     if (doc["status"].is<JsonObjectConst>()) {
         Read(doc["status"]);
         Apply();
         SaveNVM();
+        applied = true;
     }
     else
     {
         logPrintf(LOG_WARNING, "missing key \"status\": %s", doc.as<String>().c_str());
     }
+    return applied;
 }
 
 
@@ -188,4 +221,75 @@ bool JsonCameraConfig::checkConfigValue(String field, int value) {
 
     return true;
     #undef FIELD_VALUES
-}
\ No newline at end of file
+}
+
+// ===== Camera configuration from S3 =====
+
+#define CAMERA_CONFIG_CACHE_KEY "camcfg"
+
+unsigned long lastCameraConfigCheck = 0;
+
+// Parse a downloaded config document and hand it to readCameraConfiguration
+// (Read + Apply + SaveNVM). Only an applied document goes in the S3 cache, so
+// a rejected one is fetched again rather than answered 304 from then on.
+static bool applyCameraConfigDocument(const String& content) {
+    JsonDocument doc;
+    DeserializationError err = deserializeJson(doc, content);
+    if (err) {
+        logPrintf(LOG_ERROR, "S3 camera config parse error: %s", err.c_str());
+        return false;
+    }
+    return JsonCameraConfig::config.readCameraConfiguration(doc);
+}
+
+void loadCameraConfigAtBoot() {
+    if (!cameraAvailable) {
+        return;
+    }
+
+    // NVM holds the last applied configuration, use it as the baseline
+    JsonCameraConfig::config.ReadNVM();
+
+    S3CachedFetch fetch;
+    String content;
+    String errorMsg;
+    S3FetchResult result = fetch.Fetch(CAMERA_CONFIG_S3_FILE, CAMERA_CONFIG_CACHE_KEY, content, errorMsg);
+    if (result == S3_FETCH_MODIFIED && applyCameraConfigDocument(content)) {
+        fetch.Commit(content);
+        logPrint(LOG_INFO, "Camera config loaded from S3");
+        return;
+    }
+
+    if (result == S3_FETCH_ERROR) {
+        logPrintf(LOG_WARNING, "Camera config from S3 unavailable: %s", errorMsg.c_str());
+    }
+    JsonCameraConfig::config.Apply();
+}
+
+void checkCameraConfigUpdate() {
+    if (!cameraAvailable) {
+        return;
+    }
+
+    S3CachedFetch fetch;
+    String content;
+    String errorMsg;
+    switch (fetch.Fetch(CAMERA_CONFIG_S3_FILE, CAMERA_CONFIG_CACHE_KEY, content, errorMsg)) {
+        case S3_FETCH_MODIFIED:
+            logPrint(LOG_INFO, "Camera config changed in S3, applying");
+            if (applyCameraConfigDocument(content)) {
+                fetch.Commit(content);
+            }
+            break;
+        case S3_FETCH_NOT_MODIFIED:
+            // Unchanged: skip Apply() entirely
+            logPrint(LOG_DEBUG, "Camera config unchanged");
+            break;
+        case S3_FETCH_NOT_FOUND:
+            logPrint(LOG_DEBUG, "No camera config in S3");
+            break;
+        case S3_FETCH_ERROR:
+            logPrintf(LOG_WARNING, "Camera config check failed: %s", errorMsg.c_str());
+            break;
+    }
+}
@@ -0,0 +1,248 @@
+#include <Arduino.h>
+#include <Preferences.h>
+#include <ArduinoJson.h>
+#include <algorithm>
+#include <esp_timer.h>
+#include "common.h"
+#include "aws_iot.h"
+#include "latency_slo.h"
+
+#define NVM_PREFS_SECTION "slo"
+#define NVM_PERCENTILE_KEY "percentile"
+#define NVM_TARGETS_KEY "targets"
+
+LatencySlo LatencySlo::slo;
+volatile uint32_t LatencySlo::_pirEdgeUs = 0;
+
+static const char* STAGE_NAMES[SLO_STAGE_COUNT] = {
+    "trigger", "capture", "analysis", "upload_start", "upload", "publish", "total"};
+
+// Stamps each stage runs between; the total spans the whole way
+static const SloStamp STAGE_FROM[SLO_STAGE_COUNT] = {
+    SLO_PIR_EDGE, SLO_CAPTURE_START, SLO_CAPTURE_END, SLO_ANALYSIS_DONE,
+    SLO_UPLOAD_FIRST_BYTE, SLO_UPLOAD_DONE, SLO_PIR_EDGE};
+static const SloStamp STAGE_TO[SLO_STAGE_COUNT] = {
+    SLO_CAPTURE_START, SLO_CAPTURE_END, SLO_ANALYSIS_DONE, SLO_UPLOAD_FIRST_BYTE,
+    SLO_UPLOAD_DONE, SLO_PUBLISH_DONE, SLO_PUBLISH_DONE};
+
+void SloWindow::Add(uint32_t ms) {
+    _ms[_next] = ms;
+    _next = (_next + 1) % SLO_WINDOW;
+    if (_count < SLO_WINDOW) {
+        ++_count;
+    }
+}
+
+uint32_t SloWindow::Percentile(uint8_t p) const {
+    if (_count == 0) {
+        return 0;
+    }
+    uint32_t sorted[SLO_WINDOW];
+    memcpy(sorted, _ms, _count * sizeof(uint32_t));
+    std::sort(sorted, sorted + _count);
+    size_t rank = (p * _count + 99) / 100;
+    return sorted[rank ? rank - 1 : 0];
+}
+
+const char* LatencySlo::StageName(SloStage stage) {
+    return STAGE_NAMES[stage];
+}
+
+void IRAM_ATTR LatencySlo::OnPirEdge() {
+    uint32_t us = (uint32_t)esp_timer_get_time();
+    _pirEdgeUs = us ? us : 1;
+}
+
+void LatencySlo::AttachPir(uint8_t pin) {
+    attachInterrupt(digitalPinToInterrupt(pin), OnPirEdge, RISING);
+}
+
+void LatencySlo::ReadNVM() {
+    Preferences prefs;
+    prefs.begin(NVM_PREFS_SECTION, true);
+    _percentile = prefs.getUChar(NVM_PERCENTILE_KEY, SLO_DEFAULT_PERCENTILE);
+    if (prefs.getBytesLength(NVM_TARGETS_KEY) == sizeof(_targetMs)) {
+        prefs.getBytes(NVM_TARGETS_KEY, _targetMs, sizeof(_targetMs));
+    } else {
+        _targetMs[SLO_STAGE_TOTAL] = SLO_DEFAULT_TOTAL_MS;
+    }
+    prefs.end();
+    _loaded = true;
+}
+
+void LatencySlo::SaveNVM() {
+    Preferences prefs;
+    prefs.begin(NVM_PREFS_SECTION, false);
+    prefs.putUChar(NVM_PERCENTILE_KEY, _percentile);
+    prefs.putBytes(NVM_TARGETS_KEY, _targetMs, sizeof(_targetMs));
+    prefs.end();
+}
+
+void LatencySlo::Begin(bool motion) {
+    int64_t now = esp_timer_get_time();
+    memset(_stamps, 0, sizeof(_stamps));
+    _stamps[SLO_PIR_EDGE] = now;
+    // Each edge starts at most one event
+    uint32_t edge = _pirEdgeUs;
+    _pirEdgeUs = 0;
+    uint32_t age = (uint32_t)now - edge;
+    if (motion && edge && age < SLO_PIR_EDGE_MAX_AGE * 1000UL) {
+        _stamps[SLO_PIR_EDGE] = now - age;
+    }
+    _task = xTaskGetCurrentTaskHandle();
+}
+
+void LatencySlo::Stamp(SloStamp stamp) {
+    if (!_task || _task != xTaskGetCurrentTaskHandle() || _stamps[stamp]) {
+        return;
+    }
+    _stamps[stamp] = esp_timer_get_time();
+}
+
+void LatencySlo::Latencies(JsonObject out) const {
+    for (int stage = 0; stage < SLO_STAGE_COUNT; stage++) {
+        int64_t from = _stamps[STAGE_FROM[stage]], to = _stamps[STAGE_TO[stage]];
+        if (from && to) {
+            out[STAGE_NAMES[stage]] = (uint32_t)((to - from + 500) / 1000);
+        }
+    }
+}
+
+void LatencySlo::Abort() {
+    _task = nullptr;
+}
+
+void LatencySlo::Finish() {
+    if (!_task) {
+        return;
+    }
+    _task = nullptr;
+    if (!_loaded) {
+        ReadNVM();
+    }
+    ++_events;
+    if (!_stamps[SLO_PUBLISH_DONE]) {
+        ++_incomplete;
+    }
+    for (int stage = 0; stage < SLO_STAGE_COUNT; stage++) {
+        int64_t from = _stamps[STAGE_FROM[stage]], to = _stamps[STAGE_TO[stage]];
+        if (from && to) {
+            _windows[stage].Add((uint32_t)((to - from + 500) / 1000));
+            Check((SloStage)stage);
+        }
+    }
+}
+
+void LatencySlo::Check(SloStage stage) {
+    if (!_targetMs[stage] || _windows[stage].Count() < SLO_MIN_SAMPLES) {
+        return;
+    }
+    uint32_t value = _windows[stage].Percentile(_percentile);
+    bool breached = value > _targetMs[stage];
+    unsigned long now = millis();
+    bool alert = breached ? !_breached[stage] || now - _lastAlertMs[stage] >= SLO_ALERT_REPEAT
+                          : _breached[stage];
+    _breached[stage] = breached;
+    if (!alert) {
+        return;
+    }
+    _lastAlertMs[stage] = now;
+    ++_alerts;
+    if (breached) {
+        logPrintf(LOG_WARNING, "SLO breached: %s p%u %u ms > %u ms", STAGE_NAMES[stage], _percentile, value,
+                  _targetMs[stage]);
+    } else {
+        logPrintf(LOG_INFO, "SLO recovered: %s p%u %u ms", STAGE_NAMES[stage], _percentile, value);
+    }
+
+    JsonDocument doc;
+    doc["device"] = deviceName;
+    doc["timestamp"] = getTimestamp();
+    doc["stage"] = STAGE_NAMES[stage];
+    doc["breached"] = breached;
+    doc["percentile"] = _percentile;
+    doc["value_ms"] = value;
+    doc["target_ms"] = _targetMs[stage];
+    doc["samples"] = _windows[stage].Count();
+    IoTPublish(buildTopicName("slo-alert"), doc, false, 0);
+}
+
+void LatencySlo::WriteStatus(StatusSink& out) const {
+    out.BeginObject("latency_ms");
+    for (int stage = 0; stage < SLO_STAGE_COUNT; stage++) {
+        const SloWindow& window = _windows[stage];
+        if (window.Count() == 0) {
+            continue;
+        }
+        out.BeginObject(STAGE_NAMES[stage]);
+        out.Int("p50", window.Percentile(50));
+        out.Int("p95", window.Percentile(95));
+        out.Int("p99", window.Percentile(99));
+        out.EndObject();
+    }
+    out.EndObject();
+}
+
+void LatencySlo::Configure(const JsonDocument& doc) {
+    if (!_loaded) {
+        ReadNVM();
+    }
+    bool changed = false;
+    if (doc["percentile"].is<int>()) {
+        int p = doc["percentile"];
+        if (p >= 1 && p <= 100 && p != _percentile) {
+            _percentile = p;
+            changed = true;
+        }
+    }
+    JsonObjectConst targets = doc["targets"];
+    for (int stage = 0; stage < SLO_STAGE_COUNT && targets; stage++) {
+        JsonVariantConst target = targets[STAGE_NAMES[stage]];
+        if (target.isUnbound()) {
+            continue;
+        }
+        // null (or 0) removes the SLO of the stage
+        uint32_t ms = target | 0u;
+        if (ms != _targetMs[stage]) {
+            _targetMs[stage] = ms;
+            _breached[stage] = false;
+            changed = true;
+        }
+    }
+    if (doc["reset"] | false) {
+        for (int stage = 0; stage < SLO_STAGE_COUNT; stage++) {
+            _windows[stage] = SloWindow();
+            _breached[stage] = false;
+        }
+        _events = _incomplete = _alerts = 0;
+    }
+    if (changed) {
+        SaveNVM();
+        logPrintf(LOG_INFO, "Latency SLO: p%u, total %u ms", _percentile, _targetMs[SLO_STAGE_TOTAL]);
+    }
+}
+
+JsonDocument LatencySlo::describe() {
+    if (!_loaded) {
+        ReadNVM();
+    }
+    JsonDocument doc;
+    doc["percentile"] = _percentile;
+    doc["events"] = _events;
+    doc["incomplete"] = _incomplete;
+    doc["alerts"] = _alerts;
+    JsonObject stages = doc["stages"].to<JsonObject>();
+    for (int stage = 0; stage < SLO_STAGE_COUNT; stage++) {
+        const SloWindow& window = _windows[stage];
+        JsonObject s = stages[STAGE_NAMES[stage]].to<JsonObject>();
+        s["samples"] = window.Count();
+        s["p50"] = window.Percentile(50);
+        s["p95"] = window.Percentile(95);
+        s["p99"] = window.Percentile(99);
+        if (_targetMs[stage]) {
+            s["target_ms"] = _targetMs[stage];
+            s["breached"] = _breached[stage];
+        }
+    }
+    return doc;
+}
@@ -1,13 +1,42 @@
+#define LOG_MODULE LOG_MODULE_IOT
+
 #include <ArduinoJson.h>
+#include "img_converters.h"
 #include"common.h"
 #include "live_photo.h"
 #include "aws_iot.h"
 #include "secrets.h"
 #include "ambient.h"
 #include "json_config.h"
+#include "upload_pipeline.h"
+#include "rate_controller.h"
 
 #define LIVEPHOTO_STREAM_MAX_MS 5*60*1000
 #define LIVEPHOTO_STREAM_FPS_MS 1000
+#define LIVEPHOTO_PREVIEW_FRAMESIZE FRAMESIZE_QVGA  // sensor framesize while streaming
+#define LIVEPHOTO_PREVIEW_JPEG_QUALITY 12   // sensor JPEG quality while streaming
+#define LIVEPHOTO_PREVIEW_MAX_WIDTH 320     // QVGA, larger frames are scaled down
+#define LIVEPHOTO_PREVIEW_QUALITY 60        // fmt2jpg quality (0-100) for scaled previews
+#define LIVEPHOTO_PREVIEW_EST_BYTES 10000   // budget estimate for one preview frame
+#define LIVEPHOTO_CHUNK_SIZE 1536           // JPEG bytes per MQTT message
+
+// Chunk header + payload, reused for every message so the frame is never copied into a String
+static uint8_t chunkMessage[LIVE_PREVIEW_HEADER_SIZE + LIVEPHOTO_CHUNK_SIZE];
+
+static uint8_t* putLe(uint8_t* p, uint32_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        *p++ = (uint8_t)(value >> (8 * i));
+    }
+    return p;
+}
+
+static void writeChunkHeader(const LivePreviewChunk& header, uint8_t* out) {
+    out = putLe(out, header.seq, 2);
+    out = putLe(out, header.chunk, 2);
+    out = putLe(out, header.chunks, 2);
+    out = putLe(out, header.width, 2);
+    putLe(out, header.total, 4);
+}
 
 void LivePhoto::Start() {
     _isStreaming = true;
@@ -16,9 +45,42 @@ void LivePhoto::Start() {
 
 void LivePhoto::Stop() {
     _isStreaming = false;
+    if (_previewApplied) {
+        // Back to the rate controller's operating point for the next photo
+        _previewApplied = false;
+        RateController::rate.Reapply();
+    }
+}
+
+void LivePhoto::RequestFull() {
+    _fullRequested = true;
 }
     
 void LivePhoto::Loop() {
+    // Publish frames the upload pipeline finished since the last loop
+    String uri;
+    bool success;
+    while (UploadPipeline::pipeline.Poll(uri, success)) {
+        if (success) {
+            auto topicName = buildTopicName("live-photo");
+            JsonDocument doc;
+            doc["id"] = uri.substring(1);
+            doc["status"] = JsonCameraConfig::config.BuildStatus();
+            doc["ltr"] = Ambient::ltr.describe();
+            IoTPublish(topicName, doc, false, 0);
+        }
+    }
+
+    if (!cameraAvailable) {
+        return;
+    }
+
+    if (_fullRequested) {
+        _fullRequested = false;
+        UploadFull();
+        return;
+    }
+
     if (!_isStreaming) {
         return;
     }
@@ -30,26 +92,140 @@ void LivePhoto::Loop() {
         return;
     }
 
-    if (cameraAvailable && 
-        (_lastPhotoMs == 0 || now - _lastPhotoMs >= LIVEPHOTO_STREAM_FPS_MS)) {
+    if (_lastPhotoMs == 0 || now - _lastPhotoMs >= LIVEPHOTO_STREAM_FPS_MS) {
+        if (UploadScheduler::scheduler.Admit(UPLOAD_LIVE, LIVEPHOTO_PREVIEW_EST_BYTES, 0) == UPLOAD_SKIP) {
+            Stop();
+            return;
+        }
 
-        camera_fb_t *fb = capturePhoto();
+        camera_fb_t *fb = CapturePreview();
         if (fb) {
-            // Generate base filename with timestamp (without extension)
-            String baseFilename = "cat_" + getTimestamp();
-            String photoFilename = baseFilename + ".jpg";
-
-            if (uploadPhotoToS3(fb, photoFilename, S3_LIVE_PHOTO)) {
-                _lastPhotoMs = millis();
-                auto topicName = buildTopicName("live-photo");
-                JsonDocument doc;
-                doc["id"] = String(S3_LIVE_PHOTO) + "/" + photoFilename;
-                doc["status"] = JsonCameraConfig::config.BuildStatus();
-                doc["ltr"] = Ambient::ltr.describe();
-                IoTPublish(topicName, doc, false, 0);
-            }
-
+            SendPreview(fb);
             esp_camera_fb_return(fb);
-        } 
+        }
+        _lastPhotoMs = millis();
     }
 }
+
+// Preview frame straight from the sensor: no flash, no stale-frame flush and no
+// rate control. The sensor produces the thumbnail and stays at the preview
+// framesize for the session; a full capture in between (capturePhoto) puts
+// the operating point back, so switch again when that happened.
+camera_fb_t* LivePhoto::CapturePreview() {
+    sensor_t* s = esp_camera_sensor_get();
+    if (!s) {
+        return nullptr;
+    }
+    if (s->status.framesize > LIVEPHOTO_PREVIEW_FRAMESIZE) {
+        JsonCameraConfig::config.ApplyOperatingPoint(LIVEPHOTO_PREVIEW_FRAMESIZE, LIVEPHOTO_PREVIEW_JPEG_QUALITY);
+        RateController::rate.Invalidate();
+        _previewApplied = true;
+    }
+    camera_fb_t* fb = esp_camera_fb_get();
+    if (!fb) {
+        logPrint(LOG_WARNING, "Live preview: capture failed");
+    }
+    return fb;
+}
+
+// Publish a preview-size JPEG, DC-scaled and re-encoded if the frame is too large
+void LivePhoto::SendPreview(camera_fb_t* fb) {
+    if (fb->format != PIXFORMAT_JPEG) {
+        return;
+    }
+
+    if (fb->width <= LIVEPHOTO_PREVIEW_MAX_WIDTH) {
+        if (PublishChunks(fb->buf, fb->len, fb->width)) {
+            UploadScheduler::scheduler.Consume(UPLOAD_LIVE, fb->len);
+        }
+        return;
+    }
+
+    // 1/2, 1/4 or 1/8 decode: the 1/8 case only uses the DCT DC coefficients
+    int shift = 1;
+    while (shift < 3 && (fb->width >> shift) > LIVEPHOTO_PREVIEW_MAX_WIDTH) {
+        ++shift;
+    }
+    jpg_scale_t scale = shift == 1 ? JPG_SCALE_2X : shift == 2 ? JPG_SCALE_4X : JPG_SCALE_8X;
+    size_t width = fb->width >> shift;
+    size_t height = fb->height >> shift;
+    size_t rgbLen = width * height * 2;
+
+    uint8_t* rgb = (uint8_t*)(psramFound() ? ps_malloc(rgbLen) : malloc(rgbLen));
+    if (!rgb) {
+        logPrint(LOG_WARNING, "Live preview: no memory for scaling");
+        return;
+    }
+
+    uint8_t* jpeg = nullptr;
+    size_t jpegLen = 0;
+    bool ok = jpg2rgb565(fb->buf, fb->len, rgb, scale) &&
+              fmt2jpg(rgb, rgbLen, width, height, PIXFORMAT_RGB565, LIVEPHOTO_PREVIEW_QUALITY, &jpeg, &jpegLen);
+    free(rgb);
+
+    if (ok && PublishChunks(jpeg, jpegLen, width)) {
+        UploadScheduler::scheduler.Consume(UPLOAD_LIVE, jpegLen);
+    }
+    free(jpeg);
+}
+
+bool LivePhoto::PublishChunks(const uint8_t* jpeg, size_t len, uint16_t width) {
+    String topic = buildTopicName("live-preview");
+    size_t maxPayload = IoTMaxPayload(topic);
+    if (maxPayload <= LIVE_PREVIEW_HEADER_SIZE) {
+        logPrintf(LOG_WARNING, "Live preview: no room for a chunk (%u bytes max)", maxPayload);
+        return false;
+    }
+    size_t chunkSize = min((size_t)LIVEPHOTO_CHUNK_SIZE, maxPayload - LIVE_PREVIEW_HEADER_SIZE);
+    size_t chunks = (len + chunkSize - 1) / chunkSize;
+    if (chunks > UINT16_MAX) {
+        logPrintf(LOG_WARNING, "Live preview: %u bytes need too many chunks", len);
+        return false;
+    }
+
+    LivePreviewChunk header;
+    header.seq = _seq++;
+    header.chunks = (uint16_t)chunks;
+    header.width = width;
+    header.total = len;
+
+    for (uint16_t i = 0; i < header.chunks; i++) {
+        size_t offset = (size_t)i * chunkSize;
+        size_t n = min(chunkSize, len - offset);
+        header.chunk = i;
+        writeChunkHeader(header, chunkMessage);
+        memcpy(chunkMessage + LIVE_PREVIEW_HEADER_SIZE, jpeg + offset, n);
+        if (!IoTPublish(topic, chunkMessage, LIVE_PREVIEW_HEADER_SIZE + n, false, 0)) {
+            logPrintf(LOG_WARNING, "Live preview: chunk %u/%u of frame %u not sent", i + 1, header.chunks, header.seq);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Full resolution frame through the S3 upload pipeline, on request only
+void LivePhoto::UploadFull() {
+    UploadDecision decision = UploadScheduler::scheduler.Admit(UPLOAD_LIVE,
+        RateController::rate.EstimateBytes(-1),
+        RateController::rate.EstimateBytes(RateController::ThumbnailLevel()));
+    if (decision == UPLOAD_SKIP) {
+        return;
+    }
+    if (decision == UPLOAD_REDUCED) {
+        RateController::rate.SetFloor(RateController::ThumbnailLevel());
+    }
+    camera_fb_t *fb = capturePhoto();
+    RateController::rate.SetFloor(0);
+    if (fb) {
+        // Generate base filename with timestamp (without extension)
+        String baseFilename = "cat_" + getTimestamp();
+        String photoFilename = baseFilename + ".jpg";
+
+        // Hash/sign and send happen on the pipeline tasks, the frame is copied
+        if (UploadPipeline::pipeline.Enqueue(fb, photoFilename, S3_LIVE_PHOTO)) {
+            UploadScheduler::scheduler.Consume(UPLOAD_LIVE, fb->len);
+        }
+
+        esp_camera_fb_return(fb);
+    } 
+}
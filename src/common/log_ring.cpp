@@ -0,0 +1,337 @@
+#include <stdio.h>
+#include <string.h>
+#include "log_ring.h"
+
+#define LOG_RING_MASK (LOG_RING_SLOTS - 1)
+#define LOG_SPEC_MAX 24
+
+enum LogArgKind {
+    ARG_NONE,           // %%
+    ARG_INT,
+    ARG_LONG,
+    ARG_LLONG,
+    ARG_SIZE,
+    ARG_DOUBLE,
+    ARG_STRING,
+    ARG_POINTER,
+    ARG_INVALID
+};
+
+struct LogSpec {
+    LogArgKind kind;
+    int stars;          // '*' width/precision, each an int argument
+    int precision;      // literal precision, -1 if none
+    const char* end;    // past the conversion character
+};
+
+// Same walk on both sides, so Format reads back exactly what Push wrote
+static LogSpec parseSpec(const char* p) {
+    LogSpec spec = {ARG_INVALID, 0, -1, p + 1};
+    ++p;
+    if (*p == '%') {
+        spec.kind = ARG_NONE;
+        spec.end = p + 1;
+        return spec;
+    }
+    while (*p && strchr("-+ #0", *p)) {
+        ++p;
+    }
+    if (*p == '*') {
+        ++spec.stars;
+        ++p;
+    }
+    while (*p >= '0' && *p <= '9') {
+        ++p;
+    }
+    if (*p == '.') {
+        ++p;
+        if (*p == '*') {
+            ++spec.stars;
+            ++p;
+        } else {
+            spec.precision = 0;
+            while (*p >= '0' && *p <= '9') {
+                spec.precision = spec.precision * 10 + (*p++ - '0');
+            }
+        }
+    }
+    int longs = 0;
+    bool size = false;
+    while (*p && strchr("hlzjtL", *p)) {
+        if (*p == 'l') {
+            ++longs;
+        } else if (*p == 'z' || *p == 't') {
+            size = true;
+        } else if (*p == 'j' || *p == 'L') {
+            longs = 2;
+        }
+        ++p;
+    }
+    if (!*p) {
+        spec.end = p;
+        return spec;
+    }
+    switch (*p) {
+    case 'd': case 'i': case 'u': case 'x': case 'X': case 'o': case 'c':
+        spec.kind = size ? ARG_SIZE : longs >= 2 ? ARG_LLONG : longs == 1 ? ARG_LONG : ARG_INT;
+        break;
+    case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+        spec.kind = longs >= 2 ? ARG_INVALID : ARG_DOUBLE;
+        break;
+    case 's':
+        spec.kind = ARG_STRING;
+        break;
+    case 'p':
+        spec.kind = ARG_POINTER;
+        break;
+    default:
+        spec.kind = ARG_INVALID;
+        break;
+    }
+    spec.end = p + 1;
+    return spec;
+}
+
+LogRing::LogRing() {
+    for (uint32_t i = 0; i < LOG_RING_SLOTS; i++) {
+        _slots[i].seq.store(i, std::memory_order_relaxed);
+    }
+}
+
+template <typename T>
+static inline bool put(LogRecord& record, T value) {
+    if (record.argLen + sizeof(T) > LOG_RECORD_ARGS) {
+        return false;
+    }
+    memcpy(record.args + record.argLen, &value, sizeof(T));
+    record.argLen += sizeof(T);
+    return true;
+}
+
+// Strings are copied with their terminator, cut to the precision or the room left
+static inline bool putString(LogRecord& record, const char* s, int precision) {
+    if (!s) {
+        s = "(null)";
+    }
+    size_t room = LOG_RECORD_ARGS - record.argLen;
+    if (room < 2) {
+        return false;
+    }
+    size_t len = strnlen(s, precision >= 0 && (size_t)precision < room - 1 ? precision : room - 1);
+    memcpy(record.args + record.argLen, s, len);
+    record.args[record.argLen + len] = 0;
+    record.argLen += len + 1;
+    return true;
+}
+
+static void pack(LogRecord& record, const char* format, va_list args) {
+    for (const char* p = strchr(format, '%'); p; p = strchr(p, '%')) {
+        LogSpec spec = parseSpec(p);
+        p = spec.end;
+        bool ok = true;
+        for (int i = 0; i < spec.stars && ok; i++) {
+            ok = put(record, va_arg(args, int));
+        }
+        switch (spec.kind) {
+        case ARG_NONE:
+            break;
+        case ARG_INT:
+            ok = ok && put(record, va_arg(args, int));
+            break;
+        case ARG_LONG:
+            ok = ok && put(record, va_arg(args, long));
+            break;
+        case ARG_LLONG:
+            ok = ok && put(record, va_arg(args, long long));
+            break;
+        case ARG_SIZE:
+            ok = ok && put(record, va_arg(args, size_t));
+            break;
+        case ARG_DOUBLE:
+            ok = ok && put(record, va_arg(args, double));
+            break;
+        case ARG_STRING:
+            ok = ok && putString(record, va_arg(args, const char*), spec.precision);
+            break;
+        case ARG_POINTER:
+            ok = ok && put(record, va_arg(args, void*));
+            break;
+        case ARG_INVALID:
+            ok = false;
+            break;
+        }
+        if (!ok) {
+            record.flags |= LOG_RECORD_TRUNCATED;
+            return;
+        }
+    }
+}
+
+bool LogRing::Push(uint8_t module, uint8_t level, uint32_t ms, const char* format, va_list args) {
+    uint32_t pos = _enqueue.load(std::memory_order_relaxed);
+    Slot* slot;
+    for (;;) {
+        slot = &_slots[pos & LOG_RING_MASK];
+        int32_t diff = (int32_t)(slot->seq.load(std::memory_order_acquire) - pos);
+        if (diff == 0) {
+            if (_enqueue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            _dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        } else {
+            pos = _enqueue.load(std::memory_order_relaxed);
+        }
+    }
+
+    LogRecord& record = slot->record;
+    record.ms = ms;
+    record.format = format;
+    record.level = level;
+    record.module = module;
+    record.argLen = 0;
+    record.flags = 0;
+    va_list copy;
+    va_copy(copy, args);
+    pack(record, format, copy);
+    va_end(copy);
+
+    slot->seq.store(pos + 1, std::memory_order_release);
+    _pushed.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+bool LogRing::Pop(LogRecord& out) {
+    uint32_t pos = _dequeue.load(std::memory_order_relaxed);
+    Slot* slot;
+    for (;;) {
+        slot = &_slots[pos & LOG_RING_MASK];
+        int32_t diff = (int32_t)(slot->seq.load(std::memory_order_acquire) - (pos + 1));
+        if (diff == 0) {
+            if (_dequeue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false;
+        } else {
+            pos = _dequeue.load(std::memory_order_relaxed);
+        }
+    }
+    // Only the used part of the arguments
+    memcpy(&out, &slot->record, offsetof(LogRecord, args) + slot->record.argLen);
+    slot->seq.store(pos + LOG_RING_SLOTS, std::memory_order_release);
+    return true;
+}
+
+template <typename T>
+static inline bool take(const LogRecord& record, size_t& pos, T& value) {
+    if (pos + sizeof(T) > record.argLen) {
+        return false;
+    }
+    memcpy(&value, record.args + pos, sizeof(T));
+    pos += sizeof(T);
+    return true;
+}
+
+template <typename T>
+static int emit(char* out, size_t room, const char* spec, int stars, const int* star, T value) {
+    switch (stars) {
+    case 0:
+        return snprintf(out, room, spec, value);
+    case 1:
+        return snprintf(out, room, spec, star[0], value);
+    default:
+        return snprintf(out, room, spec, star[0], star[1], value);
+    }
+}
+
+size_t LogRing::Format(const LogRecord& record, char* out, size_t cap) {
+    if (cap == 0) {
+        return 0;
+    }
+    size_t len = 0;
+    size_t pos = 0;
+    const char* p = record.format;
+    char spec[LOG_SPEC_MAX];
+
+    while (*p && len < cap - 1) {
+        if (*p != '%') {
+            out[len++] = *p++;
+            continue;
+        }
+        LogSpec s = parseSpec(p);
+        size_t specLen = s.end - p;
+        if (s.kind == ARG_NONE) {
+            out[len++] = '%';
+            p = s.end;
+            continue;
+        }
+        int star[2] = {0, 0};
+        bool ok = s.kind != ARG_INVALID && specLen < sizeof(spec);
+        for (int i = 0; i < s.stars && ok; i++) {
+            ok = take(record, pos, star[i]);
+        }
+        int n = 0;
+        if (ok) {
+            memcpy(spec, p, specLen);
+            spec[specLen] = 0;
+            char* dst = out + len;
+            size_t room = cap - len;
+            switch (s.kind) {
+            case ARG_INT: {
+                int v;
+                ok = take(record, pos, v) && (n = emit(dst, room, spec, s.stars, star, v)) >= 0;
+                break;
+            }
+            case ARG_LONG: {
+                long v;
+                ok = take(record, pos, v) && (n = emit(dst, room, spec, s.stars, star, v)) >= 0;
+                break;
+            }
+            case ARG_LLONG: {
+                long long v;
+                ok = take(record, pos, v) && (n = emit(dst, room, spec, s.stars, star, v)) >= 0;
+                break;
+            }
+            case ARG_SIZE: {
+                size_t v;
+                ok = take(record, pos, v) && (n = emit(dst, room, spec, s.stars, star, v)) >= 0;
+                break;
+            }
+            case ARG_DOUBLE: {
+                double v;
+                ok = take(record, pos, v) && (n = emit(dst, room, spec, s.stars, star, v)) >= 0;
+                break;
+            }
+            case ARG_POINTER: {
+                void* v;
+                ok = take(record, pos, v) && (n = emit(dst, room, spec, s.stars, star, v)) >= 0;
+                break;
+            }
+            case ARG_STRING: {
+                const char* v = (const char*)record.args + pos;
+                size_t slen = pos < record.argLen ? strnlen(v, record.argLen - pos) : 0;
+                ok = pos + slen < record.argLen && (n = emit(dst, room, spec, s.stars, star, v)) >= 0;
+                pos += slen + 1;
+                break;
+            }
+            default:
+                ok = false;
+                break;
+            }
+        }
+        if (!ok) {
+            // Arguments that did not fit the record: keep the text so far
+            const char* more = "...";
+            while (*more && len < cap - 1) {
+                out[len++] = *more++;
+            }
+            break;
+        }
+        len += (size_t)n < cap - len ? (size_t)n : cap - 1 - len;
+        p = s.end;
+    }
+    out[len] = 0;
+    return len;
+}
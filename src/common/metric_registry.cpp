@@ -0,0 +1,81 @@
+#include <stdio.h>
+#include "metric_registry.h"
+
+Metric* Metric::_head = nullptr;
+
+const uint32_t MetricHistogram::BOUNDS_MS[METRICS_BUCKET_COUNT] = {
+    1, 5, 10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000, 30000};
+
+Metric::Metric(const char* name, const char* help) : _next(_head), _name(name), _help(help) {
+    // Static initialization runs on one core before any task starts
+    _head = this;
+}
+
+void MetricHistogram::Observe(uint32_t us) {
+    // Bucket i holds BOUNDS_MS[i-1] < ms <= BOUNDS_MS[i], like Prometheus "le"
+    int i = 0;
+    while (i < METRICS_BUCKET_COUNT && us > BOUNDS_MS[i] * 1000) {
+        ++i;
+    }
+    _buckets[i].fetch_add(1, std::memory_order_relaxed);
+    _count.fetch_add(1, std::memory_order_relaxed);
+    _sumMs.fetch_add((us + 500) / 1000, std::memory_order_relaxed);
+
+    uint32_t max = _maxUs.load(std::memory_order_relaxed);
+    while (us > max && !_maxUs.compare_exchange_weak(max, us, std::memory_order_relaxed)) {
+    }
+}
+
+static const char* typeName(MetricType type) {
+    switch (type) {
+    case METRIC_COUNTER:
+        return "counter";
+    case METRIC_GAUGE:
+        return "gauge";
+    default:
+        return "histogram";
+    }
+}
+
+void Metrics::WritePrometheus(void (*emit)(const char* line, size_t len, void* ctx), void* ctx) {
+    char line[192];
+    auto put = [&](int n) {
+        if (n > 0) {
+            emit(line, (size_t)n < sizeof(line) ? (size_t)n : sizeof(line) - 1, ctx);
+        }
+    };
+
+    for (Metric* m = Metric::First(); m; m = m->Next()) {
+        put(snprintf(line, sizeof(line), "# HELP " METRICS_PREFIX "%s %s\n# TYPE " METRICS_PREFIX "%s %s\n",
+                     m->Name(), m->Help(), m->Name(), typeName(m->Type())));
+        switch (m->Type()) {
+        case METRIC_COUNTER:
+            put(snprintf(line, sizeof(line), METRICS_PREFIX "%s %u\n", m->Name(),
+                         static_cast<MetricCounter*>(m)->Value()));
+            break;
+        case METRIC_GAUGE:
+            put(snprintf(line, sizeof(line), METRICS_PREFIX "%s %d\n", m->Name(),
+                         static_cast<MetricGauge*>(m)->Value()));
+            break;
+        case METRIC_HISTOGRAM: {
+            MetricHistogram* h = static_cast<MetricHistogram*>(m);
+            uint32_t cumulative = 0;
+            for (int i = 0; i <= METRICS_BUCKET_COUNT; i++) {
+                cumulative += h->Bucket(i);
+                if (i < METRICS_BUCKET_COUNT) {
+                    uint32_t bound = MetricHistogram::BOUNDS_MS[i];
+                    put(snprintf(line, sizeof(line), METRICS_PREFIX "%s_bucket{le=\"%u.%03u\"} %u\n", m->Name(),
+                                 bound / 1000, bound % 1000, cumulative));
+                } else {
+                    put(snprintf(line, sizeof(line), METRICS_PREFIX "%s_bucket{le=\"+Inf\"} %u\n", m->Name(),
+                                 cumulative));
+                }
+            }
+            uint32_t sumMs = h->SumMs();
+            put(snprintf(line, sizeof(line), METRICS_PREFIX "%s_sum %u.%03u\n" METRICS_PREFIX "%s_count %u\n",
+                         m->Name(), sumMs / 1000, sumMs % 1000, m->Name(), h->Count()));
+            break;
+        }
+        }
+    }
+}
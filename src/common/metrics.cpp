@@ -0,0 +1,83 @@
+#include <Arduino.h>
+#include <WiFi.h>
+#include <ArduinoJson.h>
+#include <esp_timer.h>
+#include "common.h"
+#include "metrics.h"
+#include "heap_profile.h"
+
+MetricHistogram metricCapture("camera_capture_seconds", "Frame capture including flash and stale frame flush");
+MetricHistogram metricAnalysis("image_analysis_seconds", "ImageAnalyzer pass over a captured frame");
+MetricHistogram metricSigV4("sigv4_sign_seconds", "AWS Signature V4 including the payload hash");
+MetricHistogram metricS3Connect("s3_connect_seconds", "TCP/TLS connection setup to an upload target");
+MetricHistogram metricS3Request("s3_request_seconds", "S3 request from connect or send to response");
+MetricHistogram metricPhotoUpload("photo_upload_seconds", "uploadPhotoToS3 including retries");
+MetricHistogram metricWifiScan("wifi_scan_seconds", "Network scan before connecting");
+MetricHistogram metricWifiConnect("wifi_connect_seconds", "WiFi.begin to IP address");
+MetricHistogram metricMqttConnect("mqtt_connect_seconds", "MQTT connect including the TLS handshake");
+MetricCounter metricCaptureFailures("camera_capture_failures_total", "Captures that returned no frame");
+MetricCounter metricPhotoUploadFailures("photo_upload_failures_total", "Photo uploads that failed");
+MetricCounter metricWifiDisconnects("wifi_disconnects_total", "WiFi disconnect events");
+MetricCounter metricMqttConnectFailures("mqtt_connect_failures_total", "Failed MQTT connect attempts");
+
+static MetricGauge heapFree("heap_free_bytes", "Free internal heap");
+static MetricGauge heapMinFree("heap_min_free_bytes", "Lowest free internal heap since boot");
+static MetricGauge heapLargest("heap_largest_free_block_bytes", "Largest free block of internal heap");
+static MetricGauge heapFragmentation("heap_fragmentation_percent", "Free internal heap outside the largest block");
+static MetricGauge psramFree("psram_free_bytes", "Free PSRAM");
+static MetricGauge psramLargest("psram_largest_free_block_bytes", "Largest free block of PSRAM");
+static MetricGauge wifiRssi("wifi_rssi_dbm", "Signal strength of the current access point");
+static MetricGauge uptime("uptime_seconds", "Seconds since boot");
+
+MetricTimer::MetricTimer(MetricHistogram& histogram) : _histogram(histogram), _start(esp_timer_get_time()) {
+}
+
+MetricTimer::~MetricTimer() {
+    _histogram.Observe((uint32_t)(esp_timer_get_time() - _start));
+}
+
+void Metrics::Sample() {
+    heapFree.Set(ESP.getFreeHeap());
+    heapMinFree.Set(ESP.getMinFreeHeap());
+    HeapRegion internal = HeapProfile::Internal();
+    heapLargest.Set(internal.largest);
+    heapFragmentation.Set(internal.Fragmentation());
+    psramFree.Set(ESP.getFreePsram());
+    psramLargest.Set(HeapProfile::Psram().largest);
+    wifiRssi.Set(WiFi.isConnected() ? WiFi.RSSI() : 0);
+    uptime.Set(millis() / 1000);
+}
+
+void Metrics::Prometheus(void (*emit)(const char* line, size_t len, void* ctx), void* ctx) {
+    Sample();
+    WritePrometheus(emit, ctx);
+}
+
+JsonDocument Metrics::describe() {
+    Sample();
+    JsonDocument doc;
+    for (Metric* m = Metric::First(); m; m = m->Next()) {
+        switch (m->Type()) {
+        case METRIC_COUNTER:
+            doc[m->Name()] = static_cast<MetricCounter*>(m)->Value();
+            break;
+        case METRIC_GAUGE:
+            doc[m->Name()] = static_cast<MetricGauge*>(m)->Value();
+            break;
+        case METRIC_HISTOGRAM: {
+            MetricHistogram* h = static_cast<MetricHistogram*>(m);
+            JsonObject obj = doc[m->Name()].to<JsonObject>();
+            obj["count"] = h->Count();
+            obj["sum_ms"] = h->SumMs();
+            obj["max_ms"] = h->MaxUs() / 1000;
+            // Non-cumulative, one entry per BOUNDS_MS bucket plus +Inf
+            JsonArray buckets = obj["buckets"].to<JsonArray>();
+            for (int i = 0; i <= METRICS_BUCKET_COUNT; i++) {
+                buckets.add(h->Bucket(i));
+            }
+            break;
+        }
+        }
+    }
+    return doc;
+}
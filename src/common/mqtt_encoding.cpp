@@ -0,0 +1,183 @@
+#define LOG_MODULE LOG_MODULE_IOT
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <ArduinoJson.h>
+#include <esp_timer.h>
+#include "common.h"
+#include "cbor.h"
+#include "mqtt_encoding.h"
+
+#define NVM_PREFS_SECTION "mqtt-encoding"
+#define NVM_CBOR_KEY "cbor"
+
+MqttEncoding MqttEncoding::encoding;
+
+void MqttEncoding::Stats::Record(size_t len, uint32_t us) {
+    ++documents;
+    bytes += len;
+    totalUs += us;
+    maxUs = max(maxUs, us);
+}
+
+void MqttEncoding::Stats::Describe(JsonObject obj) const {
+    obj["documents"] = documents;
+    obj["bytes"] = bytes;
+    obj["avg_bytes"] = documents ? (uint32_t)(bytes / documents) : 0;
+    obj["avg_us"] = documents ? (uint32_t)(totalUs / documents) : 0;
+    obj["max_us"] = maxUs;
+}
+
+void MqttEncoding::ReadNVM() {
+    Preferences prefs;
+    prefs.begin(NVM_PREFS_SECTION, true);
+    prefs.getString(NVM_CBOR_KEY, _cborTopics, sizeof(_cborTopics));
+    prefs.end();
+    _loaded = true;
+}
+
+void MqttEncoding::SaveNVM() {
+    Preferences prefs;
+    prefs.begin(NVM_PREFS_SECTION, false);
+    prefs.putString(NVM_CBOR_KEY, _cborTopics);
+    prefs.end();
+}
+
+bool MqttEncoding::Cbor(const String& topic) {
+    if (!_loaded) {
+        ReadNVM();
+    }
+    if (!_cborTopics[0]) {
+        return false;
+    }
+    const char* name = strrchr(topic.c_str(), '/');
+    name = name ? name + 1 : topic.c_str();
+    size_t len = strlen(name);
+
+    for (const char* p = _cborTopics; *p;) {
+        const char* end = strchr(p, ',');
+        size_t itemLen = end ? (size_t)(end - p) : strlen(p);
+        if (itemLen == len && strncmp(p, name, len) == 0) {
+            return true;
+        }
+        if (!end) {
+            break;
+        }
+        p = end + 1;
+    }
+    return false;
+}
+
+static void writeVariant(CborWriter& out, JsonVariantConst value) {
+    if (value.is<JsonObjectConst>()) {
+        JsonObjectConst obj = value.as<JsonObjectConst>();
+        out.Map(obj.size());
+        for (JsonPairConst pair : obj) {
+            out.Key(pair.key().c_str());
+            writeVariant(out, pair.value());
+        }
+    } else if (value.is<JsonArrayConst>()) {
+        JsonArrayConst array = value.as<JsonArrayConst>();
+        out.Array(array.size());
+        for (JsonVariantConst item : array) {
+            writeVariant(out, item);
+        }
+    } else if (value.is<bool>()) {
+        out.Bool(value.as<bool>());
+    } else if (value.is<const char*>()) {
+        out.Text(value.as<const char*>());
+    } else if (value.is<int64_t>()) {
+        out.Int(value.as<int64_t>());
+    } else if (value.is<uint64_t>()) {
+        out.Uint(value.as<uint64_t>());
+    } else if (value.is<double>()) {
+        out.Float(value.as<double>());
+    } else {
+        out.Null();
+    }
+}
+
+size_t MqttEncoding::EncodeCbor(const JsonDocument& doc, uint8_t* buf, size_t cap) {
+    int64_t start = esp_timer_get_time();
+    CborWriter out(buf, cap);
+    JsonVariantConst root = doc.as<JsonVariantConst>();
+    if (root.is<JsonObjectConst>()) {
+        // Dictionary version first, so decoders can tell which table to use
+        JsonObjectConst obj = root.as<JsonObjectConst>();
+        out.Map(obj.size() + 1);
+        out.Uint(CBOR_KEY_VERSION);
+        out.Uint(CBOR_DICTIONARY_VERSION);
+        for (JsonPairConst pair : obj) {
+            out.Key(pair.key().c_str());
+            writeVariant(out, pair.value());
+        }
+    } else {
+        writeVariant(out, root);
+    }
+    uint32_t us = (uint32_t)(esp_timer_get_time() - start);
+
+    size_t len = out.Length();
+    if (len == 0) {
+        ++_cborFailed;
+        logPrintf(LOG_WARNING, "CBOR payload exceeds %u bytes, sending JSON", cap);
+        return 0;
+    }
+    _cbor.Record(len, us);
+    _cborJsonBytes += measureJson(doc);
+    return len;
+}
+
+void MqttEncoding::RecordJson(size_t len, uint32_t us) {
+    _json.Record(len, us);
+}
+
+void MqttEncoding::Configure(const JsonDocument& doc) {
+    if (!_loaded) {
+        ReadNVM();
+    }
+    if (!doc["cbor"].is<JsonArrayConst>()) {
+        return;
+    }
+    // The list replaces the previous one; an empty list sends everything as JSON
+    char topics[MQTT_CBOR_TOPICS_SIZE] = "";
+    for (JsonVariantConst topic : doc["cbor"].as<JsonArrayConst>()) {
+        const char* name = topic.as<const char*>();
+        if (!name || !name[0] || strchr(name, ',')) {
+            continue;
+        }
+        if (topics[0]) {
+            strlcat(topics, ",", sizeof(topics));
+        }
+        if (strlcat(topics, name, sizeof(topics)) >= sizeof(topics)) {
+            logPrint(LOG_WARNING, "CBOR topic list too long, ignored");
+            return;
+        }
+    }
+    strlcpy(_cborTopics, topics, sizeof(_cborTopics));
+    SaveNVM();
+    logPrintf(LOG_INFO, "MQTT CBOR topics: %s", _cborTopics[0] ? _cborTopics : "(none)");
+}
+
+JsonDocument MqttEncoding::describe() {
+    if (!_loaded) {
+        ReadNVM();
+    }
+    JsonDocument doc;
+    JsonArray topics = doc["cbor"].to<JsonArray>();
+    for (const char* p = _cborTopics; *p;) {
+        const char* end = strchr(p, ',');
+        topics.add(String(p).substring(0, end ? end - p : strlen(p)));
+        if (!end) {
+            break;
+        }
+        p = end + 1;
+    }
+    doc["dictionary"] = CBOR_DICTIONARY_VERSION;
+    _json.Describe(doc["json_stats"].to<JsonObject>());
+    JsonObject cbor = doc["cbor_stats"].to<JsonObject>();
+    _cbor.Describe(cbor);
+    cbor["json_bytes"] = _cborJsonBytes;
+    cbor["ratio"] = _cborJsonBytes ? (float)_cbor.bytes / _cborJsonBytes : 0;
+    cbor["failed"] = _cborFailed;
+    return doc;
+}
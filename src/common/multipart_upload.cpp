@@ -0,0 +1,178 @@
+#include <stdio.h>
+#include <string.h>
+#include "multipart_upload.h"
+
+bool multipartXmlElement(const char* xml, const char* tag, char* out, size_t cap) {
+    char open[48], close[48];
+    snprintf(open, sizeof(open), "<%s>", tag);
+    snprintf(close, sizeof(close), "</%s>", tag);
+    const char* start = strstr(xml, open);
+    if (!start) {
+        return false;
+    }
+    start += strlen(open);
+    const char* end = strstr(start, close);
+    if (!end || (size_t)(end - start) >= cap) {
+        return false;
+    }
+    memcpy(out, start, end - start);
+    out[end - start] = '\0';
+    return true;
+}
+
+bool multipartUriEncode(const char* value, char* out, size_t cap) {
+    static const char hex[] = "0123456789ABCDEF";
+    size_t n = 0;
+    for (const char* p = value; *p; p++) {
+        unsigned char c = (unsigned char)*p;
+        bool plain = (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') ||
+                     c == '-' || c == '_' || c == '.' || c == '~';
+        if (n + (plain ? 1 : 3) >= cap) {
+            return false;
+        }
+        if (plain) {
+            out[n++] = (char)c;
+        } else {
+            out[n++] = '%';
+            out[n++] = hex[c >> 4];
+            out[n++] = hex[c & 0x0f];
+        }
+    }
+    out[n] = '\0';
+    return true;
+}
+
+// prefix, then the URI-encoded upload id, into _query
+const char* MultipartUpload::UploadIdQuery(const char* prefix) {
+    size_t n = snprintf(_query, sizeof(_query), "%suploadId=", prefix);
+    multipartUriEncode(_state.uploadId, _query + n, sizeof(_query) - n);
+    return _query;
+}
+
+bool MultipartUpload::Initiate() {
+    int status = _transport.Request("POST", _state.key, "uploads=", nullptr, 0,
+                                    _response, sizeof(_response), nullptr, 0);
+    if (status != 200 ||
+        !multipartXmlElement(_response, "UploadId", _state.uploadId, sizeof(_state.uploadId)) ||
+        !_state.uploadId[0]) {
+        _state.version = 0;
+        return false;
+    }
+    _state.partCount = 0;
+    _store.Save(_state);
+    return true;
+}
+
+bool MultipartUpload::UploadPart(uint32_t part, const uint8_t* buf, size_t len) {
+    char prefix[24];
+    snprintf(prefix, sizeof(prefix), "partNumber=%u&", (unsigned)part);
+
+    char etag[S3_MULTIPART_ETAG_MAX] = "";
+    int status = _transport.Request("PUT", _state.key, UploadIdQuery(prefix), buf, len, nullptr, 0,
+                                    etag, sizeof(etag));
+    if (status == 404) {
+        // The upload is gone (expired or aborted elsewhere): start over next time
+        _store.Clear();
+        _state.version = 0;
+        return false;
+    }
+    if (status != 200 || !etag[0]) {
+        return false;
+    }
+    memcpy(_state.etags[part - 1], etag, sizeof(etag));
+    _state.partCount = part;
+    _store.Save(_state);
+    ++_partsSent;
+    return true;
+}
+
+bool MultipartUpload::Complete() {
+    size_t n = snprintf(_body, sizeof(_body), "<CompleteMultipartUpload>");
+    for (uint32_t i = 0; i < _state.partCount; i++) {
+        n += snprintf(_body + n, sizeof(_body) - n, "<Part><PartNumber>%u</PartNumber><ETag>%s</ETag></Part>",
+                      (unsigned)(i + 1), _state.etags[i]);
+    }
+    n += snprintf(_body + n, sizeof(_body) - n, "</CompleteMultipartUpload>");
+
+    int status = _transport.Request("POST", _state.key, UploadIdQuery(""), (const uint8_t*)_body, n,
+                                    _response, sizeof(_response), nullptr, 0);
+    if (status == 404) {
+        _store.Clear();
+        _state.version = 0;
+        return false;
+    }
+    // S3 may report a failed completion with HTTP 200 and an <Error> body
+    if (status != 200 || strstr(_response, "<Error>")) {
+        return false;
+    }
+    _store.Clear();
+    _state.version = 0;
+    return true;
+}
+
+bool MultipartUpload::Abort() {
+    int status = _transport.Request("DELETE", _state.key, UploadIdQuery(""), nullptr, 0, nullptr, 0, nullptr, 0);
+    // 404: already gone (completed, aborted or expired)
+    if (status != 204 && status != 404) {
+        return false;
+    }
+    _store.Clear();
+    _state.version = 0;
+    ++_aborted;
+    return true;
+}
+
+MultipartResult MultipartUpload::Upload(const uint8_t* buf, size_t len, const char* key) {
+    size_t parts = _partSize ? (len + _partSize - 1) / _partSize : 0;
+    if (!buf || len == 0 || parts > S3_MULTIPART_MAX_PARTS || strlen(key) >= sizeof(_state.key)) {
+        return MULTIPART_INVALID;
+    }
+
+    if (!_store.Load(_state) || _state.version != S3_MULTIPART_STATE_VERSION ||
+        _state.partCount > S3_MULTIPART_MAX_PARTS) {
+        memset(&_state, 0, sizeof(_state));
+    }
+    if (_state.version &&
+        (strcmp(_state.key, key) != 0 || _state.totalLen != len || _state.partSize != _partSize)) {
+        // A different object: its buffer is gone, so nothing can resume it
+        if (!Abort()) {
+            return MULTIPART_FAILED;
+        }
+    }
+
+    if (_state.version) {
+        ++_resumed;
+    } else {
+        memset(&_state, 0, sizeof(_state));
+        _state.version = S3_MULTIPART_STATE_VERSION;
+        _state.totalLen = len;
+        _state.partSize = _partSize;
+        strcpy(_state.key, key);
+        if (!Initiate()) {
+            return MULTIPART_FAILED;
+        }
+    }
+
+    for (uint32_t part = _state.partCount + 1; part <= parts; part++) {
+        size_t offset = (size_t)(part - 1) * _partSize;
+        size_t partLen = len - offset < _partSize ? len - offset : _partSize;
+        for (int attempt = 1;; attempt++) {
+            if (UploadPart(part, buf + offset, partLen)) {
+                break;
+            }
+            if (!_state.version || attempt >= S3_MULTIPART_PART_ATTEMPTS || !_transport.Reconnect()) {
+                return MULTIPART_FAILED;
+            }
+            ++_partRetries;
+        }
+    }
+
+    return Complete() ? MULTIPART_DONE : MULTIPART_FAILED;
+}
+
+bool MultipartUpload::AbortPending() {
+    if (!_store.Load(_state) || _state.version != S3_MULTIPART_STATE_VERSION) {
+        return true;
+    }
+    return Abort();
+}
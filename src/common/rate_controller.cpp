@@ -0,0 +1,217 @@
+#define LOG_MODULE LOG_MODULE_CAMERA
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <ArduinoJson.h>
+#include "common.h"
+#include "json_config.h"
+#include "rate_controller.h"
+
+// Best first. Size factors are approximate pixel count x quality scaling
+// relative to UXGA q10; they only steer the choice, measurements correct them.
+static const OperatingPoint OPERATING_POINTS[] = {
+    {FRAMESIZE_UXGA, 10, 1.00f},
+    {FRAMESIZE_UXGA, 14, 0.75f},
+    {FRAMESIZE_SXGA, 12, 0.58f},
+    {FRAMESIZE_XGA,  12, 0.35f},
+    {FRAMESIZE_SVGA, 12, 0.21f},
+    {FRAMESIZE_VGA,  12, 0.14f},
+    {FRAMESIZE_QVGA, 12, 0.035f},
+};
+static const int OPERATING_POINT_COUNT = sizeof(OPERATING_POINTS) / sizeof(OPERATING_POINTS[0]);
+static const int SVGA_LEVEL = 4;
+static const size_t DEFAULT_REF_BYTES = 250000;  // UXGA q10 frame before any measurement
+
+RateController RateController::rate;
+
+const OperatingPoint& RateController::Current() const {
+    return OPERATING_POINTS[_level < 0 ? MinLevel() : _level];
+}
+
+// Frame buffers are allocated for the initCamera() frame size, never go above it
+int RateController::MinLevel() const {
+    return psramFound() ? 0 : SVGA_LEVEL;
+}
+
+unsigned long RateController::PredictMs(int level) const {
+    if (_throughputBps <= 0) {
+        return 0;
+    }
+    float bytes = (_refBytes > 0 ? _refBytes : DEFAULT_REF_BYTES) * OPERATING_POINTS[level].sizeFactor;
+    return (unsigned long)(bytes * 1000.0f / _throughputBps);
+}
+
+int RateController::ThumbnailLevel() {
+    return OPERATING_POINT_COUNT - 1;
+}
+
+void RateController::SetFloor(int level) {
+    _floorLevel = constrain(level, 0, OPERATING_POINT_COUNT - 1);
+}
+
+// Expected JPEG size at a ladder level (current level when negative)
+size_t RateController::EstimateBytes(int level) const {
+    if (level < 0) {
+        level = _level < 0 ? MinLevel() : _level;
+    }
+    float refBytes = DEFAULT_REF_BYTES;
+    if (_lock) {
+        xSemaphoreTake(_lock, portMAX_DELAY);
+        if (_refBytes > 0) {
+            refBytes = _refBytes;
+        }
+        xSemaphoreGive(_lock);
+    }
+    return (size_t)(refBytes * OPERATING_POINTS[level].sizeFactor);
+}
+
+int RateController::PickLevel() const {
+    int minLevel = max(MinLevel(), _floorLevel);
+
+    if (_samples == 0) {
+        // No measurement yet: use RSSI to pick a safe starting point
+        if (WiFi.isConnected() && WiFi.RSSI() < RATE_CONTROL_WEAK_RSSI) {
+            return max(minLevel, SVGA_LEVEL);
+        }
+        return _level < 0 ? minLevel : _level;
+    }
+
+    for (int level = minLevel; level < OPERATING_POINT_COUNT; level++) {
+        unsigned long predicted = PredictMs(level);
+        unsigned long limit = _targetMs;
+        if (level < _level) {
+            // Hysteresis: stepping up needs clear headroom
+            limit = (unsigned long)(_targetMs * RATE_CONTROL_UPGRADE_MARGIN);
+        }
+        if (predicted <= limit) {
+            return level;
+        }
+    }
+    return OPERATING_POINT_COUNT - 1;
+}
+
+void RateController::Begin() {
+    if (!_lock) {
+        _lock = xSemaphoreCreateMutex();
+    }
+}
+
+// Apply the operating point for the next capture (call before taking a photo)
+void RateController::Select() {
+    if (!_lock) {
+        return;
+    }
+
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    int level = -1;
+    if (_enabled) {
+        level = PickLevel();
+    } else if (_floorLevel > 0) {
+        level = max(MinLevel(), _floorLevel);
+    } else if (_level >= 0) {
+        // Disabled: return to full quality after a budget reduction
+        level = MinLevel();
+    }
+    float throughputBps = _throughputBps;
+    unsigned long predictedMs = level >= 0 ? PredictMs(level) : 0;
+    xSemaphoreGive(_lock);
+
+    if (level >= 0 && level != _level) {
+        const OperatingPoint& point = OPERATING_POINTS[level];
+        logPrintf(LOG_INFO, "Rate control: level %d -> %d (framesize %d, quality %d, %.0f B/s, predicted %lu ms)",
+                  _level, level, point.framesize, point.quality, throughputBps, predictedMs);
+        _level = level;
+    } else if (!_sensorStale) {
+        return;
+    }
+    Reapply();
+}
+
+// Push the current operating point to the sensor again, e.g. after the camera
+// config was applied over it
+void RateController::Reapply() {
+    if (_level < 0 && !_sensorStale) {
+        return;
+    }
+    _sensorStale = false;
+    const OperatingPoint& point = Current();
+    JsonCameraConfig::config.ApplyOperatingPoint(point.framesize, point.quality);
+}
+
+// The sensor was set to something else (live preview): the next Select()
+// puts the operating point back even if the level did not change
+void RateController::Invalidate() {
+    _sensorStale = true;
+}
+
+// level: operating point the uploaded frame was captured at, negative for
+// bundles and other non-frame uploads
+void RateController::RecordUpload(size_t bytes, unsigned long ms, bool success, int level) {
+    if (bytes == 0 || !_lock) {
+        return;
+    }
+    if (ms == 0) {
+        ms = 1;
+    }
+
+    float bps = bytes * 1000.0f / ms;
+    if (!success) {
+        // The transfer did not finish in that time, the real rate is lower
+        bps /= 2;
+    }
+    int rssi = WiFi.RSSI();
+
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    _rssi = rssi;
+    _lastUploadMs = ms;
+    _lastUploadBytes = bytes;
+
+    if (_samples == 0) {
+        _throughputBps = bps;
+    } else {
+        _throughputBps += RATE_CONTROL_EWMA_ALPHA * (bps - _throughputBps);
+    }
+
+    // Non-frame uploads only say something about the link
+    if (level >= 0 && level < OPERATING_POINT_COUNT) {
+        float refBytes = bytes / OPERATING_POINTS[level].sizeFactor;
+        if (_refBytes <= 0) {
+            _refBytes = refBytes;
+        } else if (success) {
+            _refBytes += RATE_CONTROL_EWMA_ALPHA * (refBytes - _refBytes);
+        }
+    }
+    ++_samples;
+    xSemaphoreGive(_lock);
+}
+
+void RateController::Configure(const JsonDocument& doc) {
+    if (doc["enabled"].is<bool>()) {
+        _enabled = doc["enabled"].as<bool>();
+    }
+    if (doc["target_ms"].is<unsigned long>()) {
+        _targetMs = doc["target_ms"].as<unsigned long>();
+    }
+    logPrintf(LOG_INFO, "Rate control: %s, target %lu ms", _enabled ? "enabled" : "disabled", _targetMs);
+}
+
+JsonDocument RateController::describe() const {
+    JsonDocument doc;
+    const OperatingPoint& point = Current();
+    if (_lock) {
+        xSemaphoreTake(_lock, portMAX_DELAY);
+    }
+    doc["enabled"] = _enabled;
+    doc["target_ms"] = _targetMs;
+    doc["level"] = _level;
+    doc["framesize"] = (int)point.framesize;
+    doc["quality"] = point.quality;
+    doc["throughput_bps"] = (int)_throughputBps;
+    doc["last_upload_ms"] = _lastUploadMs;
+    doc["last_upload_bytes"] = _lastUploadBytes;
+    doc["rssi"] = _rssi;
+    if (_lock) {
+        xSemaphoreGive(_lock);
+    }
+    return doc;
+}
@@ -0,0 +1,212 @@
+#define LOG_MODULE LOG_MODULE_UPLOAD
+
+#include <Arduino.h>
+#include <HTTPClient.h>
+#include <ArduinoJson.h>
+#include "common.h"
+#include "s3_connection.h"
+#include "metrics.h"
+#include "trace.h"
+#include "latency_slo.h"
+
+S3Connection S3Connection::shared;
+
+void S3Connection::Begin(const UploadEndpoint& target, const char* method, const char* uri) {
+    _request.Begin(target.host, method, uri);
+}
+
+void S3Connection::Header(const char* name, const char* value) {
+    _request.Header(name, value);
+}
+
+void S3Connection::Header(const char* name, unsigned long value) {
+    _request.Header(name, value);
+}
+
+// Reuse the open connection when it belongs to the same target and is still up
+bool S3Connection::Connect(const UploadEndpoint& target, uint16_t connectTimeout, bool& reused) {
+    reused = false;
+    if (_client && _client->connected() && _tlsActive == target.tls && strcmp(_host, target.host) == 0) {
+        reused = true;
+        return true;
+    }
+    Close();
+
+    // host[:port]
+    char host[sizeof(target.host)];
+    strlcpy(host, target.host, sizeof(host));
+    uint16_t port = target.tls ? 443 : 80;
+    char* colon = strchr(host, ':');
+    if (colon) {
+        *colon = '\0';
+        port = atoi(colon + 1);
+    }
+
+    MetricTimer timer(metricS3Connect);
+    TRACE_SPAN("http.connect");
+    int connected = 0;
+    if (target.tls) {
+        _tls.setInsecure();
+        // Resolves through DnsCache
+        connected = _tls.connect(host, port, (int32_t)connectTimeout);
+        _client = &_tls;
+    } else {
+        IPAddress ip;
+        if (DnsCache::cache.Resolve(host, ip)) {
+            connected = _plain.connect(ip, port, connectTimeout);
+        }
+        _client = &_plain;
+    }
+    if (!connected) {
+        _client = nullptr;
+        return false;
+    }
+    strlcpy(_host, target.host, sizeof(_host));
+    _tlsActive = target.tls;
+    return true;
+}
+
+bool S3Connection::Write(const uint8_t* buf, size_t len) {
+    while (len > 0) {
+        size_t chunk = min(len, (size_t)S3_WRITE_CHUNK);
+        size_t written = _client->write(buf, chunk);
+        if (written == 0) {
+            return false;
+        }
+        buf += written;
+        len -= written;
+        _bytesSent += written;
+    }
+    return true;
+}
+
+int S3Connection::Read(uint8_t* buf, size_t len) {
+    int n = _client->read(buf, len);
+    if (n > 0) {
+        return n;
+    }
+    return !_client->connected() && !_client->available() ? -1 : 0;
+}
+
+bool S3Connection::Idle() {
+    if ((long)(millis() - _deadline) > 0) {
+        return false;
+    }
+    delay(1);
+    return true;
+}
+
+int S3Connection::ReadResponse(bool& gotBytes) {
+    int status = _response.Parse(*this, _request.IsHead(), gotBytes);
+    switch (status) {
+    case S3_HTTP_NO_RESPONSE:
+        return HTTPC_ERROR_READ_TIMEOUT;
+    case S3_HTTP_CONNECTION_LOST:
+        return HTTPC_ERROR_CONNECTION_LOST;
+    case S3_HTTP_NOT_HTTP:
+        return HTTPC_ERROR_NO_HTTP_SERVER;
+    default:
+        return status;
+    }
+}
+
+int S3Connection::Send(const UploadEndpoint& target, const uint8_t* body, size_t len,
+                       uint16_t connectTimeout, uint16_t timeout) {
+    if (!_request.Finish()) {
+        logPrint(LOG_ERROR, "S3 request headers exceed buffer");
+        return HTTPC_ERROR_TOO_LESS_RAM;
+    }
+
+    MetricTimer timer(metricS3Request);
+    TRACE_SPAN("http.request");
+    ++_requests;
+    // A kept-alive connection may have been closed by the server. Connect() drops it
+    // when the close is already visible; if the headers still can't be written,
+    // resend once on a new connection. Later failures are left to the caller,
+    // the server may have acted on the request.
+    for (int pass = 0; pass < 2; pass++) {
+        bool reused = false;
+        if (!Connect(target, connectTimeout, reused)) {
+            _status = HTTPC_ERROR_CONNECTION_REFUSED;
+            return _status;
+        }
+        uint32_t heapBefore = ESP.getFreeHeap();
+        LatencySlo::slo.Stamp(SLO_UPLOAD_FIRST_BYTE);
+
+        bool gotBytes = false;
+        if (!Write((const uint8_t*)_request.Data(), _request.Length())) {
+            _status = HTTPC_ERROR_SEND_HEADER_FAILED;
+        } else if (len > 0 && !Write(body, len)) {
+            _status = HTTPC_ERROR_SEND_PAYLOAD_FAILED;
+        } else {
+            _deadline = millis() + timeout;
+            _status = ReadResponse(gotBytes);
+        }
+
+        if (_status < 0 || !_response.KeepAlive()) {
+            Close();
+        }
+        if (_status == HTTPC_ERROR_SEND_HEADER_FAILED && reused) {
+            ++_reconnects;
+            continue;
+        }
+
+        _lastUseMs = millis();
+        if (reused) {
+            ++_reused;
+            _lastHeapDelta = (int32_t)ESP.getFreeHeap() - (int32_t)heapBefore;
+            _minHeapDelta = min(_minHeapDelta, _lastHeapDelta);
+        }
+        break;
+    }
+    return _status;
+}
+
+void S3Connection::Close() {
+    if (_client) {
+        _client->stop();
+        _client = nullptr;
+    }
+    _host[0] = '\0';
+}
+
+void S3Connection::CloseIdle() {
+    if (_client && millis() - _lastUseMs > S3_CONNECTION_IDLE_MS) {
+        Close();
+    }
+}
+
+JsonDocument S3Connection::describe() const {
+    JsonDocument doc;
+    doc["connected"] = _client != nullptr;
+    doc["host"] = _host;
+    doc["requests"] = _requests;
+    doc["reused"] = _reused;
+    doc["reconnects"] = _reconnects;
+    doc["bytes_sent"] = _bytesSent;
+    doc["heap_delta"] = _lastHeapDelta;
+    doc["heap_delta_min"] = _minHeapDelta;
+    return doc;
+}
+
+// Same wording as HTTPClient::errorToString, without building a String
+const char* S3Connection::ErrorToString(int error) {
+    switch (error) {
+    case HTTPC_ERROR_CONNECTION_REFUSED:
+        return "connection refused";
+    case HTTPC_ERROR_SEND_HEADER_FAILED:
+        return "send header failed";
+    case HTTPC_ERROR_SEND_PAYLOAD_FAILED:
+        return "send payload failed";
+    case HTTPC_ERROR_CONNECTION_LOST:
+        return "connection lost";
+    case HTTPC_ERROR_NO_HTTP_SERVER:
+        return "no HTTP server";
+    case HTTPC_ERROR_TOO_LESS_RAM:
+        return "too less ram";
+    case HTTPC_ERROR_READ_TIMEOUT:
+        return "read Timeout";
+    default:
+        return "unknown error";
+    }
+}
@@ -0,0 +1,49 @@
+#include <string.h>
+#include "s3_fetch_cache.h"
+
+S3FetchResult S3FetchCache::Fetch(const char* key, const char* cacheKey, char* body, size_t bodyCap) {
+    _pendingEtag[0] = '\0';
+    if (strlen(cacheKey) >= sizeof(_cacheKey) || bodyCap == 0) {
+        return S3_FETCH_ERROR;
+    }
+    strcpy(_cacheKey, cacheKey);
+
+    // Without a cached body a 304 would leave us with nothing to use
+    char cachedEtag[S3_FETCH_ETAG_MAX] = "";
+    if (!_store.Load(cacheKey, cachedEtag, sizeof(cachedEtag), nullptr, 0)) {
+        cachedEtag[0] = '\0';
+    }
+
+    char etag[S3_FETCH_ETAG_MAX] = "";
+    body[0] = '\0';
+    int status = _transport.Get(key, cachedEtag, body, bodyCap, etag, sizeof(etag));
+
+    if (status == 304 && cachedEtag[0]) {
+        return _store.Load(cacheKey, etag, sizeof(etag), body, bodyCap) ? S3_FETCH_NOT_MODIFIED : S3_FETCH_ERROR;
+    }
+
+    if (status == 200) {
+        if (cachedEtag[0] && strcmp(etag, cachedEtag) == 0) {
+            // Server ignored If-None-Match but the object is the same
+            return S3_FETCH_NOT_MODIFIED;
+        }
+        // Cached by Commit() once the caller accepted it
+        strcpy(_pendingEtag, etag);
+        return S3_FETCH_MODIFIED;
+    }
+
+    if (!_store.Load(cacheKey, etag, sizeof(etag), body, bodyCap)) {
+        body[0] = '\0';
+    }
+    return status == 404 ? S3_FETCH_NOT_FOUND : S3_FETCH_ERROR;
+}
+
+bool S3FetchCache::Commit(const char* body) {
+    if (!_pendingEtag[0]) {
+        // Nothing fetched, or no ETag to revalidate with
+        return false;
+    }
+    _store.Save(_cacheKey, _pendingEtag, body);
+    _pendingEtag[0] = '\0';
+    return true;
+}
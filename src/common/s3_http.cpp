@@ -0,0 +1,194 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "s3_http.h"
+
+// ===== Request =====
+
+void S3RequestHead::Append(const char* text) {
+    size_t len = strlen(text);
+    if (_len + len >= sizeof(_head)) {
+        _overflow = true;
+        return;
+    }
+    memcpy(_head + _len, text, len);
+    _len += len;
+    _head[_len] = '\0';
+}
+
+void S3RequestHead::Begin(const char* host, const char* method, const char* uri) {
+    _len = 0;
+    _overflow = false;
+    _isHead = strcmp(method, "HEAD") == 0;
+    int n = snprintf(_head, sizeof(_head), "%s %s HTTP/1.1\r\nHost: %s\r\n", method, uri, host);
+    if (n < 0 || n >= (int)sizeof(_head)) {
+        _overflow = true;
+        return;
+    }
+    _len = n;
+}
+
+void S3RequestHead::Header(const char* name, const char* value) {
+    Append(name);
+    Append(": ");
+    Append(value);
+    Append("\r\n");
+}
+
+void S3RequestHead::Header(const char* name, unsigned long value) {
+    char digits[12];
+    snprintf(digits, sizeof(digits), "%lu", value);
+    Header(name, digits);
+}
+
+bool S3RequestHead::Finish() {
+    Append("\r\n");
+    return !_overflow;
+}
+
+// ===== Response =====
+
+// One CRLF terminated line, truncated to cap - 1 characters
+bool S3Response::ReadLine(S3ResponseSource& source, char* line, size_t cap) {
+    size_t len = 0;
+    for (;;) {
+        uint8_t c;
+        int n = source.Read(&c, 1);
+        if (n <= 0) {
+            if (n < 0 || !source.Idle()) {
+                return false;
+            }
+            continue;
+        }
+        if (c == '\n') {
+            if (len > 0 && line[len - 1] == '\r') {
+                --len;
+            }
+            line[len] = '\0';
+            return true;
+        }
+        if (len + 1 < cap) {
+            line[len++] = (char)c;
+        }
+    }
+}
+
+// Keep the start of the body for error logs, discard the rest
+bool S3Response::ReadBody(S3ResponseSource& source, size_t length, bool chunked) {
+    size_t kept = strlen(_body);
+    char line[S3_RESPONSE_LINE_SIZE];
+    for (;;) {
+        size_t remaining = length;
+        if (chunked) {
+            if (!ReadLine(source, line, sizeof(line))) {
+                return false;
+            }
+            remaining = strtoul(line, nullptr, 16);
+            if (remaining == 0) {
+                // Trailers up to the empty line
+                while (ReadLine(source, line, sizeof(line)) && line[0]) {
+                }
+                return true;
+            }
+        }
+
+        while (remaining > 0) {
+            uint8_t scratch[64];
+            int n = source.Read(scratch, remaining < sizeof(scratch) ? remaining : sizeof(scratch));
+            if (n <= 0) {
+                if (n < 0 || !source.Idle()) {
+                    return false;
+                }
+                continue;
+            }
+            size_t room = sizeof(_body) - 1 - kept;
+            size_t copy = (size_t)n < room ? (size_t)n : room;
+            memcpy(_body + kept, scratch, copy);
+            kept += copy;
+            _body[kept] = '\0';
+            remaining -= n;
+        }
+
+        if (!chunked) {
+            return true;
+        }
+        // CRLF after the chunk data
+        if (!ReadLine(source, line, sizeof(line))) {
+            return false;
+        }
+    }
+}
+
+int S3Response::Parse(S3ResponseSource& source, bool isHead, bool& gotBytes) {
+    char line[S3_RESPONSE_LINE_SIZE];
+    gotBytes = false;
+    _status = 0;
+    _keepAlive = false;
+    _etag[0] = '\0';
+    _body[0] = '\0';
+
+    // Status line, skipping interim 100 Continue responses
+    int status = 0;
+    do {
+        if (!ReadLine(source, line, sizeof(line))) {
+            return gotBytes ? S3_HTTP_CONNECTION_LOST : S3_HTTP_NO_RESPONSE;
+        }
+        gotBytes = true;
+        if (strncmp(line, "HTTP/1.", 7) != 0 || strlen(line) < 12) {
+            return S3_HTTP_NOT_HTTP;
+        }
+        _keepAlive = line[7] == '1';
+        status = atoi(line + 9);
+
+        if (status == 100) {
+            while (ReadLine(source, line, sizeof(line)) && line[0]) {
+            }
+        }
+    } while (status == 100);
+
+    long contentLength = -1;
+    bool chunked = false;
+    for (;;) {
+        if (!ReadLine(source, line, sizeof(line))) {
+            _keepAlive = false;
+            return S3_HTTP_CONNECTION_LOST;
+        }
+        if (line[0] == '\0') {
+            break;
+        }
+        char* colon = strchr(line, ':');
+        if (!colon) {
+            continue;
+        }
+        *colon = '\0';
+        const char* value = colon + 1;
+        while (*value == ' ') {
+            ++value;
+        }
+        if (strcasecmp(line, "ETag") == 0) {
+            snprintf(_etag, sizeof(_etag), "%s", value);
+        } else if (strcasecmp(line, "Content-Length") == 0) {
+            contentLength = atol(value);
+        } else if (strcasecmp(line, "Transfer-Encoding") == 0) {
+            chunked = strcasecmp(value, "chunked") == 0;
+        } else if (strcasecmp(line, "Connection") == 0) {
+            _keepAlive = strcasecmp(value, "close") != 0;
+        }
+    }
+
+    _status = status;
+    if (isHead || status == 204 || status == 304) {
+        return status;
+    }
+    if (!chunked && contentLength < 0) {
+        // Body runs until the server closes the connection
+        _keepAlive = false;
+        ReadBody(source, SIZE_MAX, false);
+        return status;
+    }
+    if (!ReadBody(source, chunked ? 0 : contentLength, chunked)) {
+        _keepAlive = false;
+    }
+    return status;
+}
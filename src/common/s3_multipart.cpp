@@ -0,0 +1,139 @@
+#define LOG_MODULE LOG_MODULE_UPLOAD
+
+#include <Arduino.h>
+#include <HTTPClient.h>
+#include <Preferences.h>
+#include "secrets.h"
+#include "common.h"
+#include "s3_multipart.h"
+
+#define NVM_PREFS_SECTION "s3-multipart"
+#define NVM_STATE_KEY "state"
+
+// ===== NVM state =====
+
+bool S3MultipartUpload::Load(MultipartState& state) {
+  Preferences prefs;
+  prefs.begin(NVM_PREFS_SECTION, true);
+  bool ok = prefs.getBytesLength(NVM_STATE_KEY) == sizeof(state) &&
+            prefs.getBytes(NVM_STATE_KEY, &state, sizeof(state)) == sizeof(state);
+  prefs.end();
+  return ok;
+}
+
+// One blob, so the upload id and the ETags it goes with are written together
+void S3MultipartUpload::Save(const MultipartState& state) {
+  Preferences prefs;
+  prefs.begin(NVM_PREFS_SECTION, false);
+  if (prefs.putBytes(NVM_STATE_KEY, &state, sizeof(state)) != sizeof(state)) {
+    logPrint(LOG_ERROR, "S3 multipart: saving resume state failed");
+  }
+  prefs.end();
+}
+
+void S3MultipartUpload::Clear() {
+  Preferences prefs;
+  prefs.begin(NVM_PREFS_SECTION, false);
+  prefs.clear();
+  prefs.end();
+}
+
+// ===== S3 requests =====
+
+// Send a signed request for the object. Returns the HTTP status code
+// (or a negative HTTPClient error code on network failure).
+int S3MultipartUpload::Request(const char* method, const char* key, const char* query,
+                               const uint8_t* payload, size_t len,
+                               char* body, size_t bodyCap, char* etag, size_t etagCap) {
+  String host = s3Host();
+  String url = s3Url(String(key) + "?" + query);
+
+  char authHeader[400];
+  char amzDate[18];
+  char payloadHash[65];
+
+  const uint8_t emptyPayload[] = "";
+  generateAWSSignatureV4(method, host.c_str(), key,
+                         AWS_REGION, AWS_ACCESS_KEY_ID, AWS_SECRET_ACCESS_KEY,
+                         payload ? payload : emptyPayload, len,
+                         authHeader, amzDate, payloadHash,
+                         query);
+
+  HTTPClient http;
+  beginS3Request(http, url);
+
+  http.setConnectTimeout(15000);
+  http.setTimeout(60000);
+
+  const char* headerKeys[] = {"ETag"};
+  http.collectHeaders(headerKeys, 1);
+
+  http.addHeader("Host", host);
+  http.addHeader("x-amz-date", amzDate);
+  http.addHeader("x-amz-content-sha256", payloadHash);
+  http.addHeader("Authorization", authHeader);
+
+  int httpResponseCode = http.sendRequest(method, const_cast<uint8_t*>(payload), len);
+
+  if (httpResponseCode > 0) {
+    if (body && bodyCap) {
+      strlcpy(body, http.getString().c_str(), bodyCap);
+    }
+    if (etag && etagCap) {
+      strlcpy(etag, http.header("ETag").c_str(), etagCap);
+    }
+    if (httpResponseCode >= 300) {
+      logPrintf(LOG_WARNING, "S3 multipart %s %s: HTTP %d", method, key, httpResponseCode);
+    }
+  } else {
+    if (body && bodyCap) {
+      body[0] = '\0';
+    }
+    logPrintf(LOG_WARNING, "S3 multipart %s network error: %s", method, http.errorToString(httpResponseCode).c_str());
+  }
+
+  http.end();
+  lastWiFiActivity = millis();
+  return httpResponseCode;
+}
+
+bool S3MultipartUpload::Reconnect() {
+  logPrint(LOG_INFO, "S3 multipart: retrying part after reconnect");
+  return connectWiFi();
+}
+
+// ===== Public API =====
+
+void S3MultipartUpload::AbortPending() {
+  if (connectWiFi()) {
+    _upload.AbortPending();
+  }
+}
+
+bool S3MultipartUpload::Upload(const uint8_t* buf, size_t len, const String& filename, const String& folderName) {
+  if (!connectWiFi()) {
+    return false;
+  }
+
+  // Verify time is set (required for AWS Signature V4)
+  if (time(nullptr) < 100000) {
+    logPrint(LOG_ERROR, "Time not synchronized for S3 multipart upload");
+    return false;
+  }
+
+  String key = "/" + folderName + "/" + filename;
+  MultipartResult result = _upload.Upload(buf, len, key.c_str());
+  switch (result) {
+    case MULTIPART_DONE:
+      logPrintf(LOG_INFO, "S3 multipart completed: %s (%u parts sent%s)", key.c_str(),
+                _upload.PartsSent(), _upload.Resumed() ? ", resumed" : "");
+      return true;
+    case MULTIPART_INVALID:
+      logPrintf(LOG_ERROR, "S3 multipart upload rejected: %s (%u bytes)", key.c_str(), len);
+      return false;
+    default:
+      logPrintf(LOG_WARNING, "S3 multipart upload interrupted: %s at part %u", key.c_str(),
+                _upload.PartCount() + 1);
+      return false;
+  }
+}
@@ -0,0 +1,60 @@
+#include <string.h>
+#include <strings.h>
+#include "s3_policy_url.h"
+
+#define S3_POLICY_HOST_MAX 128
+
+// Case-insensitive "a" + "b" + "c" == host
+static bool hostIs(const char* host, const char* a, const char* b = "", const char* c = "", const char* d = "") {
+    char expected[S3_POLICY_HOST_MAX];
+    size_t n = strlen(a) + strlen(b) + strlen(c) + strlen(d);
+    if (n >= sizeof(expected)) {
+        return false;
+    }
+    strcpy(expected, a);
+    strcat(expected, b);
+    strcat(expected, c);
+    strcat(expected, d);
+    return strcasecmp(host, expected) == 0;
+}
+
+bool s3PolicyUrlAllowed(const char* url, const char* bucket, const char* region, const char* endpoint) {
+    if (!url || !bucket || !bucket[0] || !region) {
+        return false;
+    }
+
+    bool standIn = endpoint && endpoint[0];
+    const char* scheme = standIn ? "http://" : "https://";
+    if (strncasecmp(url, scheme, strlen(scheme)) != 0) {
+        return false;
+    }
+
+    // Authority up to the path; no user info, query or fragment tricks
+    const char* authority = url + strlen(scheme);
+    size_t authorityLen = strcspn(authority, "/?#");
+    if (authorityLen == 0 || authorityLen >= S3_POLICY_HOST_MAX ||
+        memchr(authority, '@', authorityLen) || memchr(authority, '\\', authorityLen)) {
+        return false;
+    }
+    char host[S3_POLICY_HOST_MAX];
+    memcpy(host, authority, authorityLen);
+    host[authorityLen] = '\0';
+    const char* path = authority + authorityLen;
+
+    if (standIn) {
+        return strcasecmp(host, endpoint) == 0 && (strcmp(path, "/") == 0 || path[0] == '\0');
+    }
+
+    // Virtual-hosted: the form posts to the bucket root
+    if (hostIs(host, bucket, ".s3.", region, ".amazonaws.com") || hostIs(host, bucket, ".s3.amazonaws.com")) {
+        return strcmp(path, "/") == 0 || path[0] == '\0';
+    }
+
+    // Path-style: https://s3.<region>.amazonaws.com/<bucket>[/]
+    if (hostIs(host, "s3.", region, ".amazonaws.com") && path[0] == '/') {
+        size_t bucketLen = strlen(bucket);
+        return strncmp(path + 1, bucket, bucketLen) == 0 &&
+               (strcmp(path + 1 + bucketLen, "/") == 0 || path[1 + bucketLen] == '\0');
+    }
+    return false;
+}
@@ -0,0 +1,257 @@
+#define LOG_MODULE LOG_MODULE_UPLOAD
+
+#include <Arduino.h>
+#include <HTTPClient.h>
+#include <Preferences.h>
+#include <ArduinoJson.h>
+#include "esp_timer.h"
+#include "secrets.h"
+#include "common.h"
+#include "aws_iot.h"
+#include "s3_post_policy.h"
+#include "s3_policy_url.h"
+#include "latency_slo.h"
+
+#define NVM_PREFS_SECTION "s3-policy"
+#define NVM_ENABLED_KEY "enabled"
+#define FORM_BOUNDARY "----catshelter7d1f3a9c2b"
+
+S3PostPolicy S3PostPolicy::policy;
+
+/// @brief Read-only stream over preamble + payload + epilogue so the form body
+/// is sent without copying the photo into another buffer
+class MultipartBodyStream : public Stream {
+    const uint8_t* _parts[3];
+    size_t _lens[3];
+    int _part = 0;
+    size_t _pos = 0;
+
+public:
+    MultipartBodyStream(const String& preamble, const uint8_t* payload, size_t len, const String& epilogue) {
+        _parts[0] = (const uint8_t*)preamble.c_str();
+        _lens[0] = preamble.length();
+        _parts[1] = payload;
+        _lens[1] = len;
+        _parts[2] = (const uint8_t*)epilogue.c_str();
+        _lens[2] = epilogue.length();
+    }
+
+    size_t size() const {
+        return _lens[0] + _lens[1] + _lens[2];
+    }
+
+    int available() override {
+        size_t remaining = _part < 3 ? _lens[_part] - _pos : 0;
+        for (int i = _part + 1; i < 3; i++) {
+            remaining += _lens[i];
+        }
+        return (int)remaining;
+    }
+
+    int peek() override {
+        while (_part < 3 && _pos >= _lens[_part]) {
+            ++_part;
+            _pos = 0;
+        }
+        return _part < 3 ? _parts[_part][_pos] : -1;
+    }
+
+    int read() override {
+        int c = peek();
+        if (c >= 0) {
+            ++_pos;
+        }
+        return c;
+    }
+
+    size_t readBytes(char* buffer, size_t length) override {
+        size_t copied = 0;
+        while (copied < length && peek() >= 0) {
+            size_t n = min(length - copied, _lens[_part] - _pos);
+            memcpy(buffer + copied, _parts[_part] + _pos, n);
+            _pos += n;
+            copied += n;
+        }
+        return copied;
+    }
+
+    size_t write(uint8_t) override {
+        return 0;
+    }
+};
+
+static void appendFormField(String& body, const char* name, const char* value) {
+    body += "--" FORM_BOUNDARY "\r\nContent-Disposition: form-data; name=\"";
+    body += name;
+    body += "\"\r\n\r\n";
+    body += value;
+    body += "\r\n";
+}
+
+// ===== State =====
+
+void S3PostPolicy::ReadNVM() {
+    Preferences prefs;
+    prefs.begin(NVM_PREFS_SECTION, true);
+    _enabled = prefs.getBool(NVM_ENABLED_KEY, false);
+    prefs.end();
+}
+
+void S3PostPolicy::SaveNVM() {
+    Preferences prefs;
+    prefs.begin(NVM_PREFS_SECTION, false);
+    prefs.putBool(NVM_ENABLED_KEY, _enabled);
+    prefs.end();
+}
+
+void S3PostPolicy::Begin() {
+    ReadNVM();
+    logPrintf(LOG_INFO, "S3 upload mode: %s", _enabled ? "POST policy" : "SigV4");
+}
+
+bool S3PostPolicy::Valid() const {
+    return _enabled && _url.length() > 0 && time(nullptr) + 30 < _expires;
+}
+
+void S3PostPolicy::Invalidate() {
+    _url = "";
+    _expires = 0;
+    _lastRequestMs = 0;
+}
+
+// Ask the cloud for a fresh policy ahead of expiry (MQTT must be connected)
+void S3PostPolicy::Loop() {
+    if (!_enabled) {
+        return;
+    }
+
+    time_t now = time(nullptr);
+    if (now < 100000 || now + S3_POLICY_REFRESH_MARGIN < _expires) {
+        return;
+    }
+
+    unsigned long nowMs = millis();
+    if (_lastRequestMs != 0 && nowMs - _lastRequestMs < S3_POLICY_REQUEST_INTERVAL) {
+        return;
+    }
+    _lastRequestMs = nowMs;
+
+    JsonDocument doc;
+    doc["device"] = deviceName;
+    doc["timestamp"] = getTimestamp();
+    JsonArray prefixes = doc["prefixes"].to<JsonArray>();
+    if (s3Folder) {
+        prefixes.add(String(s3Folder) + "/");
+    }
+    prefixes.add(String(S3_LIVE_PHOTO) + "/");
+    IoTPublish(buildTopicName("policy-request"), doc, false, 0);
+    logPrint(LOG_DEBUG, "S3 POST policy requested");
+}
+
+// Policy response: {"url": "...", "expires": <epoch>, "fields": {"policy": ..., "x-amz-signature": ..., ...}}
+void S3PostPolicy::Read(const JsonDocument& doc) {
+    const char* url = doc["url"];
+    if (!url || !doc["fields"].is<JsonObjectConst>() || !doc["expires"].is<uint32_t>()) {
+        logPrint(LOG_WARNING, "S3 POST policy: malformed response");
+        return;
+    }
+#ifdef S3_ENDPOINT
+    const char* endpoint = S3_ENDPOINT;
+#else
+    const char* endpoint = nullptr;
+#endif
+    if (!s3PolicyUrlAllowed(url, S3_BUCKET, AWS_REGION, endpoint)) {
+        // The MQTT TLS is not verified: only ever post to our own bucket
+        logPrintf(LOG_ERROR, "S3 POST policy: rejected url %s", url);
+        return;
+    }
+    _url = url;
+    _expires = (time_t)doc["expires"].as<uint32_t>();
+    _fields.clear();
+    _fields.set(doc["fields"]);
+    logPrintf(LOG_INFO, "S3 POST policy received, expires in %ld s", (long)(_expires - time(nullptr)));
+}
+
+void S3PostPolicy::Configure(const JsonDocument& doc) {
+    const char* mode = doc["mode"];
+    if (mode) {
+        _enabled = strcmp(mode, "policy") == 0;
+        if (!_enabled) {
+            Invalidate();
+        }
+        SaveNVM();
+        logPrintf(LOG_INFO, "S3 upload mode: %s", _enabled ? "POST policy" : "SigV4");
+    }
+}
+
+// ===== Upload =====
+
+bool S3PostPolicy::Upload(const uint8_t* buf, size_t len, const String& key, const char* contentType,
+                          const char* contentEncoding) {
+    if (!Valid()) {
+        return false;
+    }
+
+    int64_t start = esp_timer_get_time();
+
+    // Form fields first, the file must be the last part
+    String preamble;
+    preamble.reserve(2048);
+    for (JsonPairConst field : _fields.as<JsonObjectConst>()) {
+        appendFormField(preamble, field.key().c_str(), field.value().as<const char*>());
+    }
+    appendFormField(preamble, "key", key.c_str());
+    appendFormField(preamble, "Content-Type", contentType);
+    if (contentEncoding) {
+        appendFormField(preamble, "Content-Encoding", contentEncoding);
+    }
+    preamble += "--" FORM_BOUNDARY "\r\nContent-Disposition: form-data; name=\"file\"; filename=\"upload\"\r\n";
+    preamble += "Content-Type: ";
+    preamble += contentType;
+    preamble += "\r\n\r\n";
+    String epilogue = "\r\n--" FORM_BOUNDARY "--\r\n";
+
+    MultipartBodyStream body(preamble, buf, len, epilogue);
+    _policyUs += esp_timer_get_time() - start;
+    ++_policyUploads;
+
+    HTTPClient http;
+    beginS3Request(http, _url);
+    http.setConnectTimeout(15000);
+    http.setTimeout(60000);
+    http.addHeader("Content-Type", "multipart/form-data; boundary=" FORM_BOUNDARY);
+
+    // HTTPClient connects inside sendRequest: the connect counts as upload time here
+    LatencySlo::slo.Stamp(SLO_UPLOAD_FIRST_BYTE);
+    int httpResponseCode = http.sendRequest("POST", &body, body.size());
+    http.end();
+
+    if (httpResponseCode >= 200 && httpResponseCode < 300) {
+        logPrintf(LOG_INFO, "Upload successful (POST policy)! HTTP %d", httpResponseCode);
+        return true;
+    }
+
+    logPrintf(LOG_WARNING, "POST policy upload failed: HTTP %d", httpResponseCode);
+    if (httpResponseCode == 403) {
+        // Expired or rejected policy: drop it and ask for a new one
+        Invalidate();
+    }
+    return false;
+}
+
+void S3PostPolicy::RecordSigV4(uint32_t us) {
+    _sigv4Us += us;
+    ++_sigv4Uploads;
+}
+
+JsonDocument S3PostPolicy::describe() const {
+    JsonDocument doc;
+    doc["mode"] = _enabled ? "policy" : "sigv4";
+    doc["valid"] = Valid();
+    doc["expires_in"] = _expires > 0 ? (long)(_expires - time(nullptr)) : 0;
+    doc["policy_uploads"] = _policyUploads;
+    doc["policy_prep_us"] = _policyUploads ? (uint32_t)(_policyUs / _policyUploads) : 0;
+    doc["sigv4_uploads"] = _sigv4Uploads;
+    doc["sigv4_sign_us"] = _sigv4Uploads ? (uint32_t)(_sigv4Us / _sigv4Uploads) : 0;
+    return doc;
+}
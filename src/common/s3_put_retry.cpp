@@ -0,0 +1,113 @@
+#include <string.h>
+#include <strings.h>
+#include "s3_put_retry.h"
+
+bool s3Retryable(int status, const char* body) {
+    if (status <= 0 || status >= 500 || status == 408 || status == 429) {
+        return true;
+    }
+    return status == 400 && strstr(body, "BadDigest");
+}
+
+bool s3EtagMatches(const char* etag, const char* md5Hex) {
+    const char* p = etag;
+    size_t len = strlen(etag);
+    if (len >= 2 && p[0] == '"' && p[len - 1] == '"') {
+        ++p;
+        len -= 2;
+    }
+    return len == 32 && strncasecmp(p, md5Hex, 32) == 0;
+}
+
+S3EtagCheck s3CheckEtag(const char* etag, const char* md5Hex) {
+    if (etag[0] == '\0' || strchr(etag, '-')) {
+        return S3_ETAG_UNVERIFIED;
+    }
+    return s3EtagMatches(etag, md5Hex) ? S3_ETAG_MATCH : S3_ETAG_MISMATCH;
+}
+
+static uint32_t minMs(uint32_t a, uint32_t b) {
+    return a < b ? a : b;
+}
+
+UploadOutcome S3PutRetry::Put(const char* md5Hex, uint32_t connectTimeout, uint32_t timeout, bool verifyEtag) {
+    _target = -1;
+    _attempts = 0;
+
+    uint32_t startMs = _transport.Millis();
+    uint32_t budgetMs = connectTimeout + timeout;
+    uint32_t backoffFrom = startMs;
+    uint32_t backoffMs = UPLOAD_RETRY_MIN_DELAY;
+
+    uint32_t tried = 0;
+    int lostTarget = -1;           // target whose response was lost, the object may exist there
+    for (int attempt = 1; attempt <= UPLOAD_MAX_ATTEMPTS; attempt++) {
+        uint32_t elapsed = _transport.Millis() - startMs;
+        if (attempt > 1 && elapsed + UPLOAD_RETRY_MIN_ATTEMPT_MS > budgetMs) {
+            return UPLOAD_OUTCOME_DEADLINE;
+        }
+        if (attempt > 1 && !_transport.TakeRetry()) {
+            return UPLOAD_OUTCOME_BUDGET;
+        }
+
+        // Healthiest target first, the others next; once all failed, back off and start over
+        int target;
+        if (!_transport.Select(tried, target)) {
+            tried = 0;
+            uint32_t now = _transport.Millis();
+            uint32_t waited = now - backoffFrom;
+            uint32_t wait = waited < backoffMs ? backoffMs - waited : 0;
+            uint32_t spare = budgetMs - minMs(budgetMs, now - startMs + UPLOAD_RETRY_MIN_ATTEMPT_MS);
+            _transport.Delay(minMs(wait, spare));
+            backoffFrom = _transport.Millis();
+            backoffMs = minMs(UPLOAD_RETRY_MAX_DELAY, backoffMs * 2);
+            if (!_transport.Online() || !_transport.Select(tried, target)) {
+                break;
+            }
+        }
+        tried |= 1u << target;
+        _target = target;
+        _attempts = attempt;
+
+        // Later requests only get the time that is left
+        uint32_t left = budgetMs - minMs(budgetMs, _transport.Millis() - startMs);
+        S3PutReply reply;
+        if (target == lostTarget) {
+            ++_heads;
+            _transport.Head(target, minMs(UPLOAD_HEAD_CONNECT_TIMEOUT, left), minMs(UPLOAD_HEAD_TIMEOUT, left), reply);
+            if (reply.status == 200 && s3EtagMatches(reply.etag, md5Hex)) {
+                return UPLOAD_OUTCOME_ALREADY_STORED;
+            }
+            if (s3Retryable(reply.status, reply.body)) {
+                // Still don't know whether it landed: check again next time instead of writing
+                ++_headsInDoubt;
+                continue;
+            }
+            lostTarget = -1;
+            left = budgetMs - minMs(budgetMs, _transport.Millis() - startMs);
+        }
+
+        ++_puts;
+        _transport.Put(target, minMs(connectTimeout, left), minMs(timeout, left), reply);
+
+        // HTTP 2xx codes are success, confirmed by the ETag
+        S3EtagCheck etag = verifyEtag ? s3CheckEtag(reply.etag, md5Hex) : S3_ETAG_SKIPPED;
+        bool ok = reply.status >= 200 && reply.status < 300 && etag != S3_ETAG_MISMATCH;
+        _transport.Recorded(target, reply, etag, ok);
+        if (ok) {
+            return attempt == 1 ? UPLOAD_OUTCOME_FIRST_TRY : UPLOAD_OUTCOME_AFTER_RETRY;
+        }
+
+        lostTarget = reply.status <= 0 ? target : -1;
+        if (reply.status >= 200 && reply.status < 300) {
+            // ETag mismatch: rewrite the same key
+            continue;
+        }
+        // Another target may still take it, but the same request won't fix a 4xx
+        int other;
+        if (!s3Retryable(reply.status, reply.body) && !_transport.Select(tried, other)) {
+            return UPLOAD_OUTCOME_PERMANENT;
+        }
+    }
+    return UPLOAD_OUTCOME_EXHAUSTED;
+}
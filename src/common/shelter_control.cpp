@@ -0,0 +1,138 @@
+#include <math.h>
+#include "shelter_control.h"
+
+// Typical winter temperatures for Pitesti, Romania (December-February) by hour (in Celsius)
+// Based on average winter nighttime lows (-5 to 5°C) and daytime highs (0 to 10°C)
+const float WINTER_TEMP_TABLE[24] = {
+  -2.0,  // 00:00 - coldest part of night
+  -3.0,  // 01:00
+  -3.5,  // 02:00
+  -4.0,  // 03:00 - coldest before dawn
+  -3.5,  // 04:00
+  -3.0,  // 05:00
+  -2.0,  // 06:00 - sunrise
+  -1.0,  // 07:00
+   0.0,  // 08:00
+   2.0,  // 09:00
+   4.0,  // 10:00 - warming up
+   6.0,  // 11:00
+   7.0,  // 12:00 - peak daytime
+   8.0,  // 13:00
+   7.0,  // 14:00
+   6.0,  // 15:00 - starting to cool
+   4.0,  // 16:00
+   2.0,  // 17:00 - sunset
+   1.0,  // 18:00
+   0.0,  // 19:00
+  -1.0,  // 20:00
+  -1.5,  // 21:00
+  -2.0,  // 22:00
+  -2.0   // 23:00
+};
+
+PresenceChange ShelterState::Motion(bool motion, uint32_t now) {
+    // PIR HC-SR501 is a MOTION detector, not a PRESENCE sensor
+    // Motion detection extends the presence timer (cat might be sleeping)
+    if (motion) {
+        PresenceChange change = catPresent ? PRESENCE_EXTENDED : PRESENCE_ARRIVED;
+        catPresent = true;
+        lastMotionDetected = now;
+        return change;
+    }
+    // No current motion - check if presence timeout expired
+    if (catPresent && (now - lastMotionDetected) >= CAT_PRESENCE_TIMEOUT) {
+        catPresent = false;
+        return PRESENCE_TIMEOUT;
+    }
+    return PRESENCE_NONE;
+}
+
+DhtChange ShelterState::Reading(float temp, float humidity) {
+    if (isnan(temp) || isnan(humidity)) {
+        if (!dhtSensorWorking) {
+            return DHT_STILL_FAILED;
+        }
+        dhtSensorWorking = false;
+        return DHT_FAILED;
+    }
+
+    DhtChange change = dhtSensorWorking ? DHT_READING : DHT_RECOVERED;
+    dhtSensorWorking = true;
+    currentTemp = temp;
+    currentHumidity = humidity;
+    return change;
+}
+
+float ShelterState::ExpectedTemperature(int hour) {
+    if (hour < 0) {
+        // Time not synced, assume coldest hour (3 AM)
+        return WINTER_TEMP_TABLE[3];
+    }
+    return WINTER_TEMP_TABLE[hour < 24 ? hour : 0];
+}
+
+float ShelterState::EffectiveTemperature(int hour, TempSource* source) const {
+    TempSource from = TEMP_SOURCE_SENSOR;
+    if (!dhtSensorWorking) {
+        from = TEMP_SOURCE_FAILED;
+    } else if (currentTemp > TEMP_MAX_REASONABLE || currentTemp < TEMP_MIN_REASONABLE) {
+        // Direct sunlight on the sensor or a malfunction
+        from = TEMP_SOURCE_ABERRANT;
+    }
+    if (source) {
+        *source = from;
+    }
+    return from == TEMP_SOURCE_SENSOR ? currentTemp : ExpectedTemperature(hour);
+}
+
+BlanketStep ShelterState::Blanket(float effectiveTemp, uint32_t now, uint32_t* remainingMs) const {
+    // Skip automatic control if in manual override mode
+    if (blanketManualOverride) {
+        return BLANKET_KEEP;
+    }
+
+    // Blanket should be on if the cat is present and it is cold
+    bool shouldBeOn = catPresent && (effectiveTemp < TEMP_COLD_THRESHOLD);
+    if (shouldBeOn == blanketOn) {
+        return BLANKET_KEEP;
+    }
+
+    // Debouncing: only change state if minimum time has elapsed
+    uint32_t timeSinceLastChange = now - lastBlanketChange;
+    if (timeSinceLastChange >= BLANKET_MIN_STATE_TIME) {
+        return BLANKET_SWITCH;
+    }
+    if (remainingMs) {
+        *remainingMs = BLANKET_MIN_STATE_TIME - timeSinceLastChange;
+    }
+    return BLANKET_DELAYED;
+}
+
+bool ShelterState::SetBlanket(bool on, uint32_t now) {
+    if (on == blanketOn) {
+        return false;
+    }
+    blanketOn = on;
+    lastBlanketChange = now;
+    return true;
+}
+
+PhotoTrigger ShelterState::Photo(uint32_t now) {
+    // Check for scheduled photo (regular interval)
+    if (now - lastHourlyPhotoTime >= PHOTO_HOURLY_INTERVAL) {
+        lastHourlyPhotoTime = now;
+        lastPhotoTime = now;
+        return PHOTO_SCHEDULED;
+    }
+
+    // Take photo when cat arrives, but not more often than the cooldown
+    bool catJustArrived = catPresent && !lastCatPresent;
+    bool cooldownExpired = (now - lastPhotoTime) >= PHOTO_MOTION_COOLDOWN;
+    lastCatPresent = catPresent;
+
+    if (catJustArrived && cooldownExpired) {
+        lastPhotoTime = now;
+        return PHOTO_MOTION;
+    }
+    return PHOTO_NONE;
+}
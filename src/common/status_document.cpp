@@ -0,0 +1,46 @@
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <math.h>
+#include "status_document.h"
+
+JsonDocumentSink::JsonDocumentSink(JsonDocument& doc) {
+    _objects[0] = doc.to<JsonObject>();
+}
+
+void JsonDocumentSink::BeginObject(const char* key) {
+    JsonObject child = _objects[_depth][key].to<JsonObject>();
+    if (_depth < STATUS_WRITER_MAX_DEPTH) {
+        _objects[++_depth] = child;
+    }
+}
+
+void JsonDocumentSink::EndObject() {
+    if (_depth > 0) {
+        --_depth;
+    }
+}
+
+void JsonDocumentSink::Text(const char* key, const char* value) {
+    _objects[_depth][key] = value;
+}
+
+void JsonDocumentSink::Int(const char* key, int64_t value) {
+    _objects[_depth][key] = value;
+}
+
+void JsonDocumentSink::Float(const char* key, double value, int decimals) {
+    if (isnan(value) || isinf(value)) {
+        _objects[_depth][key] = nullptr;
+        return;
+    }
+    // Same precision as the S3 document, not the float noise
+    double scale = 1;
+    for (int i = 0; i < constrain(decimals, 0, 6); i++) {
+        scale *= 10;
+    }
+    _objects[_depth][key] = round(value * scale) / scale;
+}
+
+void JsonDocumentSink::Bool(const char* key, bool value) {
+    _objects[_depth][key] = value;
+}
@@ -0,0 +1,175 @@
+#include <math.h>
+#include "status_writer.h"
+
+JsonBufferWriter::JsonBufferWriter(char* buf, size_t cap, bool pretty)
+    : _buf(buf), _cap(cap), _pretty(pretty) {
+    _first[0] = true;
+    Put('{');
+}
+
+void JsonBufferWriter::Put(char c) {
+    // Keep room for the terminator
+    if (_len + 1 >= _cap) {
+        _overflow = true;
+        return;
+    }
+    _buf[_len++] = c;
+}
+
+void JsonBufferWriter::Put(const char* text) {
+    while (*text) {
+        Put(*text++);
+    }
+}
+
+void JsonBufferWriter::PutEscaped(const char* text) {
+    static const char HEX_DIGITS[] = "0123456789abcdef";
+    Put('"');
+    for (const char* p = text; *p; ++p) {
+        unsigned char c = (unsigned char)*p;
+        if (c == '"' || c == '\\') {
+            Put('\\');
+            Put((char)c);
+        } else if (c == '\n') {
+            Put("\\n");
+        } else if (c == '\r') {
+            Put("\\r");
+        } else if (c == '\t') {
+            Put("\\t");
+        } else if (c < 0x20) {
+            Put("\\u00");
+            Put(HEX_DIGITS[c >> 4]);
+            Put(HEX_DIGITS[c & 0xf]);
+        } else {
+            Put((char)c);
+        }
+    }
+    Put('"');
+}
+
+void JsonBufferWriter::PutUnsigned(uint64_t value) {
+    char digits[21];
+    int n = 0;
+    do {
+        digits[n++] = '0' + value % 10;
+        value /= 10;
+    } while (value);
+    while (n) {
+        Put(digits[--n]);
+    }
+}
+
+void JsonBufferWriter::Key(const char* key) {
+    if (!_first[_depth]) {
+        Put(',');
+    }
+    _first[_depth] = false;
+    if (_pretty) {
+        Put('\n');
+        for (int i = 0; i <= _depth; i++) {
+            Put("  ");
+        }
+    }
+    PutEscaped(key);
+    Put(_pretty ? ": " : ":");
+}
+
+void JsonBufferWriter::Close(char bracket) {
+    if (_pretty) {
+        Put('\n');
+        for (int i = 0; i < _depth; i++) {
+            Put("  ");
+        }
+    }
+    Put(bracket);
+}
+
+void JsonBufferWriter::BeginObject(const char* key) {
+    Key(key);
+    Put('{');
+    if (_depth >= STATUS_WRITER_MAX_DEPTH) {
+        _overflow = true;
+        return;
+    }
+    _first[++_depth] = true;
+}
+
+void JsonBufferWriter::EndObject() {
+    if (_depth == 0) {
+        return;
+    }
+    Close('}');
+    --_depth;
+}
+
+size_t JsonBufferWriter::Finish() {
+    while (_depth > 0) {
+        EndObject();
+    }
+    Close('}');
+    _buf[_overflow ? 0 : _len] = '\0';
+    return _overflow ? 0 : _len;
+}
+
+void JsonBufferWriter::Text(const char* key, const char* value) {
+    Key(key);
+    PutEscaped(value ? value : "");
+}
+
+void JsonBufferWriter::Int(const char* key, int64_t value) {
+    Key(key);
+    if (value < 0) {
+        Put('-');
+        PutUnsigned((uint64_t)0 - (uint64_t)value);
+    } else {
+        PutUnsigned(value);
+    }
+}
+
+// Same digits as String(value, decimals), i.e. dtostrf: add half a unit of
+// the last place, then peel the digits off one at a time
+void JsonBufferWriter::Float(const char* key, double value, int decimals) {
+    Key(key);
+    // JSON has no NaN
+    if (isnan(value) || isinf(value)) {
+        Put("null");
+        return;
+    }
+    decimals = decimals < 0 ? 0 : decimals > 6 ? 6 : decimals;
+    if (value < 0.0) {
+        Put('-');
+        value = -value;
+    }
+    double rounding = 2.0;
+    for (int i = 0; i < decimals; i++) {
+        rounding *= 10.0;
+    }
+    value += 1.0 / rounding;
+
+    double tenpow = 1.0;
+    int digits = 1;
+    while (value >= 10.0 * tenpow) {
+        tenpow *= 10.0;
+        digits++;
+    }
+    value /= tenpow;
+
+    digits += decimals;
+    while (digits-- > 0) {
+        int digit = (int)value;
+        if (digit > 9) {
+            digit = 9;
+        }
+        Put((char)('0' + digit));
+        if (digits == decimals && decimals > 0) {
+            Put('.');
+        }
+        value -= digit;
+        value *= 10.0;
+    }
+}
+
+void JsonBufferWriter::Bool(const char* key, bool value) {
+    Key(key);
+    Put(value ? "true" : "false");
+}
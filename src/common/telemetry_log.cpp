@@ -0,0 +1,296 @@
+#define LOG_MODULE LOG_MODULE_UPLOAD
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <ArduinoJson.h>
+#include "secrets.h"
+#include "common.h"
+#include "aws_iot.h"
+#include "telemetry_log.h"
+
+#define NVM_PREFS_SECTION "telemetry"
+#define NVM_ENABLED_KEY "enabled"
+#define NVM_INTERVAL_KEY "interval"
+#define NVM_MQTT_KEY "mqtt"
+
+TelemetryLog TelemetryLog::telemetry;
+
+static const char* SERIES_NAMES[TELEMETRY_SERIES_COUNT] = {
+    "temperature", "humidity", "lux", "motion", "blanket"};
+
+void TelemetryLog::ReadNVM() {
+    Preferences prefs;
+    prefs.begin(NVM_PREFS_SECTION, true);
+    _enabled = prefs.getBool(NVM_ENABLED_KEY, true);
+    _intervalMinutes = prefs.getUShort(NVM_INTERVAL_KEY, TELEMETRY_DEFAULT_INTERVAL);
+    _mqtt = prefs.getBool(NVM_MQTT_KEY, false);
+    prefs.end();
+    _loaded = true;
+}
+
+void TelemetryLog::SaveNVM() {
+    Preferences prefs;
+    prefs.begin(NVM_PREFS_SECTION, false);
+    prefs.putBool(NVM_ENABLED_KEY, _enabled);
+    prefs.putUShort(NVM_INTERVAL_KEY, _intervalMinutes);
+    prefs.putBool(NVM_MQTT_KEY, _mqtt);
+    prefs.end();
+}
+
+bool TelemetryLog::Enabled() {
+    if (!_loaded) {
+        ReadNVM();
+    }
+    return _enabled;
+}
+
+// Streams and queue in PSRAM when present, a smaller set in internal RAM otherwise
+bool TelemetryLog::Allocate() {
+    if (_streams) {
+        return true;
+    }
+    bool psram = psramFound();
+    _seriesBytes = psram ? TELEMETRY_SERIES_BYTES_PSRAM : TELEMETRY_SERIES_BYTES;
+    _queueCap = psram ? TELEMETRY_QUEUE_BYTES_PSRAM : TELEMETRY_QUEUE_BYTES;
+    size_t total = TELEMETRY_SERIES_COUNT * _seriesBytes + _queueCap;
+    uint8_t* mem = (uint8_t*)(psram ? ps_malloc(total) : malloc(total));
+    if (!mem) {
+        logPrintf(LOG_ERROR, "Telemetry: allocation of %u bytes failed", total);
+        _enabled = false;
+        return false;
+    }
+    _streams = mem;
+    _queue = mem + TELEMETRY_SERIES_COUNT * _seriesBytes;
+    _queueLen = 0;
+    _queued = 0;
+    logPrintf(LOG_INFO, "Telemetry buffers: %u bytes (%s)", total, psram ? "PSRAM" : "internal");
+    return true;
+}
+
+// Motion/blanket carry their last state into the new batch, so each batch
+// can be read on its own
+void TelemetryLog::StartBatch(uint32_t now) {
+    float states[TELEMETRY_SERIES_COUNT];
+    bool carry[TELEMETRY_SERIES_COUNT];
+    for (int i = 0; i < TELEMETRY_SERIES_COUNT; i++) {
+        carry[i] = (i == TELEMETRY_MOTION || i == TELEMETRY_BLANKET) && _writers[i].HasLast();
+        states[i] = carry[i] ? _writers[i].LastValue() : 0;
+    }
+    for (int i = 0; i < TELEMETRY_SERIES_COUNT; i++) {
+        _writers[i].Begin(_streams + i * _seriesBytes, _seriesBytes);
+        if (carry[i]) {
+            _writers[i].Append(now, states[i]);
+        }
+    }
+    _batchStart = now;
+}
+
+void TelemetryLog::Seal(uint32_t now) {
+    size_t size = sizeof(TelemetryHeader);
+    uint8_t seriesCount = 0;
+    uint32_t samples = 0;
+    for (int i = 0; i < TELEMETRY_SERIES_COUNT; i++) {
+        if (_writers[i].Count() > 0) {
+            size += sizeof(TelemetrySeriesHeader) + _writers[i].Bytes();
+            samples += _writers[i].Count();
+            ++seriesCount;
+        }
+    }
+    if (seriesCount == 0) {
+        return;
+    }
+
+    // Oldest batches make room
+    size_t need = sizeof(uint32_t) + size;
+    while (_queued > 0 && _queueLen + need > _queueCap) {
+        uint32_t len;
+        memcpy(&len, _queue, sizeof(len));
+        size_t recordLen = sizeof(len) + len;
+        memmove(_queue, _queue + recordLen, _queueLen - recordLen);
+        _queueLen -= recordLen;
+        --_queued;
+        ++_dropped;
+        logPrint(LOG_WARNING, "Telemetry: queue full, oldest batch dropped");
+    }
+    if (_queueLen + need > _queueCap) {
+        ++_dropped;
+        return;
+    }
+
+    uint8_t* p = _queue + _queueLen;
+    uint32_t len = size;
+    memcpy(p, &len, sizeof(len));
+    p += sizeof(len);
+
+    TelemetryHeader header;
+    memcpy(header.magic, TELEMETRY_MAGIC, sizeof(header.magic));
+    header.version = TELEMETRY_VERSION;
+    header.seriesCount = seriesCount;
+    header.reserved = 0;
+    header.startTime = _batchStart;
+    header.endTime = now;
+    memcpy(p, &header, sizeof(header));
+    p += sizeof(header);
+
+    for (int i = 0; i < TELEMETRY_SERIES_COUNT; i++) {
+        const GorillaWriter& writer = _writers[i];
+        if (writer.Count() == 0) {
+            continue;
+        }
+        TelemetrySeriesHeader series = {(uint8_t)i, 0, writer.Count(), (uint16_t)writer.Bytes(), 0};
+        memcpy(p, &series, sizeof(series));
+        p += sizeof(series);
+        memcpy(p, writer.Data(), writer.Bytes());
+        p += writer.Bytes();
+    }
+
+    _queueLen += need;
+    ++_queued;
+    ++_batches;
+    _rawBytes += samples * 8;
+    _sealedBytes += size;
+    logPrintf(LOG_DEBUG, "Telemetry: batch of %u samples sealed (%u bytes)", samples, size);
+}
+
+void TelemetryLog::Record(TelemetrySeries series, float value) {
+    if (!Enabled() || !Allocate()) {
+        return;
+    }
+    time_t now = time(nullptr);
+    if (now < 100000) {
+        return;
+    }
+    if (_batchStart == 0) {
+        StartBatch((uint32_t)now);
+    }
+    if (!_writers[series].Append((uint32_t)now, value)) {
+        // Stream full: seal early rather than lose samples
+        Seal((uint32_t)now);
+        StartBatch((uint32_t)now);
+        _writers[series].Append((uint32_t)now, value);
+    }
+    ++_samples;
+}
+
+void TelemetryLog::RecordState(TelemetrySeries series, bool state) {
+    float value = state ? 1 : 0;
+    if (_batchStart != 0 && _writers[series].HasLast() && _writers[series].LastValue() == value) {
+        return;
+    }
+    Record(series, value);
+}
+
+// Oldest batch first, to MQTT when configured and it fits, else to S3
+bool TelemetryLog::Upload() {
+    uint32_t len;
+    memcpy(&len, _queue, sizeof(len));
+    const uint8_t* batch = _queue + sizeof(len);
+
+    bool ok = false;
+    String topic = buildTopicName("telemetry");
+    if (_mqtt && isIotConnected() && len <= IoTMaxPayload(topic)) {
+        ok = IoTPublish(topic, batch, len, false, 0);
+    } else {
+        if (UploadScheduler::scheduler.Admit(UPLOAD_TELEMETRY, len, 0) == UPLOAD_SKIP) {
+            _lastFailMs = millis();
+            return false;
+        }
+        TelemetryHeader header;
+        memcpy(&header, batch, sizeof(header));
+        time_t start = (time_t)header.startTime;
+        struct tm timeinfo;
+        gmtime_r(&start, &timeinfo);
+        char filename[48];
+        strftime(filename, sizeof(filename), "telemetry_%Y%m%d_%H%M%S" TELEMETRY_EXTENSION, &timeinfo);
+        ok = uploadBufferToS3(batch, len, filename, String(s3Folder), "application/octet-stream");
+        if (ok) {
+            UploadScheduler::scheduler.Consume(UPLOAD_TELEMETRY, len);
+        }
+    }
+
+    if (!ok) {
+        ++_failed;
+        _lastFailMs = millis();
+        logPrint(LOG_WARNING, "Telemetry batch upload failed");
+        return false;
+    }
+
+    size_t recordLen = sizeof(len) + len;
+    memmove(_queue, _queue + recordLen, _queueLen - recordLen);
+    _queueLen -= recordLen;
+    --_queued;
+    ++_uploaded;
+    _lastFailMs = 0;
+    return true;
+}
+
+void TelemetryLog::Loop() {
+    if (!Enabled() || !_streams) {
+        return;
+    }
+    time_t now = time(nullptr);
+    if (_batchStart != 0 && now >= 100000 && (uint32_t)now - _batchStart >= _intervalMinutes * 60UL) {
+        Seal((uint32_t)now);
+        StartBatch((uint32_t)now);
+    }
+
+    if (_queued == 0 || !IsWiFiConnected()) {
+        return;
+    }
+    if (_lastFailMs != 0 && millis() - _lastFailMs < TELEMETRY_RETRY_INTERVAL) {
+        return;
+    }
+    Upload();
+}
+
+void TelemetryLog::Configure(const JsonDocument& doc) {
+    Enabled();
+    bool changed = false;
+    if (doc["enabled"].is<bool>()) {
+        _enabled = doc["enabled"].as<bool>();
+        changed = true;
+    }
+    if (doc["interval_minutes"].is<int>()) {
+        _intervalMinutes = constrain(doc["interval_minutes"].as<int>(), 1, TELEMETRY_MAX_INTERVAL);
+        changed = true;
+    }
+    if (doc["mqtt"].is<bool>()) {
+        _mqtt = doc["mqtt"].as<bool>();
+        changed = true;
+    }
+    if (changed) {
+        SaveNVM();
+        logPrintf(LOG_INFO, "Telemetry %s, %u min batches to %s", _enabled ? "enabled" : "disabled",
+                  _intervalMinutes, _mqtt ? "MQTT" : "S3");
+    }
+    if (doc["flush"].is<bool>() && doc["flush"].as<bool>() && _streams && _batchStart != 0) {
+        uint32_t now = (uint32_t)time(nullptr);
+        Seal(now);
+        StartBatch(now);
+        _lastFailMs = 0;
+    }
+}
+
+JsonDocument TelemetryLog::describe() {
+    JsonDocument doc;
+    doc["enabled"] = Enabled();
+    doc["interval_minutes"] = _intervalMinutes;
+    doc["mqtt"] = _mqtt;
+    doc["series_bytes"] = _seriesBytes;
+    doc["queue_bytes"] = _queueCap;
+    doc["queue_used"] = _queueLen;
+    doc["queued"] = _queued;
+    doc["samples"] = _samples;
+    doc["batches"] = _batches;
+    doc["uploaded"] = _uploaded;
+    doc["dropped"] = _dropped;
+    doc["failed"] = _failed;
+    doc["ratio"] = _rawBytes ? (float)_sealedBytes / _rawBytes : 0;
+    if (_streams && _batchStart != 0) {
+        JsonObject pending = doc["pending"].to<JsonObject>();
+        for (int i = 0; i < TELEMETRY_SERIES_COUNT; i++) {
+            pending[SERIES_NAMES[i]] = _writers[i].Count();
+        }
+    }
+    return doc;
+}
@@ -0,0 +1,211 @@
+#define LOG_MODULE LOG_MODULE_UPLOAD
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <ArduinoJson.h>
+#include "secrets.h"
+#include "common.h"
+#include "s3_multipart.h"
+#include "timelapse_bundle.h"
+
+#define NVM_PREFS_SECTION "timelapse"
+#define NVM_ENABLED_KEY "enabled"
+
+TimelapseBundle TimelapseBundle::bundle;
+
+void TimelapseBundle::ReadNVM() {
+    Preferences prefs;
+    prefs.begin(NVM_PREFS_SECTION, true);
+    _enabled = prefs.getBool(NVM_ENABLED_KEY, false);
+    prefs.end();
+    _loaded = true;
+}
+
+void TimelapseBundle::SaveNVM() {
+    Preferences prefs;
+    prefs.begin(NVM_PREFS_SECTION, false);
+    prefs.putBool(NVM_ENABLED_KEY, _enabled);
+    prefs.end();
+}
+
+bool TimelapseBundle::Enabled() {
+    if (!_loaded) {
+        ReadNVM();
+    }
+    return _enabled;
+}
+
+// Bundle buffer lives in PSRAM, boards without it keep uploading single frames
+bool TimelapseBundle::Allocate() {
+    if (_buf) {
+        return true;
+    }
+    if (!psramFound()) {
+        return false;
+    }
+
+    size_t available = ESP.getMaxAllocPsram();
+    if (available < TIMELAPSE_PSRAM_HEADROOM + TIMELAPSE_MIN_CAPACITY) {
+        logPrintf(LOG_WARNING, "Time-lapse: not enough PSRAM (%u bytes)", available);
+        return false;
+    }
+    _capacity = min((size_t)TIMELAPSE_BUNDLE_CAPACITY, available - TIMELAPSE_PSRAM_HEADROOM);
+    _buf = (uint8_t*)ps_malloc(_capacity);
+    if (!_buf) {
+        logPrint(LOG_ERROR, "Time-lapse: bundle allocation failed");
+        return false;
+    }
+
+    _len = sizeof(TimelapseHeader);
+    _count = 0;
+    logPrintf(LOG_INFO, "Time-lapse bundle buffer: %u bytes", _capacity);
+    return true;
+}
+
+// Room for the frame plus the index entry it adds
+bool TimelapseBundle::Fits(size_t len) const {
+    return _count < TIMELAPSE_MAX_FRAMES &&
+           _len + len + (_count + 1) * sizeof(TimelapseIndexEntry) <= _capacity;
+}
+
+bool TimelapseBundle::Append(const uint8_t* jpeg, size_t len, const char* metadata, size_t metadataLen) {
+    if (!Enabled() || !Allocate()) {
+        return false;
+    }
+
+    time_t now = time(nullptr);
+    if (now < 100000) {
+        return false;
+    }
+
+    // A new hour starts a new bundle. While the previous hour's bundle can't
+    // be uploaded the frame goes up on its own, so it never lands in the
+    // object of an hour it wasn't taken in; Loop() retries the old bundle.
+    if (_count > 0 && (uint32_t)now / TIMELAPSE_PERIOD != _startTime / TIMELAPSE_PERIOD && !Flush()) {
+        return false;
+    }
+
+    size_t frameLen = len + metadataLen;
+    if (!Fits(frameLen)) {
+        Flush();
+        if (!Fits(frameLen)) {
+            return false;
+        }
+    }
+
+    if (_count == 0) {
+        _startTime = (uint32_t)now;
+    }
+
+    TimelapseIndexEntry& entry = _index[_count++];
+    entry.timestamp = (uint32_t)now;
+    entry.offset = _len;
+    entry.length = len;
+    entry.metaLength = metadataLen;
+
+    memcpy(_buf + _len, jpeg, len);
+    _len += len;
+    memcpy(_buf + _len, metadata, metadataLen);
+    _len += metadataLen;
+
+    ++_frames;
+    logPrintf(LOG_INFO, "Time-lapse: frame %u added (%u bytes in bundle)", _count, _len);
+    return true;
+}
+
+// Write header and index around the frames, returns the bundle size
+size_t TimelapseBundle::Finalize() {
+    TimelapseHeader header;
+    memcpy(header.magic, TIMELAPSE_MAGIC, sizeof(header.magic));
+    header.version = TIMELAPSE_VERSION;
+    header.reserved = 0;
+    header.frameCount = _count;
+    header.indexOffset = _len;
+    header.startTime = _startTime;
+    memcpy(_buf, &header, sizeof(header));
+
+    size_t indexLen = _count * sizeof(TimelapseIndexEntry);
+    memcpy(_buf + _len, _index, indexLen);
+    return _len + indexLen;
+}
+
+bool TimelapseBundle::Flush() {
+    if (!_buf || _count == 0) {
+        return true;
+    }
+
+    size_t size = Finalize();
+
+    time_t start = (time_t)_startTime;
+    struct tm timeinfo;
+    gmtime_r(&start, &timeinfo);
+    char filename[48];
+    strftime(filename, sizeof(filename), "timelapse_%Y%m%d_%H" TIMELAPSE_EXTENSION, &timeinfo);
+
+    logPrintf(LOG_INFO, "Time-lapse: uploading %s (%u frames, %u bytes)", filename, _count, size);
+
+    bool ok;
+    if (size > S3_MULTIPART_PART_SIZE) {
+        static S3MultipartUpload upload;    // resume state is too large for the loop stack
+        ok = upload.Upload(_buf, size, filename, String(s3Folder));
+    } else {
+        ok = uploadBufferToS3(_buf, size, filename, String(s3Folder), "application/octet-stream");
+    }
+
+    if (!ok) {
+        // Keep the frames, the index is rewritten on the next attempt
+        ++_failed;
+        _lastFailMs = millis();
+        logPrint(LOG_WARNING, "Time-lapse bundle upload failed");
+        return false;
+    }
+
+    UploadScheduler::scheduler.Consume(UPLOAD_SCHEDULED, size);
+    lastWiFiActivity = millis();
+    ++_bundles;
+    _lastBundleBytes = size;
+    _len = sizeof(TimelapseHeader);
+    _count = 0;
+    _lastFailMs = 0;
+    return true;
+}
+
+// Upload the previous hour's bundle even when no new frame arrives to push it out
+void TimelapseBundle::Loop() {
+    if (_count == 0 || !IsWiFiConnected()) {
+        return;
+    }
+    if (_lastFailMs != 0 && millis() - _lastFailMs < TIMELAPSE_RETRY_INTERVAL) {
+        return;
+    }
+
+    time_t now = time(nullptr);
+    if ((uint32_t)now / TIMELAPSE_PERIOD != _startTime / TIMELAPSE_PERIOD) {
+        Flush();
+    }
+}
+
+void TimelapseBundle::Configure(const JsonDocument& doc) {
+    Enabled();
+    if (doc["enabled"].is<bool>()) {
+        _enabled = doc["enabled"].as<bool>();
+        SaveNVM();
+        logPrintf(LOG_INFO, "Time-lapse bundling %s", _enabled ? "enabled" : "disabled");
+    }
+    if (doc["flush"].is<bool>() && doc["flush"].as<bool>()) {
+        Flush();
+    }
+}
+
+JsonDocument TimelapseBundle::describe() {
+    JsonDocument doc;
+    doc["enabled"] = Enabled();
+    doc["capacity"] = _capacity;
+    doc["pending_frames"] = _count;
+    doc["pending_bytes"] = _count ? _len : 0;
+    doc["frames"] = _frames;
+    doc["bundles"] = _bundles;
+    doc["failed"] = _failed;
+    doc["last_bundle_bytes"] = _lastBundleBytes;
+    return doc;
+}
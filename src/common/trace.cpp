@@ -0,0 +1,68 @@
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <esp_timer.h>
+#include "common.h"
+#include "trace.h"
+
+TraceRing Trace::_rings;
+uint32_t Trace::_spanCostNs = 0;
+
+void Trace::Record(const char* name, int64_t startUs, int64_t endUs) {
+    _rings.Record(xPortGetCoreID(), xTaskGetCurrentTaskHandle(), name, startUs, endUs);
+}
+
+void Trace::Enable(bool enabled) {
+    _rings.Enable(enabled);
+}
+
+void Trace::Clear() {
+    _rings.Clear();
+}
+
+void Trace::ChromeJson(char* buf, size_t cap, bool split,
+                       void (*flush)(const char* json, size_t len, void* ctx), void* ctx) {
+    _rings.ChromeJson(esp_timer_get_time(), buf, cap, split, flush, ctx);
+}
+
+size_t Trace::Recent(TraceEvent* out, uint8_t* cores, size_t max) {
+    return _rings.Recent((uint32_t)esp_timer_get_time(), out, cores, max);
+}
+
+// Times real spans, so they take the oldest slots of this core's ring
+void Trace::Calibrate() {
+    if (!Recording()) {
+        return;
+    }
+    const int rounds = 64;
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < rounds; i++) {
+        TraceSpan span("trace.calibrate");
+    }
+    _spanCostNs = (uint32_t)((esp_timer_get_time() - start) * 1000 / rounds);
+}
+
+JsonDocument Trace::describe() {
+    JsonDocument doc;
+    doc["enabled"] = _rings.Enabled();
+    doc["spans"] = _rings.Spans();
+    doc["ring_events"] = TRACE_RING_EVENTS;
+    JsonArray held = doc["held"].to<JsonArray>();
+    for (int core = 0; core < TRACE_CORES; core++) {
+        held.add(_rings.Held(core));
+    }
+    doc["span_cost_ns"] = _spanCostNs;
+    return doc;
+}
+
+void Trace::Configure(const JsonDocument& doc) {
+    if (doc["enabled"].is<bool>()) {
+        Enable(doc["enabled"]);
+        logPrintf(LOG_INFO, "Tracing %s", doc["enabled"].as<bool>() ? "enabled" : "disabled");
+    }
+    if (doc["clear"] | false) {
+        Clear();
+    }
+    if (doc["calibrate"] | false) {
+        Calibrate();
+    }
+}
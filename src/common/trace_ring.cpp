@@ -0,0 +1,126 @@
+#include <stdio.h>
+#include <string.h>
+#include "trace_ring.h"
+
+void TraceRing::Record(int core, void* task, const char* name, int64_t startUs, int64_t endUs) {
+    uint32_t slot = _head[core].fetch_add(1, std::memory_order_relaxed) % TRACE_RING_EVENTS;
+    TraceEvent& e = _ring[core][slot];
+    e.startUs = (uint32_t)startUs;
+    e.durUs = (uint32_t)(endUs - startUs);
+    e.task = task;
+    e.name = name;
+    _spans.fetch_add(1, std::memory_order_relaxed);
+}
+
+void TraceRing::Enable(bool enabled) {
+    _enabled.store(enabled, std::memory_order_relaxed);
+}
+
+void TraceRing::Clear() {
+    _paused.store(true);
+    for (int core = 0; core < TRACE_CORES; core++) {
+        memset(_ring[core], 0, sizeof(_ring[core]));
+        _head[core].store(0);
+    }
+    _paused.store(false);
+}
+
+#define TRACE_JSON_HEADER "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n" \
+    "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":\"core 0\"}},\n" \
+    "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"core 1\"}}"
+#define TRACE_JSON_FOOTER "\n]}\n"
+
+void TraceRing::ChromeJson(int64_t nowUs, char* buf, size_t cap, bool split,
+                           void (*flush)(const char* json, size_t len, void* ctx), void* ctx) {
+    const size_t headerLen = sizeof(TRACE_JSON_HEADER) - 1;
+    const size_t footerLen = sizeof(TRACE_JSON_FOOTER) - 1;
+    if (cap < headerLen + footerLen + 160) {
+        return;
+    }
+
+    // Spans that finish during the dump would race the reader for their slots
+    bool wasPaused = _paused.exchange(true);
+    // Timestamps were stored as 32 bits; they are unwrapped against the current
+    // time, which holds for spans younger than 71 minutes
+    uint32_t nowLow = (uint32_t)nowUs;
+
+    memcpy(buf, TRACE_JSON_HEADER, headerLen);
+    size_t len = headerLen;
+    char event[160];
+    for (int core = 0; core < TRACE_CORES; core++) {
+        uint32_t head = _head[core].load();
+        uint32_t count = head < TRACE_RING_EVENTS ? head : TRACE_RING_EVENTS;
+        for (uint32_t i = head - count; i != head; i++) {
+            const TraceEvent& e = _ring[core][i % TRACE_RING_EVENTS];
+            if (!e.name) {
+                continue;
+            }
+            int64_t ts = nowUs - (int64_t)(uint32_t)(nowLow - e.startUs);
+            int n = snprintf(event, sizeof(event),
+                             ",\n{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%lld,\"dur\":%u,\"pid\":%d,\"tid\":%u}",
+                             e.name, (long long)ts, (unsigned)e.durUs, core, (unsigned)(uintptr_t)e.task);
+            if (n <= 0 || (size_t)n >= sizeof(event)) {
+                continue;
+            }
+            if (len + n + footerLen > cap) {
+                if (split) {
+                    memcpy(buf + len, TRACE_JSON_FOOTER, footerLen);
+                    flush(buf, len + footerLen, ctx);
+                    memcpy(buf, TRACE_JSON_HEADER, headerLen);
+                    len = headerLen;
+                } else {
+                    flush(buf, len, ctx);
+                    len = 0;
+                }
+            }
+            memcpy(buf + len, event, n);
+            len += n;
+        }
+    }
+    memcpy(buf + len, TRACE_JSON_FOOTER, footerLen);
+    flush(buf, len + footerLen, ctx);
+
+    _paused.store(wasPaused);
+}
+
+size_t TraceRing::Recent(uint32_t nowUs, TraceEvent* out, uint8_t* cores, size_t max) const {
+    size_t count = 0;
+    for (int core = 0; core < TRACE_CORES; core++) {
+        uint32_t head = _head[core].load();
+        uint32_t held = head < TRACE_RING_EVENTS ? head : TRACE_RING_EVENTS;
+        uint32_t take = held < max ? held : max;
+        for (uint32_t i = head - take; i != head; i++) {
+            const TraceEvent& e = _ring[core][i % TRACE_RING_EVENTS];
+            if (!e.name) {
+                continue;
+            }
+            // Insert by age, newest first; once full, older spans fall off the end
+            uint32_t age = nowUs - e.startUs;
+            size_t pos = count;
+            while (pos > 0 && nowUs - out[pos - 1].startUs > age) {
+                --pos;
+            }
+            if (pos >= max) {
+                continue;
+            }
+            size_t last = count < max ? count : max - 1;
+            memmove(out + pos + 1, out + pos, (last - pos) * sizeof(TraceEvent));
+            memmove(cores + pos + 1, cores + pos, last - pos);
+            out[pos] = e;
+            cores[pos] = core;
+            if (count < max) {
+                ++count;
+            }
+        }
+    }
+    // Oldest first
+    for (size_t i = 0; i < count / 2; i++) {
+        TraceEvent e = out[i];
+        out[i] = out[count - 1 - i];
+        out[count - 1 - i] = e;
+        uint8_t c = cores[i];
+        cores[i] = cores[count - 1 - i];
+        cores[count - 1 - i] = c;
+    }
+    return count;
+}
@@ -0,0 +1,86 @@
+#define LOG_MODULE LOG_MODULE_UPLOAD
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <algorithm>
+#include "secrets.h"
+#include "common.h"
+#include "s3_post_policy.h"
+#include "upload_benchmark.h"
+
+// Latency summary for one operation type, latencies are sorted in place
+static void summarize(JsonObject out, uint32_t* latencies, int ok, int failed, size_t bytes, unsigned long elapsedMs) {
+    out["ok"] = ok;
+    out["failed"] = failed;
+    if (ok == 0 || elapsedMs == 0) {
+        return;
+    }
+    std::sort(latencies, latencies + ok);
+    out["req_per_s"] = ok * 1000.0f / elapsedMs;
+    out["bytes_per_s"] = (uint32_t)((uint64_t)ok * bytes * 1000 / elapsedMs);
+    out["p50_ms"] = latencies[(ok - 1) * 50 / 100];
+    out["p99_ms"] = latencies[(ok - 1) * 99 / 100];
+    out["max_ms"] = latencies[ok - 1];
+}
+
+JsonDocument uploadBenchmark(int count, size_t bytes) {
+    JsonDocument doc;
+    count = constrain(count, 1, UPLOAD_BENCHMARK_MAX_COUNT);
+    bytes = constrain(bytes, (size_t)1024, (size_t)UPLOAD_BENCHMARK_MAX_BYTES);
+    doc["count"] = count;
+    doc["bytes"] = bytes;
+    doc["endpoint"] = s3Host();
+    doc["mode"] = S3PostPolicy::policy.Valid() ? "policy" : "sigv4";
+
+    if (!s3Folder || !connectWiFi()) {
+        doc["error"] = "not connected";
+        return doc;
+    }
+
+    // Printable payload so the GET body survives the String round trip
+    uint8_t* payload = (uint8_t*)(psramFound() ? ps_malloc(bytes) : malloc(bytes));
+    if (!payload) {
+        doc["error"] = "no memory";
+        return doc;
+    }
+    for (size_t i = 0; i < bytes; i++) {
+        payload[i] = 'a' + esp_random() % 26;
+    }
+
+    uint32_t latencies[UPLOAD_BENCHMARK_MAX_COUNT];
+    String folder = String(s3Folder) + "/" UPLOAD_BENCHMARK_FOLDER;
+    logPrintf(LOG_INFO, "Upload benchmark: %d x %u bytes to %s", count, bytes, s3Host().c_str());
+
+    // PUT through the same path as photos (SigV4 or POST policy)
+    int ok = 0, failed = 0;
+    unsigned long start = millis();
+    for (int i = 0; i < count; i++) {
+        unsigned long t0 = millis();
+        if (uploadBufferToS3(payload, bytes, "bench_" + String(i) + ".bin", folder, "application/octet-stream")) {
+            latencies[ok++] = millis() - t0;
+        } else {
+            ++failed;
+        }
+    }
+    summarize(doc["put"].to<JsonObject>(), latencies, ok, failed, bytes, millis() - start);
+    UploadScheduler::scheduler.Consume(UPLOAD_MANUAL, (size_t)ok * bytes);
+    free(payload);
+
+    // GET the objects back through the signed download path
+    ok = failed = 0;
+    start = millis();
+    for (int i = 0; i < count; i++) {
+        String content, etag, errorMsg;
+        unsigned long t0 = millis();
+        if (downloadFromS3(UPLOAD_BENCHMARK_FOLDER "/bench_" + String(i) + ".bin", content, etag, errorMsg) &&
+            content.length() == bytes) {
+            latencies[ok++] = millis() - t0;
+        } else {
+            ++failed;
+        }
+    }
+    summarize(doc["get"].to<JsonObject>(), latencies, ok, failed, bytes, millis() - start);
+
+    lastWiFiActivity = millis();
+    return doc;
+}
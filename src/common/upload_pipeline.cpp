@@ -0,0 +1,264 @@
+#define LOG_MODULE LOG_MODULE_UPLOAD
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "esp_timer.h"
+#include "secrets.h"
+#include "common.h"
+#include "upload_pipeline.h"
+#include "rate_controller.h"
+#include "upload_targets.h"
+#include "upload_retry.h"
+#include "s3_connection.h"
+
+#define UPLOAD_PIPELINE_PREP_STACK 6144
+#define UPLOAD_PIPELINE_NET_STACK 12288
+#define UPLOAD_PIPELINE_PRIORITY 1
+
+struct UploadJob {
+    uint8_t* buf;
+    size_t len;
+    int level;              // rate controller operating point at capture
+    bool success;
+    int64_t enqueuedUs;
+    int64_t preparedUs;
+    char uri[128];
+    char authHeader[400];
+    char amzDate[18];
+    char payloadHash[65];
+    PayloadMd5 md5;
+    UploadEndpoint target;
+};
+
+UploadPipeline UploadPipeline::pipeline;
+
+// Network stage state (only touched from NetTask)
+static S3Connection netConnection;
+
+static void freeJob(UploadJob* job) {
+    if (job) {
+        free(job->buf);
+        free(job);
+    }
+}
+
+static JsonDocument describeStage(const UploadStageStats& stage) {
+    JsonDocument doc;
+    doc["count"] = stage.count;
+    doc["avg_us"] = stage.AverageUs();
+    doc["max_us"] = stage.maxUs;
+    return doc;
+}
+
+void UploadPipeline::RecordStats(UploadStageStats& stage, uint32_t us) {
+    xSemaphoreTake(_statsLock, portMAX_DELAY);
+    stage.Record(us);
+    xSemaphoreGive(_statsLock);
+}
+
+bool UploadPipeline::Begin() {
+    if (_started) {
+        return true;
+    }
+
+    _frames = xQueueCreate(UPLOAD_PIPELINE_DEPTH, sizeof(UploadJob*));
+    _prepared = xQueueCreate(UPLOAD_PIPELINE_DEPTH, sizeof(UploadJob*));
+    _done = xQueueCreate(UPLOAD_PIPELINE_DEPTH * 2, sizeof(UploadJob*));
+    _statsLock = xSemaphoreCreateMutex();
+    if (!_frames || !_prepared || !_done || !_statsLock) {
+        logPrint(LOG_ERROR, "Upload pipeline: queue allocation failed");
+        return false;
+    }
+
+    xTaskCreatePinnedToCore(PrepTask, "upl-prep", UPLOAD_PIPELINE_PREP_STACK, this,
+                            UPLOAD_PIPELINE_PRIORITY, nullptr, UPLOAD_PIPELINE_PREP_CORE);
+    xTaskCreatePinnedToCore(NetTask, "upl-net", UPLOAD_PIPELINE_NET_STACK, this,
+                            UPLOAD_PIPELINE_PRIORITY, nullptr, UPLOAD_PIPELINE_NET_CORE);
+
+    _started = true;
+    logPrint(LOG_INFO, "Upload pipeline started");
+    return true;
+}
+
+// Copy the frame so the camera buffer can be returned right away.
+// Returns false (frame dropped) when the pipeline is full.
+bool UploadPipeline::Enqueue(camera_fb_t* fb, const String& filename, const String& folderName) {
+    if (!fb || fb->len == 0 || !Begin()) {
+        return false;
+    }
+
+    if (uxQueueSpacesAvailable(_frames) == 0) {
+        ++_dropped;
+        logPrint(LOG_DEBUG, "Upload pipeline full, frame dropped");
+        return false;
+    }
+
+    UploadJob* job = (UploadJob*)calloc(1, sizeof(UploadJob));
+    uint8_t* buf = (uint8_t*)(psramFound() ? ps_malloc(fb->len) : malloc(fb->len));
+    if (!job || !buf) {
+        free(job);
+        free(buf);
+        ++_dropped;
+        logPrint(LOG_WARNING, "Upload pipeline: out of memory, frame dropped");
+        return false;
+    }
+
+    memcpy(buf, fb->buf, fb->len);
+    job->buf = buf;
+    job->len = fb->len;
+    job->level = RateController::rate.Level();
+    job->enqueuedUs = esp_timer_get_time();
+    snprintf(job->uri, sizeof(job->uri), "/%s/%s", folderName.c_str(), filename.c_str());
+
+    if (_firstEnqueueMs == 0) {
+        _firstEnqueueMs = millis();
+    }
+
+    if (xQueueSend(_frames, &job, 0) != pdTRUE) {
+        freeJob(job);
+        ++_dropped;
+        return false;
+    }
+    return true;
+}
+
+// Retrieve the next completed upload (loop task only). Returns false when none.
+bool UploadPipeline::Poll(String& uri, bool& success) {
+    UploadJob* job = nullptr;
+    if (!_started || xQueueReceive(_done, &job, 0) != pdTRUE) {
+        return false;
+    }
+    uri = job->uri;
+    success = job->success;
+    freeJob(job);
+    return true;
+}
+
+// ===== Stage 1: hash and sign =====
+
+void UploadPipeline::Prepare(UploadJob* job) {
+    // Target picked at signing time, the signature is only valid for its host
+    UploadTargets::targets.Select(0, job->target);
+    generateAWSSignatureV4("PUT", job->target.host, job->uri,
+                           job->target.region, AWS_ACCESS_KEY_ID, AWS_SECRET_ACCESS_KEY,
+                           job->buf, job->len,
+                           job->authHeader, job->amzDate, job->payloadHash);
+    job->md5.Compute(job->buf, job->len);
+}
+
+void UploadPipeline::PrepTask(void* arg) {
+    UploadPipeline* self = (UploadPipeline*)arg;
+    for (;;) {
+        UploadJob* job = nullptr;
+        if (xQueueReceive(self->_frames, &job, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+
+        int64_t start = esp_timer_get_time();
+        self->Prepare(job);
+        job->preparedUs = esp_timer_get_time();
+        self->RecordStats(self->_prep, (uint32_t)(job->preparedUs - start));
+
+        // Blocks while the network stage is busy: bounded queue applies back-pressure
+        xQueueSend(self->_prepared, &job, portMAX_DELAY);
+    }
+}
+
+// ===== Stage 2: network =====
+
+bool UploadPipeline::Send(UploadJob* job) {
+    if (!IsWiFiConnected()) {
+        return false;
+    }
+
+    // Kept-alive connection, closed by the server or when the target changes
+    netConnection.Begin(job->target, "PUT", job->uri);
+    netConnection.Header("x-amz-date", job->amzDate);
+    netConnection.Header("x-amz-content-sha256", job->payloadHash);
+    netConnection.Header("Authorization", job->authHeader);
+    netConnection.Header("Content-Type", "image/jpeg");
+    netConnection.Header("Content-MD5", job->md5.base64);
+    netConnection.Header("Content-Length", (unsigned long)job->len);
+
+    unsigned long putStart = millis();
+    int httpResponseCode = netConnection.Send(job->target, job->buf, job->len, 15000, 60000);
+    // Not retried: in continuous capture the next frame supersedes this one
+    bool ok = httpResponseCode >= 200 && httpResponseCode < 300 &&
+              UploadRetry::retry.CheckEtag(job->md5, netConnection.ETag());
+    RateController::rate.RecordUpload(job->len, millis() - putStart, ok, job->level);
+    UploadTargets::targets.Record(job->target.index, millis() - putStart, job->len, ok);
+
+    if (ok) {
+        return true;
+    }
+    logPrintf(LOG_WARNING, "Pipeline upload failed: %s HTTP %d (%s)", job->uri, httpResponseCode, job->target.host);
+    return false;
+}
+
+void UploadPipeline::NetTask(void* arg) {
+    UploadPipeline* self = (UploadPipeline*)arg;
+    for (;;) {
+        UploadJob* job = nullptr;
+        if (xQueueReceive(self->_prepared, &job, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+
+        int64_t start = esp_timer_get_time();
+        self->RecordStats(self->_queue, (uint32_t)(start - job->preparedUs));
+
+        job->success = self->Send(job);
+        uint32_t netUs = (uint32_t)(esp_timer_get_time() - start);
+        xSemaphoreTake(self->_statsLock, portMAX_DELAY);
+        self->_net.Record(netUs);
+        if (job->success) {
+            self->_lastDoneMs = millis();
+        } else {
+            ++self->_failed;
+        }
+        xSemaphoreGive(self->_statsLock);
+
+        // The frame itself is no longer needed, only the result
+        free(job->buf);
+        job->buf = nullptr;
+        if (xQueueSend(self->_done, &job, 0) != pdTRUE) {
+            freeJob(job);
+        }
+    }
+}
+
+JsonDocument UploadPipeline::describe() const {
+    JsonDocument doc;
+    doc["started"] = _started;
+    if (!_started) {
+        return doc;
+    }
+
+    // Consistent snapshot: the 64-bit totals are not updated atomically
+    xSemaphoreTake(_statsLock, portMAX_DELAY);
+    UploadStageStats prep = _prep;
+    UploadStageStats queue = _queue;
+    UploadStageStats net = _net;
+    uint32_t failed = _failed;
+    unsigned long lastDoneMs = _lastDoneMs;
+    xSemaphoreGive(_statsLock);
+
+    doc["prep"] = describeStage(prep);
+    doc["queue_wait"] = describeStage(queue);
+    doc["net"] = describeStage(net);
+    doc["connection"] = netConnection.describe();
+    doc["dropped"] = _dropped;
+    doc["failed"] = failed;
+
+    // Frames/minute: measured, plus the serial vs pipelined model from stage averages
+    uint32_t sent = net.count - failed;
+    if (sent > 0 && lastDoneMs > _firstEnqueueMs) {
+        doc["measured_fpm"] = 60000.0 * sent / (lastDoneMs - _firstEnqueueMs);
+    }
+    uint32_t prepUs = prep.AverageUs();
+    uint32_t netUs = net.AverageUs();
+    if (prepUs + netUs > 0) {
+        doc["serial_fpm"] = uploadSerialFpm(prepUs, netUs);
+        doc["pipelined_fpm"] = uploadPipelinedFpm(prepUs, netUs);
+    }
+    return doc;
+}
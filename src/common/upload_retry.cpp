@@ -0,0 +1,198 @@
+#define LOG_MODULE LOG_MODULE_UPLOAD
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <ArduinoJson.h>
+#include <mbedtls/md5.h>
+#include <mbedtls/base64.h>
+#include "common.h"
+#include "upload_retry.h"
+
+#define NVM_PREFS_SECTION "upload-retry"
+#define NVM_VERIFY_KEY "verify"
+
+UploadRetry UploadRetry::retry;
+
+static const char* OUTCOME_NAMES[UPLOAD_OUTCOME_COUNT] = {
+    "first_try", "after_retry", "already_stored", "permanent", "exhausted", "budget", "deadline"};
+
+void PayloadMd5::Compute(const uint8_t* buf, size_t len) {
+    uint8_t digest[16];
+    mbedtls_md5_context ctx;
+    mbedtls_md5_init(&ctx);
+    mbedtls_md5_starts(&ctx);
+    mbedtls_md5_update(&ctx, buf, len);
+    mbedtls_md5_finish(&ctx, digest);
+    mbedtls_md5_free(&ctx);
+
+    size_t written = 0;
+    mbedtls_base64_encode((unsigned char*)base64, sizeof(base64), &written, digest, sizeof(digest));
+    base64[written] = '\0';
+    for (int i = 0; i < 16; i++) {
+        sprintf(hex + 2 * i, "%02x", digest[i]);
+    }
+}
+
+bool PayloadMd5::Matches(const char* etag) const {
+    return s3EtagMatches(etag, hex);
+}
+
+void UploadRetry::ReadNVM() {
+    Preferences prefs;
+    prefs.begin(NVM_PREFS_SECTION, true);
+    _verifyEtag = prefs.getBool(NVM_VERIFY_KEY, true);
+    prefs.end();
+}
+
+void UploadRetry::SaveNVM() {
+    Preferences prefs;
+    prefs.begin(NVM_PREFS_SECTION, false);
+    prefs.putBool(NVM_VERIFY_KEY, _verifyEtag);
+    prefs.end();
+}
+
+void UploadRetry::Begin() {
+    if (_lock) {
+        return;
+    }
+    _lock = xSemaphoreCreateMutex();
+    ReadNVM();
+}
+
+bool UploadRetry::VerifyEtag() {
+    if (!_lock) {
+        Begin();
+    }
+    return _verifyEtag;
+}
+
+bool UploadRetry::TakeRetry() {
+    if (!_lock) {
+        Begin();
+    }
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    bool ok = _tokens >= 1;
+    if (ok) {
+        _tokens -= 1;
+        ++_retries;
+    }
+    xSemaphoreGive(_lock);
+    return ok;
+}
+
+void UploadRetry::RecordAttempt(int httpCode, const char* responseBody) {
+    if (!_lock) {
+        Begin();
+    }
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    ++_attempts;
+    if (httpCode == 400 && strstr(responseBody, "BadDigest")) {
+        ++_digestErrors;
+    }
+    xSemaphoreGive(_lock);
+}
+
+// True when the ETag confirms the payload, or cannot be checked
+bool UploadRetry::CheckEtag(const PayloadMd5& md5, const char* etag) {
+    S3EtagCheck check = VerifyEtag() ? s3CheckEtag(etag, md5.hex) : S3_ETAG_SKIPPED;
+    RecordEtag(check, etag, md5.hex);
+    return check != S3_ETAG_MISMATCH;
+}
+
+void UploadRetry::RecordEtag(S3EtagCheck check, const char* etag, const char* md5Hex) {
+    if (check == S3_ETAG_MATCH || check == S3_ETAG_SKIPPED) {
+        return;
+    }
+    if (!_lock) {
+        Begin();
+    }
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    if (check == S3_ETAG_UNVERIFIED) {
+        ++_unverified;
+    } else {
+        ++_etagMismatches;
+    }
+    xSemaphoreGive(_lock);
+    if (check == S3_ETAG_MISMATCH) {
+        logPrintf(LOG_WARNING, "Upload ETag %s does not match MD5 %s", etag, md5Hex);
+    }
+}
+
+void UploadRetry::RecordOutcome(UploadOutcome outcome) {
+    if (!_lock) {
+        Begin();
+    }
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    ++_outcomes[outcome];
+    _tokens = min((float)UPLOAD_RETRY_BUDGET_MAX, _tokens + (float)UPLOAD_RETRY_BUDGET_RATIO);
+    xSemaphoreGive(_lock);
+}
+
+uint32_t UploadRetry::Attempts() {
+    if (!_lock) {
+        Begin();
+    }
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    uint32_t attempts = _attempts;
+    xSemaphoreGive(_lock);
+    return attempts;
+}
+
+uint32_t UploadRetry::Retries() {
+    if (!_lock) {
+        Begin();
+    }
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    uint32_t retries = _retries;
+    xSemaphoreGive(_lock);
+    return retries;
+}
+
+float UploadRetry::Budget() {
+    if (!_lock) {
+        Begin();
+    }
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    float tokens = _tokens;
+    xSemaphoreGive(_lock);
+    return tokens;
+}
+
+uint32_t UploadRetry::Failed() {
+    if (!_lock) {
+        Begin();
+    }
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    uint32_t failed = _outcomes[UPLOAD_OUTCOME_PERMANENT] + _outcomes[UPLOAD_OUTCOME_EXHAUSTED] +
+                      _outcomes[UPLOAD_OUTCOME_BUDGET] + _outcomes[UPLOAD_OUTCOME_DEADLINE];
+    xSemaphoreGive(_lock);
+    return failed;
+}
+
+void UploadRetry::Configure(const JsonDocument& doc) {
+    VerifyEtag();
+    if (doc["verify_etag"].is<bool>()) {
+        // SSE-KMS buckets return ETags that are not the MD5 of the object
+        _verifyEtag = doc["verify_etag"].as<bool>();
+        SaveNVM();
+        logPrintf(LOG_INFO, "Upload ETag verification %s", _verifyEtag ? "enabled" : "disabled");
+    }
+}
+
+JsonDocument UploadRetry::describe() {
+    JsonDocument doc;
+    doc["verify_etag"] = VerifyEtag();
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    doc["attempts"] = _attempts;
+    doc["retries"] = _retries;
+    doc["budget"] = _tokens;
+    doc["digest_errors"] = _digestErrors;
+    doc["etag_mismatches"] = _etagMismatches;
+    doc["unverified"] = _unverified;
+    JsonObject outcomes = doc["outcomes"].to<JsonObject>();
+    for (int i = 0; i < UPLOAD_OUTCOME_COUNT; i++) {
+        outcomes[OUTCOME_NAMES[i]] = _outcomes[i];
+    }
+    xSemaphoreGive(_lock);
+    return doc;
+}
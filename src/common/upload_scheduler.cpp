@@ -0,0 +1,154 @@
+#define LOG_MODULE LOG_MODULE_UPLOAD
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <ArduinoJson.h>
+#include "common.h"
+#include "upload_scheduler.h"
+
+#define NVM_PREFS_SECTION "upload-budget"
+#define NVM_TOKENS_KEY "tokens"
+#define NVM_REFILL_KEY "refill"
+#define NVM_BUDGET_KEY "budget"
+
+// Share of the daily budget each class must leave in the bucket
+static const uint8_t RESERVE_PERCENT[UPLOAD_PRIORITY_COUNT] = {
+    0,    // motion may use everything
+    5,    // manual
+    15,   // live
+    25,   // scheduled
+    40,   // telemetry
+};
+
+UploadScheduler UploadScheduler::scheduler;
+
+const char* UploadScheduler::PriorityName(UploadPriority priority) {
+    switch (priority) {
+        case UPLOAD_MOTION:    return "motion";
+        case UPLOAD_MANUAL:    return "manual";
+        case UPLOAD_LIVE:      return "live";
+        case UPLOAD_SCHEDULED: return "scheduled";
+        case UPLOAD_TELEMETRY: return "telemetry";
+        default:               return "unknown";
+    }
+}
+
+void UploadScheduler::ReadNVM() {
+    Preferences prefs;
+    prefs.begin(NVM_PREFS_SECTION, true);
+    _dailyBudget = prefs.getULong(NVM_BUDGET_KEY, UPLOAD_DAILY_BUDGET_BYTES);
+    _tokens = prefs.getFloat(NVM_TOKENS_KEY, _dailyBudget);
+    _lastRefill = (time_t)prefs.getULong64(NVM_REFILL_KEY, 0);
+    prefs.end();
+
+    _loaded = true;
+    _lastSaveMs = millis();
+    logPrintf(LOG_INFO, "Upload budget: %.0f/%lu bytes", _tokens, (unsigned long)_dailyBudget);
+}
+
+void UploadScheduler::SaveNVM() {
+    Preferences prefs;
+    prefs.begin(NVM_PREFS_SECTION, false);
+    prefs.putULong(NVM_BUDGET_KEY, _dailyBudget);
+    prefs.putFloat(NVM_TOKENS_KEY, _tokens);
+    prefs.putULong64(NVM_REFILL_KEY, (uint64_t)_lastRefill);
+    prefs.end();
+
+    _dirty = false;
+    _lastSaveMs = millis();
+}
+
+// Tokens accrue continuously at dailyBudget/day, capped at one day's worth.
+// Wall clock based so time spent rebooting or offline also refills.
+void UploadScheduler::Refill() {
+    if (!_loaded) {
+        ReadNVM();
+    }
+
+    time_t now = time(nullptr);
+    if (now < 100000) {
+        return;
+    }
+    if (_lastRefill == 0 || _lastRefill > now) {
+        _lastRefill = now;
+        _dirty = true;
+        return;
+    }
+
+    time_t elapsed = now - _lastRefill;
+    if (elapsed > 0) {
+        _tokens = min((float)_dailyBudget, _tokens + (float)_dailyBudget * elapsed / 86400.0f);
+        _lastRefill = now;
+        _dirty = true;
+    }
+}
+
+float UploadScheduler::Reserve(UploadPriority priority) const {
+    return (float)_dailyBudget * RESERVE_PERCENT[priority] / 100.0f;
+}
+
+UploadDecision UploadScheduler::Admit(UploadPriority priority, size_t estimatedBytes, size_t reducedBytes) {
+    Refill();
+
+    float reserve = Reserve(priority);
+    bool low = _tokens < (float)_dailyBudget * UPLOAD_BUDGET_LOW_PERCENT / 100.0f;
+
+    UploadDecision decision = UPLOAD_SKIP;
+    if (_tokens - estimatedBytes >= reserve && !(low && priority != UPLOAD_MOTION && reducedBytes > 0)) {
+        decision = UPLOAD_FULL;
+    } else if (reducedBytes > 0 && _tokens - reducedBytes >= reserve) {
+        decision = UPLOAD_REDUCED;
+    }
+
+    switch (decision) {
+        case UPLOAD_FULL:    ++_full[priority]; break;
+        case UPLOAD_REDUCED: ++_reduced[priority]; break;
+        case UPLOAD_SKIP:    ++_skipped[priority]; break;
+    }
+
+    if (decision != UPLOAD_FULL) {
+        logPrintf(LOG_INFO, "Upload budget: %s upload %s (%.0f bytes left)",
+                  PriorityName(priority), decision == UPLOAD_REDUCED ? "reduced" : "skipped", _tokens);
+    }
+    return decision;
+}
+
+void UploadScheduler::Consume(UploadPriority priority, size_t bytes) {
+    Refill();
+    _tokens = max(0.0f, _tokens - (float)bytes);
+    _bytes[priority] += bytes;
+    _dirty = true;
+
+    if (millis() - _lastSaveMs >= UPLOAD_BUDGET_SAVE_INTERVAL) {
+        SaveNVM();
+    }
+}
+
+void UploadScheduler::Configure(const JsonDocument& doc) {
+    Refill();
+    if (doc["daily_budget"].is<uint32_t>()) {
+        _dailyBudget = doc["daily_budget"].as<uint32_t>();
+        _tokens = min(_tokens, (float)_dailyBudget);
+    }
+    if (doc["reset"].is<bool>() && doc["reset"].as<bool>()) {
+        _tokens = _dailyBudget;
+    }
+    SaveNVM();
+}
+
+JsonDocument UploadScheduler::describe() {
+    Refill();
+
+    JsonDocument doc;
+    doc["daily_budget"] = _dailyBudget;
+    doc["tokens"] = (uint32_t)_tokens;
+    JsonObject classes = doc["classes"].to<JsonObject>();
+    for (int i = 0; i < UPLOAD_PRIORITY_COUNT; i++) {
+        JsonObject c = classes[PriorityName((UploadPriority)i)].to<JsonObject>();
+        c["full"] = _full[i];
+        c["reduced"] = _reduced[i];
+        c["skipped"] = _skipped[i];
+        c["bytes"] = _bytes[i];
+    }
+    return doc;
+}
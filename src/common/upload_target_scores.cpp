@@ -0,0 +1,87 @@
+#include "upload_target_scores.h"
+
+int UploadTargetScores::Add() {
+    if (_count >= UPLOAD_TARGETS_MAX) {
+        return -1;
+    }
+    _targets[_count] = UploadTargetScore();
+    return _count++;
+}
+
+void UploadTargetScores::Truncate(int count) {
+    if (count < _count) {
+        _count = count < 0 ? 0 : count;
+    }
+}
+
+void UploadTargetScores::Reset() {
+    for (int i = 0; i < _count; i++) {
+        _targets[i].samples = 0;
+        _targets[i].errorRate = 0;
+        _targets[i].consecutiveFailures = 0;
+        _targets[i].cooldownUntil = 0;
+    }
+}
+
+uint32_t UploadTargetScores::CooldownLeft(int index, uint32_t nowMs) const {
+    int32_t left = (int32_t)(_targets[index].cooldownUntil - nowMs);
+    return _targets[index].cooldownUntil != 0 && left > 0 ? (uint32_t)left : 0;
+}
+
+float UploadTargetScores::Score(int index, uint32_t nowMs) const {
+    const UploadTargetScore& target = _targets[index];
+    float cost = target.samples > 0 ? target.msPerKb : UPLOAD_TARGET_DEFAULT_MS_PER_KB;
+    float score = cost * (1 + UPLOAD_TARGET_ERROR_WEIGHT * target.errorRate);
+    if (CooldownLeft(index, nowMs) > 0) {
+        // Still usable as a last resort
+        score += UPLOAD_TARGET_LAST_RESORT;
+    }
+    return score;
+}
+
+int UploadTargetScores::Select(uint32_t excludeMask, uint32_t nowMs) const {
+    int best = -1;
+    float bestScore = 0;
+    for (int i = 0; i < _count; i++) {
+        if (excludeMask & (1u << i)) {
+            continue;
+        }
+        float score = Score(i, nowMs);
+        if (best < 0 || score < bestScore) {
+            best = i;
+            bestScore = score;
+        }
+    }
+    return best;
+}
+
+uint32_t UploadTargetScores::Record(int index, uint32_t ms, size_t bytes, bool success, uint32_t nowMs) {
+    if (index < 0 || index >= _count) {
+        return 0;
+    }
+    UploadTargetScore& target = _targets[index];
+    target.errorRate += UPLOAD_TARGET_EWMA_ALPHA * ((success ? 0.0f : 1.0f) - target.errorRate);
+    if (success) {
+        // Failed requests mostly measure the timeout, only successes update the cost
+        float cost = ms / (UPLOAD_TARGET_OVERHEAD_KB + bytes / 1024.0f);
+        target.msPerKb = target.samples == 0 ? cost : target.msPerKb + UPLOAD_TARGET_EWMA_ALPHA * (cost - target.msPerKb);
+        ++target.samples;
+        ++target.ok;
+        target.consecutiveFailures = 0;
+        target.cooldownUntil = 0;
+        return 0;
+    }
+    ++target.failed;
+    if (target.consecutiveFailures < 16) {
+        ++target.consecutiveFailures;
+    }
+    uint32_t cooldown = (uint32_t)UPLOAD_TARGET_COOLDOWN_MS << (target.consecutiveFailures - 1);
+    if (cooldown > UPLOAD_TARGET_MAX_COOLDOWN_MS) {
+        cooldown = UPLOAD_TARGET_MAX_COOLDOWN_MS;
+    }
+    target.cooldownUntil = nowMs + cooldown;
+    if (target.cooldownUntil == 0) {
+        target.cooldownUntil = 1;
+    }
+    return cooldown;
+}
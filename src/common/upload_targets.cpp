@@ -0,0 +1,150 @@
+#define LOG_MODULE LOG_MODULE_UPLOAD
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <ArduinoJson.h>
+#include "secrets.h"
+#include "common.h"
+#include "upload_targets.h"
+
+#define NVM_PREFS_SECTION "upload-targets"
+#define NVM_LIST_KEY "list"
+
+UploadTargets UploadTargets::targets;
+
+// Primary target from secrets.h plus the extra targets saved in NVM
+void UploadTargets::Begin() {
+    if (_lock) {
+        return;
+    }
+    _lock = xSemaphoreCreateMutex();
+
+#ifdef S3_ENDPOINT
+    AddTarget("primary", s3Host(), AWS_REGION, false);
+#else
+    AddTarget("primary", s3Host(), AWS_REGION, true);
+#endif
+
+    Preferences prefs;
+    prefs.begin(NVM_PREFS_SECTION, true);
+    String list = prefs.getString(NVM_LIST_KEY, "");
+    prefs.end();
+
+    JsonDocument doc;
+    if (list.length() > 0 && deserializeJson(doc, list) == DeserializationError::Ok) {
+        LoadExtras(doc);
+    }
+}
+
+void UploadTargets::AddTarget(const char* name, const String& host, const char* region, bool tls) {
+    int index = _scores.Add();
+    if (index < 0) {
+        logPrintf(LOG_WARNING, "Upload targets: ignoring %s, list is full", name);
+        return;
+    }
+    Target& target = _targets[index];
+    target = Target();
+    target.name = name;
+    target.host = host;
+    target.region = region;
+    target.tls = tls;
+}
+
+// [{"name": "eu", "bucket": "cats-eu", "region": "eu-west-1"}, {"name": "lan", "endpoint": "192.168.1.5:9000"}]
+void UploadTargets::LoadExtras(const JsonDocument& doc) {
+    _scores.Truncate(1);
+    for (JsonObjectConst entry : doc.as<JsonArrayConst>()) {
+        const char* name = entry["name"] | "target";
+        const char* region = entry["region"] | AWS_REGION;
+        const char* bucket = entry["bucket"];
+        const char* endpoint = entry["endpoint"];
+        if (bucket) {
+            AddTarget(name, String(bucket) + ".s3." + region + ".amazonaws.com", region, true);
+        } else if (endpoint) {
+            AddTarget(name, endpoint, region, entry["tls"] | false);
+        }
+    }
+}
+
+// Best scoring target not in excludeMask (bit per index). Ties go to the lower index.
+bool UploadTargets::Select(uint32_t excludeMask, UploadEndpoint& endpoint) {
+    if (!_lock) {
+        Begin();
+    }
+
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    int best = _scores.Select(excludeMask, millis());
+    if (best >= 0) {
+        const Target& target = _targets[best];
+        endpoint.index = best;
+        strlcpy(endpoint.host, target.host.c_str(), sizeof(endpoint.host));
+        strlcpy(endpoint.region, target.region.c_str(), sizeof(endpoint.region));
+        endpoint.tls = target.tls;
+    }
+    xSemaphoreGive(_lock);
+    return best >= 0;
+}
+
+void UploadTargets::Record(int index, unsigned long ms, size_t bytes, bool success) {
+    if (!_lock || index < 0) {
+        return;
+    }
+
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    uint32_t cooldown = _scores.Record(index, ms, bytes, success, millis());
+    if (cooldown > 0 && _scores.Count() > 1) {
+        logPrintf(LOG_WARNING, "Upload target %s cooling down for %lu s", _targets[index].name.c_str(), (unsigned long)(cooldown / 1000));
+    }
+    xSemaphoreGive(_lock);
+}
+
+void UploadTargets::Configure(const JsonDocument& doc) {
+    if (!_lock) {
+        Begin();
+    }
+
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    if (doc["targets"].is<JsonArrayConst>()) {
+        JsonDocument list;
+        list.set(doc["targets"]);
+        LoadExtras(list);
+
+        String serialized;
+        serializeJson(list, serialized);
+        Preferences prefs;
+        prefs.begin(NVM_PREFS_SECTION, false);
+        prefs.putString(NVM_LIST_KEY, serialized);
+        prefs.end();
+        logPrintf(LOG_INFO, "Upload targets: %d configured", _scores.Count());
+    }
+    if (doc["reset"].is<bool>() && doc["reset"].as<bool>()) {
+        _scores.Reset();
+    }
+    xSemaphoreGive(_lock);
+}
+
+JsonDocument UploadTargets::describe() {
+    if (!_lock) {
+        Begin();
+    }
+
+    JsonDocument doc;
+    JsonArray list = doc["targets"].to<JsonArray>();
+
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    uint32_t now = millis();
+    for (int i = 0; i < _scores.Count(); i++) {
+        const UploadTargetScore& score = _scores.Target(i);
+        JsonObject t = list.add<JsonObject>();
+        t["name"] = _targets[i].name;
+        t["host"] = _targets[i].host;
+        t["ms_per_kb"] = score.msPerKb;
+        t["error_rate"] = score.errorRate;
+        t["ok"] = score.ok;
+        t["failed"] = score.failed;
+        t["cooldown_s"] = _scores.CooldownLeft(i, now) / 1000;
+        t["score"] = _scores.Score(i, now);
+    }
+    xSemaphoreGive(_lock);
+    return doc;
+}
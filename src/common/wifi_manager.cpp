@@ -1,3 +1,5 @@
+#define LOG_MODULE LOG_MODULE_WIFI
+
 #include <Arduino.h>
 #include <DHT.h>
 #include <WiFi.h>
@@ -9,10 +11,13 @@
 #include "esp_camera.h"
 #include "esp_wifi.h"
 #include <esp_sntp.h>
+#include <esp_timer.h>
 #include "image_analyzer.h"
 #include "secrets.h"  // WiFi credentials (not in git)
 
 #include "common.h"
+#include "dns_cache.h"
+#include "metrics.h"
 
 typedef enum {
     Disconnected,
@@ -25,6 +30,7 @@ static bool wifiSetupInitialized = false;
 static BackOffRetry connectRetry(WIFI_RETRY_CONNECT);
 
 static EWiFiState _wifiState = EWiFiState::Disconnected;
+static int64_t connectStartUs = 0;   // WiFi.begin(), for the connect latency metric
 
 volatile bool wifiConnected = false;
 bool wifiManualOverride = false;  // Track if WiFi is in manual control mode
@@ -71,6 +77,7 @@ void WiFiStationDisconnected(WiFiEvent_t event, WiFiEventInfo_t info) {
     _wifiState = EWiFiState::Disconnected;
     wifiConnected = false;
     lastDisconnectTime = millis();
+    metricWifiDisconnects.Inc();
 }
 
 void WiFiStationConnected(WiFiEvent_t event, WiFiEventInfo_t info) {
@@ -96,6 +103,11 @@ void WiFiStationGotIP(WiFiEvent_t event, WiFiEventInfo_t info) {
     wifiConnected = true;
     lastConnectTime = millis();
     connectRetry.Reset();
+
+    if (connectStartUs) {
+        metricWifiConnect.Observe((uint32_t)(esp_timer_get_time() - connectStartUs));
+        connectStartUs = 0;
+    }
 }
 
 void setupWifi(const char* hostname) {
@@ -110,6 +122,8 @@ void setupWifi(const char* hostname) {
         WiFi.setSleep(false);
         WiFi.setAutoReconnect(false);
 
+        DnsCache::cache.Begin();
+
         if (hostname) {
             uint64_t chipId = ESP.getEfuseMac();
             char chiphost[32+1];
@@ -144,7 +158,9 @@ bool connectWiFi() {
     logPrintf(LOG_INFO, "Starting WiFi connect [Retry %ld %ld %ld]...", connectRetry.AllowedCount(), connectRetry.DelayedCount(), connectRetry.ResetCount());
 
     // Scan for available networks
+    int64_t scanStart = esp_timer_get_time();
     int networksFound = WiFi.scanNetworks();
+    metricWifiScan.Observe((uint32_t)(esp_timer_get_time() - scanStart));
     if (networksFound <= 0) {
         logPrintf(LOG_WARNING, "No  networks found: %d", networksFound);
         // no need to call scanDelete()
@@ -213,7 +229,8 @@ bool connectWiFi() {
     wifi_config.sta.pmf_cfg.required = false;
     esp_wifi_set_config(WIFI_IF_STA, &wifi_config);  
 
-    // Start WiFi connection
+    // Start WiFi connection, completed in WiFiStationGotIP
+    connectStartUs = esp_timer_get_time();
     WiFi.begin(selectedSSID, selectedPassword);
 
     return false;
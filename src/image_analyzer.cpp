@@ -1,6 +1,8 @@
 #include "image_analyzer.h"
 #include <Arduino.h>
 #include <math.h>
+#include "metrics.h"
+#include "trace.h"
 
 // Static constants
 const float ImageAnalyzer::DARK_THRESHOLD = 40.0f;
@@ -11,6 +13,8 @@ ImageAnalyzer::ImageAnalyzer() {
 }
 
 ImageQualityMetrics ImageAnalyzer::analyze(camera_fb_t* fb) {
+    MetricTimer timer(metricAnalysis);
+    TRACE_SPAN("image.analyze");
     ImageQualityMetrics metrics;
 
     if (!fb || fb->len == 0) {
@@ -1,8 +1,13 @@
+#define LOG_MODULE LOG_MODULE_HTTPD
+
 #include <WebServer.h>
 #include <ArduinoJson.h>
 #include "common.h"
 #include "app_httpd.h"
 #include "json_config.h"
+#include "metrics.h"
+#include "trace.h"
+#include "heap_profile.h"
 
 
 static int portNumber = 80;
@@ -85,7 +90,11 @@ void HttpdSendStream() {
     while (isStreaming) {
         unsigned long msStart = millis();
         sendStreamFrame();
-        externalLoop();
+        {
+            // The main loop runs from here while streaming: not charged to "httpd"
+            HEAP_PROBE(heapSiteOther);
+            externalLoop();
+        }
         long msThisFrame = millis() - msStart;
         if (msThisFrame > 0 && msThisFrame < msPerFrame) {
             delay(msPerFrame - msThisFrame);
@@ -106,6 +115,8 @@ String response = R"EOF(
         <h1>Web Server</h1>
           <a href="/stream">Stream</a>
           <a href="/snapshot">Snapshot</a>
+          <a href="/metrics">Metrics</a>
+          <a href="/trace">Trace</a>
         </div>
       </body>
     </html>
@@ -113,12 +124,36 @@ String response = R"EOF(
   webServer.send(200, "text/html", response);
 }
 
+// Prometheus scrape, sent chunked one line at a time
+void HttpdMetrics() {
+    webServer.setContentLength(CONTENT_LENGTH_UNKNOWN);
+    webServer.send(200, "text/plain; version=0.0.4", "");
+    Metrics::Prometheus([](const char* line, size_t len, void*) {
+        webServer.sendContent(line, len);
+    }, nullptr);
+    webServer.sendContent("");
+}
+
+// Chrome trace JSON of the recent spans, open it in Perfetto
+void HttpdTrace() {
+    char buf[1024];
+    webServer.sendHeader("Content-Disposition", "attachment; filename=trace.json");
+    webServer.setContentLength(CONTENT_LENGTH_UNKNOWN);
+    webServer.send(200, "application/json", "");
+    Trace::ChromeJson(buf, sizeof(buf), false, [](const char* json, size_t len, void*) {
+        webServer.sendContent(json, len);
+    }, nullptr);
+    webServer.sendContent("");
+}
+
 void InitHttpd() {
     WiFi.onEvent(WiFiHttpdDisconnected, WiFiEvent_t::ARDUINO_EVENT_WIFI_STA_DISCONNECTED);
     WiFi.onEvent(WiFiHttpdIP, WiFiEvent_t::ARDUINO_EVENT_WIFI_STA_GOT_IP);
 
     webServer.on("/stream", HTTP_GET, HttpdSendStream);
     webServer.on("/snapshot", HTTP_GET, HttpdSendSnapshot);
+    webServer.on("/metrics", HTTP_GET, HttpdMetrics);
+    webServer.on("/trace", HTTP_GET, HttpdTrace);
     webServer.on("/", HTTP_GET, HttpdRoot);
 
     logPrintf(LOG_INFO, "HTTPD ready to start");
@@ -128,5 +163,6 @@ void LoopHttpd(loopCallback_t loopCallback) {
     externalLoop = loopCallback;
     externalLoop();
 
+    HEAP_PROBE(heapSiteHttpd);
     webServer.handleClient();
 }
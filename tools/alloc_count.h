@@ -0,0 +1,45 @@
+#pragma once
+
+// Heap allocation counter for the host checks. malloc, calloc and realloc
+// are replaced by wrappers around glibc's (operator new goes through
+// malloc); allocations made while an AllocationScope is alive are counted.
+// Include from exactly one translation unit. glibc only.
+
+#include <cstddef>
+#include <cstdlib>
+
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t count, size_t size);
+extern "C" void* __libc_realloc(void* ptr, size_t size);
+
+static bool allocationCounting = false;
+static unsigned long allocationCount = 0;
+
+extern "C" void* malloc(size_t size) {
+    allocationCount += allocationCounting;
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size) {
+    allocationCount += allocationCounting;
+    return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* ptr, size_t size) {
+    allocationCount += allocationCounting;
+    return __libc_realloc(ptr, size);
+}
+
+/// @brief Counts allocations for its lifetime
+class AllocationScope {
+    unsigned long _start;
+
+public:
+    AllocationScope() : _start(allocationCount) { allocationCounting = true; }
+    ~AllocationScope() { allocationCounting = false; }
+    unsigned long Count() const { return allocationCount - _start; }
+};
+
+/// @brief malloc through a volatile pointer, so the compiler cannot drop a
+/// malloc/free pair: proves the counter is wired up
+static void* (*volatile allocationProbe)(size_t) = malloc;
@@ -0,0 +1,341 @@
+// Host-side decoder for CBOR MQTT payloads (the "mqtt-encoding" IoT command).
+//
+// Build:  g++ -std=c++17 -O2 -I include -o cbor_decode tools/cbor_decode.cpp src/common/cbor.cpp
+// Usage:  cbor_decode [-p] <payload.cbor | -> ...
+//
+// Prints each payload as JSON, integer map keys replaced by their name in the
+// key dictionary (src/common/cbor.cpp), so the output matches the JSON the
+// device would have published. -p pretty-prints. The CBOR size and the
+// compact JSON size are reported on stderr.
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "cbor.h"
+
+struct Decoder {
+    const std::vector<uint8_t>& data;
+    size_t pos = 0;
+    bool pretty = false;
+    std::string out;
+    std::string error;
+
+    explicit Decoder(const std::vector<uint8_t>& d) : data(d) {}
+
+    bool Byte(uint8_t& b) {
+        if (pos >= data.size()) {
+            error = "truncated payload";
+            return false;
+        }
+        b = data[pos++];
+        return true;
+    }
+
+    // Argument of an initial byte; indefinite is set for the 31 (streaming) form
+    bool Argument(uint8_t info, uint64_t& value, bool& indefinite) {
+        indefinite = false;
+        if (info < 24) {
+            value = info;
+            return true;
+        }
+        if (info == 31) {
+            indefinite = true;
+            return true;
+        }
+        if (info > 27) {
+            error = "reserved additional information";
+            return false;
+        }
+        int bytes = 1 << (info - 24);
+        value = 0;
+        for (int i = 0; i < bytes; i++) {
+            uint8_t b;
+            if (!Byte(b)) {
+                return false;
+            }
+            value = (value << 8) | b;
+        }
+        return true;
+    }
+
+    void Newline(int depth) {
+        if (pretty) {
+            out += '\n';
+            out.append(depth * 2, ' ');
+        }
+    }
+
+    void Quote(const std::string& text) {
+        out += '"';
+        for (unsigned char c : text) {
+            if (c == '"' || c == '\\') {
+                out += '\\';
+                out += (char)c;
+            } else if (c < 0x20) {
+                char esc[8];
+                snprintf(esc, sizeof(esc), "\\u%04x", c);
+                out += esc;
+            } else {
+                out += (char)c;
+            }
+        }
+        out += '"';
+    }
+
+    bool AtBreak() {
+        if (pos < data.size() && data[pos] == 0xff) {
+            ++pos;
+            return true;
+        }
+        return false;
+    }
+
+    bool Bytes(uint64_t len, std::string& text) {
+        if (len > data.size() - pos) {
+            error = "truncated string";
+            return false;
+        }
+        text.assign(reinterpret_cast<const char*>(data.data() + pos), len);
+        pos += len;
+        return true;
+    }
+
+    // Significant digits of the encoded precision, so 12.35f prints as 12.35
+    void Number(double value, int digits) {
+        if (std::isnan(value) || std::isinf(value)) {
+            out += "null";
+            return;
+        }
+        char num[32];
+        snprintf(num, sizeof(num), "%.*g", digits, value);
+        out += num;
+    }
+
+    bool Key(int depth) {
+        uint8_t b;
+        if (!Byte(b)) {
+            return false;
+        }
+        uint8_t major = b >> 5;
+        uint64_t value = 0;
+        bool indefinite;
+        if (!Argument(b & 31, value, indefinite)) {
+            return false;
+        }
+        if (major == 0) {
+            if (depth == 1 && value == CBOR_KEY_VERSION) {
+                Quote(CBOR_KEYS[0]);
+            } else if (value < CBOR_KEY_COUNT) {
+                Quote(CBOR_KEYS[value]);
+            } else {
+                Quote("#" + std::to_string(value));
+            }
+            return true;
+        }
+        if (major == 3 && !indefinite) {
+            std::string text;
+            if (!Bytes(value, text)) {
+                return false;
+            }
+            Quote(text);
+            return true;
+        }
+        error = "unsupported map key type";
+        return false;
+    }
+
+    bool Item(int depth) {
+        uint8_t b;
+        if (!Byte(b)) {
+            return false;
+        }
+        uint8_t major = b >> 5;
+        uint8_t info = b & 31;
+        if (major == 7) {
+            if (info == 20 || info == 21) {
+                out += info == 21 ? "true" : "false";
+            } else if (info == 22 || info == 23) {
+                out += "null";
+            } else if (info >= 25 && info <= 27) {
+                uint64_t bits = 0;
+                bool indefinite;
+                if (!Argument(info, bits, indefinite)) {
+                    return false;
+                }
+                if (info == 25) {
+                    // Half precision
+                    int exp = (bits >> 10) & 0x1f;
+                    double mant = bits & 0x3ff;
+                    double v = exp == 0 ? std::ldexp(mant, -24)
+                             : exp == 31 ? (mant ? NAN : INFINITY)
+                             : std::ldexp(mant + 1024, exp - 25);
+                    Number(bits & 0x8000 ? -v : v, 5);
+                } else if (info == 26) {
+                    uint32_t u = (uint32_t)bits;
+                    float f;
+                    memcpy(&f, &u, sizeof(f));
+                    Number(f, 7);
+                } else {
+                    double d;
+                    memcpy(&d, &bits, sizeof(d));
+                    Number(d, 17);
+                }
+            } else {
+                error = "unsupported simple value";
+                return false;
+            }
+            return true;
+        }
+
+        uint64_t value = 0;
+        bool indefinite;
+        if (!Argument(info, value, indefinite)) {
+            return false;
+        }
+        switch (major) {
+        case 0:
+            out += std::to_string(value);
+            return true;
+        case 1:
+            out += "-" + std::to_string(value + 1);
+            return true;
+        case 2:
+        case 3: {
+            std::string text;
+            if (indefinite) {
+                // Concatenated definite chunks up to the break
+                while (!AtBreak()) {
+                    uint8_t chunk;
+                    uint64_t len;
+                    bool nested;
+                    std::string part;
+                    if (!Byte(chunk) || !Argument(chunk & 31, len, nested) || nested || !Bytes(len, part)) {
+                        if (error.empty()) {
+                            error = "bad string chunk";
+                        }
+                        return false;
+                    }
+                    text += part;
+                }
+            } else if (!Bytes(value, text)) {
+                return false;
+            }
+            if (major == 2) {
+                // Byte strings as hex
+                std::string hex;
+                for (unsigned char c : text) {
+                    char h[3];
+                    snprintf(h, sizeof(h), "%02x", c);
+                    hex += h;
+                }
+                text = hex;
+            }
+            Quote(text);
+            return true;
+        }
+        case 4:
+        case 5: {
+            out += major == 4 ? '[' : '{';
+            for (uint64_t i = 0; indefinite || i < value; i++) {
+                if (indefinite && AtBreak()) {
+                    break;
+                }
+                if (i) {
+                    out += ',';
+                }
+                Newline(depth + 1);
+                if (major == 5) {
+                    if (!Key(depth + 1)) {
+                        return false;
+                    }
+                    out += pretty ? ": " : ":";
+                }
+                if (!Item(depth + 1)) {
+                    return false;
+                }
+            }
+            Newline(depth);
+            out += major == 4 ? ']' : '}';
+            return true;
+        }
+        case 6:
+            // Tags (e.g. 55799 self-describe) carry no meaning here
+            return Item(depth);
+        }
+        return false;
+    }
+};
+
+// Compact JSON length of the decoded document, for the size comparison
+static size_t compactLength(const std::string& json) {
+    size_t len = 0;
+    bool inString = false;
+    for (size_t i = 0; i < json.size(); i++) {
+        char c = json[i];
+        if (inString) {
+            if (c == '\\') {
+                ++len;
+                ++i;
+            } else if (c == '"') {
+                inString = false;
+            }
+        } else if (c == '"') {
+            inString = true;
+        } else if (c == ' ' || c == '\n') {
+            continue;
+        }
+        ++len;
+    }
+    return len;
+}
+
+int main(int argc, char** argv) {
+    bool pretty = false;
+    int first = 1;
+    if (argc > 1 && strcmp(argv[1], "-p") == 0) {
+        pretty = true;
+        first = 2;
+    }
+    if (first >= argc) {
+        fprintf(stderr, "usage: %s [-p] <payload.cbor | -> ...\n", argv[0]);
+        return 2;
+    }
+
+    int status = 0;
+    for (int i = first; i < argc; i++) {
+        std::vector<uint8_t> data;
+        if (strcmp(argv[i], "-") == 0) {
+            data.assign(std::istreambuf_iterator<char>(std::cin), std::istreambuf_iterator<char>());
+        } else {
+            std::ifstream in(argv[i], std::ios::binary);
+            if (!in) {
+                fprintf(stderr, "%s: cannot open\n", argv[i]);
+                status = 1;
+                continue;
+            }
+            data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        }
+
+        Decoder decoder(data);
+        decoder.pretty = pretty;
+        if (!decoder.Item(0)) {
+            fprintf(stderr, "%s: %s at byte %zu\n", argv[i], decoder.error.c_str(), decoder.pos);
+            status = 1;
+            continue;
+        }
+        if (decoder.pos != data.size()) {
+            fprintf(stderr, "%s: %zu trailing bytes\n", argv[i], data.size() - decoder.pos);
+        }
+        printf("%s\n", decoder.out.c_str());
+        size_t jsonLen = compactLength(decoder.out);
+        fprintf(stderr, "%s: %zu bytes CBOR, %zu bytes compact JSON (%.0f%%)\n", argv[i], data.size(), jsonLen,
+                jsonLen ? 100.0 * data.size() / jsonLen : 0.0);
+    }
+    return status;
+}
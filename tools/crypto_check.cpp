@@ -0,0 +1,119 @@
+// Software SHA-256/HMAC backend check (crypto_software.cpp):
+//
+//   known      FIPS 180-4 and RFC 4231 test vectors (the same table the
+//              crypto-benchmark IoT command runs on the device, where it also
+//              covers the hardware backend)
+//   openssl    random messages, keys and Update() splits compared with OpenSSL,
+//              which also runs the known answers to check the table itself
+//
+// Exits 1 on any mismatch.
+//
+// Build:  g++ -std=c++17 -O2 -I include -o crypto_check tools/crypto_check.cpp src/common/crypto_software.cpp -lcrypto
+// Usage:  crypto_check [rounds] [seed]
+
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "crypto_backend.h"
+
+static int failures = 0;
+
+static void check(bool ok, const char* what) {
+    printf("%s %s\n", ok ? "ok  " : "FAIL", what);
+    failures += !ok;
+}
+
+/// @brief Reference backend: OpenSSL behind the same interface
+class OpenSslBackend : public CryptoBackend {
+public:
+    const char* Name() const override { return "openssl"; }
+
+    void Begin(Context& ctx) const override {
+        EVP_MD_CTX* c = EVP_MD_CTX_new();
+        EVP_DigestInit_ex(c, EVP_sha256(), nullptr);
+        memcpy(ctx.opaque, &c, sizeof(c));
+    }
+
+    void Update(Context& ctx, const uint8_t* data, size_t len) const override {
+        EVP_MD_CTX* c;
+        memcpy(&c, ctx.opaque, sizeof(c));
+        EVP_DigestUpdate(c, data, len);
+    }
+
+    void Finish(Context& ctx, uint8_t* digest) const override {
+        EVP_MD_CTX* c;
+        memcpy(&c, ctx.opaque, sizeof(c));
+        EVP_DigestFinal_ex(c, digest, nullptr);
+        EVP_MD_CTX_free(c);
+    }
+};
+
+int main(int argc, char** argv) {
+    int rounds = argc > 1 ? atoi(argv[1]) : 2000;
+    unsigned seed = argc > 2 ? (unsigned)atoi(argv[2]) : 1;
+    const CryptoBackend& software = CryptoBackend::Software();
+    OpenSslBackend openssl;
+
+    check(openssl.KnownAnswerFailures() == 0, "known answers: openssl agrees with the table");
+    check(software.KnownAnswerFailures() == 0, "known answers: software backend");
+
+    std::mt19937 rng(seed);
+    std::vector<uint8_t> data(512 * 1024 + 67);
+    for (uint8_t& b : data) {
+        b = (uint8_t)rng();
+    }
+
+    // Lengths around the block and padding boundaries, then random ones
+    int hashMismatches = 0, streamMismatches = 0, macMismatches = 0;
+    for (int round = 0; round < rounds; round++) {
+        size_t len = round < 200 ? (size_t)round : rng() % (round % 50 == 0 ? data.size() : 4096);
+        const uint8_t* message = data.data() + rng() % 64;
+
+        uint8_t expected[SHA256_DIGEST_SIZE], digest[SHA256_DIGEST_SIZE];
+        openssl.Sha256(message, len, expected);
+        software.Sha256(message, len, digest);
+        hashMismatches += memcmp(expected, digest, sizeof(digest)) != 0;
+
+        // The same message fed in random pieces
+        CryptoBackend::Context ctx;
+        software.Begin(ctx);
+        for (size_t pos = 0; pos < len;) {
+            size_t piece = 1 + rng() % (rng() % 2 ? 7 : 200);
+            piece = piece < len - pos ? piece : len - pos;
+            software.Update(ctx, message + pos, piece);
+            pos += piece;
+        }
+        software.Finish(ctx, digest);
+        streamMismatches += memcmp(expected, digest, sizeof(digest)) != 0;
+
+        size_t keyLen = rng() % 160;
+        const uint8_t* key = data.data() + rng() % 1024;
+        uint8_t mac[SHA256_DIGEST_SIZE];
+        unsigned macLen = 0;
+        HMAC(EVP_sha256(), key, (int)keyLen, message, len, expected, &macLen);
+        software.HmacSha256(key, keyLen, message, len, mac);
+        macMismatches += macLen != SHA256_DIGEST_SIZE || memcmp(expected, mac, sizeof(mac)) != 0;
+    }
+    printf("%d rounds, up to %zu bytes\n", rounds, data.size());
+    check(hashMismatches == 0, "openssl: one-shot SHA-256");
+    check(streamMismatches == 0, "openssl: SHA-256 in random Update() pieces");
+    check(macMismatches == 0, "openssl: HMAC-SHA256 with random key lengths");
+
+    // SigV4 chains HMACs with the output as the next input
+    uint8_t chained[SHA256_DIGEST_SIZE], expected[SHA256_DIGEST_SIZE];
+    unsigned macLen = 0;
+    memcpy(chained, data.data(), sizeof(chained));
+    memcpy(expected, data.data(), sizeof(expected));
+    for (int i = 0; i < 4; i++) {
+        software.HmacSha256(data.data() + 100, 40, chained, sizeof(chained), chained);
+        HMAC(EVP_sha256(), data.data() + 100, 40, expected, sizeof(expected), expected, &macLen);
+    }
+    check(memcmp(chained, expected, sizeof(chained)) == 0, "openssl: HMAC with data aliasing the output");
+
+    printf(failures ? "%d checks failed\n" : "all checks passed\n", failures);
+    return failures ? 1 : 0;
+}
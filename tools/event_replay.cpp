@@ -0,0 +1,613 @@
+// Deterministic replay of recorded event traces (events_*.cev, event_recorder.h)
+// through the shelter decisions the firmware runs (shelter_control.cpp), on a
+// virtual clock: a recorded week replays in well under a second.
+//
+// The Patura loop is rebuilt around the recorded inputs. An iteration runs at
+// every recorded time, decisions included (the device ran one then), at the
+// last loop before each PIR edge, and every --tick ms in between, except
+// inside recorded loop stalls (a photo upload blocking the loop). An
+// in-between iteration that takes a decision the device recorded a little
+// later is dropped: the device did not run then. Each iteration does what
+// loop() does, in its order: serial commands, PIR level, DHT22 reading,
+// blanket, photo schedule. IoT commands do not touch these decisions; -e lists
+// them with the other inputs.
+//
+// The replayed decisions are printed one per line, diff style, against the
+// decisions the device recorded: ' ' both (within --tolerance ms), '+' replay
+// only, '-' device only. Built with the shelter_control.cpp of the recorded
+// firmware, both sides match; built with another version, the differences are
+// what that version would have done with the same week. The exit status is 1
+// when they differ. Network, camera and upload timing are not simulated: a
+// photo takes the time of the stall recorded after it.
+//
+// Consecutive segments of one boot continue each other; after a reboot or a
+// lost segment the replay restarts from the next segment's snapshot.
+//
+// Build:  g++ -std=c++17 -O2 -I include -o event_replay tools/event_replay.cpp src/common/event_trace.cpp src/common/shelter_control.cpp
+// Usage:  event_replay [-q] [-e] [--tick ms] [--tolerance ms] <events.cev> ...
+//         -q  summary only, -e  print the recorded inputs too
+//
+// Segments must be given in time order (the S3 names sort that way).
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "event_trace.h"
+#include "shelter_control.h"
+
+static const char* DECISION_NAMES[EVENT_DECISION_COUNT] = {
+    "cat arrived", "cat left", "blanket on", "blanket off", "photo scheduled", "photo motion"};
+
+struct Segment {
+    std::string path;
+    EventTraceHeader header;
+    std::vector<uint8_t> data;
+};
+
+struct Record {
+    uint64_t t;                 // unwrapped millis() of the run
+    EventRecord r;
+};
+
+struct Decision {
+    uint64_t t;
+    uint8_t kind;               // EventDecision
+    std::string detail;
+    int match = -1;             // index on the other side, -1: none
+};
+
+struct Options {
+    bool quiet = false;
+    bool events = false;
+    uint32_t tick = 100;        // patura.cpp: delay(100) plus the loop's own work
+    uint32_t tolerance = 1000;
+};
+
+struct Totals {
+    uint64_t replayedMs = 0;
+    uint64_t iterations = 0;
+    uint64_t guessesDropped = 0;
+    uint64_t records = 0;
+    uint32_t segments = 0;
+    uint32_t runs = 0;
+    uint64_t blanketOnMs = 0;
+    uint64_t presentMs = 0;
+    uint64_t fallbackMs = 0;
+    uint32_t offlinePhotos = 0;
+    uint32_t count[EVENT_DECISION_COUNT][3] = {};     // replayed, recorded, matched
+    std::vector<uint32_t> arrivalLatency;             // PIR rising edge to cat arrived
+    std::vector<uint32_t> blanketOnLag;               // should be on (cat and cold) to on
+    std::vector<uint32_t> blanketOffLag;
+    uint32_t mismatches = 0;
+};
+
+static Options options;
+static Totals totals;
+
+static bool readSegment(const char* path, Segment& segment) {
+    std::ifstream in(path, std::ios::binary);
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (data.size() < sizeof(EventTraceHeader)) {
+        fprintf(stderr, "%s: too short\n", path);
+        return false;
+    }
+    memcpy(&segment.header, data.data(), sizeof(segment.header));
+    const EventTraceHeader& h = segment.header;
+    if (memcmp(h.magic, EVENT_TRACE_MAGIC, 4) != 0 || h.version != EVENT_TRACE_VERSION) {
+        fprintf(stderr, "%s: not an event trace (version %u)\n", path, h.version);
+        return false;
+    }
+    if (sizeof(h) + h.length > data.size()) {
+        fprintf(stderr, "%s: truncated, %zu of %u record bytes\n", path, data.size() - sizeof(h), h.length);
+        return false;
+    }
+    segment.path = path;
+    segment.data.assign(data.begin() + sizeof(h), data.begin() + sizeof(h) + h.length);
+    return true;
+}
+
+static bool continues(const Segment& prev, const Segment& next) {
+    return prev.header.bootId == next.header.bootId && prev.header.sequence + 1 == next.header.sequence &&
+           prev.header.endMs == next.header.startMs;
+}
+
+static std::string percentiles(std::vector<uint32_t> v) {
+    if (v.empty()) {
+        return "-";
+    }
+    std::sort(v.begin(), v.end());
+    char buf[96];
+    snprintf(buf, sizeof(buf), "p50 %u  p95 %u  max %u ms  (%zu)", v[(v.size() - 1) / 2],
+             v[(v.size() * 95 + 99) / 100 - 1], v.back(), v.size());
+    return buf;
+}
+
+static std::string duration(uint64_t ms) {
+    char buf[48];
+    uint64_t s = ms / 1000;
+    snprintf(buf, sizeof(buf), "%llud %02llu:%02llu:%02llu", (unsigned long long)(s / 86400),
+             (unsigned long long)(s / 3600 % 24), (unsigned long long)(s / 60 % 60), (unsigned long long)(s % 60));
+    return buf;
+}
+
+/// @brief One continuous recording: segments of one boot with nothing lost in between
+class Run {
+    std::vector<Record> _records;
+    std::vector<uint64_t> _reads;   // earlier loops a PIR edge points back to
+    std::vector<Decision> _recorded;
+    std::vector<Decision> _replayed;
+    uint64_t _start = 0;
+    uint64_t _end = 0;
+    uint32_t _base = 0;         // device millis() at run time 0
+
+    ShelterState _state;
+    bool _pir = false;
+    bool _wifi = false;
+    bool _camera = true;
+    int _hour = -1;
+    std::vector<std::pair<uint64_t, uint32_t>> _clocks;  // run time, epoch seconds then
+
+    uint64_t _lastRise = 0;     // PIR rising edge waiting for an arrival
+    uint64_t _wantSince = 0;    // automatic control wants the other blanket state since, 0: no
+
+    std::string Time(uint64_t t) const {
+        char buf[48];
+        auto clock = std::upper_bound(_clocks.begin(), _clocks.end(), std::make_pair(t, UINT32_MAX));
+        if (clock != _clocks.begin()) {
+            --clock;
+            uint64_t ms = (uint64_t)clock->second * 1000 + (t - clock->first);
+            time_t s = (time_t)(ms / 1000);
+            struct tm tm;
+            gmtime_r(&s, &tm);
+            size_t n = strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm);
+            snprintf(buf + n, sizeof(buf) - n, ".%03u", (unsigned)(ms % 1000));
+        } else {
+            uint64_t uptime = _base + t;
+            snprintf(buf, sizeof(buf), "uptime %llu.%03us", (unsigned long long)(uptime / 1000),
+                     (unsigned)(uptime % 1000));
+        }
+        return buf;
+    }
+
+    void Decide(uint64_t t, EventDecision kind, const std::string& detail = "") {
+        _replayed.push_back({t, (uint8_t)kind, detail});
+    }
+
+    // handleSerialCommands(), the commands that touch decisions
+    void Command(uint64_t t, const EventRecord& r) {
+        std::string text(r.text, r.textLength);
+        if (text == "blanket on" || text == "blanket off") {
+            _state.blanketManualOverride = true;
+            if (_state.SetBlanket(text == "blanket on", (uint32_t)t)) {
+                Decide(t, _state.blanketOn ? EVENT_BLANKET_ON : EVENT_BLANKET_OFF, "manual");
+            }
+        } else if (text == "blanket auto") {
+            _state.blanketManualOverride = false;
+        }
+    }
+
+    void Iterate(uint64_t t, const std::vector<const EventRecord*>& inputs) {
+        uint32_t now = (uint32_t)t;
+        ++totals.iterations;
+
+        // handleSerialCommands()
+        const EventRecord* dht = nullptr;
+        for (const EventRecord* r : inputs) {
+            if (r->type == EVENT_COMMAND && r->value == EVENT_SOURCE_SERIAL) {
+                Command(t, *r);
+            } else if (r->type == EVENT_DHT || r->type == EVENT_DHT_FAIL) {
+                dht = r;
+            }
+        }
+
+        // checkPIRSensor()
+        switch (_state.Motion(_pir, now)) {
+            case PRESENCE_ARRIVED:
+                if (_lastRise) {
+                    totals.arrivalLatency.push_back((uint32_t)(t - _lastRise));
+                    _lastRise = 0;
+                }
+                Decide(t, EVENT_CAT_ARRIVED);
+                break;
+            case PRESENCE_TIMEOUT:
+                Decide(t, EVENT_CAT_LEFT);
+                break;
+            default:
+                break;
+        }
+
+        // readDHT22()
+        if (dht) {
+            float temperature = dht->temperature;
+            float humidity = dht->humidity;
+            if (dht->type == EVENT_DHT_FAIL) {
+                temperature = dht->value & EVENT_DHT_NAN_TEMPERATURE ? NAN : _state.currentTemp;
+                humidity = dht->value & EVENT_DHT_NAN_HUMIDITY ? NAN : _state.currentHumidity;
+            }
+            _state.Reading(temperature, humidity);
+        }
+
+        // updateBlanketControl()
+        TempSource source;
+        float effective = _state.EffectiveTemperature(_hour, &source);
+        BlanketStep step = _state.Blanket(effective, now);
+        if (step == BLANKET_KEEP) {
+            _wantSince = 0;
+        } else if (!_wantSince) {
+            _wantSince = t + 1;
+        }
+        if (step == BLANKET_SWITCH) {
+            _state.SetBlanket(!_state.blanketOn, now);
+            (_state.blanketOn ? totals.blanketOnLag : totals.blanketOffLag).push_back((uint32_t)(t + 1 - _wantSince));
+            _wantSince = 0;
+            char detail[48];
+            snprintf(detail, sizeof(detail), "%.1f C%s", effective,
+                     source == TEMP_SOURCE_SENSOR ? "" : source == TEMP_SOURCE_FAILED ? " expected, sensor failed"
+                                                                                      : " expected, aberrant reading");
+            Decide(t, _state.blanketOn ? EVENT_BLANKET_ON : EVENT_BLANKET_OFF, detail);
+        }
+
+        // checkPhotoSchedule()
+        if (_camera) {
+            PhotoTrigger photo = _state.Photo(now);
+            if (photo != PHOTO_NONE) {
+                if (!_wifi) {
+                    ++totals.offlinePhotos;
+                }
+                Decide(t, photo == PHOTO_SCHEDULED ? EVENT_PHOTO_SCHEDULED : EVENT_PHOTO_MOTION,
+                       _wifi ? "" : "offline, not taken");
+            }
+        }
+    }
+
+    // A device decision of this kind a little after t
+    bool RecordedSoon(uint64_t t, uint8_t kind) const {
+        auto it = std::upper_bound(_recorded.begin(), _recorded.end(), t,
+                                   [](uint64_t v, const Decision& d) { return v < d.t; });
+        for (; it != _recorded.end() && it->t <= t + options.tolerance; ++it) {
+            if (it->kind == kind) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // An iteration between recorded times is a guess at when the loop ran.
+    // One that takes a decision the device took a little later did not run:
+    // without this a timer restarted from the decision (the hourly photo)
+    // drifts ahead by a fraction of a loop every time.
+    void Guess(uint64_t t) {
+        ShelterState state = _state;
+        uint64_t lastRise = _lastRise, wantSince = _wantSince;
+        size_t decided = _replayed.size(), arrival = totals.arrivalLatency.size();
+        size_t on = totals.blanketOnLag.size(), off = totals.blanketOffLag.size();
+        uint32_t offline = totals.offlinePhotos;
+
+        Iterate(t, {});
+        for (size_t i = decided; i < _replayed.size(); i++) {
+            if (RecordedSoon(t, _replayed[i].kind)) {
+                _state = state;
+                _lastRise = lastRise;
+                _wantSince = wantSince;
+                _replayed.resize(decided);
+                totals.arrivalLatency.resize(arrival);
+                totals.blanketOnLag.resize(on);
+                totals.blanketOffLag.resize(off);
+                totals.offlinePhotos = offline;
+                --totals.iterations;
+                ++totals.guessesDropped;
+                return;
+            }
+        }
+    }
+
+    void Account(uint64_t from, uint64_t to) {
+        uint64_t ms = to - from;
+        totals.blanketOnMs += _state.blanketOn ? ms : 0;
+        totals.presentMs += _state.catPresent ? ms : 0;
+        TempSource source;
+        _state.EffectiveTemperature(_hour, &source);
+        totals.fallbackMs += source != TEMP_SOURCE_SENSOR ? ms : 0;
+    }
+
+    void PrintInput(uint64_t t, const EventRecord& r) const {
+        static const char* names[EVENT_TYPE_END] = {"", "pir low", "pir high", "dht", "dht nan", "lux",
+            "wifi down", "wifi up", "mqtt down", "mqtt up", "command", "clock", "stall", "decision"};
+        if (r.type == EVENT_DECISION) {
+            return;
+        }
+        printf("  %s  . %s", Time(t).c_str(), names[r.type]);
+        switch (r.type) {
+            case EVENT_DHT:
+                printf(" %.1f C %.1f %%", r.temperature, r.humidity);
+                break;
+            case EVENT_DHT_FAIL:
+                printf(" 0x%x", r.value);
+                break;
+            case EVENT_LUX:
+                printf(" %.2f", r.lux);
+                break;
+            case EVENT_COMMAND:
+                printf(" %s %.*s", r.value == EVENT_SOURCE_IOT ? "iot" : "serial", r.textLength, r.text);
+                break;
+            case EVENT_CLOCK:
+                printf(" hour %d", r.hour);
+                break;
+            case EVENT_STALL:
+                printf(" %u ms", r.value);
+                break;
+        }
+        printf("\n");
+    }
+
+    void Match() {
+        // Greedy, in time order, per kind
+        for (Decision& replayed : _replayed) {
+            for (size_t i = 0; i < _recorded.size(); i++) {
+                Decision& recorded = _recorded[i];
+                if (recorded.match >= 0 || recorded.kind != replayed.kind) {
+                    continue;
+                }
+                uint64_t dt = recorded.t > replayed.t ? recorded.t - replayed.t : replayed.t - recorded.t;
+                if (dt <= options.tolerance) {
+                    recorded.match = (int)(&replayed - _replayed.data());
+                    replayed.match = (int)i;
+                    break;
+                }
+                if (recorded.t > replayed.t + options.tolerance) {
+                    break;
+                }
+            }
+        }
+    }
+
+    void Report() {
+        Match();
+        for (const Decision& d : _replayed) {
+            ++totals.count[d.kind][0];
+            totals.count[d.kind][2] += d.match >= 0;
+            totals.mismatches += d.match < 0;
+        }
+        for (const Decision& d : _recorded) {
+            ++totals.count[d.kind][1];
+            totals.mismatches += d.match < 0;
+        }
+        if (options.quiet) {
+            return;
+        }
+        // Merged, in time order; a match prints once, at the replayed time
+        size_t i = 0, j = 0;
+        while (i < _replayed.size() || j < _recorded.size()) {
+            if (j < _recorded.size() && _recorded[j].match >= 0) {
+                ++j;
+                continue;
+            }
+            bool replayedFirst = i < _replayed.size() && (j >= _recorded.size() || _replayed[i].t <= _recorded[j].t);
+            const Decision& d = replayedFirst ? _replayed[i++] : _recorded[j++];
+            char mark = !replayedFirst ? '-' : d.match >= 0 ? ' ' : '+';
+            printf("%c %s  %s", mark, Time(d.t).c_str(), DECISION_NAMES[d.kind]);
+            if (replayedFirst && d.match >= 0) {
+                int64_t dt = (int64_t)d.t - (int64_t)_recorded[d.match].t;
+                if (dt) {
+                    printf(" (device %+lld ms)", (long long)-dt);
+                }
+            }
+            printf(d.detail.empty() ? "\n" : "  %s\n", d.detail.c_str());
+        }
+    }
+
+public:
+    /// @brief Decode a run of segments into one unwrapped timeline
+    bool Load(const std::vector<Segment>& segments, size_t first, size_t last) {
+        const EventTraceHeader& h = segments[first].header;
+        _start = 0;
+        if (h.startTime) {
+            _clocks.push_back({0, h.startTime});
+        }
+        uint64_t t = 0;
+        uint32_t lastMs = h.startMs;
+        for (size_t s = first; s <= last; s++) {
+            const Segment& segment = segments[s];
+            EventTraceReader reader;
+            reader.Begin(segment.data.data(), segment.data.size(), segment.header.startMs);
+            EventRecord r;
+            while (reader.Next(r)) {
+                t += (uint32_t)(r.ms - lastMs);
+                lastMs = r.ms;
+                if (r.type == EVENT_DECISION && r.value < EVENT_DECISION_COUNT) {
+                    _recorded.push_back({t, (uint8_t)r.value, ""});
+                } else if (r.type == EVENT_CLOCK && r.value) {
+                    _clocks.push_back({t, r.value});
+                } else if ((r.type == EVENT_PIR_HIGH || r.type == EVENT_PIR_LOW) && r.value && r.value <= t) {
+                    _reads.push_back(t - r.value);
+                }
+                _records.push_back({t, r});
+                ++totals.records;
+            }
+            if (reader.Corrupt()) {
+                fprintf(stderr, "%s: malformed record, rest of the segment skipped\n", segment.path.c_str());
+            }
+            t += (uint32_t)(segment.header.endMs - lastMs);
+            lastMs = segment.header.endMs;
+        }
+        _end = t;
+        std::sort(_reads.begin(), _reads.end());
+
+        // Snapshot of the first segment; times are relative to its start
+        uint32_t base = h.startMs;
+        _base = base;
+        _state.catPresent = h.flags & EVENT_FLAG_CAT_PRESENT;
+        _state.blanketOn = h.flags & EVENT_FLAG_BLANKET_ON;
+        _state.blanketManualOverride = h.flags & EVENT_FLAG_BLANKET_OVERRIDE;
+        _state.dhtSensorWorking = h.flags & EVENT_FLAG_DHT_WORKING;
+        _state.lastCatPresent = h.flags & EVENT_FLAG_LAST_CAT_PRESENT;
+        _state.lastBlanketChange = h.lastBlanketChange - base;
+        _state.lastMotionDetected = h.lastMotionDetected - base;
+        _state.lastPhotoTime = h.lastPhotoTime - base;
+        _state.lastHourlyPhotoTime = h.lastHourlyPhotoTime - base;
+        _state.currentTemp = h.currentTemp;
+        _state.currentHumidity = h.currentHumidity;
+        _pir = h.flags & EVENT_FLAG_PIR;
+        _wifi = h.flags & EVENT_FLAG_WIFI;
+        _camera = h.flags & EVENT_FLAG_CAMERA;
+        _hour = h.hour;
+        return true;
+    }
+
+    void Replay() {
+        // Stalls, and the time between a PIR edge and the loop before it: no
+        // iteration ran strictly inside (end - gap, end)
+        std::vector<std::pair<uint64_t, uint64_t>> stalls;
+        for (const Record& rec : _records) {
+            if (rec.r.type == EVENT_STALL || rec.r.type == EVENT_PIR_HIGH || rec.r.type == EVENT_PIR_LOW) {
+                stalls.push_back({rec.t > rec.r.value ? rec.t - rec.r.value : 0, rec.t});
+            }
+        }
+        std::sort(stalls.begin(), stalls.end());
+
+        size_t next = 0, stall = 0, read = 0;
+        uint64_t t = _start, last = _start;
+        uint64_t tick = _start;
+        std::vector<const EventRecord*> inputs;
+        for (;;) {
+            uint64_t event = next < _records.size() ? _records[next].t : UINT64_MAX;
+            if (read < _reads.size()) {
+                event = std::min(event, _reads[read]);
+            }
+            while (stall < stalls.size() && stalls[stall].second <= tick) {
+                ++stall;
+            }
+            if (stall < stalls.size() && stalls[stall].first < tick) {
+                tick = stalls[stall].second;
+            }
+            if (event <= tick) {
+                t = event;
+            } else if (tick <= _end) {
+                t = tick;
+            } else {
+                break;
+            }
+
+            inputs.clear();
+            while (next < _records.size() && _records[next].t == t) {
+                const EventRecord& r = _records[next].r;
+                if (options.events) {
+                    PrintInput(t, r);
+                }
+                switch (r.type) {
+                    case EVENT_PIR_HIGH:
+                        _pir = true;
+                        _lastRise = t;
+                        break;
+                    case EVENT_PIR_LOW:
+                        _pir = false;
+                        break;
+                    case EVENT_WIFI_UP:
+                    case EVENT_WIFI_DOWN:
+                        _wifi = r.type == EVENT_WIFI_UP;
+                        break;
+                    case EVENT_CLOCK:
+                        _hour = r.hour;
+                        break;
+                    case EVENT_COMMAND:
+                        if (r.value == EVENT_SOURCE_SERIAL) {
+                            inputs.push_back(&r);
+                        }
+                        break;
+                    case EVENT_DHT:
+                    case EVENT_DHT_FAIL:
+                        inputs.push_back(&r);
+                        break;
+                }
+                ++next;
+            }
+
+            Account(last, t);
+            last = t;
+            if (event == t) {
+                Iterate(t, inputs);
+            } else {
+                Guess(t);
+            }
+            while (read < _reads.size() && _reads[read] <= t) {
+                ++read;
+            }
+            tick = t + options.tick;
+        }
+        Account(last, _end);
+        totals.replayedMs += _end - _start;
+        Report();
+    }
+};
+
+int main(int argc, char** argv) {
+    std::vector<Segment> segments;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-q") == 0) {
+            options.quiet = true;
+        } else if (strcmp(argv[i], "-e") == 0) {
+            options.events = true;
+        } else if (strcmp(argv[i], "--tick") == 0 && i + 1 < argc) {
+            options.tick = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) {
+            options.tolerance = atoi(argv[++i]);
+        } else {
+            Segment segment;
+            if (!readSegment(argv[i], segment)) {
+                return 2;
+            }
+            segments.push_back(std::move(segment));
+        }
+    }
+    if (segments.empty()) {
+        fprintf(stderr, "usage: %s [-q] [-e] [--tick ms] [--tolerance ms] <events.cev> ...\n", argv[0]);
+        return 2;
+    }
+
+    auto started = std::chrono::steady_clock::now();
+    for (size_t first = 0; first < segments.size();) {
+        size_t last = first;
+        while (last + 1 < segments.size() && continues(segments[last], segments[last + 1])) {
+            ++last;
+        }
+        const EventTraceHeader& h = segments[first].header;
+        if (!options.quiet) {
+            printf("# boot %08x, segments %u-%u%s\n", h.bootId, h.sequence, segments[last].header.sequence,
+                   first > 0 ? ", state restarted from the snapshot" : "");
+        }
+        Run run;
+        run.Load(segments, first, last);
+        run.Replay();
+        totals.segments += last - first + 1;
+        ++totals.runs;
+        first = last + 1;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+    printf("\nreplayed %s in %.2f s: %u segments, %u runs, %llu records, %llu iterations (%llu dropped)\n",
+           duration(totals.replayedMs).c_str(), seconds, totals.segments, totals.runs,
+           (unsigned long long)totals.records, (unsigned long long)totals.iterations,
+           (unsigned long long)totals.guessesDropped);
+    printf("%-16s %9s %9s %9s\n", "decision", "replayed", "device", "matched");
+    for (int k = 0; k < EVENT_DECISION_COUNT; k++) {
+        printf("%-16s %9u %9u %9u\n", DECISION_NAMES[k], totals.count[k][0], totals.count[k][1], totals.count[k][2]);
+    }
+    double total = totals.replayedMs ? (double)totals.replayedMs : 1;
+    printf("cat present      %s (%.1f%%)\n", duration(totals.presentMs).c_str(), 100 * totals.presentMs / total);
+    printf("blanket on       %s (%.1f%%)\n", duration(totals.blanketOnMs).c_str(), 100 * totals.blanketOnMs / total);
+    printf("fallback temp    %s (%.1f%%)\n", duration(totals.fallbackMs).c_str(), 100 * totals.fallbackMs / total);
+    printf("offline photos   %u\n", totals.offlinePhotos);
+    printf("pir -> arrived   %s\n", percentiles(totals.arrivalLatency).c_str());
+    printf("blanket on lag   %s\n", percentiles(totals.blanketOnLag).c_str());
+    printf("blanket off lag  %s\n", percentiles(totals.blanketOffLag).c_str());
+    printf("%u decisions differ from the device\n", totals.mismatches);
+    return totals.mismatches ? 1 : 0;
+}
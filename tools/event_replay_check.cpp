@@ -0,0 +1,390 @@
+// Round trip check of the event trace replay (tools/event_replay.cpp): a
+// simulated Patura loop runs the shelter decisions (shelter_control.cpp) over
+// two boots, recording segments with EventTraceWriter the way EventRecorder
+// does, then the replay binaries are run on them:
+//
+//   record    the loop takes every kind of decision; 6 hours in hourly
+//             segments, then a reboot and 3 more hours
+//   same      event_replay built with the same shelter_control.cpp matches
+//             every decision and exits 0, over 3 runs: segments 0-2, 4-5
+//             after the lost segment 3, and the second boot
+//   changed   event_replay built with another TEMP_COLD_THRESHOLD exits 1
+//
+// The loop runs every 100 ms, stalls after each photo (upload) and sees cat
+// visits, a DHT22 failure with the hourly fallback, a manual blanket override
+// and a WiFi drop. Exits 1 on any failure.
+//
+// Build:  g++ -std=c++17 -O2 -I include -o event_replay_check tools/event_replay_check.cpp src/common/event_trace.cpp src/common/shelter_control.cpp
+// Usage:  event_replay_check <event_replay> <event_replay built with another threshold> [seed]
+
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include "event_trace.h"
+#include "shelter_control.h"
+
+#define LOOP_MS 100                    // patura.cpp: delay(100)
+#define SEGMENT_MS 3600000             // EVENT_DEFAULT_INTERVAL
+#define SEGMENT_BYTES 16384            // EVENT_SEGMENT_BYTES_PSRAM
+#define STALL_MS 1000                  // EVENT_STALL_MS
+#define DHT_INTERVAL 2000
+#define HOUR_MS 3600000u
+
+static int failures = 0;
+
+static void check(bool ok, const char* scenario, const char* what) {
+    printf("%s %-8s %s\n", ok ? "ok  " : "FAIL", scenario, what);
+    failures += !ok;
+}
+
+/// @brief What the loop sees at a given uptime
+struct Inputs {
+    std::vector<std::pair<uint32_t, uint32_t>> motion;      // PIR high from, to (ms)
+    std::vector<std::pair<uint32_t, std::string>> commands;
+    uint32_t dhtFailFrom = 0, dhtFailTo = 0;
+    uint32_t wifiDownFrom = 0, wifiDownTo = 0;
+    float tempFrom = 0, tempTo = 0;                          // linear over the boot, plus noise
+    uint32_t bootMs = 0, endMs = 0;
+    uint32_t startEpoch = 0;                                 // at bootMs
+
+    bool Pir(uint32_t now) const {
+        for (const auto& m : motion) {
+            if (now >= m.first && now < m.second) {
+                return true;
+            }
+        }
+        return false;
+    }
+    bool Wifi(uint32_t now) const { return now < wifiDownFrom || now >= wifiDownTo; }
+    uint32_t Epoch(uint32_t now) const { return startEpoch + (now - bootMs) / 1000; }
+};
+
+/// @brief One boot of the Patura loop, recording like EventRecorder
+class Device {
+    const Inputs& _in;
+    std::mt19937& _rng;
+    ShelterState _state;
+    EventTraceWriter _writer;
+    EventTraceHeader _header;
+    std::vector<uint8_t> _buf = std::vector<uint8_t>(SEGMENT_BYTES);
+    uint32_t _bootId;
+    uint32_t _sequence = 0;
+
+    bool _pir = false;
+    uint32_t _pirReadMs = 0;
+    bool _wifi = true;
+    int _hour = -1;
+    uint32_t _lastLoopMs = 0;
+    uint32_t _lastDhtMs = 0;
+    int32_t _temperature = INT32_MIN, _humidity = INT32_MIN;
+    uint8_t _dhtNan = 0;
+
+    void StartSegment(uint32_t now) {
+        memset(&_header, 0, sizeof(_header));
+        memcpy(_header.magic, EVENT_TRACE_MAGIC, sizeof(_header.magic));
+        _header.version = EVENT_TRACE_VERSION;
+        _header.flags = (_state.catPresent ? EVENT_FLAG_CAT_PRESENT : 0) |
+                        (_state.blanketOn ? EVENT_FLAG_BLANKET_ON : 0) |
+                        (_state.blanketManualOverride ? EVENT_FLAG_BLANKET_OVERRIDE : 0) |
+                        (_state.dhtSensorWorking ? EVENT_FLAG_DHT_WORKING : 0) |
+                        (_state.lastCatPresent ? EVENT_FLAG_LAST_CAT_PRESENT : 0) |
+                        (_pir ? EVENT_FLAG_PIR : 0) | (_wifi ? EVENT_FLAG_WIFI : 0) | EVENT_FLAG_CAMERA;
+        _header.bootId = _bootId;
+        _header.sequence = _sequence++;
+        _header.startMs = now;
+        _header.startTime = _in.Epoch(now);
+        _header.lastBlanketChange = _state.lastBlanketChange;
+        _header.lastMotionDetected = _state.lastMotionDetected;
+        _header.lastPhotoTime = _state.lastPhotoTime;
+        _header.lastHourlyPhotoTime = _state.lastHourlyPhotoTime;
+        _header.currentTemp = _state.currentTemp;
+        _header.currentHumidity = _state.currentHumidity;
+        _header.hour = (int8_t)_hour;
+        _writer.Begin(_buf.data(), _buf.size(), now);
+    }
+
+    void Seal(uint32_t now) {
+        _header.endMs = now;
+        _header.length = _writer.Bytes();
+        _header.records = _writer.Records();
+        std::vector<uint8_t> segment((uint8_t*)&_header, (uint8_t*)&_header + sizeof(_header));
+        segment.insert(segment.end(), _writer.Data(), _writer.Data() + _writer.Bytes());
+        segments.push_back(std::move(segment));
+    }
+
+    // EventRecorder::Recording(): a full segment is sealed early
+    void Room(uint32_t now) {
+        if (_writer.Bytes() + EVENT_RECORD_MAX > _buf.size()) {
+            Seal(now);
+            StartSegment(now);
+        }
+    }
+
+    void Decide(uint32_t now, EventDecision decision) {
+        Room(now);
+        _writer.Decision(now, decision);
+        ++decisions[decision];
+    }
+
+    // handleSerialCommands()
+    void Command(uint32_t now, const std::string& text) {
+        Room(now);
+        _writer.Command(now, EVENT_SOURCE_SERIAL, text.c_str(), text.size());
+        if (text == "blanket on" || text == "blanket off") {
+            _state.blanketManualOverride = true;
+            if (_state.SetBlanket(text == "blanket on", now)) {
+                Decide(now, _state.blanketOn ? EVENT_BLANKET_ON : EVENT_BLANKET_OFF);
+            }
+        } else if (text == "blanket auto") {
+            _state.blanketManualOverride = false;
+        }
+    }
+
+    // readDHT22(), recorded when the reading changes
+    void Dht(uint32_t now) {
+        float progress = (float)(now - _in.bootMs) / (_in.endMs - _in.bootMs);
+        float temperature = _in.tempFrom + (_in.tempTo - _in.tempFrom) * progress +
+                            std::uniform_real_distribution<float>(-0.3f, 0.3f)(_rng);
+        float humidity = 75 + std::uniform_real_distribution<float>(-2, 2)(_rng);
+        temperature = eventFromTenths(eventTenths(temperature));
+        humidity = eventFromTenths(eventTenths(humidity));
+        if (now >= _in.dhtFailFrom && now < _in.dhtFailTo) {
+            temperature = NAN;
+        }
+
+        uint8_t nan = (std::isnan(temperature) ? EVENT_DHT_NAN_TEMPERATURE : 0) |
+                      (std::isnan(humidity) ? EVENT_DHT_NAN_HUMIDITY : 0);
+        if (nan && nan != _dhtNan) {
+            Room(now);
+            _dhtNan = nan;
+            _writer.DhtFail(now, nan);
+        } else if (!nan && (_dhtNan || eventTenths(temperature) != _temperature || eventTenths(humidity) != _humidity)) {
+            Room(now);
+            _dhtNan = 0;
+            _temperature = eventTenths(temperature);
+            _humidity = eventTenths(humidity);
+            _writer.Dht(now, temperature, humidity);
+        }
+        _state.Reading(temperature, humidity);
+    }
+
+public:
+    std::vector<std::vector<uint8_t>> segments;
+    uint32_t decisions[EVENT_DECISION_COUNT] = {};
+
+    Device(const Inputs& in, std::mt19937& rng, uint32_t bootId) : _in(in), _rng(rng), _bootId(bootId) {}
+
+    void Run() {
+        // setup()
+        uint32_t now = _in.bootMs;
+        _state.lastPhotoTime = now - PHOTO_MOTION_COOLDOWN - 1000;
+        _state.lastHourlyPhotoTime = now;
+        _hour = (int)(_in.Epoch(now) / 3600 % 24);
+        _lastLoopMs = now;
+        _pirReadMs = now;
+        StartSegment(now);
+
+        size_t command = 0;
+        while (now < _in.endMs) {
+            // EventRecorder::Loop()
+            if (now - _lastLoopMs >= STALL_MS) {
+                Room(now);
+                _writer.Stall(now, now - _lastLoopMs);
+            }
+            _lastLoopMs = now;
+            if (_in.Wifi(now) != _wifi) {
+                Room(now);
+                _wifi = !_wifi;
+                _writer.Event(_wifi ? EVENT_WIFI_UP : EVENT_WIFI_DOWN, now);
+            }
+            int hour = (int)(_in.Epoch(now) / 3600 % 24);
+            if (hour != _hour) {
+                Room(now);
+                _hour = hour;
+                _writer.Clock(now, _in.Epoch(now), hour);
+            }
+            if (now - _header.startMs >= SEGMENT_MS) {
+                Seal(now);
+                StartSegment(now);
+            }
+
+            // loop()
+            while (command < _in.commands.size() && _in.commands[command].first <= now) {
+                Command(now, _in.commands[command++].second);
+            }
+
+            bool pir = _in.Pir(now);
+            if (pir != _pir) {
+                Room(now);
+                _writer.Pir(now, pir, now - _pirReadMs);
+                _pir = pir;
+            }
+            _pirReadMs = now;
+            switch (_state.Motion(_pir, now)) {
+                case PRESENCE_ARRIVED:
+                    Decide(now, EVENT_CAT_ARRIVED);
+                    break;
+                case PRESENCE_TIMEOUT:
+                    Decide(now, EVENT_CAT_LEFT);
+                    break;
+                default:
+                    break;
+            }
+
+            if (now - _lastDhtMs >= DHT_INTERVAL) {
+                _lastDhtMs = now;
+                Dht(now);
+            }
+
+            if (_state.Blanket(_state.EffectiveTemperature(_hour), now) == BLANKET_SWITCH) {
+                _state.SetBlanket(!_state.blanketOn, now);
+                Decide(now, _state.blanketOn ? EVENT_BLANKET_ON : EVENT_BLANKET_OFF);
+            }
+
+            uint32_t next = LOOP_MS;
+            PhotoTrigger photo = _state.Photo(now);
+            if (photo != PHOTO_NONE) {
+                Decide(now, photo == PHOTO_SCHEDULED ? EVENT_PHOTO_SCHEDULED : EVENT_PHOTO_MOTION);
+                // The upload holds the loop; offline it only takes the picture
+                next = _wifi ? std::uniform_int_distribution<uint32_t>(2000, 9000)(_rng) : 400;
+            }
+            now += next;
+        }
+        Seal(now);
+    }
+};
+
+/// @brief Cat visits: a few motion bursts each, visits further apart than the presence timeout
+static void visits(Inputs& in, std::mt19937& rng, const std::vector<uint32_t>& starts) {
+    for (uint32_t start : starts) {
+        uint32_t t = in.bootMs + start;
+        int bursts = std::uniform_int_distribution<int>(3, 8)(rng);
+        for (int i = 0; i < bursts; i++) {
+            uint32_t len = std::uniform_int_distribution<uint32_t>(2500, 20000)(rng);
+            in.motion.push_back({t, t + len});
+            t += len + std::uniform_int_distribution<uint32_t>(20000, 900000)(rng);
+        }
+    }
+}
+
+static bool writeFile(const std::string& path, const std::vector<uint8_t>& data) {
+    FILE* f = fopen(path.c_str(), "wb");
+    if (!f) {
+        return false;
+    }
+    bool ok = fwrite(data.data(), 1, data.size(), f) == data.size();
+    return fclose(f) == 0 && ok;
+}
+
+/// @brief Runs a replay binary on the files; returns its exit status, -1 when it did not exit
+static int replay(const std::string& binary, const std::vector<std::string>& files, std::string& output) {
+    std::string command = binary + " -q";
+    for (const std::string& file : files) {
+        command += " " + file;
+    }
+    output.clear();
+    FILE* p = popen(command.c_str(), "r");
+    if (!p) {
+        return -1;
+    }
+    char line[256];
+    while (fgets(line, sizeof(line), p)) {
+        output += line;
+    }
+    int status = pclose(p);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s <event_replay> <event_replay built with another threshold> [seed]\n", argv[0]);
+        return 2;
+    }
+    std::mt19937 rng(argc > 3 ? (unsigned)atoi(argv[3]) : 1);
+
+    // Boot 1: evening, getting colder, 6 hours
+    Inputs first;
+    first.bootMs = 3000;
+    first.endMs = first.bootMs + 6 * HOUR_MS;
+    first.startEpoch = 1767117600;                       // 2025-12-30 18:00 UTC
+    first.tempFrom = 15;
+    first.tempTo = 7;
+    visits(first, rng, {20 * 60000u, 140 * 60000u, 280 * 60000u});
+    first.dhtFailFrom = first.bootMs + 150 * 60000u;     // during the second visit
+    first.dhtFailTo = first.dhtFailFrom + 25 * 60000u;
+    first.wifiDownFrom = first.bootMs + 40 * 60000u;
+    first.wifiDownTo = first.wifiDownFrom + 15 * 60000u;
+    first.commands = {{first.bootMs + 290 * 60000u, "blanket on"}, {first.bootMs + 300 * 60000u, "blanket auto"}};
+    Device boot1(first, rng, 0x1a2b3c4d);
+    boot1.Run();
+
+    // Boot 2: a reboot shortly after, 3 hours around 10 C
+    Inputs second;
+    second.bootMs = 2500;
+    second.endMs = second.bootMs + 3 * HOUR_MS;
+    second.startEpoch = first.Epoch(first.endMs) + 60;
+    second.tempFrom = 11;
+    second.tempTo = 9;
+    visits(second, rng, {30 * 60000u});
+    Device boot2(second, rng, 0x5e6f7a8b);
+    boot2.Run();
+
+    bool every = true;
+    for (int k = 0; k < EVENT_DECISION_COUNT; k++) {
+        every = every && boot1.decisions[k] + boot2.decisions[k] > 0;
+    }
+    check(every, "record", "every kind of decision taken");
+    check(boot1.segments.size() == 6 && boot2.segments.size() == 3, "record", "hourly segments, 6 + 3");
+
+    char dir[] = "/tmp/event-replay-XXXXXX";
+    if (!mkdtemp(dir)) {
+        return 2;
+    }
+    std::vector<std::string> files;
+    for (size_t boot = 0; boot < 2; boot++) {
+        const Device& device = boot == 0 ? boot1 : boot2;
+        for (size_t i = 0; i < device.segments.size(); i++) {
+            if (boot == 0 && i == 3) {
+                continue;               // lost on the way
+            }
+            char name[64];
+            snprintf(name, sizeof(name), "/events_%zu_%05zu" EVENT_TRACE_EXTENSION, boot, i);
+            files.push_back(dir + std::string(name));
+            if (!writeFile(files.back(), device.segments[i])) {
+                fprintf(stderr, "cannot write %s\n", files.back().c_str());
+                return 2;
+            }
+        }
+    }
+
+    std::string output;
+    int status = replay(argv[1], files, output);
+    check(status == 0, "same", "exit 0");
+    check(output.find(" 3 runs,") != std::string::npos, "same", "3 runs: lost segment and reboot restart");
+    check(output.find("\n0 decisions differ") != std::string::npos, "same", "every decision matched");
+    if (status != 0) {
+        printf("%s", output.c_str());
+    }
+
+    status = replay(argv[2], files, output);
+    check(status == 1, "changed", "exit 1");
+    check(output.find("\n0 decisions differ") == std::string::npos, "changed", "blanket decisions differ");
+
+    for (const std::string& file : files) {
+        unlink(file.c_str());
+    }
+    rmdir(dir);
+
+    if (failures) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,160 @@
+// Cached S3 config download check (s3_fetch_cache.cpp) against the S3
+// stand-in (tools/s3_standin.py), which it starts itself. The device applies
+// a camera config document and only then commits it to the cache; here a
+// document is "applied" when it starts with "good":
+//
+//   fresh      first download is MODIFIED; once committed, the next one is a
+//              304 answered from the cache
+//   rejected   a document the device rejects is not cached: it comes back
+//              MODIFIED (200, not 304) on every check, with the last applied
+//              copy still in the cache
+//   changed    a newer good document replaces the cached one
+//   deleted    NOT_FOUND, with the cached copy returned
+//   offline    no response: ERROR, with the cached copy returned
+//
+// Exits 1 on any failure.
+//
+// Build:  g++ -std=c++17 -O2 -I include -o fetch_cache_check tools/fetch_cache_check.cpp src/common/s3_fetch_cache.cpp
+// Usage:  fetch_cache_check      (from the repository root)
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include "s3_fetch_cache.h"
+#include "standin_client.h"
+
+#define CONFIG_KEY "/check/camera-config.json"
+#define CACHE_KEY "camcfg"
+
+static int failures = 0;
+
+static void check(bool ok, const char* scenario, const char* what) {
+    printf("%s %-8s %s\n", ok ? "ok  " : "FAIL", scenario, what);
+    failures += !ok;
+}
+
+/// @brief NVM stand-in
+class MemoryStore : public S3FetchStore {
+public:
+    bool present = false;
+    std::string etag;
+    std::string body;
+    uint32_t saves = 0;
+
+    bool Load(const char* cacheKey, char* e, size_t etagCap, char* b, size_t bodyCap) override {
+        if (!present || strcmp(cacheKey, CACHE_KEY) != 0) {
+            return false;
+        }
+        snprintf(e, etagCap, "%s", etag.c_str());
+        if (b) {
+            snprintf(b, bodyCap, "%s", body.c_str());
+        }
+        return true;
+    }
+    void Save(const char* cacheKey, const char* e, const char* b) override {
+        present = strcmp(cacheKey, CACHE_KEY) == 0;
+        etag = e;
+        body = b;
+        ++saves;
+    }
+};
+
+/// @brief GET with the quoted If-None-Match the device sends (getFromS3)
+class StandInTransport : public S3FetchTransport {
+public:
+    int port;
+    int lastStatus = 0;
+
+    explicit StandInTransport(int p) : port(p) {}
+
+    int Get(const char* key, const char* ifNoneMatch, char* body, size_t bodyCap, char* etag,
+            size_t etagCap) override {
+        std::vector<std::pair<std::string, std::string>> headers;
+        if (ifNoneMatch[0]) {
+            headers.push_back({"If-None-Match", std::string("\"") + ifNoneMatch + "\""});
+        }
+        HttpResponse response;
+        lastStatus = httpRequest(port, "GET", key, headers, nullptr, 0, response);
+        if (lastStatus == 200) {
+            std::string tag = response.headers["etag"];
+            if (tag.size() >= 2 && tag.front() == '"' && tag.back() == '"') {
+                tag = tag.substr(1, tag.size() - 2);
+            }
+            if (response.body.size() >= bodyCap || tag.size() >= etagCap) {
+                return -1;
+            }
+            strcpy(body, response.body.c_str());
+            strcpy(etag, tag.c_str());
+        }
+        return lastStatus;
+    }
+};
+
+static bool put(int port, const std::string& body) {
+    HttpResponse response;
+    return httpRequest(port, "PUT", CONFIG_KEY, {}, body.data(), body.size(), response) == 200;
+}
+
+/// @brief One checkCameraConfigUpdate() pass: fetch, apply, commit when applied
+static S3FetchResult update(StandInTransport& transport, MemoryStore& store, std::string& body) {
+    char buf[S3_FETCH_BODY_MAX];
+    S3FetchCache cache(transport, store);
+    S3FetchResult result = cache.Fetch(CONFIG_KEY, CACHE_KEY, buf, sizeof(buf));
+    body = buf;
+    if (result == S3_FETCH_MODIFIED && body.compare(0, 4, "good") == 0) {
+        cache.Commit(buf);
+    }
+    return result;
+}
+
+int main() {
+    StandIn standin;
+    if (!standin.Start({"--no-verify"})) {
+        fprintf(stderr, "cannot start tools/s3_standin.py (run from the repository root)\n");
+        return 2;
+    }
+    MemoryStore store;
+    StandInTransport transport(standin.port);
+    std::string body;
+    const std::string first = "good {\"status\":{\"quality\":12}}";
+    const std::string bad = "bad {\"status\":";
+    const std::string second = "good {\"status\":{\"quality\":10}}";
+
+    put(standin.port, first);
+    S3FetchResult result = update(transport, store, body);
+    check(result == S3_FETCH_MODIFIED && body == first, "fresh", "first download is MODIFIED");
+    check(store.present && store.body == first, "fresh", "committed after it was applied");
+    result = update(transport, store, body);
+    check(result == S3_FETCH_NOT_MODIFIED && transport.lastStatus == 304, "fresh", "next check is a 304");
+    check(body == first, "fresh", "304 answered with the cached body");
+
+    put(standin.port, bad);
+    uint32_t saves = store.saves;
+    result = update(transport, store, body);
+    check(result == S3_FETCH_MODIFIED && body == bad, "rejected", "bad document downloaded");
+    check(store.saves == saves && store.body == first, "rejected", "not cached, last applied copy kept");
+    result = update(transport, store, body);
+    check(result == S3_FETCH_MODIFIED && transport.lastStatus == 200, "rejected", "fetched again, not a 304");
+    check(store.saves == saves, "rejected", "still not cached");
+
+    put(standin.port, second);
+    result = update(transport, store, body);
+    check(result == S3_FETCH_MODIFIED && body == second && store.body == second, "changed",
+          "new document applied and cached");
+    result = update(transport, store, body);
+    check(result == S3_FETCH_NOT_MODIFIED && transport.lastStatus == 304 && body == second, "changed",
+          "then a 304");
+
+    HttpResponse response;
+    httpRequest(standin.port, "DELETE", CONFIG_KEY, {}, nullptr, 0, response);
+    result = update(transport, store, body);
+    check(result == S3_FETCH_NOT_FOUND && body == second, "deleted", "NOT_FOUND with the cached copy");
+
+    put(standin.port, second);
+    standin.Stop();
+    result = update(transport, store, body);
+    check(result == S3_FETCH_ERROR && body == second, "offline", "ERROR with the cached copy");
+
+    printf(failures ? "%d checks failed\n" : "all checks passed\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,162 @@
+// Host benchmark for the JSON gzip encoder used by the firmware (src/common/gzip.cpp).
+//
+// Build:  g++ -std=c++17 -O2 -I include -o gzip_bench tools/gzip_bench.cpp src/common/gzip.cpp
+// Usage:  gzip_bench [-n iterations] [-o outdir] [file.json ...]
+//
+// Without files, a representative status document (same shape as
+// writeStatusJSON) is used. For every document it prints the pretty,
+// compact and gzipped sizes and the time per document for minify and gzip.
+// With -o, the .json.gz output is written so it can be checked with
+// `gzip -t` / `zcat`. Host timings are only relative: the ESP32 runs the same
+// code about 20-40x slower (the "compression" IoT command reports device numbers).
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "gzip.h"
+
+static const char* SAMPLE_STATUS = R"({
+  "device": "cat-shelter-01",
+  "timestamp": "2025-01-12T08:30:00Z",
+  "uptime_seconds": 183245,
+  "mode": "NORMAL",
+  "boot_attempts": 0,
+  "max_boot_attempts": 3,
+  "lux": 412.50,
+  "ae_level": -1,
+  "temperature_celsius": 6.4,
+  "humidity_percent": 81.2,
+  "dht22_sensor_working": true,
+  "effective_temperature_celsius": 6.4,
+  "expected_temperature_celsius": 7.1,
+  "using_fallback_temperature": false,
+  "cat_present": true,
+  "seconds_since_last_motion": 42,
+  "presence_timeout_seconds": 1758,
+  "blanket_on": true,
+  "blanket_on_seconds": 3600,
+  "wifi_connected": true,
+  "wifi_rssi": -67,
+  "wifi_ssid": "shelter",
+  "free_heap": 143212,
+  "min_free_heap": 98124,
+  "free_psram": 3821144,
+  "camera_available": true,
+  "image": {
+    "width": 1600,
+    "height": 1200,
+    "jpeg_bytes": 81234,
+    "brightness": 112.4,
+    "contrast": 38.2,
+    "sharpness": 14.7
+  },
+  "rate_control": {
+    "level": 3,
+    "framesize": "UXGA",
+    "quality": 12,
+    "throughput_bps": 412344,
+    "predicted_ms": 1821
+  },
+  "dns": {
+    "hits": 1214,
+    "misses": 12,
+    "avg_lookup_ms": 48
+  },
+  "wifi_manual_override": false,
+  "last_photo_timestamp": "2025-01-12T08:15:00Z",
+  "photos_uploaded": 1423,
+  "photos_failed": 7
+}
+)";
+
+static bool readFile(const char* path, std::string& out) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        return false;
+    }
+    out.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    return true;
+}
+
+template <typename F>
+static double timeUs(int iterations, F&& fn) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        fn();
+    }
+    std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / iterations;
+}
+
+static bool bench(const std::string& name, const std::string& pretty, int iterations, const char* outdir) {
+    std::vector<char> compact(pretty.begin(), pretty.end());
+    size_t compactLen = jsonMinify(compact.data(), compact.size());
+
+    std::vector<uint8_t> gz(gzipBound(pretty.size()));
+    size_t gzPretty = gzipCompress((const uint8_t*)pretty.data(), pretty.size(), gz.data(), gz.size());
+    size_t gzCompact = gzipCompress((const uint8_t*)compact.data(), compactLen, gz.data(), gz.size());
+    if (gzPretty == 0 || gzCompact == 0) {
+        fprintf(stderr, "%s: compression failed\n", name.c_str());
+        return false;
+    }
+
+    std::vector<char> scratch(pretty.size());
+    double minifyUs = timeUs(iterations, [&] {
+        memcpy(scratch.data(), pretty.data(), pretty.size());
+        jsonMinify(scratch.data(), scratch.size());
+    });
+    double gzipUs = timeUs(iterations, [&] {
+        gzipCompress((const uint8_t*)compact.data(), compactLen, gz.data(), gz.size());
+    });
+
+    printf("%-24s pretty %7zu  compact %7zu (%4.1f%%)  gzip %6zu (%4.1f%%)  gzip(pretty) %6zu  minify %7.1f us  gzip %7.1f us  %6.1f MB/s\n",
+           name.c_str(), pretty.size(),
+           compactLen, 100.0 * compactLen / pretty.size(),
+           gzCompact, 100.0 * gzCompact / pretty.size(),
+           gzPretty, minifyUs, gzipUs, compactLen / gzipUs);
+
+    if (outdir) {
+        std::string base = name.substr(name.find_last_of('/') + 1);
+        std::ofstream out(std::string(outdir) + "/" + base + ".gz", std::ios::binary);
+        out.write((const char*)gz.data(), gzCompact);
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    int iterations = 2000;
+    const char* outdir = nullptr;
+    std::vector<const char*> files;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            iterations = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            outdir = argv[++i];
+        } else {
+            files.push_back(argv[i]);
+        }
+    }
+    if (iterations < 1) {
+        iterations = 1;
+    }
+
+    bool ok = true;
+    if (files.empty()) {
+        ok = bench("status.json", SAMPLE_STATUS, iterations, outdir);
+    }
+    for (const char* path : files) {
+        std::string doc;
+        if (!readFile(path, doc)) {
+            fprintf(stderr, "%s: cannot read\n", path);
+            ok = false;
+            continue;
+        }
+        ok = bench(path, doc, iterations, outdir) && ok;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,418 @@
+// Heap soak test: a week of simulated device activity through the portable
+// modules the firmware runs on every cycle, with every allocation charged to a
+// site by the same accounting the firmware uses (heap_probe.cpp):
+//
+//   json.status   every 5 minutes: status JSON built by appending (like String),
+//                 minified, gzipped and CBOR-encoded into heap buffers
+//   telemetry     every 10 seconds: temperature/humidity into Gorilla streams,
+//                 a batch buffer per hour
+//   journal       every 10 minutes: metrics text appended to the flash journal
+//   log           a second thread formats the records of the log ring
+//   canary        leaks 24 bytes a day, to show the leak check works
+//
+// At each simulated midnight the live bytes of every site are compared with
+// the first day: the canary has to be reported, any other growth fails. Before
+// the soak, the wrappers are checked on their own:
+//
+//   idle      with no probe open and nothing charged the wrappers go straight
+//             to the allocator and no counter moves
+//   foreign   a block the wrappers never saw (heap_caps_malloc on the device)
+//             freed with free(), inside and outside a probe: no live bytes move
+//   handoff   a block charged in a probe and freed by another thread outside
+//             any probe is credited to its site
+//   realloc   a block grown outside probes stays with its site
+//
+// HTTP and MQTT need the device: there, the "heap-report" IoT command of the
+// profiling build shows the same counters. Exits 1 on any failure.
+//
+// Build:  g++ -std=c++17 -O2 -pthread -I include -static-libstdc++ -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc,--wrap=free -o heap_soak tools/heap_soak.cpp src/common/heap_probe.cpp src/common/gzip.cpp src/common/cbor.cpp src/common/gorilla.cpp src/common/log_ring.cpp src/common/journal_store.cpp
+// Usage:  heap_soak [days]
+
+#include <atomic>
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <malloc.h>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+#include "cbor.h"
+#include "gorilla.h"
+#include "gzip.h"
+#include "heap_probe.h"
+#include "journal_store.h"
+#include "log_ring.h"
+
+static int failures = 0;
+
+static void check(bool ok, const char* scenario, const char* what) {
+    printf("%s %-8s %s\n", ok ? "ok  " : "FAIL", scenario, what);
+    failures += !ok;
+}
+
+// ===== Allocator wrappers, as on the device but with glibc's usable size =====
+
+static void* self() {
+    static thread_local char id;
+    return &id;
+}
+
+extern "C" {
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t n, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+void __real_free(void* ptr);
+
+static void* allocated(void* ptr, size_t size) {
+    HeapSite* site = HeapProbe::Current(self());
+    if (!site) {
+        return ptr;
+    }
+    if (ptr) {
+        HeapProbe::Charge(*site, ptr, malloc_usable_size(ptr));
+    } else if (size) {
+        site->Failed(size);
+    }
+    return ptr;
+}
+
+void* __wrap_malloc(size_t size) {
+    if (!HeapProbe::Open()) {
+        return __real_malloc(size);
+    }
+    return allocated(__real_malloc(size), size);
+}
+
+void* __wrap_calloc(size_t n, size_t size) {
+    if (!HeapProbe::Open()) {
+        return __real_calloc(n, size);
+    }
+    return allocated(__real_calloc(n, size), n * size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+    if (!HeapProbe::Open()) {
+        return __real_realloc(ptr, size);
+    }
+    HeapSite* previous = ptr ? HeapProbe::Release(ptr) : nullptr;
+    void* p = __real_realloc(ptr, size);
+    HeapSite* site = HeapProbe::Current(self());
+    if (!site) {
+        site = previous;
+    }
+    if (!p && size) {
+        if (previous) {
+            HeapProbe::Charge(*previous, ptr, malloc_usable_size(ptr));
+        }
+        if (site) {
+            site->Failed(size);
+        }
+    } else if (p && site) {
+        HeapProbe::Charge(*site, p, malloc_usable_size(p));
+    }
+    return p;
+}
+
+void __wrap_free(void* ptr) {
+    if (!HeapProbe::Open()) {
+        __real_free(ptr);
+        return;
+    }
+    if (ptr) {
+        HeapProbe::Release(ptr);
+    }
+    __real_free(ptr);
+}
+}
+
+// ===== Wrappers on their own =====
+
+static HeapSite siteForeign("check.foreign");
+static HeapSite siteHandoff("check.handoff");
+static HeapSite siteRealloc("check.realloc");
+
+static uint32_t totalAllocs() {
+    uint32_t total = 0;
+    for (HeapSite* site = HeapSite::First(); site; site = site->Next()) {
+        total += site->Allocs() + site->Frees();
+    }
+    return total;
+}
+
+static void checkWrappers() {
+    check(!HeapProbe::Open(), "idle", "nothing open or charged before the first probe");
+    uint32_t before = totalAllocs();
+    void* volatile p = malloc(100);
+    p = realloc(p, 5000);
+    free(p);
+    check(totalAllocs() == before && HeapProbe::Charged() == 0, "idle", "no counter moves outside probes");
+
+    // Never charged: the stand-in for a heap_caps_malloc() block
+    void* foreign = __real_malloc(256);
+    void* foreign2 = __real_malloc(256);
+    {
+        HeapProbe probe(siteForeign, self());
+        free(foreign);
+    }
+    free(foreign2);
+    check(siteForeign.Live() == 0 && siteForeign.Frees() == 0 && heapSiteOther.Live() == 0, "foreign",
+          "freeing a block never charged moves no live bytes");
+
+    void* handed = nullptr;
+    {
+        HeapProbe probe(siteHandoff, self());
+        handed = malloc(300);
+    }
+    int32_t held = siteHandoff.Live();
+    check(held >= 300 && HeapProbe::Charged() == 1, "handoff", "charged in the probe");
+    std::thread([handed] { free(handed); }).join();
+    check(siteHandoff.Live() == 0 && HeapProbe::Charged() == 0, "handoff",
+          "credited when another thread frees it outside probes");
+
+    void* grown = nullptr;
+    {
+        HeapProbe probe(siteRealloc, self());
+        grown = malloc(64);
+    }
+    grown = realloc(grown, 4096);
+    check(siteRealloc.Live() >= 4096 && siteRealloc.Allocs() == 2, "realloc", "grown outside probes, still its site");
+    free(grown);
+    check(siteRealloc.Live() == 0 && !HeapProbe::Open(), "realloc", "and credited on free");
+}
+
+// ===== Simulated activity =====
+
+static HeapSite siteStatus("json.status");
+static HeapSite siteTelemetry("telemetry");
+static HeapSite siteJournal("journal");
+static HeapSite siteLog("log");
+static HeapSite siteCanary("canary");
+static HeapSite* const soakSites[] = {&siteStatus, &siteTelemetry, &siteJournal, &siteLog, &siteCanary};
+
+class RamFlash : public JournalFlash {
+    std::vector<uint8_t> _mem;
+
+public:
+    explicit RamFlash(uint32_t size) : _mem(size, 0xff) {}
+    bool Read(uint32_t offset, void* buf, size_t len) override {
+        memcpy(buf, _mem.data() + offset, len);
+        return true;
+    }
+    bool Write(uint32_t offset, const void* buf, size_t len) override {
+        const uint8_t* src = (const uint8_t*)buf;
+        for (size_t i = 0; i < len; i++) {
+            _mem[offset + i] &= src[i];
+        }
+        return true;
+    }
+    bool EraseSector(uint32_t offset) override {
+        memset(_mem.data() + offset, 0xff, JOURNAL_SECTOR_SIZE);
+        return true;
+    }
+    uint32_t Size() const override { return _mem.size(); }
+};
+
+static LogRing ring;
+static std::atomic<bool> consumerBusy{false};
+static std::atomic<bool> stopping{false};
+
+static void logf(uint32_t ms, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    for (;;) {
+        va_list copy;
+        va_copy(copy, args);
+        bool pushed = ring.Push(0, 2, ms, format, copy);
+        va_end(copy);
+        if (pushed) {
+            break;
+        }
+        std::this_thread::yield();
+    }
+    va_end(args);
+}
+
+static void logConsumer() {
+    char line[256];
+    LogRecord record;
+    while (!stopping.load()) {
+        consumerBusy.store(true);
+        if (ring.Pop(record)) {
+            HeapProbe probe(siteLog, self());
+            size_t len = LogRing::Format(record, line, sizeof(line));
+            std::string out = "[" + std::to_string(record.ms) + "] " + std::string(line, len);
+            if (out.empty()) {
+                abort();
+            }
+        }
+        consumerBusy.store(false);
+        std::this_thread::yield();
+    }
+}
+
+static void drainLog() {
+    while (ring.Pending() || consumerBusy.load()) {
+        std::this_thread::yield();
+    }
+}
+
+static float temperatureAt(uint32_t t) {
+    return -5.0f + 8.0f * sinf(t / 86400.0f * 6.2831853f) + (t % 7) * 0.05f;
+}
+
+static void statusCycle(uint32_t t) {
+    HeapProbe probe(siteStatus, self());
+    // Built field by field, as String concatenation does on the device
+    std::string json = "{\n  \"device\": \"soak\",\n";
+    char field[96];
+    snprintf(field, sizeof(field), "  \"uptime_seconds\": %u,\n", t);
+    json += field;
+    snprintf(field, sizeof(field), "  \"temperature_celsius\": %.2f,\n", temperatureAt(t));
+    json += field;
+    for (int i = 0; i < 40; i++) {
+        snprintf(field, sizeof(field), "  \"field_%d\": %u,\n", i, (t / 300 + i) % 1000);
+        json += field;
+    }
+    json += "  \"cat_present\": false\n}\n";
+
+    std::vector<char> compact(json.begin(), json.end());
+    size_t len = jsonMinify(compact.data(), compact.size());
+    uint8_t* gz = (uint8_t*)malloc(gzipBound(len));
+    size_t gzLen = gzipCompress((const uint8_t*)compact.data(), len, gz, gzipBound(len));
+    uint8_t* cbor = (uint8_t*)malloc(1024);
+    CborWriter writer(cbor, 1024);
+    writer.Map(2);
+    writer.Key("uptime_seconds");
+    writer.Uint(t);
+    writer.Key("temperature_celsius");
+    writer.Float(temperatureAt(t));
+    if (!gzLen || !writer.Length()) {
+        abort();
+    }
+    free(cbor);
+    free(gz);
+}
+
+static void canaryLeak() {
+    HeapProbe probe(siteCanary, self());
+    static void* volatile lost;
+    lost = malloc(24);
+    (void)lost;
+}
+
+struct Batch {
+    uint8_t* mem = nullptr;
+    GorillaWriter temperature;
+    GorillaWriter humidity;
+};
+
+static void telemetrySample(Batch& batch, uint32_t t) {
+    HeapProbe probe(siteTelemetry, self());
+    if (!batch.mem) {
+        batch.mem = (uint8_t*)malloc(2 * 2048);
+        batch.temperature.Begin(batch.mem, 2048);
+        batch.humidity.Begin(batch.mem + 2048, 2048);
+    }
+    batch.temperature.Append(t, temperatureAt(t));
+    batch.humidity.Append(t, 70.0f + (t / 600 % 10));
+}
+
+static void telemetrySeal(Batch& batch) {
+    HeapProbe probe(siteTelemetry, self());
+    // The sealed batch is copied out for upload, then both go
+    std::vector<uint8_t> upload(batch.temperature.Data(), batch.temperature.Data() + batch.temperature.Bytes());
+    upload.insert(upload.end(), batch.humidity.Data(), batch.humidity.Data() + batch.humidity.Bytes());
+    free(batch.mem);
+    batch.mem = nullptr;
+}
+
+static void journalSnapshot(JournalStore& store, uint32_t t) {
+    HeapProbe probe(siteJournal, self());
+    std::string text;
+    for (HeapSite* site = HeapSite::First(); site; site = site->Next()) {
+        text += std::string(site->Name()) + " " + std::to_string(site->Live()) + "\n";
+    }
+    store.Append(JOURNAL_METRICS, 2, t * 1000, t, text.data(), (uint16_t)text.size());
+}
+
+int main(int argc, char** argv) {
+    int days = argc > 1 ? atoi(argv[1]) : 7;
+    if (days < 2) {
+        fprintf(stderr, "usage: %s [days >= 2]\n", argv[0]);
+        return 2;
+    }
+
+    checkWrappers();
+
+    RamFlash flash(16 * JOURNAL_SECTOR_SIZE);
+    JournalStore store;
+    store.Open(&flash);
+    std::thread consumer(logConsumer);
+    Batch batch;
+
+    std::map<HeapSite*, int32_t> firstDay;
+    int leaks = 0;
+    int canaryReports = 0;
+    for (uint32_t t = 10; t <= (uint32_t)days * 86400; t += 10) {
+        telemetrySample(batch, t);
+        if (t % 300 == 0) {
+            statusCycle(t);
+            logf(t * 1000, "Status uploaded: %u bytes, %s", 1234 + t % 100, "ok");
+        }
+        if (t % 600 == 0) {
+            journalSnapshot(store, t);
+        }
+        if (t % 3600 == 0) {
+            telemetrySeal(batch);
+            logf(t * 1000, "Telemetry batch sealed at %u", t);
+        }
+        if (t % 86400 == 43200) {
+            canaryLeak();
+        }
+        if (t % 86400 != 0) {
+            continue;
+        }
+
+        drainLog();
+        int day = t / 86400;
+        printf("day %d:", day);
+        for (HeapSite* site : soakSites) {
+            printf("  %s %d B live, %u allocs", site->Name(), site->Live(), site->Allocs());
+            if (day == 1) {
+                firstDay[site] = site->Live();
+            } else if (site->Live() > firstDay[site]) {
+                printf(" LEAK +%d B/day", (site->Live() - firstDay[site]) / (day - 1));
+                if (site == &siteCanary) {
+                    ++canaryReports;
+                } else {
+                    ++leaks;
+                }
+            }
+        }
+        printf("\n");
+    }
+
+    stopping.store(true);
+    consumer.join();
+    printf("\n%-14s %10s %10s %12s %12s %10s %10s\n", "site", "entries", "allocs", "alloc_bytes", "peak_live",
+           "largest", "live");
+    for (HeapSite* site = HeapSite::First(); site; site = site->Next()) {
+        printf("%-14s %10u %10u %12u %12d %10u %10d\n", site->Name(), site->Entries(), site->Allocs(),
+               site->AllocBytes(), site->PeakLive(), site->Largest(), site->Live());
+    }
+    check(leaks == 0, "soak", "no site's live bytes grow from day to day");
+    check(canaryReports == days - 1, "soak", "the canary leak is reported every day");
+    check(siteStatus.Allocs() > 0 && siteTelemetry.Allocs() > 0 && siteJournal.Allocs() > 0 &&
+              siteLog.Allocs() > 0, "soak", "every site charged");
+    check(HeapProbe::Overflows() == 0, "soak", "no probe or block overflow");
+
+    if (failures) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
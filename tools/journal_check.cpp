@@ -0,0 +1,419 @@
+// Flash journal check (journal_store.cpp) on a RAM model of the partition:
+//
+//   wear      many boots of appends over 8 sectors: every sector erased
+//             within one of the others, Erases() matches the flash
+//   reopen    a reopened store continues the boot count and reads back the
+//             last lap of records in order, byte for byte
+//   torn      power cut in the middle of a record: the records before it
+//             survive, the torn one is gone, the next append starts a fresh
+//             sector and survives the next reopen
+//   erase     power cut during a sector erase (half erased, noise): no
+//             corrupt record is read back and appends carry on
+//   upload    the previous boots are packed as one upload, gzipped, run
+//             through gzip -dc and read back by the decoder: exactly the
+//             records of the boots after the uploaded one plus the reset
+//             reason of the current boot; a small buffer keeps the newest
+//   decode    a flipped byte, a cut upload or a wrong record count is refused
+//
+// tools/journal_sim.cpp cuts the power at random points on a NOR flash model.
+// Exits 1 on any failure.
+//
+// Build:  g++ -std=c++17 -O2 -I include -o journal_check tools/journal_check.cpp src/common/journal_store.cpp src/common/gzip.cpp
+// Usage:  journal_check
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+#include <vector>
+#include "gzip.h"
+#include "journal_store.h"
+
+#define SECTORS 8
+
+static int failures = 0;
+
+static void check(bool ok, const char* scenario, const char* what) {
+    printf("%s %-7s %s\n", ok ? "ok  " : "FAIL", scenario, what);
+    failures += !ok;
+}
+
+// Erase-before-write flash with a power cut after a number of programmed bytes
+class RamFlash : public JournalFlash {
+public:
+    std::vector<uint8_t> mem;
+    std::vector<uint32_t> erases;
+    long budget = -1;       // bytes that can still be programmed, -1 for no cut
+    bool cutErase = false;  // the next erase is cut half way
+    bool dead = false;
+
+    explicit RamFlash(uint32_t sectors) : mem(sectors * JOURNAL_SECTOR_SIZE, 0xff), erases(sectors) {}
+
+    void PowerOn() {
+        budget = -1;
+        cutErase = false;
+        dead = false;
+    }
+
+    bool Read(uint32_t offset, void* buf, size_t len) override {
+        if (offset + len > mem.size()) {
+            return false;
+        }
+        memcpy(buf, mem.data() + offset, len);
+        return true;
+    }
+
+    bool Write(uint32_t offset, const void* buf, size_t len) override {
+        if (dead || offset + len > mem.size()) {
+            return false;
+        }
+        const uint8_t* src = (const uint8_t*)buf;
+        for (size_t i = 0; i < len; i++) {
+            if (budget == 0) {
+                dead = true;
+                return false;
+            }
+            if (budget > 0) {
+                --budget;
+            }
+            mem[offset + i] &= src[i];
+        }
+        return true;
+    }
+
+    bool EraseSector(uint32_t offset) override {
+        if (dead) {
+            return false;
+        }
+        ++erases[offset / JOURNAL_SECTOR_SIZE];
+        if (cutErase) {
+            for (uint32_t i = 0; i < JOURNAL_SECTOR_SIZE; i++) {
+                mem[offset + i] = i % 3 ? 0xff : (uint8_t)(i * 37);
+            }
+            dead = true;
+            return false;
+        }
+        memset(mem.data() + offset, 0xff, JOURNAL_SECTOR_SIZE);
+        return true;
+    }
+
+    uint32_t Size() const override { return mem.size(); }
+};
+
+// Payloads carry their id and a pattern derived from it
+static uint16_t payloadLength(uint32_t id) {
+    return 4 + id * 13 % 200;
+}
+
+static void payloadFor(uint32_t id, uint8_t* out) {
+    memcpy(out, &id, 4);
+    for (uint16_t i = 4; i < payloadLength(id); i++) {
+        out[i] = (uint8_t)(id * 7 + i);
+    }
+}
+
+static bool append(JournalStore& store, uint32_t id, uint8_t type = JOURNAL_LOG) {
+    uint8_t payload[JOURNAL_RECORD_MAX];
+    payloadFor(id, payload);
+    return store.Append(type, 1, id * 10, 0, payload, payloadLength(id));
+}
+
+struct Record {
+    JournalRecordHeader header;
+    uint32_t id;
+    bool intact;
+    std::vector<uint8_t> raw;
+};
+
+static bool collect(const JournalRecordHeader& header, const uint8_t* payload, const uint8_t* raw, uint32_t rawSize,
+                    void* ctx) {
+    Record r = {header, 0, false, std::vector<uint8_t>(raw, raw + rawSize)};
+    if (header.length >= 4) {
+        memcpy(&r.id, payload, 4);
+        uint8_t expected[JOURNAL_RECORD_MAX];
+        payloadFor(r.id, expected);
+        r.intact = header.length == payloadLength(r.id) && memcmp(payload, expected, header.length) == 0;
+    }
+    static_cast<std::vector<Record>*>(ctx)->push_back(r);
+    return true;
+}
+
+static std::vector<Record> records(JournalStore& store) {
+    std::vector<Record> out;
+    store.ForEach(collect, &out);
+    return out;
+}
+
+static bool allIntact(const std::vector<Record>& rs) {
+    return std::all_of(rs.begin(), rs.end(), [](const Record& r) { return r.intact; });
+}
+
+static bool contiguous(const std::vector<Record>& rs) {
+    for (size_t i = 1; i < rs.size(); i++) {
+        if (rs[i].id != rs[i - 1].id + 1) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void checkWear() {
+    RamFlash flash(SECTORS);
+    uint32_t id = 1;
+    uint32_t erases = 0;
+    for (int boot = 0; boot < 50; boot++) {
+        JournalStore store;
+        store.Open(&flash);
+        for (int i = 0; i < 300; i++) {
+            append(store, id++);
+        }
+        erases += store.Erases();
+    }
+    uint32_t total = 0;
+    for (uint32_t e : flash.erases) {
+        total += e;
+    }
+    auto range = std::minmax_element(flash.erases.begin(), flash.erases.end());
+    printf("     %u erases, %u..%u per sector\n", total, *range.first, *range.second);
+    check(total > 10 * SECTORS, "wear", "the ring went round many times");
+    check(*range.second - *range.first <= 1, "wear", "every sector erased within one of the others");
+    check(erases == total, "wear", "Erases() counts every erase");
+}
+
+static void checkReopen() {
+    RamFlash flash(SECTORS);
+    uint32_t id = 1;
+    uint32_t boot = 0;
+    for (int i = 0; i < 5; i++) {
+        JournalStore store;
+        store.Open(&flash);
+        boot = store.Boot();
+        for (int n = 0; n < 150; n++) {
+            append(store, id++);
+        }
+    }
+    JournalStore store;
+    check(store.Open(&flash), "reopen", "opens");
+    check(store.Boot() == boot + 1, "reopen", "boot count continues");
+    std::vector<Record> rs = records(store);
+    check(!rs.empty() && rs.back().id == id - 1, "reopen", "ends at the last record appended");
+    check(contiguous(rs) && allIntact(rs), "reopen", "last lap in order, byte for byte");
+    check(rs.front().header.boot < rs.back().header.boot, "reopen", "records of several boots held");
+
+    JournalStore blank;
+    RamFlash tiny(1);
+    check(!blank.Open(&tiny), "reopen", "a single sector is refused");
+}
+
+static void checkTorn() {
+    RamFlash flash(SECTORS);
+    JournalStore store;
+    store.Open(&flash);
+    uint32_t id = 1;
+    for (int n = 0; n < 20; n++) {
+        append(store, id++);
+    }
+    flash.budget = 40;      // the next record is cut after its header
+    check(!append(store, id), "torn", "the cut append fails");
+
+    flash.PowerOn();
+    JournalStore reopened;
+    reopened.Open(&flash);
+    std::vector<Record> rs = records(reopened);
+    check(rs.size() == 20 && rs.back().id == id - 1, "torn", "records before the cut survive, the torn one is gone");
+    check(allIntact(rs), "torn", "no corrupt record");
+
+    uint32_t sector = reopened.ActiveSector();
+    check(append(reopened, id + 1), "torn", "append after the cut");
+    check(reopened.ActiveSector() != sector, "torn", "it starts a fresh sector");
+    JournalStore again;
+    again.Open(&flash);
+    rs = records(again);
+    check(!rs.empty() && rs.back().id == id + 1 && allIntact(rs), "torn", "and survives the next reopen");
+}
+
+static void checkErase() {
+    RamFlash flash(SECTORS);
+    uint32_t id = 1;
+    {
+        JournalStore store;
+        store.Open(&flash);
+        // Fill the ring so the next sector change erases old records
+        while (store.Erases() < SECTORS + 2) {
+            append(store, id++);
+        }
+        flash.cutErase = true;
+        while (append(store, id)) {
+            ++id;
+        }
+    }
+    flash.PowerOn();
+    JournalStore store;
+    store.Open(&flash);
+    std::vector<Record> rs = records(store);
+    check(!rs.empty() && allIntact(rs) && contiguous(rs), "erase", "no corrupt record after a cut erase");
+    check(rs.back().id == id - 1, "erase", "every acknowledged record before it survives");
+    for (int n = 0; n < 100; n++) {
+        append(store, id + n);
+    }
+    JournalStore again;
+    again.Open(&flash);
+    rs = records(again);
+    check(!rs.empty() && rs.back().id == id + 99 && allIntact(rs), "erase", "appends carry on");
+}
+
+// Compress with the firmware encoder, inflate with the system gzip
+static bool roundTrip(const uint8_t* data, size_t len, std::vector<uint8_t>& out) {
+    std::vector<uint8_t> gz(gzipBound(len));
+    size_t gzLen = gzipCompress(data, len, gz.data(), gz.size());
+    char path[] = "/tmp/journal_checkXXXXXX";
+    int fd = mkstemp(path);
+    if (gzLen == 0 || fd < 0 || write(fd, gz.data(), gzLen) != (ssize_t)gzLen) {
+        return false;
+    }
+    close(fd);
+    std::string command = std::string("gzip -dc < ") + path;
+    FILE* pipe = popen(command.c_str(), "r");
+    if (!pipe) {
+        unlink(path);
+        return false;
+    }
+    out.clear();
+    uint8_t buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), pipe)) > 0) {
+        out.insert(out.end(), buf, buf + n);
+    }
+    int status = pclose(pipe);
+    unlink(path);
+    return status == 0;
+}
+
+static bool selected(const Record& r, uint32_t uploadedBoot, uint32_t boot) {
+    return r.header.boot > uploadedBoot &&
+           (r.header.boot < boot || (r.header.boot == boot && r.header.type == JOURNAL_BOOT));
+}
+
+static void checkUpload(std::vector<uint8_t>& packed) {
+    RamFlash flash(SECTORS);
+    uint32_t id = 1;
+    for (int boot = 1; boot <= 4; boot++) {
+        JournalStore store;
+        store.Open(&flash);
+        append(store, id++, JOURNAL_BOOT);
+        for (int n = 0; n < 20; n++) {
+            append(store, id++);
+        }
+    }
+    JournalStore store;
+    store.Open(&flash);
+    append(store, id++, JOURNAL_BOOT);
+    append(store, id++);      // a line of this boot, not uploaded yet
+    check(store.Boot() == 5, "upload", "fifth boot");
+
+    std::vector<Record> expected;
+    for (const Record& r : records(store)) {
+        if (selected(r, 2, store.Boot())) {
+            expected.push_back(r);
+        }
+    }
+    JournalUpload upload;
+    upload.Measure(store, 2);
+    check(upload.Previous() == 42, "upload", "records of boots 3 and 4 counted");
+    size_t total = 0;
+    for (const Record& r : expected) {
+        total += r.raw.size();
+    }
+    check(upload.Total() == total, "upload", "stored size measured");
+
+    packed.assign(sizeof(JournalUploadHeader) + upload.Total(), 0);
+    size_t len = upload.Pack(store, packed.data(), packed.size());
+    check(len == packed.size(), "upload", "everything fits");
+    check(upload.Records() == 43 && upload.FromBoot() == 3 && upload.ToBoot() == 5, "upload",
+          "43 records, boots 3-5");
+
+    std::vector<uint8_t> inflated;
+    check(roundTrip(packed.data(), len, inflated), "upload", "gzip -dc inflates the upload");
+    check(inflated == packed, "upload", "inflated bytes equal the packed ones");
+
+    JournalUploadHeader header;
+    std::vector<Record> decoded;
+    bool ok = journalReadUpload(inflated.data(), inflated.size(), header, collect, &decoded);
+    check(ok, "upload", "decoder accepts it");
+    check(memcmp(header.magic, JOURNAL_UPLOAD_MAGIC, 4) == 0 && header.version == JOURNAL_VERSION &&
+              header.records == 43 && header.fromBoot == 3 && header.toBoot == 5,
+          "upload", "header");
+    bool same = decoded.size() == expected.size();
+    for (size_t i = 0; same && i < decoded.size(); i++) {
+        same = decoded[i].raw == expected[i].raw && decoded[i].intact;
+    }
+    check(same, "upload", "decoded records equal the stored ones, oldest first");
+    check(!decoded.empty() && decoded.back().header.type == JOURNAL_BOOT && decoded.back().header.boot == 5,
+          "upload", "ends with the reset reason of this boot");
+
+    // Only room for part of it: the oldest are left out
+    std::vector<uint8_t> small(sizeof(JournalUploadHeader) + total / 3);
+    JournalUpload partial;
+    partial.Measure(store, 2);
+    size_t smallLen = partial.Pack(store, small.data(), small.size());
+    decoded.clear();
+    ok = journalReadUpload(small.data(), smallLen, header, collect, &decoded);
+    check(ok && smallLen <= small.size() && partial.Records() > 0 && partial.Records() < 43, "upload",
+          "a small buffer holds part of it");
+    same = !decoded.empty() && decoded.size() <= expected.size();
+    for (size_t i = 0; same && i < decoded.size(); i++) {
+        same = decoded[i].raw == expected[expected.size() - decoded.size() + i].raw;
+    }
+    check(same && header.fromBoot == decoded.front().header.boot, "upload", "the newest records are kept");
+
+    JournalUpload none;
+    none.Measure(store, 4);
+    check(none.Previous() == 0, "upload", "nothing left once boot 4 is uploaded");
+}
+
+static void checkDecode(const std::vector<uint8_t>& packed) {
+    JournalUploadHeader header;
+    std::vector<uint8_t> data = packed;
+    check(journalReadUpload(data.data(), data.size(), header, nullptr, nullptr), "decode", "intact upload");
+
+    bool refused = true;
+    for (size_t pos = sizeof(JournalUploadHeader); pos < data.size(); pos += 97) {
+        data[pos] ^= 0x10;
+        refused &= !journalReadUpload(data.data(), data.size(), header, nullptr, nullptr);
+        data[pos] ^= 0x10;
+    }
+    check(refused, "decode", "a flipped byte anywhere in the records");
+
+    refused = true;
+    for (size_t len = 0; len < data.size(); len += 61) {
+        refused &= !journalReadUpload(data.data(), len, header, nullptr, nullptr);
+    }
+    check(refused, "decode", "a cut upload");
+
+    JournalUploadHeader wrong;
+    memcpy(&wrong, data.data(), sizeof(wrong));
+    ++wrong.records;
+    memcpy(data.data(), &wrong, sizeof(wrong));
+    check(!journalReadUpload(data.data(), data.size(), header, nullptr, nullptr), "decode", "a wrong record count");
+    data[0] = 'X';
+    check(!journalReadUpload(data.data(), data.size(), header, nullptr, nullptr), "decode", "a wrong magic");
+}
+
+int main() {
+    std::vector<uint8_t> packed;
+    checkWear();
+    checkReopen();
+    checkTorn();
+    checkErase();
+    checkUpload(packed);
+    checkDecode(packed);
+
+    if (failures) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,146 @@
+// Host-side decoder for the flash journal: uploaded objects (journal_*.cjl.gz,
+// gunzipped first) or a raw dump of the "journal" partition.
+//
+// Build:  g++ -std=c++17 -O2 -I include -o journal_decode tools/journal_decode.cpp src/common/journal_store.cpp src/common/gzip.cpp
+// Usage:  gunzip -c journal_20250101_120000_boot12.cjl.gz | journal_decode -
+//         esptool.py read_flash 0x3e0000 0x10000 journal.bin && journal_decode journal.bin
+
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "journal_store.h"
+
+static const char* RESET_REASONS[] = {
+    "UNKNOWN", "POWERON", "EXT", "SW", "PANIC", "INT_WDT", "TASK_WDT", "WDT", "DEEPSLEEP", "BROWNOUT", "SDIO"};
+static const char* LEVELS[] = {"ERROR", "WARN", "INFO", "DEBUG"};
+static const char* MODULES[] = {"main", "wifi", "iot", "upload", "camera", "sensors", "httpd"};
+
+class DumpFlash : public JournalFlash {
+    const std::vector<uint8_t>& _data;
+
+public:
+    explicit DumpFlash(const std::vector<uint8_t>& data) : _data(data) {}
+    bool Read(uint32_t offset, void* buf, size_t len) override {
+        if (offset + len > _data.size()) {
+            return false;
+        }
+        memcpy(buf, _data.data() + offset, len);
+        return true;
+    }
+    bool Write(uint32_t, const void*, size_t) override { return false; }
+    bool EraseSector(uint32_t) override { return false; }
+    uint32_t Size() const override { return _data.size(); }
+};
+
+static std::string stamp(const JournalRecordHeader& header) {
+    char buf[64];
+    uint32_t ms = header.uptimeMs;
+    int n = snprintf(buf, sizeof(buf), "boot %-4u +%02u:%02u:%02u.%03u", header.boot, ms / 3600000,
+                     ms / 60000 % 60, ms / 1000 % 60, ms % 1000);
+    if (header.time) {
+        time_t t = header.time;
+        struct tm tm;
+        gmtime_r(&t, &tm);
+        strftime(buf + n, sizeof(buf) - n, "  %Y-%m-%d %H:%M:%S", &tm);
+    } else {
+        snprintf(buf + n, sizeof(buf) - n, "  %19s", "-");
+    }
+    return buf;
+}
+
+static bool print(const JournalRecordHeader& header, const uint8_t* payload, const uint8_t*, uint32_t, void*) {
+    std::string prefix = stamp(header);
+    switch (header.type) {
+    case JOURNAL_BOOT: {
+        JournalBootPayload boot = {};
+        memcpy(&boot, payload, header.length < sizeof(boot) ? header.length : sizeof(boot));
+        const char* reason = boot.resetReason < sizeof(RESET_REASONS) / sizeof(RESET_REASONS[0])
+                                 ? RESET_REASONS[boot.resetReason] : "?";
+        printf("%s  BOOT    reset %s, boot attempts %u\n", prefix.c_str(), reason, boot.bootAttempts);
+        break;
+    }
+    case JOURNAL_LOG: {
+        uint8_t module = header.length ? payload[0] : 0;
+        printf("%s  %-7s %s: %.*s\n", prefix.c_str(), header.level < 4 ? LEVELS[header.level] : "?",
+               module < sizeof(MODULES) / sizeof(MODULES[0]) ? MODULES[module] : "?",
+               header.length ? header.length - 1 : 0, (const char*)payload + 1);
+        break;
+    }
+    case JOURNAL_SPANS: {
+        printf("%s  SPANS\n", prefix.c_str());
+        for (uint32_t pos = 0; pos + sizeof(JournalSpan) <= header.length; pos += sizeof(JournalSpan)) {
+            JournalSpan span;
+            memcpy(&span, payload + pos, sizeof(span));
+            span.name[sizeof(span.name) - 1] = 0;
+            printf("    core %u  %-24s start %10u us  %8u us\n", span.core, span.name, span.startUs, span.durUs);
+        }
+        break;
+    }
+    case JOURNAL_METRICS: {
+        printf("%s  METRICS\n", prefix.c_str());
+        std::string text((const char*)payload, header.length);
+        size_t start = 0, end;
+        while ((end = text.find('\n', start)) != std::string::npos) {
+            printf("    %s\n", text.substr(start, end - start).c_str());
+            start = end + 1;
+        }
+        break;
+    }
+    case JOURNAL_REBOOT:
+        printf("%s  REBOOT  %.*s\n", prefix.c_str(), header.length, (const char*)payload);
+        break;
+    default:
+        printf("%s  type %u, %u bytes\n", prefix.c_str(), header.type, header.length);
+        break;
+    }
+    return true;
+}
+
+static bool decodeUpload(const std::vector<uint8_t>& data) {
+    JournalUploadHeader upload;
+    memcpy(&upload, data.data(), sizeof(upload));
+    printf("upload: %u records, boots %u-%u\n", upload.records, upload.fromBoot, upload.toBoot);
+    if (!journalReadUpload(data.data(), data.size(), upload, print, nullptr)) {
+        fprintf(stderr, "truncated or corrupt upload\n");
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s <upload.cjl | partition.bin | ->\n", argv[0]);
+        return 2;
+    }
+    std::vector<uint8_t> data;
+    if (strcmp(argv[1], "-") == 0) {
+        data.assign(std::istreambuf_iterator<char>(std::cin), std::istreambuf_iterator<char>());
+    } else {
+        std::ifstream in(argv[1], std::ios::binary);
+        data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+
+    if (data.size() >= sizeof(JournalUploadHeader) && memcmp(data.data(), JOURNAL_UPLOAD_MAGIC, 4) == 0) {
+        return decodeUpload(data) ? 0 : 1;
+    }
+    if (data.size() >= 2 && data[0] == 0x1f && data[1] == 0x8b) {
+        fprintf(stderr, "gzip compressed, run it through gunzip -c first\n");
+        return 1;
+    }
+    if (data.size() < 2 * JOURNAL_SECTOR_SIZE || data.size() % JOURNAL_SECTOR_SIZE != 0) {
+        fprintf(stderr, "neither an upload nor a partition dump (%zu bytes)\n", data.size());
+        return 1;
+    }
+    DumpFlash flash(data);
+    JournalStore store;
+    store.Open(&flash);
+    printf("partition: %u sectors, newest sector %u (sequence %u), last boot %u\n", store.Sectors(),
+           store.ActiveSector(), store.Sequence(), store.Boot() - 1);
+    store.ForEach(print, nullptr);
+    return 0;
+}
@@ -0,0 +1,136 @@
+// Host benchmark for the deferred log ring: caller-side cost of a log call
+// (LogRing::Push) against formatting it in place (vsnprintf), and a check that
+// the drained message matches what vsnprintf prints.
+//
+// Build:  g++ -std=c++17 -O2 -pthread -I include -o log_bench tools/log_bench.cpp src/common/log_ring.cpp
+// Usage:  log_bench [iterations]
+//
+// Host numbers are a relative measure; the firmware reports its own drop
+// counts on the "log" MQTT topic.
+
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include "log_ring.h"
+
+static LogRing ring;
+
+static bool pushTo(LogRing& target, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    bool ok = target.Push(0, 2, 0, format, args);
+    va_end(args);
+    return ok;
+}
+
+#define push(...) pushTo(ring, __VA_ARGS__)
+
+static int format(char* buf, size_t cap, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(buf, cap, format, args);
+    va_end(args);
+    return n;
+}
+
+// Typical firmware log lines
+#define CASES(X)                                                                          \
+    X("HTTPD started http://%s:%i", "192.168.1.42", 80)                                   \
+    X("Upload OK: %s (%u bytes, %lu ms)", "photos/2025/01/01/120000_motion.jpg", 48213u,  \
+      412ul)                                                                              \
+    X("Temperature: %.1fC humidity %.0f%%", 7.25, 81.0)                                   \
+    X("MQTT connect failed (error: %d)", -3)                                              \
+    X("%-32s %3d", "wifi", 7)
+
+static bool check() {
+    bool ok = true;
+    char expected[256], actual[256];
+    LogRecord record;
+#define CHECK(...)                                                                        \
+    format(expected, sizeof(expected), __VA_ARGS__);                                      \
+    push(__VA_ARGS__);                                                                    \
+    ring.Pop(record);                                                                     \
+    LogRing::Format(record, actual, sizeof(actual));                                      \
+    if (strcmp(expected, actual) != 0) {                                                  \
+        printf("mismatch:\n  %s\n  %s\n", expected, actual);                              \
+        ok = false;                                                                       \
+    }
+    CASES(CHECK)
+#undef CHECK
+    return ok;
+}
+
+template <typename F>
+static double nsPerCall(int iterations, F call) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        call();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+}
+
+int main(int argc, char** argv) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 1000000;
+    if (!check()) {
+        return 1;
+    }
+
+    // The ring holds LOG_RING_SLOTS records; drain between batches so pushes never drop
+    LogRecord record;
+    char buf[256];
+    int batches = iterations / LOG_RING_SLOTS;
+    double pushNs = 0, formatNs = 0, drainNs = 0;
+#define BENCH(...)                                                                        \
+    for (int b = 0; b < batches; b++) {                                                   \
+        pushNs += nsPerCall(LOG_RING_SLOTS, [&] { push(__VA_ARGS__); });                  \
+        drainNs += nsPerCall(LOG_RING_SLOTS, [&] {                                        \
+            ring.Pop(record);                                                             \
+            LogRing::Format(record, buf, sizeof(buf));                                    \
+        });                                                                               \
+        formatNs += nsPerCall(LOG_RING_SLOTS, [&] { format(buf, sizeof(buf), __VA_ARGS__); }); \
+    }
+    CASES(BENCH)
+#undef BENCH
+    int cases = 5;
+    printf("caller, deferred (Push):      %6.1f ns/call\n", pushNs / batches / cases);
+    printf("caller, in place (vsnprintf): %6.1f ns/call\n", formatNs / batches / cases);
+    printf("drain (Pop + Format):         %6.1f ns/call\n", drainNs / batches / cases);
+
+    // Four producers against one consumer, retrying when full: every push is drained once
+    LogRing* shared = new LogRing();
+    const int perThread = iterations / 4;
+    std::atomic<bool> done{false};
+    uint32_t drained = 0;
+    std::thread consumer([&] {
+        LogRecord r;
+        while (!done.load() || shared->Pending()) {
+            if (shared->Pop(r)) {
+                ++drained;
+            }
+        }
+    });
+    std::thread producers[4];
+    for (auto& t : producers) {
+        t = std::thread([&] {
+            for (int i = 0; i < perThread; i++) {
+                while (!pushTo(*shared, "tick %d", i)) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for (auto& t : producers) {
+        t.join();
+    }
+    done = true;
+    consumer.join();
+    printf("4 producers: %u pushed, %u drained, %u pushes found the ring full\n", shared->Pushed(), drained,
+           shared->Dropped());
+    bool balanced = shared->Pushed() == drained && drained == (uint32_t)perThread * 4;
+    delete shared;
+    return balanced ? 0 : 1;
+}
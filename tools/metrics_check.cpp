@@ -0,0 +1,185 @@
+// Metrics registry check (metric_registry.cpp) with metrics of its own:
+//
+//   buckets     latencies on and around every bucket bound land in the
+//               Prometheus "le" bucket; sum rounded to ms, max in us
+//   threads     8 threads record into one histogram, counter and gauge
+//               without a lock: no lost updates, max is the largest seen
+//   prometheus  exposition text byte for byte for a counter, a gauge and a
+//               histogram: HELP/TYPE lines, cumulative buckets ending in
+//               +Inf == _count, _sum in seconds; every line ends in \n
+//
+// Exits 1 on any failure.
+//
+// Build:  g++ -std=c++17 -O2 -pthread -I include -o metrics_check tools/metrics_check.cpp src/common/metric_registry.cpp
+// Usage:  metrics_check
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include "metric_registry.h"
+
+#define THREADS 8
+#define PER_THREAD 100000
+
+static int failures = 0;
+
+static void check(bool ok, const char* scenario, const char* what) {
+    printf("%s %-10s %s\n", ok ? "ok  " : "FAIL", scenario, what);
+    failures += !ok;
+}
+
+// Metrics are static objects that stay linked into the registry. The list is
+// built at the head, so these are exported in reverse: the three compared by
+// the prometheus scenario come last.
+static MetricHistogram latency("check_latency_seconds", "Histogram under check");
+static MetricGauge level("check_level", "Gauge under check");
+static MetricCounter events("check_events_total", "Counter under check");
+static MetricHistogram placement("check_buckets_seconds", "Bucket placement");
+static MetricHistogram sums("check_sum_seconds", "Sum and max");
+static MetricHistogram concurrent("check_threads_seconds", "Concurrent observations");
+static MetricCounter concurrentEvents("check_threads_total", "Concurrent increments");
+static MetricGauge concurrentLevel("check_threads_gauge", "Concurrent sets");
+
+// Only bucket i changed by one observation
+static int bucketOf(MetricHistogram& h, uint32_t us) {
+    uint32_t before[METRICS_BUCKET_COUNT + 1];
+    for (int i = 0; i <= METRICS_BUCKET_COUNT; i++) {
+        before[i] = h.Bucket(i);
+    }
+    h.Observe(us);
+    int changed = -1;
+    for (int i = 0; i <= METRICS_BUCKET_COUNT; i++) {
+        if (h.Bucket(i) != before[i]) {
+            changed = changed == -1 ? i : -2;
+        }
+    }
+    return changed;
+}
+
+static void checkBuckets() {
+    MetricHistogram& h = placement;
+    bool placed = true;
+    for (int i = 0; i < METRICS_BUCKET_COUNT; i++) {
+        uint32_t bound = MetricHistogram::BOUNDS_MS[i] * 1000;
+        placed &= bucketOf(h, bound) == i;              // le is inclusive
+        placed &= bucketOf(h, bound + 1) == i + 1;      // just over goes up
+        if (i > 0) {
+            placed &= bucketOf(h, MetricHistogram::BOUNDS_MS[i - 1] * 1000 + 1) == i;
+        }
+    }
+    check(placed, "buckets", "bound lands in its le bucket, bound + 1 us in the next");
+    check(bucketOf(h, 0) == 0, "buckets", "0 us in the first bucket");
+    check(bucketOf(h, UINT32_MAX) == METRICS_BUCKET_COUNT, "buckets", "over 30 s in +Inf");
+
+    MetricHistogram& s = sums;
+    s.Observe(1499);
+    s.Observe(1500);
+    s.Observe(250000);
+    check(s.Count() == 3, "buckets", "count");
+    check(s.SumMs() == 1 + 2 + 250, "buckets", "sum rounded to ms per observation");
+    check(s.MaxUs() == 250000, "buckets", "max in us");
+}
+
+static void checkThreads() {
+    MetricHistogram& h = concurrent;
+    MetricCounter& c = concurrentEvents;
+    MetricGauge& g = concurrentLevel;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < THREADS; t++) {
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < PER_THREAD; i++) {
+                // 1..1,000,000 us spread over the buckets, thread 7 holds the max
+                uint32_t us = 1 + (uint32_t)((i * 7919u + t * 104729u) % 999999u);
+                h.Observe(t == THREADS - 1 && i == PER_THREAD / 2 ? 5000000 : us);
+                c.Inc();
+                g.Set(t);
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    uint32_t total = 0;
+    for (int i = 0; i <= METRICS_BUCKET_COUNT; i++) {
+        total += h.Bucket(i);
+    }
+    check(h.Count() == THREADS * PER_THREAD, "threads", "no lost observations");
+    check(total == h.Count(), "threads", "buckets add up to the count");
+    check(c.Value() == THREADS * PER_THREAD, "threads", "no lost increments");
+    check(h.MaxUs() == 5000000, "threads", "max is the largest observation");
+    check(g.Value() >= 0 && g.Value() < THREADS, "threads", "gauge holds one of the values set");
+}
+
+static void emit(const char* line, size_t len, void* ctx) {
+    static_cast<std::vector<std::string>*>(ctx)->push_back(std::string(line, len));
+}
+
+static void checkPrometheus() {
+    events.Inc(41);
+    events.Inc();
+    level.Set(-17);
+    latency.Observe(800);           // le 0.001
+    latency.Observe(7000);          // le 0.010
+    latency.Observe(7000);
+    latency.Observe(45000000);      // +Inf
+
+    std::vector<std::string> lines;
+    Metrics::WritePrometheus(emit, &lines);
+    std::string text;
+    bool terminated = true;
+    for (const std::string& line : lines) {
+        text += line;
+        terminated &= !line.empty() && line.back() == '\n';
+    }
+
+    // The other scenarios' metrics come first; compare from the counter on
+    size_t start = text.find("# HELP cat_shelter_check_events_total");
+    const char* expected =
+        "# HELP cat_shelter_check_events_total Counter under check\n"
+        "# TYPE cat_shelter_check_events_total counter\n"
+        "cat_shelter_check_events_total 42\n"
+        "# HELP cat_shelter_check_level Gauge under check\n"
+        "# TYPE cat_shelter_check_level gauge\n"
+        "cat_shelter_check_level -17\n"
+        "# HELP cat_shelter_check_latency_seconds Histogram under check\n"
+        "# TYPE cat_shelter_check_latency_seconds histogram\n"
+        "cat_shelter_check_latency_seconds_bucket{le=\"0.001\"} 1\n"
+        "cat_shelter_check_latency_seconds_bucket{le=\"0.005\"} 1\n"
+        "cat_shelter_check_latency_seconds_bucket{le=\"0.010\"} 3\n"
+        "cat_shelter_check_latency_seconds_bucket{le=\"0.025\"} 3\n"
+        "cat_shelter_check_latency_seconds_bucket{le=\"0.050\"} 3\n"
+        "cat_shelter_check_latency_seconds_bucket{le=\"0.100\"} 3\n"
+        "cat_shelter_check_latency_seconds_bucket{le=\"0.250\"} 3\n"
+        "cat_shelter_check_latency_seconds_bucket{le=\"0.500\"} 3\n"
+        "cat_shelter_check_latency_seconds_bucket{le=\"1.000\"} 3\n"
+        "cat_shelter_check_latency_seconds_bucket{le=\"2.500\"} 3\n"
+        "cat_shelter_check_latency_seconds_bucket{le=\"5.000\"} 3\n"
+        "cat_shelter_check_latency_seconds_bucket{le=\"10.000\"} 3\n"
+        "cat_shelter_check_latency_seconds_bucket{le=\"30.000\"} 3\n"
+        "cat_shelter_check_latency_seconds_bucket{le=\"+Inf\"} 4\n"
+        "cat_shelter_check_latency_seconds_sum 45.015\n"
+        "cat_shelter_check_latency_seconds_count 4\n";
+    bool same = start != std::string::npos && text.compare(start, std::string::npos, expected) == 0;
+    if (!same) {
+        printf("     exposition:\n%s", start == std::string::npos ? text.c_str() : text.c_str() + start);
+    }
+    check(same, "prometheus", "counter, gauge and histogram byte for byte");
+    check(terminated, "prometheus", "every line ends in \\n");
+    check(text.find("# TYPE cat_shelter_check_threads_seconds histogram\n") != std::string::npos, "prometheus",
+          "every registered metric exported");
+}
+
+int main() {
+    checkBuckets();
+    checkThreads();
+    checkPrometheus();
+
+    if (failures) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,200 @@
+// Multipart upload check (multipart_upload.cpp) against the S3 stand-in
+// (tools/s3_standin.py), which it starts itself:
+//
+//   drops    --lose-rate stores parts but drops the connection before the
+//            ETag comes back; the upload retries and resumes until it
+//            completes, and no acknowledged part is sent twice
+//   reboot   the power goes after a few parts; a new instance with the same
+//            stored state resumes at the next part
+//   stale    a pending upload of another object is aborted first
+//   expired  the stand-in restarts and forgets the upload; the next call
+//            starts over
+//
+// Each stored object must match the uploaded bytes. Exits 1 on any failure.
+//
+// Build:  g++ -std=c++17 -O2 -I include -o multipart_check tools/multipart_check.cpp src/common/multipart_upload.cpp
+// Usage:  multipart_check [lose-rate] [seed]      (from the repository root)
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include "multipart_upload.h"
+#include "standin_client.h"
+
+#define PART_SIZE (64 * 1024)       // the stand-in has no 5 MB minimum
+
+static int failures = 0;
+
+static void check(bool ok, const char* scenario, const char* what) {
+    printf("%s %-8s %s\n", ok ? "ok  " : "FAIL", scenario, what);
+    failures += !ok;
+}
+
+/// @brief NVM stand-in: outlives the MultipartUpload instances, like flash outlives a reboot
+class MemoryStore : public MultipartStore {
+public:
+    bool present = false;
+    MultipartState state = {};
+    uint32_t saves = 0;
+
+    bool Load(MultipartState& s) override {
+        if (present) {
+            s = state;
+        }
+        return present;
+    }
+    void Save(const MultipartState& s) override {
+        state = s;
+        present = true;
+        ++saves;
+    }
+    void Clear() override { present = false; }
+};
+
+class StandInTransport : public MultipartTransport {
+public:
+    int port;
+    int powerLeft = -1;             // requests until the power goes, -1: never
+    uint32_t requests = 0;
+    uint32_t lost = 0;
+
+    explicit StandInTransport(int p) : port(p) {}
+
+    int Request(const char* method, const char* key, const char* query, const uint8_t* payload, size_t len,
+                char* body, size_t bodyCap, char* etag, size_t etagCap) override {
+        if (body && bodyCap) {
+            body[0] = '\0';
+        }
+        if (powerLeft == 0) {
+            return -1;
+        }
+        if (powerLeft > 0) {
+            --powerLeft;
+        }
+        ++requests;
+        HttpResponse response;
+        int status = httpRequest(port, method, std::string(key) + "?" + query, {}, payload, len, response);
+        if (status < 0) {
+            ++lost;
+            return status;
+        }
+        if (body && bodyCap) {
+            snprintf(body, bodyCap, "%s", response.body.c_str());
+        }
+        if (etag && etagCap) {
+            snprintf(etag, etagCap, "%s", response.headers["etag"].c_str());
+        }
+        return status;
+    }
+
+    bool Reconnect() override { return powerLeft != 0; }
+};
+
+static std::vector<uint8_t> payload(size_t len, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::vector<uint8_t> data(len);
+    for (uint8_t& b : data) {
+        b = (uint8_t)rng();
+    }
+    return data;
+}
+
+static bool stored(const StandIn& standin, const char* key, const std::vector<uint8_t>& data) {
+    return standin.Object(key) == std::string(data.begin(), data.end());
+}
+
+int main(int argc, char** argv) {
+    double loseRate = argc > 1 ? atof(argv[1]) : 0.25;
+    int seed = argc > 2 ? atoi(argv[2]) : 1;
+    const size_t parts = S3_MULTIPART_MAX_PARTS - 1;
+    std::vector<uint8_t> data = payload(parts * PART_SIZE - 1234, seed);
+
+    // Dropped connections: keep calling Upload() (a later loop pass) until done
+    {
+        StandIn standin;
+        char rate[16];
+        snprintf(rate, sizeof(rate), "%g", loseRate);
+        if (!standin.Start({"--no-verify", "--lose-rate", rate, "--seed", std::to_string(seed)})) {
+            fprintf(stderr, "cannot start tools/s3_standin.py (run from the repository root)\n");
+            return 2;
+        }
+        MemoryStore store;
+        StandInTransport transport(standin.port);
+        uint32_t sent = 0, retries = 0, calls = 0;
+        MultipartResult result = MULTIPART_FAILED;
+        while (result == MULTIPART_FAILED && calls < 50) {
+            MultipartUpload upload(transport, store, PART_SIZE);
+            result = upload.Upload(data.data(), data.size(), "/check/drops.ctl");
+            sent += upload.PartsSent();
+            retries += upload.PartRetries();
+            ++calls;
+        }
+        printf("drops: %u calls, %u requests, %u lost, %u part retries\n", calls, transport.requests,
+               transport.lost, retries);
+        check(result == MULTIPART_DONE, "drops", "upload completes");
+        check(transport.lost > 0 || loseRate == 0, "drops", "connections were dropped");
+        check(sent == parts, "drops", "each part acknowledged once");
+        check(stored(standin, "/check/drops.ctl", data), "drops", "object matches");
+        check(!store.present, "drops", "resume state cleared");
+    }
+
+    // Power loss after the initiate and 5 parts, then a fresh instance
+    {
+        StandIn standin;
+        if (!standin.Start({"--no-verify"})) {
+            return 2;
+        }
+        MemoryStore store;
+        StandInTransport before(standin.port);
+        before.powerLeft = 6;
+        MultipartUpload first(before, store, PART_SIZE);
+        MultipartResult cut = first.Upload(data.data(), data.size(), "/check/reboot.ctl");
+        check(cut == MULTIPART_FAILED && store.present && store.state.partCount == 5, "reboot",
+              "5 parts stored before the power went");
+
+        StandInTransport after(standin.port);
+        MultipartUpload second(after, store, PART_SIZE);
+        MultipartResult result = second.Upload(data.data(), data.size(), "/check/reboot.ctl");
+        check(result == MULTIPART_DONE && second.Resumed() == 1, "reboot", "resumed after the reboot");
+        check(second.PartsSent() == parts - 5, "reboot", "only the missing parts sent");
+        check(stored(standin, "/check/reboot.ctl", data), "reboot", "object matches");
+
+        // Stale: an interrupted upload of one object, then another object
+        StandInTransport cutAgain(standin.port);
+        cutAgain.powerLeft = 3;
+        MultipartUpload third(cutAgain, store, PART_SIZE);
+        third.Upload(data.data(), data.size(), "/check/stale-a.ctl");
+        std::vector<uint8_t> other = payload(3 * PART_SIZE, seed + 1);
+        StandInTransport next(standin.port);
+        MultipartUpload fourth(next, store, PART_SIZE);
+        result = fourth.Upload(other.data(), other.size(), "/check/stale-b.ctl");
+        check(result == MULTIPART_DONE && fourth.Aborted() == 1 && fourth.Resumed() == 0, "stale",
+              "other object's upload aborted, new one completed");
+        check(stored(standin, "/check/stale-b.ctl", other) && standin.Object("/check/stale-a.ctl").empty(),
+              "stale", "only the new object stored");
+
+        // Expired: the stand-in forgets its uploads
+        StandInTransport cutOnce(standin.port);
+        cutOnce.powerLeft = 4;
+        MultipartUpload fifth(cutOnce, store, PART_SIZE);
+        fifth.Upload(data.data(), data.size(), "/check/expired.ctl");
+        standin.Stop();
+        if (!standin.Start({"--no-verify"})) {
+            return 2;
+        }
+        StandInTransport restarted(standin.port);
+        MultipartUpload sixth(restarted, store, PART_SIZE);
+        MultipartResult gone = sixth.Upload(data.data(), data.size(), "/check/expired.ctl");
+        check(gone == MULTIPART_FAILED && !store.present, "expired", "unknown upload id clears the state");
+        MultipartUpload seventh(restarted, store, PART_SIZE);
+        result = seventh.Upload(data.data(), data.size(), "/check/expired.ctl");
+        check(result == MULTIPART_DONE && seventh.PartsSent() == parts, "expired", "started over and completed");
+        check(stored(standin, "/check/expired.ctl", data), "expired", "object matches");
+    }
+
+    printf(failures ? "%d checks failed\n" : "all checks passed\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,233 @@
+// Upload pipeline model: the two stages of upload_pipeline.cpp as host
+// threads, with the same bounded queues (UPLOAD_PIPELINE_DEPTH), the same
+// drop-when-full capture and the same counters and frames/minute formulas
+// (upload_pipeline_model.h):
+//
+//   serial     one thread hashes/signs then sends each frame, as the loop task
+//              did before the pipeline
+//   pipelined  capture -> prep thread -> net thread; prep blocks while the
+//              net queue is full
+//
+// Stage times are drawn uniformly within +-jitter around prep-us and net-us;
+// take them from the prep/net avg_us of the get-pipeline-stats IoT command.
+// The clock runs `scale` times faster than real time. Checks that each
+// measured rate is within 10% of its model (the capture rate caps the
+// pipelined one) and, unless capture is the bottleneck, that the pipeline
+// beats serial uploads; exits 1 otherwise.
+//
+// Build:  g++ -std=c++17 -O2 -pthread -I include -o pipeline_model tools/pipeline_model.cpp
+// Usage:  pipeline_model [prep-us] [net-us] [frames] [capture-interval-ms] [jitter] [scale]
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <thread>
+#include "upload_pipeline_model.h"
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    uint32_t prepUs = 120000;
+    uint32_t netUs = 350000;
+    int frames = 200;
+    uint32_t captureMs = 50;        // faster than either stage: the pipeline stays full
+    double jitter = 0.2;
+    double scale = 20;
+};
+
+/// @brief Bounded queue of frame numbers, like a FreeRTOS queue of UploadJob*
+class FrameQueue {
+    std::mutex _lock;
+    std::condition_variable _changed;
+    std::deque<int> _items;
+    size_t _depth;
+
+public:
+    explicit FrameQueue(size_t depth) : _depth(depth) {}
+
+    bool TrySend(int frame) {
+        std::lock_guard<std::mutex> lock(_lock);
+        if (_items.size() >= _depth) {
+            return false;
+        }
+        _items.push_back(frame);
+        _changed.notify_all();
+        return true;
+    }
+
+    void Send(int frame) {
+        std::unique_lock<std::mutex> lock(_lock);
+        _changed.wait(lock, [&] { return _items.size() < _depth; });
+        _items.push_back(frame);
+        _changed.notify_all();
+    }
+
+    int Receive() {
+        std::unique_lock<std::mutex> lock(_lock);
+        _changed.wait(lock, [&] { return !_items.empty(); });
+        int frame = _items.front();
+        _items.pop_front();
+        _changed.notify_all();
+        return frame;
+    }
+};
+
+/// @brief Scaled clock and jittered stage times
+class Model {
+    const Options& _options;
+    Clock::time_point _start = Clock::now();
+    std::mutex _lock;
+    std::mt19937 _rng{1};
+
+public:
+    explicit Model(const Options& options) : _options(options) {}
+
+    /// @brief Model time since the start
+    uint64_t NowUs() const {
+        auto real = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - _start).count();
+        return (uint64_t)(real * _options.scale);
+    }
+
+    uint32_t Draw(uint32_t us) {
+        std::lock_guard<std::mutex> lock(_lock);
+        std::uniform_real_distribution<double> spread(1 - _options.jitter, 1 + _options.jitter);
+        return (uint32_t)(us * spread(_rng));
+    }
+
+    /// @brief Spend a stage's time and record what it actually took
+    void Work(uint32_t us, UploadStageStats& stats, std::mutex& statsLock) {
+        uint64_t start = NowUs();
+        std::this_thread::sleep_for(std::chrono::microseconds((int64_t)(us / _options.scale)));
+        uint32_t took = (uint32_t)(NowUs() - start);
+        std::lock_guard<std::mutex> lock(statsLock);
+        stats.Record(took);
+    }
+};
+
+struct RunResult {
+    UploadStageStats prep;
+    UploadStageStats net;
+    uint32_t dropped = 0;
+    double measuredFpm = 0;
+};
+
+static RunResult runSerial(const Options& options) {
+    Model model(options);
+    RunResult result;
+    std::mutex statsLock;
+    uint64_t start = model.NowUs();
+    for (int i = 0; i < options.frames; i++) {
+        model.Work(model.Draw(options.prepUs), result.prep, statsLock);
+        model.Work(model.Draw(options.netUs), result.net, statsLock);
+    }
+    result.measuredFpm = 60000000.0 * options.frames / (model.NowUs() - start);
+    return result;
+}
+
+static RunResult runPipelined(const Options& options) {
+    Model model(options);
+    RunResult result;
+    std::mutex statsLock;
+    FrameQueue frames(UPLOAD_PIPELINE_DEPTH);
+    FrameQueue prepared(UPLOAD_PIPELINE_DEPTH);
+    const int done = -1;
+
+    std::thread prep([&] {
+        for (int frame; (frame = frames.Receive()) != done;) {
+            model.Work(model.Draw(options.prepUs), result.prep, statsLock);
+            prepared.Send(frame);
+        }
+        prepared.Send(done);
+    });
+
+    uint64_t firstEnqueueUs = 0, lastDoneUs = 0;
+    int sent = 0;
+    std::thread net([&] {
+        for (int frame; (frame = prepared.Receive()) != done;) {
+            model.Work(model.Draw(options.netUs), result.net, statsLock);
+            lastDoneUs = model.NowUs();
+            ++sent;
+        }
+    });
+
+    // Capture: offer a frame every interval until enough got in, drop when full
+    int accepted = 0;
+    while (accepted < options.frames) {
+        if (frames.TrySend(accepted)) {
+            if (accepted++ == 0) {
+                firstEnqueueUs = model.NowUs();
+            }
+        } else {
+            ++result.dropped;
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds((int64_t)(options.captureMs * 1000 / options.scale)));
+    }
+    frames.Send(done);
+    prep.join();
+    net.join();
+
+    result.measuredFpm = 60000000.0 * sent / (lastDoneUs - firstEnqueueUs);
+    return result;
+}
+
+static int failures = 0;
+
+static void check(bool ok, const char* what, double measured, double model) {
+    printf("%s %-40s measured %7.1f  model %7.1f\n", ok ? "ok  " : "FAIL", what, measured, model);
+    failures += !ok;
+}
+
+static bool near(double measured, double model) {
+    return measured > model * 0.9 && measured < model * 1.1;
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (argc > 1) options.prepUs = (uint32_t)atol(argv[1]);
+    if (argc > 2) options.netUs = (uint32_t)atol(argv[2]);
+    if (argc > 3) options.frames = atoi(argv[3]);
+    if (argc > 4) options.captureMs = (uint32_t)atol(argv[4]);
+    if (argc > 5) options.jitter = atof(argv[5]);
+    if (argc > 6) options.scale = atof(argv[6]);
+    if (options.frames < 10 || options.scale <= 0 || options.jitter < 0 || options.jitter >= 1 ||
+        options.prepUs + options.netUs == 0) {
+        fprintf(stderr, "usage: pipeline_model [prep-us] [net-us] [frames] [capture-interval-ms] [jitter] [scale]\n");
+        return 2;
+    }
+
+    printf("prep %u us, net %u us, %d frames, capture every %u ms, jitter %.0f%%, %gx real time\n\n",
+           options.prepUs, options.netUs, options.frames, options.captureMs, options.jitter * 100, options.scale);
+
+    RunResult serial = runSerial(options);
+    RunResult pipelined = runPipelined(options);
+
+    printf("%-10s %10s %10s %10s %8s\n", "", "prep avg", "net avg", "frames/min", "dropped");
+    printf("%-10s %8u us %8u us %10.1f %8s\n", "serial", serial.prep.AverageUs(), serial.net.AverageUs(),
+           serial.measuredFpm, "-");
+    printf("%-10s %8u us %8u us %10.1f %8u\n\n", "pipelined", pipelined.prep.AverageUs(),
+           pipelined.net.AverageUs(), pipelined.measuredFpm, pipelined.dropped);
+
+    double serialModel = uploadSerialFpm(serial.prep.AverageUs(), serial.net.AverageUs());
+    double pipelinedModel = uploadPipelinedFpm(pipelined.prep.AverageUs(), pipelined.net.AverageUs());
+    // A capture slower than both stages caps the pipeline instead
+    double captureFpm = options.captureMs ? 60000.0 / options.captureMs : 0;
+    bool captureBound = captureFpm > 0 && captureFpm < pipelinedModel;
+    if (captureBound) {
+        pipelinedModel = captureFpm;
+    }
+
+    check(near(serial.measuredFpm, serialModel), "serial: 60e6 / (prep + net)", serial.measuredFpm, serialModel);
+    check(near(pipelined.measuredFpm, pipelinedModel), "pipelined: 60e6 / max(prep, net)", pipelined.measuredFpm,
+          pipelinedModel);
+    if (!captureBound) {
+        check(pipelined.measuredFpm > serial.measuredFpm, "pipelined beats serial", pipelined.measuredFpm,
+              serial.measuredFpm);
+    }
+
+    printf(failures ? "%d checks failed\n" : "all checks passed\n", failures);
+    return failures ? 1 : 0;
+}
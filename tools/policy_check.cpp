@@ -0,0 +1,288 @@
+// POST policy upload check (S3PostPolicy) against tools/policy_responder.py
+// and the S3 stand-in, both started here:
+//
+//   url        s3PolicyUrlAllowed (s3_policy_url.cpp): only the configured
+//              bucket, or the S3_ENDPOINT stand-in, is accepted
+//   mqtt       this program plays the broker: the responder connects and
+//              subscribes, gets a policy-request as the device sends it and
+//              answers on the device's policy topic
+//   upload     the form the device posts (policy fields, key, Content-Type,
+//              Content-Encoding for status JSON, file last) is accepted by
+//              the stand-in, which checks the signature and conditions;
+//              keys outside the requested prefixes and forged signatures
+//              are refused
+//
+// Exits 1 on any failure.
+//
+// Build:  g++ -std=c++17 -O2 -I include -o policy_check tools/policy_check.cpp src/common/s3_policy_url.cpp
+// Usage:  policy_check      (from the repository root)
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "s3_policy_url.h"
+#include "standin_client.h"
+
+#define ACCESS_KEY "AKIDPOLICYCHECK"
+#define SECRET_KEY "policy-check-secret"
+#define FORM_BOUNDARY "----catshelter7d1f3a9c2b"      // as s3_post_policy.cpp
+
+static int failures = 0;
+
+static void check(bool ok, const char* scenario, const char* what) {
+    printf("%s %-7s %s\n", ok ? "ok  " : "FAIL", scenario, what);
+    failures += !ok;
+}
+
+// ===== MQTT 3.1.1, just what the responder sends =====
+
+static bool readExact(int fd, void* buf, size_t len) {
+    for (size_t got = 0; got < len;) {
+        ssize_t n = recv(fd, (char*)buf + got, len - got, 0);
+        if (n <= 0) {
+            return false;
+        }
+        got += n;
+    }
+    return true;
+}
+
+static bool readPacket(int fd, uint8_t& kind, std::string& body) {
+    if (!readExact(fd, &kind, 1)) {
+        return false;
+    }
+    size_t len = 0;
+    for (int shift = 0;; shift += 7) {
+        uint8_t byte;
+        if (!readExact(fd, &byte, 1)) {
+            return false;
+        }
+        len |= (size_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            break;
+        }
+    }
+    body.resize(len);
+    return len == 0 || readExact(fd, &body[0], len);
+}
+
+static void sendPacket(int fd, uint8_t kind, const std::string& body) {
+    std::string out(1, (char)kind);
+    size_t len = body.size();
+    do {
+        uint8_t byte = len % 128;
+        len /= 128;
+        out += (char)(byte | (len ? 0x80 : 0));
+    } while (len);
+    out += body;
+    send(fd, out.data(), out.size(), MSG_NOSIGNAL);
+}
+
+static std::string mqttString(const std::string& s) {
+    return std::string(1, (char)(s.size() >> 8)) + (char)(s.size() & 0xff) + s;
+}
+
+static std::string readMqttString(const std::string& body, size_t& pos) {
+    size_t len = ((uint8_t)body[pos] << 8) | (uint8_t)body[pos + 1];
+    std::string s = body.substr(pos + 2, len);
+    pos += 2 + len;
+    return s;
+}
+
+// ===== The responder's JSON: flat string fields, as json.dumps writes them =====
+
+static std::string jsonString(const std::string& json, size_t& pos) {
+    size_t start = json.find('"', pos) + 1;
+    size_t end = json.find('"', start);
+    pos = end + 1;
+    return json.substr(start, end - start);
+}
+
+struct Policy {
+    std::string url;
+    long expires = 0;
+    std::vector<std::pair<std::string, std::string>> fields;
+};
+
+static bool parsePolicy(const std::string& json, Policy& policy) {
+    size_t pos = json.find("\"url\":");
+    if (pos == std::string::npos) {
+        return false;
+    }
+    pos += 6;
+    policy.url = jsonString(json, pos);
+    pos = json.find("\"expires\":");
+    if (pos == std::string::npos) {
+        return false;
+    }
+    policy.expires = atol(json.c_str() + pos + 10);
+    pos = json.find("\"fields\": {");
+    if (pos == std::string::npos) {
+        return false;
+    }
+    pos += 11;
+    for (size_t next; (next = json.find_first_not_of(" ,", pos)) != std::string::npos && json[next] == '"';) {
+        std::string name = jsonString(json, pos);
+        std::string value = jsonString(json, pos);
+        policy.fields.push_back({name, value});
+    }
+    return !policy.fields.empty();
+}
+
+// ===== The device's form =====
+
+static void appendFormField(std::string& body, const std::string& name, const std::string& value) {
+    body += "--" FORM_BOUNDARY "\r\nContent-Disposition: form-data; name=\"" + name + "\"\r\n\r\n" + value + "\r\n";
+}
+
+static int postForm(int port, const Policy& policy, const std::string& key, const char* contentType,
+                    const char* contentEncoding, const std::string& data) {
+    std::string body;
+    for (const auto& field : policy.fields) {
+        appendFormField(body, field.first, field.second);
+    }
+    appendFormField(body, "key", key);
+    appendFormField(body, "Content-Type", contentType);
+    if (contentEncoding) {
+        appendFormField(body, "Content-Encoding", contentEncoding);
+    }
+    body += "--" FORM_BOUNDARY "\r\nContent-Disposition: form-data; name=\"file\"; filename=\"upload\"\r\n";
+    body += std::string("Content-Type: ") + contentType + "\r\n\r\n" + data + "\r\n--" FORM_BOUNDARY "--\r\n";
+    HttpResponse response;
+    return httpRequest(port, "POST", "/", {{"Content-Type", "multipart/form-data; boundary=" FORM_BOUNDARY}},
+                       body.data(), body.size(), response);
+}
+
+static void checkUrls() {
+    const char* b = "cats";
+    const char* r = "eu-west-1";
+    check(s3PolicyUrlAllowed("https://cats.s3.eu-west-1.amazonaws.com/", b, r, nullptr), "url", "regional bucket host");
+    check(s3PolicyUrlAllowed("https://CATS.s3.amazonaws.com", b, r, nullptr), "url", "global bucket host, no path");
+    check(s3PolicyUrlAllowed("https://s3.eu-west-1.amazonaws.com/cats/", b, r, nullptr), "url", "path-style bucket");
+    check(s3PolicyUrlAllowed("http://127.0.0.1:9000/", b, r, "127.0.0.1:9000"), "url", "stand-in endpoint");
+    check(!s3PolicyUrlAllowed("https://evil.example.com/", b, r, nullptr), "url", "other host refused");
+    check(!s3PolicyUrlAllowed("https://cats.s3.eu-west-1.amazonaws.com.evil.com/", b, r, nullptr), "url",
+          "suffixed host refused");
+    check(!s3PolicyUrlAllowed("https://cats.s3.eu-west-1.amazonaws.com@evil.com/", b, r, nullptr), "url",
+          "user info refused");
+    check(!s3PolicyUrlAllowed("https://dogs.s3.eu-west-1.amazonaws.com/", b, r, nullptr), "url", "other bucket refused");
+    check(!s3PolicyUrlAllowed("https://s3.eu-west-1.amazonaws.com/catsdogs/", b, r, nullptr), "url",
+          "path-style prefix of another bucket refused");
+    check(!s3PolicyUrlAllowed("http://cats.s3.eu-west-1.amazonaws.com/", b, r, nullptr), "url", "plain http refused");
+    check(!s3PolicyUrlAllowed("https://cats.s3.eu-west-1.amazonaws.com:444/", b, r, nullptr), "url",
+          "other port refused");
+    check(!s3PolicyUrlAllowed("https://cats.s3.eu-west-1.amazonaws.com/upload", b, r, nullptr), "url",
+          "other path refused");
+    check(!s3PolicyUrlAllowed("http://127.0.0.1:9001/", b, r, "127.0.0.1:9000"), "url", "other stand-in refused");
+    check(!s3PolicyUrlAllowed("https://cats.s3.eu-west-1.amazonaws.com/", b, r, "127.0.0.1:9000"), "url",
+          "AWS refused when a stand-in is configured");
+}
+
+/// @brief Broker side of one responder session: returns its policy response
+static bool exchange(int s3Port, std::string& topic, std::string& payload) {
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addrLen = sizeof(addr);
+    if (bind(listener, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(listener, 1) != 0 ||
+        getsockname(listener, (sockaddr*)&addr, &addrLen) != 0) {
+        close(listener);
+        return false;
+    }
+
+    std::string brokerPort = std::to_string(ntohs(addr.sin_port));
+    std::string url = "http://127.0.0.1:" + std::to_string(s3Port) + "/";
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        execlp("python3", "python3", "tools/policy_responder.py", "--broker", "127.0.0.1", "--port",
+               brokerPort.c_str(), "--url", url.c_str(), "--bucket", "cats", "--access-key", ACCESS_KEY,
+               "--secret-key", SECRET_KEY, "--once", "--quiet", (char*)nullptr);
+        _exit(127);
+    }
+
+    timeval timeout = {10, 0};
+    setsockopt(listener, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    int fd = accept(listener, nullptr, nullptr);
+    close(listener);
+    bool ok = fd >= 0;
+    if (ok) {
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        uint8_t kind;
+        std::string body;
+        ok = readPacket(fd, kind, body) && kind == 0x10;
+        check(ok, "mqtt", "responder sent CONNECT");
+        sendPacket(fd, 0x20, std::string("\0\0", 2));
+
+        ok = ok && readPacket(fd, kind, body) && kind == 0x82;
+        size_t pos = 2;
+        check(ok && readMqttString(body, pos) == "cat-shelter/+/policy-request", "mqtt",
+              "subscribed to cat-shelter/+/policy-request");
+        sendPacket(fd, 0x90, body.substr(0, 2) + std::string(1, '\0'));
+
+        // As S3PostPolicy::Loop() publishes it (QoS 0)
+        sendPacket(fd, 0x30, mqttString("cat-shelter/check/policy-request") +
+                                 "{\"device\":\"check\",\"timestamp\":\"2026-10-16T10:00:00Z\","
+                                 "\"prefixes\":[\"check/\",\"check/live/\"]}");
+        ok = ok && readPacket(fd, kind, body) && (kind >> 4) == 3;
+        pos = 0;
+        if (ok) {
+            topic = readMqttString(body, pos);
+            payload = body.substr(pos);
+        }
+        close(fd);
+    }
+    int status = 0;
+    if (!ok) {
+        kill(pid, SIGTERM);
+    }
+    waitpid(pid, &status, 0);
+    return ok;
+}
+
+int main() {
+    checkUrls();
+
+    StandIn standin;
+    if (!standin.Start({"--access-key", ACCESS_KEY, "--secret-key", SECRET_KEY})) {
+        fprintf(stderr, "cannot start tools/s3_standin.py (run from the repository root)\n");
+        return 2;
+    }
+
+    std::string topic, payload;
+    bool answered = exchange(standin.port, topic, payload);
+    check(answered, "mqtt", "policy published");
+    check(topic == "cat-shelter/check/policy", "mqtt", "on the device's policy topic");
+    Policy policy;
+    check(answered && parsePolicy(payload, policy), "mqtt", "response has url, expires and fields");
+    std::string endpoint = "127.0.0.1:" + std::to_string(standin.port);
+    check(s3PolicyUrlAllowed(policy.url.c_str(), "cats", "us-east-1", endpoint.c_str()), "mqtt",
+          "device accepts the url");
+    check(policy.expires > (long)time(nullptr) + 600, "mqtt", "expires after the refresh margin");
+
+    std::string photo(70000, '\0');
+    for (size_t i = 0; i < photo.size(); i++) {
+        photo[i] = (char)(i * 131 + 7);
+    }
+    check(postForm(standin.port, policy, "check/photo.jpg", "image/jpeg", nullptr, photo) == 204 &&
+              standin.Object("/check/photo.jpg") == photo, "upload", "photo stored");
+    std::string status = "\x1f\x8b gzipped status";
+    check(postForm(standin.port, policy, "check/status.json", "application/json", "gzip", status) == 204 &&
+              standin.Object("/check/status.json") == status, "upload", "gzipped status JSON stored");
+    check(postForm(standin.port, policy, "other/photo.jpg", "image/jpeg", nullptr, photo) == 403 &&
+              standin.Object("/other/photo.jpg").empty(), "upload", "key outside the prefixes refused");
+
+    Policy forged = policy;
+    for (auto& field : forged.fields) {
+        if (field.first == "x-amz-signature") {
+            field.second[0] = field.second[0] == '0' ? '1' : '0';
+        }
+    }
+    check(postForm(standin.port, forged, "check/forged.jpg", "image/jpeg", nullptr, photo) == 403,
+          "upload", "forged signature refused");
+
+    printf(failures ? "%d checks failed\n" : "all checks passed\n", failures);
+    return failures ? 1 : 0;
+}
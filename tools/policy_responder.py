@@ -0,0 +1,229 @@
+#!/usr/bin/env python3
+"""Stand-in for the cloud side of S3 POST policy uploads (S3PostPolicy).
+
+Subscribes to cat-shelter/+/policy-request and answers each request on
+cat-shelter/<device>/policy with a SigV4-signed POST policy:
+
+    {"url": "...", "expires": <epoch>, "fields": {"policy": ..., "x-amz-signature": ..., ...}}
+
+The policy only allows keys under the common prefix of the requested
+prefixes, bodies up to --max-bytes, and the Content-Type / Content-Encoding
+fields the device sends (gzipped status JSON uses the same policy). The url
+must be the device's bucket (or its S3_ENDPOINT stand-in), or it is ignored.
+
+Talks MQTT 3.1.1 itself, QoS 0, so nothing needs installing. For AWS IoT pass
+--cafile/--cert/--key (port 8883); for a local broker, plain TCP:
+
+    python3 tools/policy_responder.py --broker localhost --port 1883 \\
+        --url http://192.168.1.20:9000/ --access-key AKIA... --secret-key ...
+
+--print <device> writes one response to stdout and exits, to paste into the
+MQTT test client by hand. tools/s3_standin.py checks the policy signature,
+expiry and conditions when it is given the same keys.
+"""
+
+import argparse
+import base64
+import datetime
+import hashlib
+import hmac
+import json
+import os
+import socket
+import ssl
+import struct
+import sys
+
+TOPIC_ROOT = "cat-shelter/"
+
+
+# ----- policy -----
+
+def sign(key, msg):
+    return hmac.new(key, msg.encode(), hashlib.sha256).digest()
+
+
+def build_policy(opts, request, now=None):
+    now = now or datetime.datetime.now(datetime.timezone.utc)
+    expires = now + datetime.timedelta(seconds=opts.lifetime)
+    date = now.strftime("%Y%m%d")
+    credential = f"{opts.access_key}/{date}/{opts.region}/s3/aws4_request"
+    fields = {
+        "x-amz-algorithm": "AWS4-HMAC-SHA256",
+        "x-amz-credential": credential,
+        "x-amz-date": now.strftime("%Y%m%dT%H%M%SZ"),
+    }
+    if opts.session_token:
+        fields["x-amz-security-token"] = opts.session_token
+
+    conditions = [{"bucket": opts.bucket}]
+    conditions += [{name: value} for name, value in fields.items()]
+    conditions += [
+        ["starts-with", "$key", os.path.commonprefix([str(p) for p in request.get("prefixes", [])])],
+        ["starts-with", "$Content-Type", ""],
+        ["starts-with", "$Content-Encoding", ""],
+        ["content-length-range", 0, opts.max_bytes],
+    ]
+    document = {"expiration": expires.strftime("%Y-%m-%dT%H:%M:%S.000Z"), "conditions": conditions}
+    policy = base64.b64encode(json.dumps(document, separators=(",", ":")).encode()).decode()
+
+    key = sign(("AWS4" + opts.secret_key).encode(), date)
+    for part in (opts.region, "s3", "aws4_request"):
+        key = sign(key, part)
+    fields["policy"] = policy
+    fields["x-amz-signature"] = hmac.new(key, policy.encode(), hashlib.sha256).hexdigest()
+
+    url = opts.url or f"https://{opts.bucket}.s3.{opts.region}.amazonaws.com/"
+    return {"url": url, "expires": int(expires.timestamp()), "fields": fields}
+
+
+# ----- MQTT 3.1.1, QoS 0 -----
+
+def encode_length(n):
+    out = bytearray()
+    while True:
+        byte, n = n % 128, n // 128
+        out.append(byte | (0x80 if n else 0))
+        if not n:
+            return bytes(out)
+
+
+def encode_string(s):
+    data = s.encode()
+    return struct.pack("!H", len(data)) + data
+
+
+def packet(kind, body):
+    return bytes([kind]) + encode_length(len(body)) + body
+
+
+def read_exact(sock, n):
+    data = b""
+    while len(data) < n:
+        chunk = sock.recv(n - len(data))
+        if not chunk:
+            raise ConnectionError("broker closed the connection")
+        data += chunk
+    return data
+
+
+def read_packet(sock):
+    kind = read_exact(sock, 1)[0]
+    length, shift = 0, 0
+    while True:
+        byte = read_exact(sock, 1)[0]
+        length += (byte & 0x7F) << shift
+        shift += 7
+        if not byte & 0x80:
+            break
+    return kind, read_exact(sock, length)
+
+
+class Mqtt:
+    def __init__(self, sock, client_id, keepalive):
+        self.sock = sock
+        self.keepalive = keepalive
+        body = encode_string("MQTT") + bytes([4, 0x02]) + struct.pack("!H", keepalive) + encode_string(client_id)
+        sock.sendall(packet(0x10, body))
+        kind, data = read_packet(sock)
+        if kind >> 4 != 2 or len(data) < 2 or data[1] != 0:
+            raise ConnectionError(f"CONNACK refused: {data.hex()}")
+
+    def subscribe(self, topic):
+        self.sock.sendall(packet(0x82, struct.pack("!H", 1) + encode_string(topic) + b"\x00"))
+        kind, data = read_packet(self.sock)
+        if kind >> 4 != 9 or data[-1] == 0x80:
+            raise ConnectionError(f"SUBSCRIBE refused: {data.hex()}")
+
+    def publish(self, topic, payload):
+        self.sock.sendall(packet(0x30, encode_string(topic) + payload))
+
+    def messages(self):
+        """Yields (topic, payload) for each PUBLISH, pinging when idle."""
+        self.sock.settimeout(self.keepalive / 2)
+        while True:
+            try:
+                kind, data = read_packet(self.sock)
+            except socket.timeout:
+                self.sock.sendall(packet(0xC0, b""))
+                continue
+            if kind >> 4 != 3:
+                continue
+            qos = (kind >> 1) & 3
+            (topic_len,) = struct.unpack("!H", data[:2])
+            topic = data[2:2 + topic_len].decode()
+            pos = 2 + topic_len
+            if qos:
+                packet_id = data[pos:pos + 2]
+                pos += 2
+                if qos == 1:
+                    self.sock.sendall(packet(0x40, packet_id))
+            yield topic, data[pos:]
+
+
+def connect(opts):
+    sock = socket.create_connection((opts.broker, opts.port), timeout=30)
+    if opts.cafile:
+        context = ssl.create_default_context(cafile=opts.cafile)
+        if opts.cert:
+            context.load_cert_chain(opts.cert, opts.key)
+        sock = context.wrap_socket(sock, server_hostname=opts.broker)
+    return Mqtt(sock, opts.client_id, opts.keepalive)
+
+
+def serve(opts):
+    mqtt = connect(opts)
+    mqtt.subscribe(TOPIC_ROOT + "+/policy-request")
+    if not opts.quiet:
+        print(f"answering policy requests on {opts.broker}:{opts.port}", flush=True)
+    for topic, payload in mqtt.messages():
+        device = topic[len(TOPIC_ROOT):].split("/", 1)[0]
+        try:
+            request = json.loads(payload)
+        except ValueError:
+            print(f"{device}: bad request {payload[:80]!r}", file=sys.stderr)
+            continue
+        response = build_policy(opts, request)
+        mqtt.publish(f"{TOPIC_ROOT}{device}/policy", json.dumps(response).encode())
+        if not opts.quiet:
+            print(f"{device}: policy for {request.get('prefixes')} until {response['expires']}", flush=True)
+        if opts.once:
+            return
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--broker", default="localhost")
+    parser.add_argument("--port", type=int, default=1883)
+    parser.add_argument("--cafile", help="CA bundle; enables TLS (AWS IoT: port 8883)")
+    parser.add_argument("--cert", help="client certificate (AWS IoT)")
+    parser.add_argument("--key", help="client private key (AWS IoT)")
+    parser.add_argument("--client-id", default="policy-responder")
+    parser.add_argument("--keepalive", type=int, default=60)
+    parser.add_argument("--bucket", default=os.environ.get("S3_BUCKET", ""))
+    parser.add_argument("--region", default=os.environ.get("AWS_REGION", "us-east-1"))
+    parser.add_argument("--url", help="form url, default https://<bucket>.s3.<region>.amazonaws.com/")
+    parser.add_argument("--access-key", default=os.environ.get("AWS_ACCESS_KEY_ID", ""))
+    parser.add_argument("--secret-key", default=os.environ.get("AWS_SECRET_ACCESS_KEY", ""))
+    parser.add_argument("--session-token", default=os.environ.get("AWS_SESSION_TOKEN", ""))
+    parser.add_argument("--lifetime", type=int, default=3600, help="policy lifetime (s)")
+    parser.add_argument("--max-bytes", type=int, default=8 * 1024 * 1024)
+    parser.add_argument("--print", metavar="DEVICE", help="print one response and exit")
+    parser.add_argument("--prefix", action="append", default=[], help="requested prefix for --print")
+    parser.add_argument("--once", action="store_true", help="exit after answering one request")
+    parser.add_argument("--quiet", action="store_true")
+    opts = parser.parse_args()
+    if not opts.access_key or not opts.secret_key:
+        parser.error("--access-key and --secret-key (or the AWS_* environment variables) are required")
+
+    if opts.print:
+        print(json.dumps(build_policy(opts, {"device": opts.print, "prefixes": opts.prefix})))
+        return
+    try:
+        serve(opts)
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,257 @@
+// Upload retry check (s3_put_retry.cpp) against the S3 stand-in
+// (tools/s3_standin.py), which it starts itself:
+//
+//   faults     200 uploads with --lose-rate, --corrupt-rate and --fail-rate;
+//              no key may be written more than once
+//   doubt      lost responses whose HEAD is answered 503 half the time; the
+//              object is checked again instead of being written blind
+//   permanent  a 403 is not retried
+//   deadline   a retry that would not fit in the time of one attempt is not
+//              started
+//   backoff    once every target failed, rounds wait 1, 2, 4 s
+//
+// Writes are counted from the stand-in's --write-log. Every confirmed upload
+// must be stored with the uploaded bytes, and an unconfirmed one must be
+// either missing or intact. Backoff waits run on a virtual clock. Exits 1 on
+// any failure.
+//
+// Build:  g++ -std=c++17 -O2 -I include -o s3_put_retry_check tools/s3_put_retry_check.cpp src/common/s3_put_retry.cpp -lcrypto
+// Usage:  s3_put_retry_check [uploads] [seed]      (from the repository root)
+
+#include <openssl/evp.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+#include "s3_put_retry.h"
+#include "standin_client.h"
+
+#define CONNECT_TIMEOUT 10000
+#define TIMEOUT 30000
+
+static int failures = 0;
+
+static void check(bool ok, const char* scenario, const char* what) {
+    printf("%s %-9s %s\n", ok ? "ok  " : "FAIL", scenario, what);
+    failures += !ok;
+}
+
+static std::string md5Hex(const std::string& data) {
+    unsigned char digest[16];
+    unsigned int len = 0;
+    EVP_Digest(data.data(), data.size(), digest, &len, EVP_md5(), nullptr);
+    char hex[33];
+    for (int i = 0; i < 16; i++) {
+        snprintf(hex + 2 * i, 3, "%02x", digest[i]);
+    }
+    return hex;
+}
+
+static std::string md5Base64(const std::string& data) {
+    unsigned char digest[16];
+    unsigned int len = 0;
+    EVP_Digest(data.data(), data.size(), digest, &len, EVP_md5(), nullptr);
+    unsigned char out[25];
+    EVP_EncodeBlock(out, digest, 16);
+    return (const char*)out;
+}
+
+/// @brief One target, the stand-in; backoff waits advance a virtual clock
+class StandInTransport : public S3PutTransport {
+    HttpResponse _response;
+
+    void Request(const char* method, const std::string& body, S3PutReply& reply) {
+        std::vector<std::pair<std::string, std::string>> headers;
+        if (body.size()) {
+            headers = {{"Content-Type", "image/jpeg"}, {"Content-MD5", md5Base64(body)}};
+        }
+        int status = httpRequest(port, method, key, headers, body.data(), body.size(), _response);
+        reply.status = status;
+        reply.body = status > 0 ? _response.body.c_str() : "connection lost";
+        auto etag = _response.headers.find("etag");
+        reply.etag = etag != _response.headers.end() ? etag->second.c_str() : "";
+    }
+
+public:
+    int port;
+    std::string key;
+    std::string payload;
+    uint32_t skewMs = 0;
+    std::vector<uint32_t> delays;
+
+    explicit StandInTransport(int p) : port(p) {}
+
+    uint32_t Millis() override {
+        using namespace std::chrono;
+        static const steady_clock::time_point start = steady_clock::now();
+        return (uint32_t)duration_cast<milliseconds>(steady_clock::now() - start).count() + skewMs;
+    }
+
+    void Delay(uint32_t ms) override {
+        delays.push_back(ms);
+        skewMs += ms;
+    }
+
+    bool Select(uint32_t excludeMask, int& target) override {
+        target = 0;
+        return !(excludeMask & 1);
+    }
+
+    // httpRequest has a fixed 10 s receive timeout; the stand-in answers well within it
+    void Put(int, uint32_t, uint32_t, S3PutReply& reply) override { Request("PUT", payload, reply); }
+    void Head(int, uint32_t, uint32_t, S3PutReply& reply) override { Request("HEAD", "", reply); }
+};
+
+/// @brief Writes per key from a --write-log file
+static std::map<std::string, int> writesPerKey(const std::string& path) {
+    std::map<std::string, int> writes;
+    std::ifstream in(path);
+    std::string key, etag;
+    while (in >> key >> etag) {
+        ++writes[key];
+    }
+    return writes;
+}
+
+struct RunResult {
+    int confirmed = 0;
+    int alreadyStored = 0;
+    int unconfirmed = 0;
+    int rewritten = 0;        // keys written more than once
+    int damaged = 0;          // stored objects that differ from the upload
+    int lost = 0;             // confirmed uploads with no object
+    uint32_t puts = 0;
+    uint32_t heads = 0;
+    uint32_t headsInDoubt = 0;
+};
+
+/// @brief uploads objects of 1-64 KB through a fresh stand-in started with options
+static bool run(int uploads, const std::vector<std::string>& options, std::mt19937& rng, RunResult& result) {
+    StandIn standIn;
+    char log[] = "/tmp/s3-writes-XXXXXX";
+    int fd = mkstemp(log);
+    if (fd < 0) {
+        return false;
+    }
+    close(fd);
+    std::vector<std::string> args = {"--no-verify", "--write-log", log};
+    args.insert(args.end(), options.begin(), options.end());
+    if (!standIn.Start(args)) {
+        return false;
+    }
+
+    StandInTransport transport(standIn.port);
+    S3PutRetry retry(transport);
+    for (int i = 0; i < uploads; i++) {
+        transport.key = "/cats/retry/" + std::to_string(i) + ".jpg";
+        transport.payload.resize(1024 + rng() % (63 * 1024));
+        for (char& c : transport.payload) {
+            c = (char)rng();
+        }
+        UploadOutcome outcome = retry.Put(md5Hex(transport.payload).c_str(), CONNECT_TIMEOUT, TIMEOUT, true);
+        bool ok = outcome == UPLOAD_OUTCOME_FIRST_TRY || outcome == UPLOAD_OUTCOME_AFTER_RETRY ||
+                  outcome == UPLOAD_OUTCOME_ALREADY_STORED;
+        result.confirmed += ok;
+        result.alreadyStored += outcome == UPLOAD_OUTCOME_ALREADY_STORED;
+        result.unconfirmed += !ok;
+
+        std::string stored = standIn.Object(transport.key);
+        if (ok && stored.empty()) {
+            ++result.lost;
+        } else if (!stored.empty() && stored != transport.payload) {
+            ++result.damaged;
+        }
+    }
+    standIn.Stop();
+    result.puts = retry.Puts();
+    result.heads = retry.Heads();
+    result.headsInDoubt = retry.HeadsInDoubt();
+    for (const auto& entry : writesPerKey(log)) {
+        result.rewritten += entry.second > 1;
+    }
+    unlink(log);
+    return true;
+}
+
+/// @brief One upload to a fresh stand-in, with the given budget
+struct Single {
+    StandIn standIn;
+    StandInTransport transport{-1};
+    S3PutRetry retry{transport};
+    UploadOutcome outcome = UPLOAD_OUTCOME_COUNT;
+
+    Single(const std::vector<std::string>& options, uint32_t connectTimeout, uint32_t timeout) {
+        if (standIn.Start(options)) {
+            transport.port = standIn.port;
+            transport.key = "/cats/retry/single.jpg";
+            transport.payload = "single";
+            outcome = retry.Put(md5Hex(transport.payload).c_str(), connectTimeout, timeout, true);
+        }
+    }
+};
+
+int main(int argc, char** argv) {
+    int uploads = argc > 1 ? atoi(argv[1]) : 200;
+    unsigned seed = argc > 2 ? (unsigned)atoi(argv[2]) : 1;
+    std::mt19937 rng(seed);
+    std::string seedArg = std::to_string(seed);
+
+    // faults
+    RunResult faults;
+    if (!run(uploads, {"--lose-rate", "0.2", "--corrupt-rate", "0.2", "--fail-rate", "0.1", "--seed", seedArg},
+             rng, faults)) {
+        fprintf(stderr, "cannot start tools/s3_standin.py (run from the repository root)\n");
+        return 2;
+    }
+    printf("faults: %d confirmed (%d already stored), %d unconfirmed, %u PUTs, %u HEADs (%u in doubt)\n",
+           faults.confirmed, faults.alreadyStored, faults.unconfirmed, faults.puts, faults.heads, faults.headsInDoubt);
+    check(faults.rewritten == 0, "faults", "no key written more than once");
+    check(faults.lost == 0, "faults", "confirmed uploads are stored");
+    check(faults.damaged == 0, "faults", "stored objects match the uploads");
+    check(faults.alreadyStored > 0, "faults", "lost responses resolved by HEAD");
+    check(faults.confirmed >= uploads * 9 / 10, "faults", "at least 90% confirmed");
+
+    // doubt
+    RunResult doubt;
+    if (!run(uploads / 4, {"--lose-rate", "0.5", "--fail-rate", "0.5", "--seed", seedArg}, rng, doubt)) {
+        return 2;
+    }
+    printf("doubt: %d confirmed (%d already stored), %d unconfirmed, %u PUTs, %u HEADs (%u in doubt)\n",
+           doubt.confirmed, doubt.alreadyStored, doubt.unconfirmed, doubt.puts, doubt.heads, doubt.headsInDoubt);
+    check(doubt.headsInDoubt > 0, "doubt", "HEADs left in doubt");
+    check(doubt.rewritten == 0, "doubt", "no key written more than once");
+    check(doubt.lost == 0 && doubt.damaged == 0, "doubt", "stored objects match the confirmed uploads");
+
+    // permanent: the stand-in checks signatures, ours has none
+    Single permanent({"--access-key", "AKIDCHECK", "--secret-key", "secret"}, CONNECT_TIMEOUT, TIMEOUT);
+    check(permanent.outcome == UPLOAD_OUTCOME_PERMANENT && permanent.retry.Puts() == 1, "permanent",
+          "403 not retried");
+
+    // deadline: one attempt's time, no retry fits
+    Single deadline({"--no-verify", "--fail-rate", "1"}, 1000, 4000);
+    check(deadline.outcome == UPLOAD_OUTCOME_DEADLINE && deadline.retry.Puts() == 1, "deadline",
+          "no retry without time left");
+
+    // backoff
+    Single backoff({"--no-verify", "--fail-rate", "1"}, CONNECT_TIMEOUT, TIMEOUT);
+    const std::vector<uint32_t>& delays = backoff.transport.delays;
+    bool waits = delays.size() == 3;
+    for (size_t i = 0; waits && i < 3; i++) {
+        uint32_t expected = UPLOAD_RETRY_MIN_DELAY << i;
+        waits = delays[i] <= expected && delays[i] + 200 > expected;
+    }
+    check(backoff.outcome == UPLOAD_OUTCOME_EXHAUSTED && backoff.retry.Puts() == UPLOAD_MAX_ATTEMPTS, "backoff",
+          "all attempts spent on 503s");
+    check(waits, "backoff", "rounds wait 1, 2, 4 s");
+
+    if (failures) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
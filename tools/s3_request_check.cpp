@@ -0,0 +1,312 @@
+// Request builder / response parser check (s3_http.cpp, the part of
+// S3Connection that runs for every upload) with heap allocations counted.
+// Allocations are counted (tools/alloc_count.h), so every check below also
+// asserts that building the request and parsing the response made none:
+//
+//   head       request line and headers byte for byte, the Content-Length
+//              overload, and a head too long for the buffer refused
+//   upload     200 PUTs + HEADs to the S3 stand-in (tools/s3_standin.py,
+//              started here with --no-verify) over one kept-alive connection, like the
+//              pipeline: 200 with the ETag of the stored object, body
+//              written from the caller's buffer
+//   responses  canned replies, fed a byte at a time: 100 Continue, chunked
+//              with trailers, close-delimited body, Connection: close, an
+//              error body longer than the kept prefix, a reply cut short,
+//              silence and a non-HTTP reply
+//
+// Exits 1 on any failure.
+//
+// Build:  g++ -std=c++17 -O2 -I include -o s3_request_check tools/s3_request_check.cpp src/common/s3_http.cpp
+// Usage:  s3_request_check      (from the repository root)
+
+#include <time.h>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include "s3_http.h"
+#include "alloc_count.h"
+#include "standin_client.h"
+
+#define UPLOADS 200
+
+static int failures = 0;
+
+static void check(bool ok, const char* scenario, const char* what) {
+    printf("%s %-9s %s\n", ok ? "ok  " : "FAIL", scenario, what);
+    failures += !ok;
+}
+
+static unsigned long nowMs() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000UL + ts.tv_nsec / 1000000;
+}
+
+// ===== Sources =====
+
+/// @brief Canned reply, one byte per Read with an empty read in between
+class MemorySource : public S3ResponseSource {
+    const char* _data;
+    size_t _len;
+    size_t _pos = 0;
+    bool _open;
+    bool _starve = false;
+    int _dryWaits = 0;
+
+public:
+    MemorySource(const char* data, bool open = false) : _data(data), _len(strlen(data)), _open(open) {}
+
+    int Read(uint8_t* buf, size_t) override {
+        if (_pos == _len) {
+            return _open ? 0 : -1;
+        }
+        _starve = !_starve;
+        if (_starve) {
+            return 0;
+        }
+        buf[0] = _data[_pos++];
+        return 1;
+    }
+    // Ran dry while open: the deadline passes after a few waits
+    bool Idle() override { return _pos < _len || ++_dryWaits < 5; }
+};
+
+/// @brief Kept-alive connection to the stand-in, like S3Connection over WiFiClient
+class SocketSource : public S3ResponseSource {
+    int _fd = -1;
+
+public:
+    unsigned long deadline = 0;
+
+    ~SocketSource() { Close(); }
+
+    bool Connect(int port) {
+        _fd = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        timeval tv = {0, 20000};
+        setsockopt(_fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        return connect(_fd, (sockaddr*)&addr, sizeof(addr)) == 0;
+    }
+    void Close() {
+        if (_fd >= 0) {
+            close(_fd);
+            _fd = -1;
+        }
+    }
+    bool Write(const void* buf, size_t len) {
+        for (size_t sent = 0; sent < len;) {
+            ssize_t n = send(_fd, (const char*)buf + sent, len - sent, MSG_NOSIGNAL);
+            if (n <= 0) {
+                return false;
+            }
+            sent += n;
+        }
+        return true;
+    }
+
+    int Read(uint8_t* buf, size_t len) override {
+        ssize_t n = recv(_fd, buf, len, 0);
+        if (n > 0) {
+            return n;
+        }
+        return n == 0 ? -1 : 0;
+    }
+    bool Idle() override { return (long)(nowMs() - deadline) <= 0; }
+};
+
+// ===== Scenarios =====
+
+static void checkHead() {
+    S3RequestHead head;
+    unsigned long count;
+    bool finished;
+    {
+        AllocationScope scope;
+        free(allocationProbe(64));
+        count = scope.Count();
+    }
+    check(count == 1, "head", "allocation counter sees malloc");
+
+    {
+        AllocationScope scope;
+        head.Begin("bucket.s3.eu-west-1.amazonaws.com", "PUT", "/cam/2026/photo.jpg");
+        head.Header("Content-Type", "image/jpeg");
+        head.Header("Content-Length", 48213UL);
+        head.Header("x-amz-content-sha256", "UNSIGNED-PAYLOAD");
+        finished = head.Finish();
+        count = scope.Count();
+    }
+    const char* expected =
+        "PUT /cam/2026/photo.jpg HTTP/1.1\r\n"
+        "Host: bucket.s3.eu-west-1.amazonaws.com\r\n"
+        "Content-Type: image/jpeg\r\n"
+        "Content-Length: 48213\r\n"
+        "x-amz-content-sha256: UNSIGNED-PAYLOAD\r\n"
+        "\r\n";
+    check(finished, "head", "fits the buffer");
+    check(std::string(head.Data(), head.Length()) == expected, "head", "request line and headers byte for byte");
+    check(!head.IsHead(), "head", "PUT is not HEAD");
+    check(count == 0, "head", "no allocation");
+
+    std::string value(S3_REQUEST_HEAD_SIZE / 2, 'x');
+    {
+        AllocationScope scope;
+        head.Begin("host", "HEAD", "/key");
+        head.Header("x-one", value.c_str());
+        head.Header("x-two", value.c_str());
+        finished = head.Finish();
+        count = scope.Count();
+    }
+    check(!finished, "head", "headers over the buffer size refused");
+    check(head.IsHead(), "head", "HEAD request flagged");
+    check(count == 0, "head", "no allocation when refused");
+
+    head.Begin("host", "GET", "/again");
+    check(head.Finish() && strncmp(head.Data(), "GET /again HTTP/1.1\r\n", 21) == 0, "head",
+          "Begin resets after an overflow");
+}
+
+static void checkUploads() {
+    StandIn standIn;
+    if (!standIn.Start({"--no-verify"})) {
+        fprintf(stderr, "cannot start tools/s3_standin.py\n");
+        exit(2);
+    }
+    SocketSource connection;
+    if (!connection.Connect(standIn.port)) {
+        fprintf(stderr, "cannot connect to the stand-in\n");
+        exit(2);
+    }
+
+    char host[32];
+    snprintf(host, sizeof(host), "127.0.0.1:%d", standIn.port);
+    std::string frame(20000, '\0');
+    for (size_t i = 0; i < frame.size(); i++) {
+        frame[i] = (char)(i * 31 + 7);
+    }
+
+    S3RequestHead head;
+    S3Response response;
+    unsigned long count = 0;
+    int ok = 0;
+    int etagsMatch = 0;
+    bool keptAlive = true;
+    for (int i = 0; i < UPLOADS; i++) {
+        char key[64];
+        snprintf(key, sizeof(key), "/check/frame-%03d.jpg", i);
+        frame[0] = (char)i;
+
+        bool gotBytes;
+        int status;
+        int headStatus;
+        char etag[48];
+        {
+            AllocationScope scope;
+            head.Begin(host, "PUT", key);
+            head.Header("Content-Type", "image/jpeg");
+            head.Header("Content-Length", (unsigned long)frame.size());
+            head.Header("x-amz-date", "20261016T120000Z");
+            head.Header("x-amz-content-sha256", "UNSIGNED-PAYLOAD");
+            head.Finish();
+            connection.Write(head.Data(), head.Length());
+            connection.Write(frame.data(), frame.size());
+            connection.deadline = nowMs() + 5000;
+            status = response.Parse(connection, head.IsHead(), gotBytes);
+            snprintf(etag, sizeof(etag), "%s", response.ETag());
+            keptAlive &= response.KeepAlive();
+
+            head.Begin(host, "HEAD", key);
+            head.Finish();
+            connection.Write(head.Data(), head.Length());
+            connection.deadline = nowMs() + 5000;
+            headStatus = response.Parse(connection, head.IsHead(), gotBytes);
+            keptAlive &= response.KeepAlive();
+            count += scope.Count();
+        }
+        ok += status == 200 && headStatus == 200;
+        etagsMatch += etag[0] == '"' && strcmp(etag, response.ETag()) == 0;
+    }
+    check(ok == UPLOADS, "upload", "every PUT and HEAD answered 200");
+    check(etagsMatch == UPLOADS, "upload", "PUT ETag matches the stored object");
+    check(keptAlive, "upload", "one kept-alive connection throughout");
+    frame[0] = (char)(UPLOADS - 1);
+    check(standIn.Object("/check/frame-199.jpg") == frame, "upload", "stored body intact");
+    printf("     %-9s %lu allocations over %d uploads\n", "upload", count, UPLOADS);
+    check(count == 0, "upload", "no allocation per upload");
+}
+
+struct Canned {
+    const char* what;
+    const char* reply;
+    bool isHead;
+    bool open;              // silent rather than closed after the reply
+    int status;
+    bool keepAlive;
+    const char* etag;
+    const char* body;
+};
+
+static void checkResponses() {
+    static std::string longError;
+    std::string longBody(400, 'e');
+    longError = "HTTP/1.1 403 Forbidden\r\nContent-Length: 400\r\n\r\n" + longBody + "HTTP/1.1 200 OK\r\n";
+    std::string kept(S3_RESPONSE_BODY_SIZE - 1, 'e');
+
+    const Canned cases[] = {
+        {"100 Continue skipped", "HTTP/1.1 100 Continue\r\n\r\nHTTP/1.1 200 OK\r\nETag: \"abc\"\r\nContent-Length: 0\r\n\r\n",
+         false, true, 200, true, "\"abc\"", ""},
+        {"chunked body with trailers",
+         "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n5\r\nhello\r\n7\r\n, world\r\n0\r\nX-Trailer: 1\r\n\r\n",
+         false, true, 200, true, "", "hello, world"},
+        {"close-delimited body", "HTTP/1.1 200 OK\r\nETag: \"x\"\r\n\r\nuntil close", false, false, 200, false, "\"x\"",
+         "until close"},
+        {"Connection: close", "HTTP/1.1 200 OK\r\nConnection: close\r\nContent-Length: 2\r\n\r\nok", false, true, 200,
+         false, "", "ok"},
+        {"HTTP/1.0 is not kept alive", "HTTP/1.0 200 OK\r\nContent-Length: 0\r\n\r\n", false, true, 200, false, "", ""},
+        {"HEAD has no body", "HTTP/1.1 200 OK\r\nETag: \"h\"\r\nContent-Length: 999\r\n\r\n", true, true, 200, true,
+         "\"h\"", ""},
+        {"304 has no body", "HTTP/1.1 304 Not Modified\r\nContent-Length: 999\r\n\r\n", false, true, 304, true, "", ""},
+        {"long error body kept in part", longError.c_str(), false, true, 403, true, "", kept.c_str()},
+        {"body cut short", "HTTP/1.1 500 Internal\r\nContent-Length: 50\r\n\r\nshort", false, false, 500, false, "",
+         "short"},
+        {"headers cut short", "HTTP/1.1 200 OK\r\nETag: \"a", false, false, S3_HTTP_CONNECTION_LOST, false, "", ""},
+        {"silence times out", "", false, true, S3_HTTP_NO_RESPONSE, false, "", ""},
+        {"closed without reply", "", false, false, S3_HTTP_NO_RESPONSE, false, "", ""},
+        {"not HTTP", "SSH-2.0-OpenSSH\r\n", false, true, S3_HTTP_NOT_HTTP, false, "", ""},
+    };
+
+    S3Response response;
+    for (const Canned& c : cases) {
+        MemorySource source(c.reply, c.open);
+        bool gotBytes;
+        int status;
+        unsigned long count;
+        {
+            AllocationScope scope;
+            status = response.Parse(source, c.isHead, gotBytes);
+            count = scope.Count();
+        }
+        bool ok = status == c.status && count == 0;
+        if (status > 0) {
+            ok &= response.KeepAlive() == c.keepAlive && strcmp(response.ETag(), c.etag) == 0 &&
+                  strcmp(response.Body(), c.body) == 0;
+        }
+        check(ok, "responses", c.what);
+    }
+}
+
+int main() {
+    checkHead();
+    checkUploads();
+    checkResponses();
+
+    if (failures) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,426 @@
+#!/usr/bin/env python3
+"""Minimal S3-compatible stand-in for testing uploads without AWS.
+
+Point the firmware at it with `#define S3_ENDPOINT "<host>:<port>"` in
+secrets.h. Requests are then sent over plain HTTP with the Host header set to
+that value, and the object path is the request path (single bucket).
+
+Supported: PUT/GET/HEAD/DELETE object (ETag, If-None-Match), multipart
+upload (initiate, upload part, complete, abort) and browser-style POST
+policy uploads. SigV4 Authorization headers and POST policies (signature,
+expiration, conditions; see tools/policy_responder.py) are verified against
+--access-key/--secret-key; the bucket condition is not, there is one bucket.
+
+Fault injection: --latency/--jitter before each response, --bandwidth to
+throttle request and response bodies, --fail-rate to answer 503 SlowDown,
+--corrupt-rate to damage PUT bodies in transit (caught by Content-MD5 as
+400 BadDigest) and --lose-rate to store a PUT (object or part) but drop the
+connection before answering; --seed makes the faults repeatable. Completing
+an upload again returns the same result, as S3 does for a retried Complete.
+The exit report counts keys written more than once, which is how retried
+uploads are checked for exactly-once object creation; --write-log appends
+"<key> <etag>" per stored object as it happens, for checks that run it.
+
+    python3 tools/s3_standin.py --port 9000 --data /tmp/s3 \\
+        --access-key AKIA... --secret-key ... --latency 200 --bandwidth 50000
+"""
+
+import argparse
+import base64
+import calendar
+import hashlib
+import hmac
+import json
+import os
+import random
+import re
+import signal
+import threading
+import time
+import urllib.parse
+import uuid
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+AUTH_RE = re.compile(
+    r"AWS4-HMAC-SHA256 Credential=([^/]+)/(\d{8})/([^/]+)/s3/aws4_request, "
+    r"SignedHeaders=([^,]+), Signature=([0-9a-f]{64})")
+
+
+class Stats:
+    def __init__(self, write_log=None):
+        self.lock = threading.Lock()
+        self.latencies = {}
+        self.writes = {}
+        self.write_log = open(write_log, "a") if write_log else None
+
+    def record_write(self, key, etag):
+        with self.lock:
+            self.writes.setdefault(key, []).append(etag)
+            if self.write_log:
+                self.write_log.write(f"{key} {etag}\n")
+                self.write_log.flush()
+
+    def record(self, method, status, ms):
+        with self.lock:
+            self.latencies.setdefault((method, status), []).append(ms)
+
+    def report(self):
+        with self.lock:
+            for (method, status), values in sorted(self.latencies.items(), key=lambda kv: (kv[0][0], str(kv[0][1]))):
+                values = sorted(values)
+                p = lambda q: values[int((len(values) - 1) * q)]
+                print(f"{method:6} {status}  n={len(values):5}  p50={p(0.5):7.1f} ms  p99={p(0.99):7.1f} ms")
+            rewritten = {k: v for k, v in self.writes.items() if len(v) > 1}
+            changed = [k for k, v in rewritten.items() if len(set(v)) > 1]
+            print(f"objects {len(self.writes)}  written more than once {len(rewritten)}  with different content {len(changed)}")
+            for key in sorted(rewritten):
+                print(f"  {key}: {len(rewritten[key])} writes")
+
+
+def sign(key, msg):
+    return hmac.new(key, msg.encode(), hashlib.sha256).digest()
+
+
+def canonical_query(query):
+    params = urllib.parse.parse_qsl(query, keep_blank_values=True)
+    quote = lambda v: urllib.parse.quote(v, safe="-_.~")
+    return "&".join(f"{quote(k)}={quote(v)}" for k, v in sorted(params))
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+    server_version = "S3StandIn/1.0"
+
+    # ----- plumbing -----
+
+    def log_message(self, fmt, *args):
+        if not self.server.opts.quiet:
+            super().log_message(fmt, *args)
+
+    def throttle(self, nbytes):
+        bandwidth = self.server.opts.bandwidth
+        if bandwidth > 0:
+            time.sleep(nbytes / bandwidth)
+
+    def read_body(self):
+        length = int(self.headers.get("Content-Length", 0))
+        chunks = []
+        while length > 0:
+            chunk = self.rfile.read(min(length, 8192))
+            if not chunk:
+                break
+            self.throttle(len(chunk))
+            chunks.append(chunk)
+            length -= len(chunk)
+        return b"".join(chunks)
+
+    def respond(self, status, body=b"", headers=None):
+        opts = self.server.opts
+        delay = opts.latency + random.uniform(0, opts.jitter)
+        if delay > 0:
+            time.sleep(delay / 1000.0)
+        self.send_response(status)
+        for name, value in (headers or {}).items():
+            self.send_header(name, value)
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        if body and self.command != "HEAD":
+            for i in range(0, len(body), 8192):
+                self.throttle(min(8192, len(body) - i))
+                self.wfile.write(body[i:i + 8192])
+        self.server.stats.record(self.command, status, (time.monotonic() - self.started) * 1000)
+
+    def error(self, status, code, message):
+        body = (f"<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<Error><Code>{code}</Code>"
+                f"<Message>{message}</Message></Error>").encode()
+        self.respond(status, body, {"Content-Type": "application/xml"})
+
+    def object_path(self, key):
+        key = urllib.parse.unquote(key).lstrip("/")
+        path = os.path.normpath(os.path.join(self.server.opts.data, key))
+        if not path.startswith(os.path.abspath(self.server.opts.data)):
+            return None
+        return path
+
+    # ----- SigV4 -----
+
+    def verify(self, body):
+        opts = self.server.opts
+        if opts.no_verify:
+            return None
+        match = AUTH_RE.fullmatch(self.headers.get("Authorization", ""))
+        if not match:
+            return "missing or malformed Authorization header"
+        access_key, date, region, signed_headers, signature = match.groups()
+        if access_key != opts.access_key:
+            return "unknown access key"
+
+        payload_hash = self.headers.get("x-amz-content-sha256", "")
+        if payload_hash != "UNSIGNED-PAYLOAD" and payload_hash != hashlib.sha256(body).hexdigest():
+            return "x-amz-content-sha256 does not match the body"
+
+        url = urllib.parse.urlsplit(self.path)
+        names = signed_headers.split(";")
+        canonical_headers = "".join(f"{n}:{(self.headers.get(n) or '').strip()}\n" for n in names)
+        canonical_request = "\n".join([self.command, url.path, canonical_query(url.query),
+                                       canonical_headers, signed_headers, payload_hash])
+
+        amz_date = self.headers.get("x-amz-date", "")
+        scope = f"{date}/{region}/s3/aws4_request"
+        string_to_sign = "\n".join(["AWS4-HMAC-SHA256", amz_date, scope,
+                                    hashlib.sha256(canonical_request.encode()).hexdigest()])
+        key = sign(("AWS4" + opts.secret_key).encode(), date)
+        for part in (region, "s3", "aws4_request"):
+            key = sign(key, part)
+        expected = hmac.new(key, string_to_sign.encode(), hashlib.sha256).hexdigest()
+        if not hmac.compare_digest(expected, signature):
+            if opts.verbose:
+                print("canonical request:\n" + canonical_request)
+            return "signature mismatch"
+        return None
+
+    def admit(self):
+        """Common checks; returns (body, query) or None after responding."""
+        self.started = time.monotonic()
+        body = self.read_body() if self.command in ("PUT", "POST") else b""
+        if random.random() < self.server.opts.fail_rate:
+            self.error(503, "SlowDown", "Injected failure")
+            return None
+        is_form = self.headers.get("Content-Type", "").startswith("multipart/form-data")
+        problem = None if is_form else self.verify(body)
+        if problem:
+            self.error(403, "SignatureDoesNotMatch", problem)
+            return None
+        return body, dict(urllib.parse.parse_qsl(urllib.parse.urlsplit(self.path).query, keep_blank_values=True))
+
+    # ----- objects -----
+
+    def store(self, key, data):
+        path = self.object_path(key)
+        if path is None:
+            return None
+        os.makedirs(os.path.dirname(path), exist_ok=True)
+        with open(path, "wb") as f:
+            f.write(data)
+        return '"' + hashlib.md5(data).hexdigest() + '"'
+
+    def do_PUT(self):
+        admitted = self.admit()
+        if not admitted:
+            return
+        body, query = admitted
+        key = urllib.parse.urlsplit(self.path).path
+
+        if "uploadId" in query:
+            upload = self.server.uploads.get(query["uploadId"])
+            if upload is None or upload["key"] != key:
+                return self.error(404, "NoSuchUpload", "Unknown upload id")
+            upload["parts"][int(query.get("partNumber", 0))] = body
+            if random.random() < self.server.opts.lose_rate:
+                return self.lose()
+            return self.respond(200, headers={"ETag": '"' + hashlib.md5(body).hexdigest() + '"'})
+
+        opts = self.server.opts
+        if body and random.random() < opts.corrupt_rate:
+            body = bytes([body[0] ^ 0xff]) + body[1:]
+        content_md5 = self.headers.get("Content-MD5")
+        if content_md5 is not None:
+            try:
+                expected = base64.b64decode(content_md5, validate=True)
+            except ValueError:
+                expected = b""
+            if len(expected) != 16:
+                return self.error(400, "InvalidDigest", "The Content-MD5 you specified was invalid.")
+            if hashlib.md5(body).digest() != expected:
+                return self.error(400, "BadDigest", "The Content-MD5 you specified did not match what we received.")
+
+        etag = self.store(key, body)
+        if etag is None:
+            return self.error(400, "InvalidKey", "Bad key")
+        self.server.stats.record_write(key, etag)
+        if random.random() < opts.lose_rate:
+            return self.lose()
+        self.respond(200, headers={"ETag": etag})
+
+    def lose(self):
+        # Stored, but the client never hears about it
+        self.close_connection = True
+        self.server.stats.record(self.command, "lost", (time.monotonic() - self.started) * 1000)
+
+    def do_GET(self):
+        admitted = self.admit()
+        if not admitted:
+            return
+        path = self.object_path(urllib.parse.urlsplit(self.path).path)
+        if path is None or not os.path.isfile(path):
+            return self.error(404, "NoSuchKey", "The specified key does not exist.")
+        with open(path, "rb") as f:
+            data = f.read()
+        etag = '"' + hashlib.md5(data).hexdigest() + '"'
+        if self.headers.get("If-None-Match") == etag:
+            return self.respond(304, headers={"ETag": etag})
+        self.respond(200, data, {"ETag": etag, "Content-Type": "application/octet-stream"})
+
+    do_HEAD = do_GET
+
+    def do_DELETE(self):
+        admitted = self.admit()
+        if not admitted:
+            return
+        _, query = admitted
+        if "uploadId" in query:
+            self.server.uploads.pop(query["uploadId"], None)
+            return self.respond(204)
+        path = self.object_path(urllib.parse.urlsplit(self.path).path)
+        if path and os.path.isfile(path):
+            os.remove(path)
+        self.respond(204)
+
+    def do_POST(self):
+        admitted = self.admit()
+        if not admitted:
+            return
+        body, query = admitted
+        key = urllib.parse.urlsplit(self.path).path
+
+        if self.headers.get("Content-Type", "").startswith("multipart/form-data"):
+            return self.post_policy_upload(body)
+
+        if "uploads" in query:
+            upload_id = uuid.uuid4().hex
+            self.server.uploads[upload_id] = {"key": key, "parts": {}}
+            xml = (f"<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<InitiateMultipartUploadResult>"
+                   f"<Key>{key.lstrip('/')}</Key><UploadId>{upload_id}</UploadId>"
+                   f"</InitiateMultipartUploadResult>").encode()
+            return self.respond(200, xml, {"Content-Type": "application/xml"})
+
+        if "uploadId" in query:
+            xml = self.server.completed.get(query["uploadId"])
+            if xml is None:
+                upload = self.server.uploads.get(query["uploadId"])
+                if upload is None:
+                    return self.error(404, "NoSuchUpload", "Unknown upload id")
+                numbers = [int(n) for n in re.findall(rb"<PartNumber>(\d+)</PartNumber>", body)]
+                if any(n not in upload["parts"] for n in numbers):
+                    return self.error(400, "InvalidPart", "Part missing")
+                del self.server.uploads[query["uploadId"]]
+                data = b"".join(upload["parts"][n] for n in numbers)
+                etag = self.store(key, data)
+                self.server.stats.record_write(key, etag)
+                xml = (f"<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<CompleteMultipartUploadResult>"
+                       f"<Key>{key.lstrip('/')}</Key><ETag>{etag}</ETag>"
+                       f"</CompleteMultipartUploadResult>").encode()
+                self.server.completed[query["uploadId"]] = xml
+            return self.respond(200, xml, {"Content-Type": "application/xml"})
+
+        self.error(400, "InvalidRequest", "Unsupported POST")
+
+    def post_policy_upload(self, body):
+        boundary = self.headers["Content-Type"].split("boundary=", 1)[-1].encode()
+        fields, data = {}, None
+        for part in body.split(b"--" + boundary):
+            head, _, value = part.partition(b"\r\n\r\n")
+            name = re.search(rb'name="([^"]+)"', head)
+            if not name:
+                continue
+            value = value[:-2] if value.endswith(b"\r\n") else value
+            if name.group(1) == b"file":
+                data = value
+            else:
+                fields[name.group(1).decode()] = value.decode()
+        if data is None or "key" not in fields:
+            return self.error(400, "InvalidArgument", "POST requires key and file")
+        problem = None if self.server.opts.no_verify else self.verify_policy(fields, len(data))
+        if problem:
+            return self.error(403, "AccessDenied", f"Invalid according to Policy: {problem}")
+        etag = self.store(fields["key"], data)
+        self.respond(204, headers={"ETag": etag})
+
+
+    def verify_policy(self, fields, size):
+        """Returns None when the form's policy allows this upload, else why not."""
+        opts = self.server.opts
+        try:
+            access_key, date, region, _, _ = fields["x-amz-credential"].split("/")
+            policy = fields["policy"]
+            signature = fields["x-amz-signature"]
+        except (KeyError, ValueError):
+            return "missing policy, credential or signature"
+        if access_key != opts.access_key:
+            return "unknown access key"
+        key = sign(("AWS4" + opts.secret_key).encode(), date)
+        for part in (region, "s3", "aws4_request"):
+            key = sign(key, part)
+        if not hmac.compare_digest(hmac.new(key, policy.encode(), hashlib.sha256).hexdigest(), signature):
+            return "signature mismatch"
+
+        document = json.loads(base64.b64decode(policy))
+        expiration = calendar.timegm(time.strptime(document["expiration"][:19], "%Y-%m-%dT%H:%M:%S"))
+        if expiration < time.time():
+            return "policy expired"
+
+        # Every field needs a condition; missing fields compare as ""
+        values = {name.lower(): value for name, value in fields.items()}
+        covered = {"policy", "x-amz-signature", "file"}
+        for condition in document["conditions"]:
+            if isinstance(condition, dict):
+                condition = ["eq", "$" + next(iter(condition)), next(iter(condition.values()))]
+            op = condition[0].lower()
+            if op == "content-length-range":
+                if not condition[1] <= size <= condition[2]:
+                    return f"size {size} outside {condition[1:]}"
+                continue
+            name = condition[1].lstrip("$").lower()
+            covered.add(name)
+            if name == "bucket":
+                continue
+            value = values.get(name, "")
+            if op == "eq" and value != condition[2] or op == "starts-with" and not value.startswith(condition[2]):
+                return f"{condition} failed for {value!r}"
+        uncovered = [name for name in values if name not in covered and not name.startswith("x-ignore-")]
+        return f"no condition for {uncovered}" if uncovered else None
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--host", default="0.0.0.0")
+    parser.add_argument("--port", type=int, default=9000)
+    parser.add_argument("--data", default="s3-standin-data", help="directory objects are stored in")
+    parser.add_argument("--access-key", default=os.environ.get("AWS_ACCESS_KEY_ID", ""))
+    parser.add_argument("--secret-key", default=os.environ.get("AWS_SECRET_ACCESS_KEY", ""))
+    parser.add_argument("--no-verify", action="store_true", help="accept any signature")
+    parser.add_argument("--latency", type=float, default=0, help="added latency per response (ms)")
+    parser.add_argument("--jitter", type=float, default=0, help="random extra latency, up to this (ms)")
+    parser.add_argument("--bandwidth", type=float, default=0, help="body throughput limit (bytes/s)")
+    parser.add_argument("--fail-rate", type=float, default=0, help="fraction of requests answered 503")
+    parser.add_argument("--corrupt-rate", type=float, default=0, help="fraction of PUT bodies damaged in transit")
+    parser.add_argument("--lose-rate", type=float, default=0, help="fraction of PUTs stored without a response")
+    parser.add_argument("--seed", type=int, help="random seed for the injected faults")
+    parser.add_argument("--write-log", help="file to append \"<key> <etag>\" to for every stored object")
+    parser.add_argument("--quiet", action="store_true")
+    parser.add_argument("--verbose", action="store_true", help="print canonical requests on mismatch")
+    opts = parser.parse_args()
+    opts.data = os.path.abspath(opts.data)
+    os.makedirs(opts.data, exist_ok=True)
+
+    server = ThreadingHTTPServer((opts.host, opts.port), Handler)
+    server.opts = opts
+    server.stats = Stats(opts.write_log)
+    server.uploads = {}
+    server.completed = {}
+    if opts.seed is not None:
+        random.seed(opts.seed)
+    print(f"S3 stand-in on {opts.host}:{opts.port}, storing in {opts.data}", flush=True)
+
+    def stop(*_):
+        raise KeyboardInterrupt
+    signal.signal(signal.SIGTERM, stop)
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+    server.stats.report()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,190 @@
+#pragma once
+
+// Host helpers for the checks that run against the S3 stand-in
+// (tools/s3_standin.py): start it on a free port with a scratch data
+// directory, and a minimal blocking HTTP/1.1 client, one connection per
+// request. POSIX only; run the checks from the repository root.
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+class StandIn {
+    pid_t _pid = -1;
+
+    static int freePort() {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t len = sizeof(addr);
+        int port = -1;
+        if (bind(fd, (sockaddr*)&addr, sizeof(addr)) == 0 && getsockname(fd, (sockaddr*)&addr, &len) == 0) {
+            port = ntohs(addr.sin_port);
+        }
+        close(fd);
+        return port;
+    }
+
+    bool Listening() const {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        bool ok = connect(fd, (sockaddr*)&addr, sizeof(addr)) == 0;
+        close(fd);
+        return ok;
+    }
+
+public:
+    int port = -1;
+    std::string data;
+
+    ~StandIn() { Stop(); }
+
+    /// @brief Start with the given extra options; the data directory is kept across restarts
+    bool Start(const std::vector<std::string>& options = {}) {
+        if (data.empty()) {
+            char dir[] = "/tmp/s3-standin-XXXXXX";
+            if (!mkdtemp(dir)) {
+                return false;
+            }
+            data = dir;
+        }
+        port = freePort();
+        std::vector<std::string> args = {"python3", "tools/s3_standin.py", "--host", "127.0.0.1",
+                                          "--port", std::to_string(port), "--data", data, "--quiet"};
+        args.insert(args.end(), options.begin(), options.end());
+
+        fflush(stdout);
+        _pid = fork();
+        if (_pid == 0) {
+            freopen("/dev/null", "w", stdout);
+            std::vector<char*> argv;
+            for (std::string& a : args) {
+                argv.push_back(&a[0]);
+            }
+            argv.push_back(nullptr);
+            execvp(argv[0], argv.data());
+            _exit(127);
+        }
+        for (int i = 0; i < 100; i++) {
+            if (Listening()) {
+                return true;
+            }
+            int status;
+            if (waitpid(_pid, &status, WNOHANG) == _pid) {
+                _pid = -1;
+                return false;
+            }
+            usleep(50000);
+        }
+        return false;
+    }
+
+    void Stop() {
+        if (_pid > 0) {
+            kill(_pid, SIGTERM);
+            waitpid(_pid, nullptr, 0);
+            _pid = -1;
+        }
+    }
+
+    /// @brief Stored object, empty when missing
+    std::string Object(const std::string& key) const {
+        std::ifstream in(data + key, std::ios::binary);
+        return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    }
+};
+
+struct HttpResponse {
+    int status = -1;
+    std::map<std::string, std::string> headers;     // names in lower case
+    std::string body;
+};
+
+/// @brief One request to 127.0.0.1:port. Returns the status, -1 when the
+/// connection fails or closes before a complete response.
+inline int httpRequest(int port, const std::string& method, const std::string& target,
+                       const std::vector<std::pair<std::string, std::string>>& headers,
+                       const void* body, size_t len, HttpResponse& response) {
+    response = HttpResponse();
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    timeval timeout = {10, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    std::string request = method + " " + target + " HTTP/1.1\r\nHost: 127.0.0.1:" + std::to_string(port) +
+                          "\r\nConnection: close\r\nContent-Length: " + std::to_string(len) + "\r\n";
+    for (const auto& h : headers) {
+        request += h.first + ": " + h.second + "\r\n";
+    }
+    request += "\r\n";
+    request.append((const char*)body, body ? len : 0);
+    for (size_t sent = 0; sent < request.size();) {
+        ssize_t n = send(fd, request.data() + sent, request.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) {
+            close(fd);
+            return -1;
+        }
+        sent += n;
+    }
+
+    std::string raw;
+    char buf[8192];
+    for (ssize_t n; (n = recv(fd, buf, sizeof(buf), 0)) > 0;) {
+        raw.append(buf, n);
+    }
+    close(fd);
+
+    size_t end = raw.find("\r\n\r\n");
+    if (end == std::string::npos || raw.compare(0, 5, "HTTP/") != 0) {
+        return -1;
+    }
+    size_t line = raw.find("\r\n");
+    for (size_t pos = line + 2; pos < end;) {
+        size_t next = raw.find("\r\n", pos);
+        std::string header = raw.substr(pos, next - pos);
+        size_t colon = header.find(':');
+        if (colon != std::string::npos) {
+            std::string name = header.substr(0, colon);
+            for (char& c : name) {
+                c = (char)tolower((unsigned char)c);
+            }
+            size_t value = header.find_first_not_of(' ', colon + 1);
+            response.headers[name] = value == std::string::npos ? "" : header.substr(value);
+        }
+        pos = next + 2;
+    }
+    response.body = raw.substr(end + 4);
+    // A HEAD response has the object's Content-Length but no body
+    auto length = response.headers.find("content-length");
+    if (method != "HEAD" && length != response.headers.end() &&
+        response.body.size() < strtoul(length->second.c_str(), nullptr, 10)) {
+        return -1;
+    }
+    response.status = atoi(raw.c_str() + raw.find(' ') + 1);
+    return response.status;
+}
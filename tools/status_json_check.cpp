@@ -0,0 +1,475 @@
+// Status JSON writer check (status_writer.cpp). The S3 status document used
+// to be built by String concatenation (generateStatusJSON) and minified with
+// jsonMinify for gzip uploads; JsonBufferWriter has to produce the same bytes
+// without allocating:
+//
+//   identical  1000 status documents with random values: pretty output equals
+//              the String-built layout (reference port below, numbers through
+//              dtostrf like String(value, decimals)), compact output equals
+//              the pretty one after jsonMinify
+//   alloc      no heap allocation while writing them (tools/alloc_count.h)
+//   edges      NaN/inf as null, tiny negatives, escaped text, a document
+//              over the buffer refused without writing past it, nesting
+//              deeper than STATUS_WRITER_MAX_DEPTH refused
+//
+// Exits 1 on any failure.
+//
+// Build:  g++ -std=c++17 -O2 -I include -o status_json_check tools/status_json_check.cpp src/common/status_writer.cpp src/common/gzip.cpp
+// Usage:  status_json_check
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include "gzip.h"
+#include "status_writer.h"
+#include "alloc_count.h"
+
+#define SAMPLES 1000
+
+static int failures = 0;
+
+static void check(bool ok, const char* scenario, const char* what) {
+    printf("%s %-9s %s\n", ok ? "ok  " : "FAIL", scenario, what);
+    failures += !ok;
+}
+
+// ===== Reference: the String-built document =====
+
+// arduino-esp32 dtostrf (stdlib_noniso.c), which String(double, decimals)
+// calls with width decimals + 2
+static std::string dtostrf(double number, int width, unsigned int prec) {
+    char s[400];
+    if (std::isnan(number)) {
+        return "nan";
+    }
+    if (std::isinf(number)) {
+        return "inf";
+    }
+    bool negative = false;
+    char* out = s;
+    int fillme = width;
+    if (prec > 0) {
+        fillme -= (prec + 1);
+    }
+    if (number < 0.0) {
+        negative = true;
+        fillme--;
+        number = -number;
+    }
+    double rounding = 2.0;
+    for (uint32_t i = 0; i < prec; ++i) {
+        rounding *= 10.0;
+    }
+    rounding = 1.0 / rounding;
+    number += rounding;
+    double tenpow = 1.0;
+    int digitcount = 1;
+    while (number >= 10.0 * tenpow) {
+        tenpow *= 10.0;
+        digitcount++;
+    }
+    number /= tenpow;
+    fillme -= digitcount;
+    while (fillme-- > 0) {
+        *out++ = ' ';
+    }
+    if (negative) {
+        *out++ = '-';
+    }
+    digitcount += prec;
+    int8_t digit = 0;
+    while (digitcount-- > 0) {
+        digit = (int8_t)number;
+        if (digit > 9) {
+            digit = 9;
+        }
+        *out++ = (char)('0' | digit);
+        if ((digitcount == (int)prec) && (prec > 0)) {
+            *out++ = '.';
+        }
+        number -= digit;
+        number *= 10.0;
+    }
+    *out = 0;
+    return s;
+}
+
+static std::string String(double value, int decimals = 2) {
+    return dtostrf(value, decimals + 2, decimals);
+}
+
+static std::string String(float value, int decimals = 2) {
+    return String((double)value, decimals);
+}
+
+static std::string String(int64_t value) {
+    return std::to_string(value);
+}
+
+static std::string String(const char* value) {
+    return value;
+}
+
+/// @brief Values behind one status document
+struct Sample {
+    char device[24];
+    char timestamp[24];
+    uint32_t uptime;
+    bool safeMode;
+    int bootAttempts;
+    double lux;
+    int aeLevel;
+    float temperature, humidity, effective, expected;
+    bool dhtWorking;
+    bool catPresent;
+    bool motionSeen;
+    uint32_t sinceMotion, presenceTimeout;
+    bool blanketOn, blanketOverride;
+    bool camera;
+    float brightness, contrast, noise, over, quality, sharpness, under;
+    bool isBright, isDark;
+    bool wifi;
+    char ssid[33];
+    int rssi;
+    int framesize, jpegQuality, throughput;
+    uint32_t hits, misses, avgLookup;
+    uint32_t attempts, retries, failed;
+    float budget;
+    bool wifiOverride;
+    uint32_t heapFree, heapSize, heapMin, psramFree, psramSize;
+    float chipTemperature;
+    uint32_t nextPhoto, sincePhoto;
+};
+
+static const char* boolText(bool value) {
+    return value ? "true" : "false";
+}
+
+// generateStatusJSON as it was, fields of a board with DHT, PIR and relay
+static std::string reference(const Sample& s) {
+    std::string json = "{\n";
+    json += "  \"device\": \"" + String(s.device) + "\",\n";
+    json += "  \"timestamp\": \"" + String(s.timestamp) + "\",\n";
+    json += "  \"uptime_seconds\": " + String((int64_t)s.uptime) + ",\n";
+    json += "  \"mode\": \"" + String(s.safeMode ? "SAFE_MODE" : "NORMAL") + "\",\n";
+    json += "  \"boot_attempts\": " + String((int64_t)s.bootAttempts) + ",\n";
+    json += "  \"max_boot_attempts\": " + String((int64_t)3) + ",\n";
+    json += "  \"lux\": " + String(s.lux) + ",\n";
+    json += "  \"ae_level\": " + String((int64_t)s.aeLevel) + ",\n";
+    json += "  \"temperature_celsius\": " + String(s.temperature, 1) + ",\n";
+    json += "  \"humidity_percent\": " + String(s.humidity, 1) + ",\n";
+    json += "  \"dht22_sensor_working\": " + String(boolText(s.dhtWorking)) + ",\n";
+    json += "  \"effective_temperature_celsius\": " + String(s.effective, 1) + ",\n";
+    json += "  \"expected_temperature_celsius\": " + String(s.expected, 1) + ",\n";
+    json += "  \"using_fallback_temperature\": " + String(boolText(s.effective != s.temperature)) + ",\n";
+    json += "  \"cat_present\": " + String(boolText(s.catPresent)) + ",\n";
+    if (s.motionSeen) {
+        json += "  \"seconds_since_last_motion\": " + String((int64_t)s.sinceMotion) + ",\n";
+        if (s.catPresent) {
+            json += "  \"presence_timeout_seconds\": " + String((int64_t)s.presenceTimeout) + ",\n";
+        }
+    }
+    json += "  \"blanket_on\": " + String(boolText(s.blanketOn)) + ",\n";
+    json += "  \"blanket_manual_override\": " + String(boolText(s.blanketOverride)) + ",\n";
+    json += "  \"camera_available\": " + String(boolText(s.camera)) + ",\n";
+    json += "  \"image_quality_metrics\": {\n"
+            "    \"brightness\": " + String(s.brightness) + ",\n"
+            "    \"contrast\": " + String(s.contrast) + ",\n"
+            "    \"isBright\": " + String((int64_t)s.isBright) + ",\n"
+            "    \"isDark\": " + String((int64_t)s.isDark) + ",\n"
+            "    \"noiseLevel\": " + String(s.noise) + ",\n"
+            "    \"overexposure\": " + String(s.over) + ",\n"
+            "    \"qualityScore\": " + String(s.quality) + ",\n"
+            "    \"sharpness\": " + String(s.sharpness) + ",\n"
+            "    \"underexposure\": " + String(s.under) + "\n"
+            "  },\n";
+    json += "  \"wifi_connected\": " + String(boolText(s.wifi)) + ",\n";
+    if (s.wifi) {
+        json += "  \"wifi_ssid\": \"" + String(s.ssid) + "\",\n";
+        json += "  \"wifi_rssi\": \"" + String((int64_t)s.rssi) + "\",\n";
+    }
+    json += "  \"rate_control\": {\n"
+            "    \"framesize\": " + String((int64_t)s.framesize) + ",\n"
+            "    \"quality\": " + String((int64_t)s.jpegQuality) + ",\n"
+            "    \"throughput_bps\": " + String((int64_t)s.throughput) + "\n"
+            "  },\n";
+    json += "  \"dns\": {\n"
+            "    \"hits\": " + String((int64_t)s.hits) + ",\n"
+            "    \"misses\": " + String((int64_t)s.misses) + ",\n"
+            "    \"avg_lookup_ms\": " + String((int64_t)s.avgLookup) + "\n"
+            "  },\n";
+    json += "  \"uploads\": {\n"
+            "    \"attempts\": " + String((int64_t)s.attempts) + ",\n"
+            "    \"retries\": " + String((int64_t)s.retries) + ",\n"
+            "    \"failed\": " + String((int64_t)s.failed) + ",\n"
+            "    \"retry_budget\": " + String(s.budget, 1) + "\n"
+            "  },\n";
+    json += "  \"wifi_manual_override\": " + String(boolText(s.wifiOverride)) + ",\n";
+    json += "  \"heap_free_bytes\": " + String((int64_t)s.heapFree) + ",\n";
+    json += "  \"heap_size_bytes\": " + String((int64_t)s.heapSize) + ",\n";
+    json += "  \"heap_min_free_bytes\": " + String((int64_t)s.heapMin) + ",\n";
+    json += "  \"psram_free_bytes\": " + String((int64_t)s.psramFree) + ",\n";
+    json += "  \"psram_size_bytes\": " + String((int64_t)s.psramSize) + ",\n";
+    json += "  \"chip_temperature\": " + String(s.chipTemperature);
+    if (s.camera) {
+        json += ",\n";
+        json += "  \"next_scheduled_photo_minutes\": " + String((int64_t)s.nextPhoto) + ",\n";
+        json += "  \"time_since_last_photo_minutes\": " + String((int64_t)s.sincePhoto);
+    }
+    json += "\n}";
+    return json;
+}
+
+// ===== Same document through a StatusSink (writeStatusFields order) =====
+
+static void writeSample(StatusSink& out, const Sample& s) {
+    out.Text("device", s.device);
+    out.Text("timestamp", s.timestamp);
+    out.Int("uptime_seconds", s.uptime);
+    out.Text("mode", s.safeMode ? "SAFE_MODE" : "NORMAL");
+    out.Int("boot_attempts", s.bootAttempts);
+    out.Int("max_boot_attempts", 3);
+    out.Float("lux", s.lux, 2);
+    out.Int("ae_level", s.aeLevel);
+    out.Float("temperature_celsius", s.temperature, 1);
+    out.Float("humidity_percent", s.humidity, 1);
+    out.Bool("dht22_sensor_working", s.dhtWorking);
+    out.Float("effective_temperature_celsius", s.effective, 1);
+    out.Float("expected_temperature_celsius", s.expected, 1);
+    out.Bool("using_fallback_temperature", s.effective != s.temperature);
+    out.Bool("cat_present", s.catPresent);
+    if (s.motionSeen) {
+        out.Int("seconds_since_last_motion", s.sinceMotion);
+        if (s.catPresent) {
+            out.Int("presence_timeout_seconds", s.presenceTimeout);
+        }
+    }
+    out.Bool("blanket_on", s.blanketOn);
+    out.Bool("blanket_manual_override", s.blanketOverride);
+    out.Bool("camera_available", s.camera);
+    out.BeginObject("image_quality_metrics");
+    out.Float("brightness", s.brightness, 2);
+    out.Float("contrast", s.contrast, 2);
+    out.Int("isBright", s.isBright);
+    out.Int("isDark", s.isDark);
+    out.Float("noiseLevel", s.noise, 2);
+    out.Float("overexposure", s.over, 2);
+    out.Float("qualityScore", s.quality, 2);
+    out.Float("sharpness", s.sharpness, 2);
+    out.Float("underexposure", s.under, 2);
+    out.EndObject();
+    out.Bool("wifi_connected", s.wifi);
+    if (s.wifi) {
+        char rssi[8];
+        snprintf(rssi, sizeof(rssi), "%d", s.rssi);
+        out.Text("wifi_ssid", s.ssid);
+        out.Text("wifi_rssi", rssi);
+    }
+    out.BeginObject("rate_control");
+    out.Int("framesize", s.framesize);
+    out.Int("quality", s.jpegQuality);
+    out.Int("throughput_bps", s.throughput);
+    out.EndObject();
+    out.BeginObject("dns");
+    out.Int("hits", s.hits);
+    out.Int("misses", s.misses);
+    out.Int("avg_lookup_ms", s.avgLookup);
+    out.EndObject();
+    out.BeginObject("uploads");
+    out.Int("attempts", s.attempts);
+    out.Int("retries", s.retries);
+    out.Int("failed", s.failed);
+    out.Float("retry_budget", s.budget, 1);
+    out.EndObject();
+    out.Bool("wifi_manual_override", s.wifiOverride);
+    out.Int("heap_free_bytes", s.heapFree);
+    out.Int("heap_size_bytes", s.heapSize);
+    out.Int("heap_min_free_bytes", s.heapMin);
+    out.Int("psram_free_bytes", s.psramFree);
+    out.Int("psram_size_bytes", s.psramSize);
+    out.Float("chip_temperature", s.chipTemperature, 2);
+    if (s.camera) {
+        out.Int("next_scheduled_photo_minutes", s.nextPhoto);
+        out.Int("time_since_last_photo_minutes", s.sincePhoto);
+    }
+}
+
+static Sample randomSample(std::mt19937& rng) {
+    auto real = [&](double lo, double hi) { return std::uniform_real_distribution<double>(lo, hi)(rng); };
+    auto whole = [&](uint32_t lo, uint32_t hi) { return std::uniform_int_distribution<uint32_t>(lo, hi)(rng); };
+    auto coin = [&]() { return whole(0, 1) == 1; };
+    // Values on a 0.005 / 0.05 grid hit the rounding ties
+    auto grid = [&](double lo, double hi, double step) { return std::round(real(lo, hi) / step) * step; };
+
+    Sample s = {};
+    snprintf(s.device, sizeof(s.device), "shelter-%u", whole(0, 99));
+    snprintf(s.timestamp, sizeof(s.timestamp), "2026-10-%02uT%02u:%02u:%02uZ", whole(1, 31), whole(0, 23),
+             whole(0, 59), whole(0, 59));
+    s.uptime = whole(0, 4000000);
+    s.safeMode = coin();
+    s.bootAttempts = whole(0, 3);
+    s.lux = coin() ? real(0, 120000) : grid(0, 10, 0.005);
+    s.aeLevel = (int)whole(0, 4) - 2;
+    s.temperature = coin() ? real(-30, 45) : grid(-5, 5, 0.05);
+    s.humidity = real(0, 100);
+    s.dhtWorking = coin();
+    s.effective = coin() ? s.temperature : real(-30, 45);
+    s.expected = real(-30, 45);
+    s.catPresent = coin();
+    s.motionSeen = coin();
+    s.sinceMotion = whole(0, 90000);
+    s.presenceTimeout = whole(0, 1800);
+    s.blanketOn = coin();
+    s.blanketOverride = coin();
+    s.camera = coin();
+    s.brightness = real(0, 255);
+    s.contrast = real(0, 128);
+    s.noise = coin() ? real(0, 50) : grid(0, 1, 0.005);
+    s.over = real(0, 100);
+    s.quality = real(0, 100);
+    s.sharpness = real(0, 500);
+    s.under = coin() ? real(0, 100) : 0.0f;
+    s.isBright = coin();
+    s.isDark = coin();
+    s.wifi = coin();
+    snprintf(s.ssid, sizeof(s.ssid), "cats-%u", whole(0, 9999));
+    s.rssi = -(int)whole(30, 95);
+    s.framesize = whole(0, 13);
+    s.jpegQuality = whole(4, 63);
+    s.throughput = whole(0, 5000000);
+    s.hits = whole(0, 100000);
+    s.misses = whole(0, 1000);
+    s.avgLookup = whole(0, 900);
+    s.attempts = whole(0, 100000);
+    s.retries = whole(0, 5000);
+    s.failed = whole(0, 500);
+    s.budget = grid(0, 10, 0.05);
+    s.wifiOverride = coin();
+    s.heapFree = whole(20000, 300000);
+    s.heapSize = 327680;
+    s.heapMin = whole(10000, 200000);
+    s.psramFree = whole(0, 8388608);
+    s.psramSize = 8388608;
+    s.chipTemperature = real(20, 80);
+    s.nextPhoto = whole(0, 60);
+    s.sincePhoto = whole(0, 600);
+    return s;
+}
+
+static void checkIdentical() {
+    std::mt19937 rng(41);
+    static char pretty[STATUS_JSON_MAX];
+    static char compact[STATUS_JSON_MAX];
+    int prettySame = 0;
+    int compactSame = 0;
+    unsigned long allocations = 0;
+    bool shown = false;
+    for (int i = 0; i < SAMPLES; i++) {
+        Sample s = randomSample(rng);
+        size_t prettyLen;
+        size_t compactLen;
+        {
+            AllocationScope scope;
+            JsonBufferWriter writer(pretty, sizeof(pretty), true);
+            writeSample(writer, s);
+            prettyLen = writer.Finish();
+            JsonBufferWriter compactWriter(compact, sizeof(compact), false);
+            writeSample(compactWriter, s);
+            compactLen = compactWriter.Finish();
+            allocations += scope.Count();
+        }
+
+        std::string expected = reference(s);
+        if (std::string(pretty, prettyLen) == expected) {
+            ++prettySame;
+        } else if (!shown) {
+            shown = true;
+            size_t at = 0;
+            while (at < expected.size() && at < prettyLen && pretty[at] == expected[at]) {
+                ++at;
+            }
+            size_t from = at > 40 ? at - 40 : 0;
+            printf("     first difference at byte %zu:\n     expected ...%s\n     written  ...%.*s\n", at,
+                   expected.substr(from, 80).c_str(), (int)(prettyLen - from < 80 ? prettyLen - from : 80),
+                   pretty + from);
+        }
+        std::string minified = expected;
+        minified.resize(jsonMinify(&minified[0], minified.size()));
+        compactSame += std::string(compact, compactLen) == minified;
+    }
+    check(prettySame == SAMPLES, "identical", "pretty output equals the String-built document");
+    check(compactSame == SAMPLES, "identical", "compact output equals jsonMinify of it");
+    printf("     %-9s %lu allocations over %d documents\n", "alloc", allocations, SAMPLES);
+    check(allocations == 0, "alloc", "no allocation while writing");
+
+    unsigned long probe;
+    {
+        AllocationScope scope;
+        free(allocationProbe(64));
+        probe = scope.Count();
+    }
+    check(probe == 1, "alloc", "allocation counter sees malloc");
+}
+
+// One-field document, compact
+static std::string one(void (*write)(StatusSink&)) {
+    char buf[256];
+    JsonBufferWriter writer(buf, sizeof(buf), false);
+    write(writer);
+    size_t len = writer.Finish();
+    return std::string(buf, len);
+}
+
+static void checkEdges() {
+    check(one([](StatusSink& out) { out.Float("v", NAN, 2); }) == "{\"v\":null}", "edges", "NaN written as null");
+    check(one([](StatusSink& out) { out.Float("v", -INFINITY, 1); }) == "{\"v\":null}", "edges",
+          "-inf written as null");
+    check(one([](StatusSink& out) { out.Float("v", -0.001, 2); }) == "{\"v\":-0.00}", "edges",
+          "tiny negative keeps its sign, like String()");
+    check(one([](StatusSink& out) { out.Float("v", 1.999, 2); }) == "{\"v\":2.00}", "edges", "rounding carries");
+    check(one([](StatusSink& out) { out.Int("v", INT64_MIN); }) == "{\"v\":-9223372036854775808}", "edges",
+          "INT64_MIN");
+    check(one([](StatusSink& out) { out.Text("v", "a\"b\\c\n\x01"); }) == "{\"v\":\"a\\\"b\\\\c\\n\\u0001\"}",
+          "edges", "text escaped");
+    check(one([](StatusSink& out) { out.Text("v", nullptr); }) == "{\"v\":\"\"}", "edges", "null text empty");
+
+    char buf[64];
+    memset(buf, '#', sizeof(buf));
+    size_t len;
+    {
+        JsonBufferWriter writer(buf, 32, true);
+        writer.Text("device", "a name longer than the buffer holds");
+        len = writer.Finish();
+    }
+    bool untouched = true;
+    for (size_t i = 32; i < sizeof(buf); i++) {
+        untouched &= buf[i] == '#';
+    }
+    check(len == 0 && buf[0] == '\0', "edges", "document over the buffer refused");
+    check(untouched, "edges", "nothing written past the buffer");
+
+    {
+        char deep[256];
+        JsonBufferWriter writer(deep, sizeof(deep), false);
+        for (int i = 0; i <= STATUS_WRITER_MAX_DEPTH; i++) {
+            writer.BeginObject("o");
+        }
+        len = writer.Finish();
+    }
+    check(len == 0, "edges", "nesting over STATUS_WRITER_MAX_DEPTH refused");
+}
+
+int main() {
+    checkIdentical();
+    checkEdges();
+
+    if (failures) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
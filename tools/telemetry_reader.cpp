@@ -0,0 +1,115 @@
+// Host-side reader for telemetry batches uploaded by the devices.
+//
+// Build:  g++ -std=c++17 -O2 -I include -o telemetry_reader tools/telemetry_reader.cpp src/common/gorilla.cpp
+// Usage:  telemetry_reader <batch.ctm> ...           summary per series
+//         telemetry_reader -c <batch.ctm> ...        CSV: time,series,value
+//
+// Several batches can be given in time order to get one continuous CSV.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "gorilla.h"
+#include "telemetry_format.h"
+
+static const char* SERIES_NAMES[TELEMETRY_SERIES_COUNT] = {
+    "temperature", "humidity", "lux", "motion", "blanket"};
+
+static std::string formatTime(uint32_t epoch) {
+    time_t t = epoch;
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    char buf[32];
+    strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm);
+    return buf;
+}
+
+static bool readBatch(const char* path, bool csv) {
+    std::ifstream in(path, std::ios::binary);
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (data.size() < sizeof(TelemetryHeader)) {
+        fprintf(stderr, "%s: too short\n", path);
+        return false;
+    }
+
+    TelemetryHeader header;
+    memcpy(&header, data.data(), sizeof(header));
+    if (memcmp(header.magic, TELEMETRY_MAGIC, 4) != 0 || header.version != TELEMETRY_VERSION) {
+        fprintf(stderr, "%s: not a telemetry batch (version %u)\n", path, header.version);
+        return false;
+    }
+    if (!csv) {
+        printf("%s: %s .. %s, %u series, %zu bytes\n", path, formatTime(header.startTime).c_str(),
+               formatTime(header.endTime).c_str(), header.seriesCount, data.size());
+    }
+
+    size_t pos = sizeof(header);
+    for (int s = 0; s < header.seriesCount; s++) {
+        TelemetrySeriesHeader series;
+        if (pos + sizeof(series) > data.size()) {
+            fprintf(stderr, "%s: truncated series header\n", path);
+            return false;
+        }
+        memcpy(&series, data.data() + pos, sizeof(series));
+        pos += sizeof(series);
+        if (pos + series.length > data.size()) {
+            fprintf(stderr, "%s: truncated series data\n", path);
+            return false;
+        }
+        const char* name = series.series < TELEMETRY_SERIES_COUNT ? SERIES_NAMES[series.series] : "unknown";
+
+        GorillaReader reader;
+        reader.Begin(data.data() + pos, series.length, series.count);
+        pos += series.length;
+
+        uint32_t time;
+        float value, minValue = 0, maxValue = 0;
+        double sum = 0;
+        uint16_t n = 0;
+        while (reader.Next(time, value)) {
+            if (csv) {
+                printf("%s,%s,%g\n", formatTime(time).c_str(), name, value);
+            }
+            minValue = n == 0 || value < minValue ? value : minValue;
+            maxValue = n == 0 || value > maxValue ? value : maxValue;
+            sum += value;
+            ++n;
+        }
+        if (n != series.count) {
+            fprintf(stderr, "%s: %s stream ended after %u of %u samples\n", path, name, n, series.count);
+        }
+        if (!csv) {
+            printf("  %-12s %5u samples %5u bytes (%.1f bits/sample)  min %g max %g avg %g\n", name, n,
+                   series.length, n ? 8.0 * series.length / n : 0.0, minValue, maxValue, n ? sum / n : 0.0);
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    bool csv = false;
+    int first = 1;
+    if (argc > 1 && strcmp(argv[1], "-c") == 0) {
+        csv = true;
+        first = 2;
+    }
+    if (first >= argc) {
+        fprintf(stderr, "usage: %s [-c] <batch.ctm> ...\n", argv[0]);
+        return 2;
+    }
+    if (csv) {
+        printf("time,series,value\n");
+    }
+    int status = 0;
+    for (int i = first; i < argc; i++) {
+        if (!readBatch(argv[i], csv)) {
+            status = 1;
+        }
+    }
+    return status;
+}
@@ -0,0 +1,106 @@
+// Host-side reader for time-lapse bundles uploaded by the cameras.
+//
+// Build:  g++ -std=c++17 -O2 -I include -o timelapse_reader tools/timelapse_reader.cpp
+// Usage:  timelapse_reader <bundle.ctl>                 list frames
+//         timelapse_reader <bundle.ctl> <dir>           extract every frame to <dir>
+//         timelapse_reader <bundle.ctl> <dir> <n>       extract frame n only
+//
+// Frames are written as frame_NNN_<timestamp>.jpg with the status JSON next to
+// them as frame_NNN_<timestamp>.json.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "timelapse_format.h"
+
+static bool writeFile(const std::string& path, const uint8_t* data, size_t len) {
+    std::ofstream out(path, std::ios::binary);
+    out.write(reinterpret_cast<const char*>(data), len);
+    return out.good();
+}
+
+static std::string formatTime(uint32_t epoch) {
+    time_t t = epoch;
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    char buf[32];
+    strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm);
+    return buf;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <bundle> [outdir [frame]]\n", argv[0]);
+        return 2;
+    }
+
+    std::ifstream in(argv[1], std::ios::binary);
+    if (!in) {
+        fprintf(stderr, "cannot open %s\n", argv[1]);
+        return 1;
+    }
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    TimelapseHeader header;
+    if (data.size() < sizeof(header)) {
+        fprintf(stderr, "%s: too short for a bundle header\n", argv[1]);
+        return 1;
+    }
+    memcpy(&header, data.data(), sizeof(header));
+    if (memcmp(header.magic, TIMELAPSE_MAGIC, sizeof(header.magic)) != 0) {
+        fprintf(stderr, "%s: not a time-lapse bundle\n", argv[1]);
+        return 1;
+    }
+    if (header.version != TIMELAPSE_VERSION) {
+        fprintf(stderr, "%s: unsupported version %u\n", argv[1], header.version);
+        return 1;
+    }
+
+    uint64_t indexEnd = (uint64_t)header.indexOffset + (uint64_t)header.frameCount * sizeof(TimelapseIndexEntry);
+    if (header.indexOffset < sizeof(header) || indexEnd > data.size()) {
+        fprintf(stderr, "%s: index out of range (truncated upload?)\n", argv[1]);
+        return 1;
+    }
+
+    std::vector<TimelapseIndexEntry> index(header.frameCount);
+    memcpy(index.data(), data.data() + header.indexOffset, header.frameCount * sizeof(TimelapseIndexEntry));
+
+    printf("%s: %u frames starting %s UTC\n", argv[1], header.frameCount, formatTime(header.startTime).c_str());
+
+    std::string outDir = argc >= 3 ? argv[2] : "";
+    long only = argc >= 4 ? strtol(argv[3], nullptr, 10) : -1;
+    int errors = 0;
+
+    for (uint32_t i = 0; i < header.frameCount; i++) {
+        const TimelapseIndexEntry& e = index[i];
+        uint64_t end = (uint64_t)e.offset + e.length + e.metaLength;
+        bool valid = e.offset >= sizeof(header) && end <= header.indexOffset;
+
+        printf("%3u  %s  offset %8u  jpeg %7u  meta %5u%s\n", i, formatTime(e.timestamp).c_str(),
+               e.offset, e.length, e.metaLength, valid ? "" : "  [out of range]");
+        if (!valid) {
+            ++errors;
+            continue;
+        }
+        if (outDir.empty() || (only >= 0 && (uint32_t)only != i)) {
+            continue;
+        }
+
+        char base[64];
+        snprintf(base, sizeof(base), "/frame_%03u_%u", i, e.timestamp);
+        std::string path = outDir + base;
+        const uint8_t* jpeg = data.data() + e.offset;
+        if (!writeFile(path + ".jpg", jpeg, e.length) ||
+            (e.metaLength > 0 && !writeFile(path + ".json", jpeg + e.length, e.metaLength))) {
+            fprintf(stderr, "cannot write %s\n", path.c_str());
+            return 1;
+        }
+    }
+
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,368 @@
+// Trace ring check (trace_ring.cpp), the part of Trace behind TRACE_SPAN:
+//
+//   ring      wrap-around keeps the newest TRACE_RING_EVENTS spans per core in
+//             order; cores are kept apart; 4 threads recording on one core
+//             (tasks preempting each other) never share a slot; Clear and
+//             Enable; Recent merges both cores by age, oldest first
+//   chrome    the dump is valid JSON with one "X" event per span (name, ts,
+//             dur, pid = core, tid = task), 32-bit start times unwrapped
+//             across the wrap; split dumps are self-contained documents that
+//             each fit the buffer, unsplit pieces join into one document
+//   overhead  a span as TraceSpan records it (recording check, two clock
+//             reads, Record) costs under 1 us; a disabled span is a load
+//
+// The device measures its own span cost with {"command": "trace",
+// "calibrate": true}. Exits 1 on any failure.
+//
+// Build:  g++ -std=c++17 -O2 -pthread -I include -o trace_check tools/trace_check.cpp src/common/trace_ring.cpp
+// Usage:  trace_check
+
+#include <time.h>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include "trace_ring.h"
+
+#define SPAN_BUDGET_NS 1000
+#define OVERHEAD_SPANS 1000000
+
+static int failures = 0;
+
+static void check(bool ok, const char* scenario, const char* what) {
+    printf("%s %-8s %s\n", ok ? "ok  " : "FAIL", scenario, what);
+    failures += !ok;
+}
+
+static int64_t nowUs() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+static void* task(uintptr_t id) {
+    return (void*)id;
+}
+
+// ===== JSON =====
+
+/// @brief Syntax check, enough for the dump: objects, arrays, strings, numbers
+class JsonSyntax {
+    const char* _p;
+
+    void Space() {
+        while (isspace((unsigned char)*_p)) {
+            ++_p;
+        }
+    }
+    bool String() {
+        if (*_p++ != '"') {
+            return false;
+        }
+        while (*_p && *_p != '"') {
+            if (*_p == '\\' && !*++_p) {
+                return false;
+            }
+            ++_p;
+        }
+        return *_p++ == '"';
+    }
+    bool Number() {
+        const char* start = _p;
+        strtod(_p, (char**)&_p);
+        return _p != start;
+    }
+    bool Value() {
+        Space();
+        if (*_p == '{') {
+            ++_p;
+            Space();
+            if (*_p == '}') {
+                ++_p;
+                return true;
+            }
+            do {
+                Space();
+                if (!String()) {
+                    return false;
+                }
+                Space();
+                if (*_p++ != ':' || !Value()) {
+                    return false;
+                }
+                Space();
+            } while (*_p == ',' && ++_p);
+            return *_p++ == '}';
+        }
+        if (*_p == '[') {
+            ++_p;
+            Space();
+            if (*_p == ']') {
+                ++_p;
+                return true;
+            }
+            do {
+                if (!Value()) {
+                    return false;
+                }
+                Space();
+            } while (*_p == ',' && ++_p);
+            return *_p++ == ']';
+        }
+        if (*_p == '"') {
+            return String();
+        }
+        return Number();
+    }
+
+public:
+    bool Valid(const std::string& json) {
+        _p = json.c_str();
+        if (!Value()) {
+            return false;
+        }
+        Space();
+        return *_p == '\0';
+    }
+};
+
+struct DumpedEvent {
+    std::string name;
+    long long ts;
+    unsigned dur;
+    int pid;
+    unsigned tid;
+};
+
+// The "X" events of one document, in order
+static std::vector<DumpedEvent> events(const std::string& json) {
+    std::vector<DumpedEvent> out;
+    for (size_t pos = 0; (pos = json.find("{\"name\":\"", pos)) != std::string::npos; ++pos) {
+        char name[64];
+        DumpedEvent e;
+        if (sscanf(json.c_str() + pos, "{\"name\":\"%63[^\"]\",\"ph\":\"X\",\"ts\":%lld,\"dur\":%u,\"pid\":%d,\"tid\":%u}",
+                   name, &e.ts, &e.dur, &e.pid, &e.tid) == 5) {
+            e.name = name;
+            out.push_back(e);
+        }
+    }
+    return out;
+}
+
+struct Dump {
+    std::vector<std::string> pieces;
+    size_t cap;
+};
+
+static void collect(const char* json, size_t len, void* ctx) {
+    static_cast<Dump*>(ctx)->pieces.push_back(std::string(json, len));
+}
+
+// ===== Scenarios =====
+
+static TraceRing rings;
+
+static void checkRing() {
+    // Core 0 wraps three times, core 1 holds a few
+    rings.Clear();
+    const uint32_t total = TRACE_RING_EVENTS * 3 + 7;
+    for (uint32_t i = 0; i < total; i++) {
+        rings.Record(0, task(1), "core0", 1000 + i * 10, 1000 + i * 10 + i % 7);
+    }
+    for (uint32_t i = 0; i < 5; i++) {
+        rings.Record(1, task(2), "core1", 1005 + i * 10, 1006 + i * 10);
+    }
+    check(rings.Held(0) == TRACE_RING_EVENTS && rings.Held(1) == 5, "ring", "held spans capped at the ring size");
+    check(rings.Spans() == total + 5, "ring", "every span counted");
+
+    static TraceEvent out[TRACE_RING_EVENTS];
+    static uint8_t cores[TRACE_RING_EVENTS];
+    uint32_t now = 1000 + total * 10;
+    size_t n = rings.Recent(now, out, cores, TRACE_RING_EVENTS);
+    bool newest = n == TRACE_RING_EVENTS;
+    bool ordered = true;
+    for (size_t i = 1; i < n; i++) {
+        ordered &= out[i - 1].startUs <= out[i].startUs;
+    }
+    // Core 1's spans are older than all that core 0 still holds, so the newest
+    // TRACE_RING_EVENTS of both are core 0's
+    newest &= out[n - 1].startUs == 1000 + (total - 1) * 10 && cores[n - 1] == 0;
+    bool intact = true;
+    for (size_t i = 0; i < n; i++) {
+        uint32_t index = (out[i].startUs - 1000) / 10;
+        intact &= cores[i] == 0 ? strcmp(out[i].name, "core0") == 0 && out[i].durUs == index % 7
+                                : strcmp(out[i].name, "core1") == 0 && out[i].durUs == 1;
+    }
+    check(newest && ordered, "ring", "Recent: newest spans, oldest first");
+    check(intact, "ring", "spans read back intact after wrapping");
+
+    size_t few = rings.Recent(now, out, cores, 3);
+    check(few == 3 && out[2].startUs == 1000 + (total - 1) * 10 && out[0].startUs == 1000 + (total - 3) * 10, "ring",
+          "Recent with a small max keeps the newest");
+
+    rings.Clear();
+    rings.Record(1, task(2), "early", 100, 150);
+    rings.Record(0, task(1), "late", 120, 130);
+    n = rings.Recent(200, out, cores, 8);
+    check(n == 2 && strcmp(out[0].name, "early") == 0 && cores[0] == 1 && cores[1] == 0, "ring",
+          "Recent merges the cores by start time");
+
+    // Tasks preempting each other on one core: no two spans in one slot
+    rings.Clear();
+    const int writers = 4;
+    const uint32_t each = TRACE_RING_EVENTS / writers - 4;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < writers; t++) {
+        threads.emplace_back([t, each] {
+            for (uint32_t i = 0; i < each; i++) {
+                rings.Record(0, task(100 + t), "task", (int64_t)t << 20 | i, ((int64_t)t << 20 | i) + t);
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    n = rings.Recent(UINT32_MAX, out, cores, TRACE_RING_EVENTS);
+    std::vector<int> seen(writers * each, 0);
+    bool distinct = n == writers * each;
+    for (size_t i = 0; i < n; i++) {
+        uintptr_t t = (uintptr_t)out[i].task - 100;
+        uint32_t index = out[i].startUs & 0xfffff;
+        bool ok = t < (uintptr_t)writers && out[i].startUs >> 20 == t && index < each && out[i].durUs == t;
+        distinct &= ok && ++seen[t * each + index] == 1;
+    }
+    check(distinct, "ring", "concurrent writers on one core get their own slots");
+
+    rings.Enable(false);
+    check(!rings.Recording(), "ring", "disabled");
+    rings.Enable(true);
+    rings.Clear();
+    check(rings.Recording() && rings.Held(0) == 0 && rings.Held(1) == 0, "ring", "Clear empties both rings");
+}
+
+static void checkChrome() {
+    rings.Clear();
+    // Clock just past a 32-bit wrap: some spans started before it
+    const int64_t now = (1LL << 32) + 5000000;
+    const int spans = 300;
+    for (int i = 0; i < spans; i++) {
+        int64_t start = now - 9000000 + i * 30000;
+        rings.Record(i % 2, task(0x3ffb0000u + i % 3), i % 5 ? "http.request" : "camera.capture", start,
+                     start + 1000 + i);
+    }
+
+    std::vector<char> buf(1500);
+    Dump split;
+    split.cap = buf.size();
+    rings.ChromeJson(now, buf.data(), buf.size(), true, collect, &split);
+    Dump whole;
+    whole.cap = buf.size();
+    rings.ChromeJson(now, buf.data(), buf.size(), false, collect, &whole);
+
+    JsonSyntax syntax;
+    bool valid = split.pieces.size() > 1;
+    bool fits = true;
+    std::vector<DumpedEvent> fromSplit;
+    for (const std::string& piece : split.pieces) {
+        valid &= syntax.Valid(piece);
+        fits &= piece.size() <= split.cap;
+        std::vector<DumpedEvent> part = events(piece);
+        fromSplit.insert(fromSplit.end(), part.begin(), part.end());
+    }
+    check(valid, "chrome", "split: every message is a JSON document");
+    check(fits, "chrome", "split: every message fits the buffer");
+
+    std::string joined;
+    fits = true;
+    for (const std::string& piece : whole.pieces) {
+        joined += piece;
+        fits &= piece.size() <= whole.cap;
+    }
+    check(whole.pieces.size() > 1 && fits && syntax.Valid(joined), "chrome",
+          "unsplit: pieces fit the buffer and join into one document");
+    check(joined.find("\"process_name\",\"ph\":\"M\",\"pid\":1") != std::string::npos &&
+              joined.find("\"displayTimeUnit\":\"ms\"") != std::string::npos,
+          "chrome", "core names and time unit");
+
+    // Core 0's spans, then core 1's, each oldest first
+    std::vector<DumpedEvent> dumped = events(joined);
+    bool exact = dumped.size() == spans;
+    for (size_t k = 0; exact && k < dumped.size(); k++) {
+        int core = k < spans / 2 ? 0 : 1;
+        int i = (int)(k % (spans / 2)) * 2 + core;
+        const DumpedEvent& e = dumped[k];
+        exact = e.name == (i % 5 ? "http.request" : "camera.capture") && e.ts == now - 9000000 + i * 30000 &&
+                e.dur == (unsigned)(1000 + i) && e.pid == core && e.tid == 0x3ffb0000u + i % 3;
+    }
+    check(exact, "chrome", "one X event per span: name, ts, dur, pid, tid");
+    check(dumped.size() == fromSplit.size(), "chrome", "split and unsplit dumps hold the same spans");
+    bool unwrapped = true;
+    for (const DumpedEvent& e : dumped) {
+        unwrapped &= e.ts > (1LL << 32) - 5000000 && e.ts <= now;
+    }
+    check(unwrapped, "chrome", "start times unwrapped across the 32-bit wrap");
+    check(rings.Recording(), "chrome", "recording resumes after a dump");
+
+    Dump tiny;
+    char small[64];
+    rings.ChromeJson(now, small, sizeof(small), true, collect, &tiny);
+    check(tiny.pieces.empty(), "chrome", "buffer too small for one event: nothing written");
+}
+
+/// @brief TraceSpan with the host clock
+class HostSpan {
+    const char* _name;
+    int64_t _start;
+
+public:
+    inline explicit HostSpan(const char* name) : _name(name), _start(rings.Recording() ? nowUs() : 0) {}
+    inline ~HostSpan() {
+        if (_start) {
+            rings.Record(0, nullptr, _name, _start, nowUs());
+        }
+    }
+};
+
+// Best of a few runs, ns per span
+static double spanCost() {
+    double best = 1e9;
+    for (int run = 0; run < 5; run++) {
+        timespec a, b;
+        clock_gettime(CLOCK_MONOTONIC, &a);
+        for (int i = 0; i < OVERHEAD_SPANS; i++) {
+            HostSpan span("overhead");
+        }
+        clock_gettime(CLOCK_MONOTONIC, &b);
+        double ns = ((b.tv_sec - a.tv_sec) * 1e9 + (b.tv_nsec - a.tv_nsec)) / OVERHEAD_SPANS;
+        best = ns < best ? ns : best;
+    }
+    return best;
+}
+
+static void checkOverhead() {
+    rings.Clear();
+    double enabled = spanCost();
+    rings.Enable(false);
+    double disabled = spanCost();
+    rings.Enable(true);
+    printf("         %-8s %.0f ns per span, %.1f ns disabled\n", "overhead", enabled, disabled);
+    check(enabled < SPAN_BUDGET_NS, "overhead", "span under 1 us");
+    check(disabled < enabled, "overhead", "disabled span cheaper than a recorded one");
+    check(rings.Held(0) == TRACE_RING_EVENTS, "overhead", "spans were recorded");
+}
+
+int main() {
+    checkRing();
+    checkChrome();
+    checkOverhead();
+
+    if (failures) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,173 @@
+// Upload target selection check (upload_target_scores.cpp) against two S3
+// stand-ins (tools/s3_standin.py), which it starts itself: "fast" with a
+// bandwidth limit only, "slow" with the same limit plus --latency and
+// --fail-rate.
+//
+//   size      fast only sent photos, slow only sent status documents; the
+//             raw request times favour slow, the cost per KB favours fast
+//   pick      mixed status and photo uploads all go to fast
+//   failover  fast stops; uploads land on slow and fast cools down
+//   cooldown  fast comes back; slow keeps the traffic until the cooldown
+//             ends, then it returns to fast
+//
+// Uploads run like putToS3WithRetry: the best target first, then the others.
+// The cooldown runs on a virtual clock. Each stored object must match the
+// uploaded bytes. Exits 1 on any failure.
+//
+// Build:  g++ -std=c++17 -O2 -I include -o upload_targets_check tools/upload_targets_check.cpp src/common/upload_target_scores.cpp
+// Usage:  upload_targets_check [seed]      (from the repository root)
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+#include "standin_client.h"
+#include "upload_target_scores.h"
+
+#define FAST 0
+#define SLOW 1
+#define PHOTO_SIZE (100 * 1024)
+#define STATUS_SIZE 1024
+#define UPLOAD_ATTEMPTS 6
+
+static int failures = 0;
+
+static void check(bool ok, const char* scenario, const char* what) {
+    printf("%s %-9s %s\n", ok ? "ok  " : "FAIL", scenario, what);
+    failures += !ok;
+}
+
+static StandIn standIns[2];
+static UploadTargetScores scores;
+static std::mt19937 rng;
+static uint32_t skewMs = 0;         // virtual time added to the real clock
+static uint32_t keys = 0;
+static uint32_t mismatches = 0;
+static double rawMs[2];             // plain request time totals, what the old score averaged
+static uint32_t rawCount[2];
+
+static uint32_t realMs() {
+    using namespace std::chrono;
+    static const steady_clock::time_point start = steady_clock::now();
+    return (uint32_t)duration_cast<milliseconds>(steady_clock::now() - start).count();
+}
+
+static uint32_t nowMs() { return realMs() + skewMs; }
+
+static std::string payload(size_t len) {
+    std::string data(len, '\0');
+    for (char& c : data) {
+        c = (char)rng();
+    }
+    return data;
+}
+
+/// @brief One PUT to target index, accounted like the firmware does
+static bool put(int index, const std::string& data) {
+    std::string key = "/cats/check/" + std::to_string(++keys) + ".jpg";
+    uint32_t start = realMs();
+    HttpResponse response;
+    int status = httpRequest(standIns[index].port, "PUT", key, {{"Content-Type", "image/jpeg"}},
+                             data.data(), data.size(), response);
+    uint32_t ms = realMs() - start;
+    bool ok = status >= 200 && status < 300;
+    scores.Record(index, ms, data.size(), ok, nowMs());
+    if (ok) {
+        rawMs[index] += ms;
+        ++rawCount[index];
+        mismatches += standIns[index].Object(key) != data;
+    }
+    return ok;
+}
+
+/// @brief Best target first, then the others. Returns where it landed, -1 when nowhere.
+static int upload(size_t len) {
+    std::string data = payload(len);
+    uint32_t tried = 0;
+    for (int attempt = 0; attempt < UPLOAD_ATTEMPTS; attempt++) {
+        int index = scores.Select(tried, nowMs());
+        if (index < 0) {
+            tried = 0;
+            index = scores.Select(tried, nowMs());
+        }
+        tried |= 1u << index;
+        if (put(index, data)) {
+            return index;
+        }
+    }
+    return -1;
+}
+
+/// @brief Uploads alternating status documents and photos. Returns how many landed on index.
+static int uploads(int count, int index) {
+    int landed = 0;
+    for (int i = 0; i < count; i++) {
+        landed += upload(i % 2 ? PHOTO_SIZE : STATUS_SIZE) == index;
+    }
+    return landed;
+}
+
+int main(int argc, char** argv) {
+    unsigned seed = argc > 1 ? (unsigned)atoi(argv[1]) : 7;
+    rng.seed(seed);
+    std::string seedArg = std::to_string(seed);
+    if (!standIns[FAST].Start({"--no-verify", "--bandwidth", "200000"}) ||
+        !standIns[SLOW].Start({"--no-verify", "--bandwidth", "200000", "--latency", "300", "--fail-rate", "0.2",
+                               "--seed", seedArg})) {
+        fprintf(stderr, "cannot start tools/s3_standin.py (run from the repository root)\n");
+        return 2;
+    }
+    scores.Add();
+    scores.Add();
+
+    // size: each target measured on one kind of payload only
+    for (int i = 0; i < 10 && rawCount[FAST] < 3; i++) {
+        put(FAST, payload(PHOTO_SIZE));
+    }
+    for (int i = 0; i < 10 && rawCount[SLOW] < 3; i++) {
+        put(SLOW, payload(STATUS_SIZE));
+    }
+    if (rawCount[FAST] == 0 || rawCount[SLOW] == 0) {
+        fprintf(stderr, "no upload to the stand-ins succeeded\n");
+        return 2;
+    }
+    check(rawMs[SLOW] / rawCount[SLOW] < rawMs[FAST] / rawCount[FAST], "size",
+          "raw request times favour the slow target");
+    check(scores.Target(FAST).msPerKb < scores.Target(SLOW).msPerKb, "size",
+          "cost per KB favours the fast target");
+    skewMs += UPLOAD_TARGET_MAX_COOLDOWN_MS;     // forget any 503 cooldown of the warm-up
+    check(scores.Select(0, nowMs()) == FAST, "size", "fast target selected");
+
+    // pick
+    check(uploads(20, FAST) == 20, "pick", "20 mixed uploads on the fast target");
+
+    // failover
+    standIns[FAST].Stop();
+    check(uploads(10, SLOW) == 10, "failover", "10 uploads land on the slow target");
+    check(scores.CooldownLeft(FAST, nowMs()) > 0, "failover", "fast target cooling down");
+    check(scores.Target(FAST).failed > 0, "failover", "fast target failures counted");
+
+    // cooldown
+    if (!standIns[FAST].Start({"--no-verify", "--bandwidth", "200000"})) {
+        fprintf(stderr, "cannot restart the fast stand-in\n");
+        return 2;
+    }
+    check(scores.Select(0, nowMs()) == SLOW, "cooldown", "slow target kept during the cooldown");
+    skewMs += scores.CooldownLeft(FAST, nowMs()) + 1;
+    check(scores.Select(0, nowMs()) == FAST, "cooldown", "fast target selected after the cooldown");
+    check(uploads(10, FAST) == 10, "cooldown", "10 uploads back on the fast target");
+
+    check(mismatches == 0, "all", "stored objects match the uploads");
+    printf("fast %.1f ms/KB (%u ok, %u failed), slow %.1f ms/KB (%u ok, %u failed)\n",
+           scores.Target(FAST).msPerKb, scores.Target(FAST).ok, scores.Target(FAST).failed,
+           scores.Target(SLOW).msPerKb, scores.Target(SLOW).ok, scores.Target(SLOW).failed);
+
+    if (failures) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}